@@ -0,0 +1,1033 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Replays a surface commit stream recorded by the "commits" debug scope:
+ *
+ *	weston-debug -o commits.log commits
+ *	weston-commit-replay commits.log
+ *
+ * Every recorded surface is recreated with the same role, buffer sizes,
+ * damage, viewport, buffer transform and scale, sub-surface position and
+ * stacking, and committed at the recorded pace. The buffer contents are
+ * not recorded; they are filled with a different solid color on every
+ * commit. Root surfaces are replayed as xdg_toplevels, whatever their
+ * original shell role was; cursor and drag icon surfaces are skipped.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include <wayland-client.h>
+#include "shared/helpers.h"
+#include <libweston/zalloc.h>
+#include "shared/timespec-util.h"
+#include "shared/os-compatibility.h"
+#include "shared/weston-drm-fourcc.h"
+#include "presentation-time-client-protocol.h"
+#include "viewporter-client-protocol.h"
+#include "xdg-shell-client-protocol.h"
+
+/* Buffers kept per surface before busy ones get reused anyway. */
+#define MAX_BUFFERS 4
+
+struct display {
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	uint32_t compositor_version;
+	struct wl_subcompositor *subcompositor;
+	struct xdg_wm_base *wm_base;
+	struct wp_viewporter *viewporter;
+
+	struct wl_shm *shm;
+
+	struct wp_presentation *presentation;
+	clockid_t clk_id;
+
+	struct wl_list surface_list; /* struct replay_surface::link */
+
+	bool fast;
+	uint32_t color;
+
+	unsigned commits;
+	unsigned surfaces;
+	unsigned skipped;
+	unsigned feedback_pending;
+	unsigned presented;
+	unsigned discarded;
+	int64_t latency_sum_nsec;
+	int64_t latency_max_nsec;
+};
+
+struct buffer {
+	struct wl_buffer *buffer;
+	void *data;
+	size_t size;
+	int width, height;
+	uint32_t format;
+	bool busy;
+};
+
+struct replay_surface {
+	struct display *display;
+	struct wl_list link;
+	char id[32];
+	bool ignored;
+
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *xdg_toplevel;
+	struct wl_subsurface *subsurface;
+	struct replay_surface *parent;
+	struct wp_viewport *viewport;
+	uint32_t configure_serial;
+
+	int sync;
+	int32_t scale;
+	uint32_t transform;
+
+	struct buffer buffers[MAX_BUFFERS];
+	unsigned next_buffer;
+
+	struct wl_callback *frame;
+};
+
+struct feedback {
+	struct display *display;
+	struct wp_presentation_feedback *feedback;
+	struct timespec commit;
+};
+
+static int running = 1;
+
+static void
+buffer_release(void *data, struct wl_buffer *buffer)
+{
+	struct buffer *mybuf = data;
+
+	mybuf->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	buffer_release
+};
+
+static void
+buffer_fini(struct buffer *buf)
+{
+	if (!buf->buffer)
+		return;
+
+	wl_buffer_destroy(buf->buffer);
+	munmap(buf->data, buf->size);
+	memset(buf, 0, sizeof *buf);
+}
+
+static int
+buffer_init(struct display *display, struct buffer *buf,
+	    int width, int height, uint32_t format)
+{
+	struct wl_shm_pool *pool;
+	int fd, stride;
+
+	stride = width * 4;
+	buf->size = (size_t)stride * height;
+
+	fd = os_create_anonymous_file(buf->size);
+	if (fd < 0) {
+		fprintf(stderr, "creating a buffer file for %zu B failed: %s\n",
+			buf->size, strerror(errno));
+		return -1;
+	}
+
+	buf->data = mmap(NULL, buf->size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fd, 0);
+	if (buf->data == MAP_FAILED) {
+		fprintf(stderr, "mmap failed: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	pool = wl_shm_create_pool(display->shm, fd, buf->size);
+	buf->buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+						stride, format);
+	wl_buffer_add_listener(buf->buffer, &buffer_listener, buf);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	buf->width = width;
+	buf->height = height;
+	buf->format = format;
+
+	return 0;
+}
+
+/* Maps a recorded "type:0xfourcc" buffer format to one of the two wl_shm
+ * formats every compositor supports; only opaqueness is kept. */
+static uint32_t
+replay_shm_format(const char *format)
+{
+	char type[8];
+	uint32_t fourcc;
+
+	if (!format || sscanf(format, "%7[^:]:%" SCNx32, type, &fourcc) != 2)
+		return WL_SHM_FORMAT_ARGB8888;
+
+	if (strcmp(type, "shm") == 0 && fourcc == WL_SHM_FORMAT_XRGB8888)
+		return WL_SHM_FORMAT_XRGB8888;
+
+	if (strcmp(type, "shm") != 0 && fourcc == DRM_FORMAT_XRGB8888)
+		return WL_SHM_FORMAT_XRGB8888;
+
+	return WL_SHM_FORMAT_ARGB8888;
+}
+
+static struct buffer *
+replay_surface_get_buffer(struct replay_surface *rs, int width, int height,
+			  uint32_t format)
+{
+	struct buffer *buf = NULL;
+	unsigned i;
+
+	for (i = 0; i < MAX_BUFFERS; i++) {
+		struct buffer *b = &rs->buffers[i];
+
+		if (b->buffer && !b->busy && b->width == width &&
+		    b->height == height && b->format == format)
+			return b;
+	}
+
+	for (i = 0; i < MAX_BUFFERS && !buf; i++) {
+		if (!rs->buffers[i].buffer || !rs->buffers[i].busy)
+			buf = &rs->buffers[i];
+	}
+
+	if (!buf) {
+		buf = &rs->buffers[rs->next_buffer];
+		rs->next_buffer = (rs->next_buffer + 1) % MAX_BUFFERS;
+	}
+
+	buffer_fini(buf);
+	if (buffer_init(rs->display, buf, width, height, format) < 0)
+		return NULL;
+
+	return buf;
+}
+
+static void
+buffer_fill(struct buffer *buf, uint32_t color)
+{
+	uint32_t *pixel = buf->data;
+	size_t i;
+
+	for (i = 0; i < buf->size / 4; i++)
+		pixel[i] = color;
+}
+
+static void
+xdg_wm_base_handle_ping(void *data, struct xdg_wm_base *xdg_wm_base,
+			uint32_t serial)
+{
+	xdg_wm_base_pong(xdg_wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener xdg_wm_base_listener = {
+	.ping = xdg_wm_base_handle_ping,
+};
+
+static void
+xdg_surface_handle_configure(void *data, struct xdg_surface *xdg_surface,
+			     uint32_t serial)
+{
+	struct replay_surface *rs = data;
+
+	rs->configure_serial = serial;
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_handle_configure,
+};
+
+static void
+xdg_toplevel_handle_configure(void *data, struct xdg_toplevel *xdg_toplevel,
+			      int32_t width, int32_t height,
+			      struct wl_array *states)
+{
+	/* The recorded buffer sizes win. */
+}
+
+static void
+xdg_toplevel_handle_close(void *data, struct xdg_toplevel *xdg_toplevel)
+{
+	running = 0;
+}
+
+static const struct xdg_toplevel_listener xdg_toplevel_listener = {
+	.configure = xdg_toplevel_handle_configure,
+	.close = xdg_toplevel_handle_close,
+};
+
+static struct replay_surface *
+display_find_surface(struct display *display, const char *id)
+{
+	struct replay_surface *rs;
+
+	wl_list_for_each(rs, &display->surface_list, link) {
+		if (strcmp(rs->id, id) == 0)
+			return rs;
+	}
+
+	return NULL;
+}
+
+static struct replay_surface *
+display_get_surface(struct display *display, const char *id)
+{
+	struct replay_surface *rs;
+
+	rs = display_find_surface(display, id);
+	if (rs)
+		return rs;
+
+	rs = zalloc(sizeof *rs);
+	assert(rs);
+
+	rs->display = display;
+	snprintf(rs->id, sizeof rs->id, "%s", id);
+	rs->surface = wl_compositor_create_surface(display->compositor);
+	rs->scale = 1;
+	rs->transform = WL_OUTPUT_TRANSFORM_NORMAL;
+	wl_list_insert(display->surface_list.prev, &rs->link);
+	display->surfaces++;
+
+	return rs;
+}
+
+static void
+replay_surface_destroy(struct replay_surface *rs)
+{
+	struct replay_surface *child;
+	unsigned i;
+
+	wl_list_for_each(child, &rs->display->surface_list, link) {
+		if (child->parent != rs)
+			continue;
+
+		/* The sub-surface becomes inert, as in the original stream. */
+		if (child->subsurface)
+			wl_subsurface_destroy(child->subsurface);
+		child->subsurface = NULL;
+		child->parent = NULL;
+	}
+
+	if (rs->frame)
+		wl_callback_destroy(rs->frame);
+	if (rs->viewport)
+		wp_viewport_destroy(rs->viewport);
+	if (rs->subsurface)
+		wl_subsurface_destroy(rs->subsurface);
+	if (rs->xdg_toplevel)
+		xdg_toplevel_destroy(rs->xdg_toplevel);
+	if (rs->xdg_surface)
+		xdg_surface_destroy(rs->xdg_surface);
+	wl_surface_destroy(rs->surface);
+
+	for (i = 0; i < MAX_BUFFERS; i++)
+		buffer_fini(&rs->buffers[i]);
+
+	wl_list_remove(&rs->link);
+	free(rs);
+}
+
+static void
+replay_surface_make_toplevel(struct replay_surface *rs)
+{
+	struct display *display = rs->display;
+
+	rs->xdg_surface = xdg_wm_base_get_xdg_surface(display->wm_base,
+						      rs->surface);
+	xdg_surface_add_listener(rs->xdg_surface, &xdg_surface_listener, rs);
+	rs->xdg_toplevel = xdg_surface_get_toplevel(rs->xdg_surface);
+	xdg_toplevel_add_listener(rs->xdg_toplevel, &xdg_toplevel_listener, rs);
+	xdg_toplevel_set_title(rs->xdg_toplevel, rs->id);
+
+	/* Wait for the initial configure before the first buffer. */
+	wl_surface_commit(rs->surface);
+	wl_display_roundtrip(display->display);
+}
+
+static void
+replay_surface_make_subsurface(struct replay_surface *rs,
+			       struct replay_surface *parent)
+{
+	rs->parent = parent;
+	rs->subsurface =
+		wl_subcompositor_get_subsurface(rs->display->subcompositor,
+						rs->surface, parent->surface);
+	rs->sync = 1;
+}
+
+static void
+feedback_sync_output(void *data,
+		     struct wp_presentation_feedback *presentation_feedback,
+		     struct wl_output *output)
+{
+	/* not interested */
+}
+
+static void
+feedback_presented(void *data,
+		   struct wp_presentation_feedback *presentation_feedback,
+		   uint32_t tv_sec_hi,
+		   uint32_t tv_sec_lo,
+		   uint32_t tv_nsec,
+		   uint32_t refresh_nsec,
+		   uint32_t seq_hi,
+		   uint32_t seq_lo,
+		   uint32_t flags)
+{
+	struct feedback *fb = data;
+	struct display *display = fb->display;
+	struct timespec present;
+	int64_t latency;
+
+	timespec_from_proto(&present, tv_sec_hi, tv_sec_lo, tv_nsec);
+	latency = timespec_sub_to_nsec(&present, &fb->commit);
+
+	display->presented++;
+	display->latency_sum_nsec += latency;
+	if (latency > display->latency_max_nsec)
+		display->latency_max_nsec = latency;
+
+	display->feedback_pending--;
+	wp_presentation_feedback_destroy(fb->feedback);
+	free(fb);
+}
+
+static void
+feedback_discarded(void *data,
+		   struct wp_presentation_feedback *presentation_feedback)
+{
+	struct feedback *fb = data;
+	struct display *display = fb->display;
+
+	display->discarded++;
+	display->feedback_pending--;
+	wp_presentation_feedback_destroy(fb->feedback);
+	free(fb);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	feedback_sync_output,
+	feedback_presented,
+	feedback_discarded
+};
+
+static void
+replay_surface_create_feedback(struct replay_surface *rs)
+{
+	struct display *display = rs->display;
+	struct feedback *fb;
+
+	if (!display->presentation)
+		return;
+
+	fb = zalloc(sizeof *fb);
+	assert(fb);
+
+	fb->display = display;
+	fb->feedback = wp_presentation_feedback(display->presentation,
+						rs->surface);
+	wp_presentation_feedback_add_listener(fb->feedback,
+					      &feedback_listener, fb);
+	clock_gettime(display->clk_id, &fb->commit);
+	display->feedback_pending++;
+}
+
+static void
+frame_done(void *data, struct wl_callback *callback, uint32_t time)
+{
+	struct replay_surface *rs = data;
+
+	wl_callback_destroy(callback);
+	rs->frame = NULL;
+}
+
+static const struct wl_callback_listener frame_listener = {
+	frame_done
+};
+
+/* Parses "x,y,w,h;x,y,w,h;..." and calls damage for every rectangle. */
+static void
+apply_damage(struct replay_surface *rs, const char *value, bool buffer)
+{
+	const char *p = value;
+	int x, y, w, h, n;
+
+	while (sscanf(p, "%d,%d,%d,%d%n", &x, &y, &w, &h, &n) == 4) {
+		if (!buffer)
+			wl_surface_damage(rs->surface, x, y, w, h);
+		else if (rs->display->compositor_version >= 4)
+			wl_surface_damage_buffer(rs->surface, x, y, w, h);
+		else
+			wl_surface_damage(rs->surface, 0, 0, INT32_MAX,
+					  INT32_MAX);
+
+		p += n;
+		if (*p != ';')
+			break;
+		p++;
+	}
+}
+
+static void
+apply_positions(struct display *display, const char *value)
+{
+	char id[32];
+	const char *p = value;
+	struct replay_surface *child;
+	int x, y, n;
+
+	while (sscanf(p, "%31[^:]:%d,%d%n", id, &x, &y, &n) == 3) {
+		child = display_find_surface(display, id);
+		if (child && child->subsurface)
+			wl_subsurface_set_position(child->subsurface, x, y);
+
+		p += n;
+		if (*p != ';')
+			break;
+		p++;
+	}
+}
+
+/* The recorded order lists the sub-surfaces top-most first, with the
+ * parent itself among them. Restack everything relative to the parent. */
+static void
+apply_order(struct replay_surface *rs, char *value)
+{
+	struct replay_surface *list[64];
+	char *tok, *save = NULL;
+	int n = 0, self = -1, i;
+
+	for (tok = strtok_r(value, ";", &save); tok && n < 64;
+	     tok = strtok_r(NULL, ";", &save)) {
+		struct replay_surface *s;
+
+		s = display_find_surface(rs->display, tok);
+		if (!s || (s != rs && (s->parent != rs || !s->subsurface)))
+			continue;
+		if (s == rs)
+			self = n;
+		list[n++] = s;
+	}
+
+	if (self < 0)
+		return;
+
+	for (i = self - 1; i >= 0; i--)
+		wl_subsurface_place_above(list[i]->subsurface,
+					  list[i + 1]->surface);
+	for (i = self + 1; i < n; i++)
+		wl_subsurface_place_below(list[i]->subsurface,
+					  list[i - 1]->surface);
+}
+
+static void
+replay_commit(struct display *display, const char *id, char *args)
+{
+	struct replay_surface *rs = display_find_surface(display, id);
+	struct buffer *buf = NULL;
+	char *key[64], *value[64];
+	char *tok, *save = NULL;
+	char *role = NULL, *parent = NULL, *size = NULL, *format = NULL;
+	int sync = -1;
+	int32_t scale = 1;
+	uint32_t transform = WL_OUTPUT_TRANSFORM_NORMAL;
+	int width = 0, height = 0, dx = 0, dy = 0;
+	bool has_src = false, has_dst = false;
+	double src[4];
+	int dst[2];
+	int n = 0, i;
+
+	for (tok = strtok_r(args, " \n", &save); tok && n < 64;
+	     tok = strtok_r(NULL, " \n", &save)) {
+		char *eq = strchr(tok, '=');
+
+		if (!eq)
+			continue;
+		*eq = '\0';
+		key[n] = tok;
+		value[n] = eq + 1;
+		n++;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (strcmp(key[i], "role") == 0)
+			role = value[i];
+		else if (strcmp(key[i], "parent") == 0)
+			parent = value[i];
+		else if (strcmp(key[i], "sync") == 0)
+			sync = atoi(value[i]);
+		else if (strcmp(key[i], "buffer") == 0)
+			size = value[i];
+		else if (strcmp(key[i], "format") == 0)
+			format = value[i];
+		else if (strcmp(key[i], "offset") == 0)
+			sscanf(value[i], "%d,%d", &dx, &dy);
+		else if (strcmp(key[i], "scale") == 0)
+			scale = atoi(value[i]);
+		else if (strcmp(key[i], "transform") == 0)
+			transform = strtoul(value[i], NULL, 10);
+		else if (strcmp(key[i], "src") == 0)
+			has_src = sscanf(value[i], "%lf,%lf,%lf,%lf", &src[0],
+					 &src[1], &src[2], &src[3]) == 4;
+		else if (strcmp(key[i], "dst") == 0)
+			has_dst = sscanf(value[i], "%d,%d", &dst[0],
+					 &dst[1]) == 2;
+	}
+
+	if (!rs) {
+		rs = display_get_surface(display, id);
+		if (role && (strcmp(role, "wl_pointer-cursor") == 0 ||
+			     strcmp(role, "wl_data_device-icon") == 0))
+			rs->ignored = true;
+	}
+
+	if (rs->ignored) {
+		display->skipped++;
+		return;
+	}
+
+	if (parent && !rs->subsurface && !rs->xdg_surface) {
+		replay_surface_make_subsurface(rs,
+			display_get_surface(display, parent));
+	} else if (!parent && role && strcmp(role, "none") != 0 &&
+		   strcmp(role, "wl_subsurface") != 0 &&
+		   !rs->subsurface && !rs->xdg_surface) {
+		replay_surface_make_toplevel(rs);
+	}
+
+	if (rs->subsurface && sync >= 0 && sync != rs->sync) {
+		if (sync)
+			wl_subsurface_set_sync(rs->subsurface);
+		else
+			wl_subsurface_set_desync(rs->subsurface);
+		rs->sync = sync;
+	}
+
+	if (rs->configure_serial) {
+		xdg_surface_ack_configure(rs->xdg_surface,
+					  rs->configure_serial);
+		rs->configure_serial = 0;
+	}
+
+	if (scale != rs->scale) {
+		wl_surface_set_buffer_scale(rs->surface, scale);
+		rs->scale = scale;
+	}
+
+	if (transform != rs->transform) {
+		wl_surface_set_buffer_transform(rs->surface, transform);
+		rs->transform = transform;
+	}
+
+	if ((has_src || has_dst) && !rs->viewport && display->viewporter)
+		rs->viewport = wp_viewporter_get_viewport(display->viewporter,
+							  rs->surface);
+	if (rs->viewport) {
+		if (has_src)
+			wp_viewport_set_source(rs->viewport,
+					       wl_fixed_from_double(src[0]),
+					       wl_fixed_from_double(src[1]),
+					       wl_fixed_from_double(src[2]),
+					       wl_fixed_from_double(src[3]));
+		else
+			wp_viewport_set_source(rs->viewport,
+					       wl_fixed_from_int(-1),
+					       wl_fixed_from_int(-1),
+					       wl_fixed_from_int(-1),
+					       wl_fixed_from_int(-1));
+
+		if (has_dst)
+			wp_viewport_set_destination(rs->viewport,
+						    dst[0], dst[1]);
+		else
+			wp_viewport_set_destination(rs->viewport, -1, -1);
+	}
+
+	if (size && strcmp(size, "none") == 0) {
+		wl_surface_attach(rs->surface, NULL, 0, 0);
+	} else if (size && sscanf(size, "%dx%d", &width, &height) == 2 &&
+		   width > 0 && height > 0) {
+		buf = replay_surface_get_buffer(rs, width, height,
+						replay_shm_format(format));
+		if (buf) {
+			buffer_fill(buf, display->color);
+			display->color += 0x00010305;
+			wl_surface_attach(rs->surface, buf->buffer, dx, dy);
+			buf->busy = true;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if (strcmp(key[i], "damage") == 0)
+			apply_damage(rs, value[i], false);
+		else if (strcmp(key[i], "bdamage") == 0)
+			apply_damage(rs, value[i], true);
+		else if (strcmp(key[i], "pos") == 0)
+			apply_positions(display, value[i]);
+		else if (strcmp(key[i], "order") == 0)
+			apply_order(rs, value[i]);
+	}
+
+	if (buf) {
+		replay_surface_create_feedback(rs);
+
+		if (display->fast && !rs->subsurface && !rs->frame) {
+			rs->frame = wl_surface_frame(rs->surface);
+			wl_callback_add_listener(rs->frame, &frame_listener, rs);
+		}
+	}
+
+	wl_surface_commit(rs->surface);
+	display->commits++;
+
+	/* As fast as possible: one frame in flight per root surface. */
+	while (display->fast && rs->frame && running) {
+		if (wl_display_dispatch(display->display) < 0)
+			running = 0;
+	}
+}
+
+/* Dispatches events until the given time on the monotonic clock. */
+static void
+wait_until(struct display *display, const struct timespec *target)
+{
+	struct pollfd pfd = {
+		.fd = wl_display_get_fd(display->display),
+		.events = POLLIN,
+	};
+	struct timespec now;
+	int64_t remaining;
+
+	while (running) {
+		wl_display_dispatch_pending(display->display);
+		wl_display_flush(display->display);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		remaining = timespec_sub_to_msec(target, &now);
+		if (remaining <= 0)
+			break;
+
+		if (poll(&pfd, 1, remaining) > 0 &&
+		    wl_display_dispatch(display->display) < 0)
+			running = 0;
+	}
+}
+
+static int
+replay(struct display *display, FILE *fp)
+{
+	struct timespec base, start, target;
+	bool have_base = false;
+	char *line = NULL;
+	size_t len = 0;
+	int64_t sec;
+	long nsec;
+	int n;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (running && getline(&line, &len, fp) >= 0) {
+		struct timespec stamp;
+		char event[16], id[32];
+
+		/* Anything else in the log, e.g. the scope header, is not
+		 * part of the stream. */
+		if (sscanf(line, "%" SCNd64 ".%ld %15s %31s %n", &sec, &nsec,
+			   event, id, &n) != 4)
+			continue;
+
+		stamp.tv_sec = sec;
+		stamp.tv_nsec = nsec;
+		if (!have_base) {
+			base = stamp;
+			have_base = true;
+		}
+
+		if (!display->fast) {
+			timespec_add_nsec(&target, &start,
+					  timespec_sub_to_nsec(&stamp, &base));
+			wait_until(display, &target);
+		}
+
+		if (strcmp(event, "commit") == 0) {
+			replay_commit(display, id, line + n);
+		} else if (strcmp(event, "destroy") == 0) {
+			struct replay_surface *rs;
+
+			rs = display_find_surface(display, id);
+			if (rs)
+				replay_surface_destroy(rs);
+		}
+	}
+
+	free(line);
+
+	/* Collect the feedback of the last frames. */
+	while (running && display->feedback_pending > 0) {
+		if (wl_display_dispatch(display->display) < 0)
+			break;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &target);
+
+	printf("replayed %u commits on %u surfaces in %.3f s "
+	       "(%u commits skipped)\n", display->commits, display->surfaces,
+	       timespec_sub_to_nsec(&target, &start) / 1e9, display->skipped);
+	if (display->presentation) {
+		printf("presented %u, discarded %u", display->presented,
+		       display->discarded);
+		if (display->presented)
+			printf(", commit to present avg %.3f ms, max %.3f ms",
+			       display->latency_sum_nsec / 1e6 /
+			       display->presented,
+			       display->latency_max_nsec / 1e6);
+		printf("\n");
+	}
+
+	return 0;
+}
+
+static void
+presentation_clock_id(void *data, struct wp_presentation *presentation,
+		      uint32_t clk_id)
+{
+	struct display *d = data;
+
+	d->clk_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	presentation_clock_id
+};
+
+static void
+registry_handle_global(void *data, struct wl_registry *registry,
+		       uint32_t name, const char *interface, uint32_t version)
+{
+	struct display *d = data;
+
+	if (strcmp(interface, "wl_compositor") == 0) {
+		d->compositor_version = MIN(version, 4);
+		d->compositor =
+			wl_registry_bind(registry, name,
+					 &wl_compositor_interface,
+					 d->compositor_version);
+	} else if (strcmp(interface, "wl_subcompositor") == 0) {
+		d->subcompositor =
+			wl_registry_bind(registry, name,
+					 &wl_subcompositor_interface, 1);
+	} else if (strcmp(interface, "xdg_wm_base") == 0) {
+		d->wm_base =
+			wl_registry_bind(registry, name,
+					 &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(d->wm_base, &xdg_wm_base_listener,
+					 d);
+	} else if (strcmp(interface, "wp_viewporter") == 0) {
+		d->viewporter =
+			wl_registry_bind(registry, name,
+					 &wp_viewporter_interface, 1);
+	} else if (strcmp(interface, "wl_shm") == 0) {
+		d->shm = wl_registry_bind(registry,
+					  name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+		d->presentation =
+			wl_registry_bind(registry,
+					 name, &wp_presentation_interface, 1);
+		wp_presentation_add_listener(d->presentation,
+					     &presentation_listener, d);
+	}
+}
+
+static void
+registry_handle_global_remove(void *data, struct wl_registry *registry,
+			      uint32_t name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+	registry_handle_global,
+	registry_handle_global_remove
+};
+
+static struct display *
+create_display(bool fast)
+{
+	struct display *display;
+
+	display = zalloc(sizeof *display);
+	if (display == NULL) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	display->display = wl_display_connect(NULL);
+	if (!display->display) {
+		fprintf(stderr, "failed to connect to the compositor\n");
+		exit(1);
+	}
+
+	display->fast = fast;
+	display->clk_id = CLOCK_MONOTONIC;
+	display->color = 0xff204060;
+	wl_list_init(&display->surface_list);
+	display->registry = wl_display_get_registry(display->display);
+	wl_registry_add_listener(display->registry,
+				 &registry_listener, display);
+	wl_display_roundtrip(display->display);
+
+	if (!display->compositor || !display->subcompositor ||
+	    !display->wm_base || !display->shm) {
+		fprintf(stderr, "wl_compositor, wl_subcompositor, "
+			"xdg_wm_base and wl_shm are required\n");
+		exit(1);
+	}
+
+	/* Get the presentation clock. */
+	wl_display_roundtrip(display->display);
+
+	return display;
+}
+
+static void
+destroy_display(struct display *display)
+{
+	struct replay_surface *rs;
+
+	/* Destroy children first so their parents are still alive. */
+	while (!wl_list_empty(&display->surface_list)) {
+		rs = wl_container_of(display->surface_list.prev, rs, link);
+		replay_surface_destroy(rs);
+	}
+
+	if (display->presentation)
+		wp_presentation_destroy(display->presentation);
+	if (display->viewporter)
+		wp_viewporter_destroy(display->viewporter);
+	wl_shm_destroy(display->shm);
+	xdg_wm_base_destroy(display->wm_base);
+	wl_subcompositor_destroy(display->subcompositor);
+	wl_compositor_destroy(display->compositor);
+
+	wl_registry_destroy(display->registry);
+	wl_display_flush(display->display);
+	wl_display_disconnect(display->display);
+	free(display);
+}
+
+static void
+signal_int(int signum)
+{
+	running = 0;
+}
+
+static void
+usage(const char *prog, int exit_code)
+{
+	fprintf(stderr, "Usage: %s [options] FILE\n"
+		"Replays a commit stream recorded with "
+		"'weston-debug -o FILE commits'.\n"
+		"FILE can be - to read from stdin.\n"
+		"Options:\n"
+		"  -f\t\tcommit as fast as the compositor presents frames,\n"
+		"\t\tinstead of at the recorded pace\n"
+		"  -h\t\tthis help text\n\n",
+		prog);
+
+	exit(exit_code);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sigaction sigint;
+	struct display *display;
+	const char *path = NULL;
+	bool fast = false;
+	FILE *fp;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp("-f", argv[i]) == 0)
+			fast = true;
+		else if (strcmp("-h", argv[i]) == 0)
+			usage(argv[0], EXIT_SUCCESS);
+		else if (!path)
+			path = argv[i];
+		else
+			usage(argv[0], EXIT_FAILURE);
+	}
+
+	if (!path)
+		usage(argv[0], EXIT_FAILURE);
+
+	if (strcmp(path, "-") == 0) {
+		fp = stdin;
+	} else {
+		fp = fopen(path, "r");
+		if (!fp) {
+			fprintf(stderr, "cannot open %s: %s\n", path,
+				strerror(errno));
+			return 1;
+		}
+	}
+
+	display = create_display(fast);
+
+	sigint.sa_handler = signal_int;
+	sigemptyset(&sigint.sa_mask);
+	sigint.sa_flags = SA_RESETHAND;
+	sigaction(SIGINT, &sigint, NULL);
+
+	replay(display, fp);
+
+	destroy_display(display);
+	if (fp != stdin)
+		fclose(fp);
+
+	return 0;
+}
@@ -33,6 +33,7 @@
 #include <errno.h>
 #include <math.h>
 #include <cairo.h>
+#include <sys/epoll.h>
 #include <sys/wait.h>
 #include <linux/input.h>
 #include <libgen.h>
@@ -43,6 +44,7 @@
 #include <wayland-client.h>
 #include "window.h"
 #include "shared/cairo-util.h"
+#include "shared/image-loader.h"
 #include <libweston/config-parser.h>
 #include "shared/helpers.h"
 #include "shared/xalloc.h"
@@ -83,6 +85,12 @@ struct desktop {
 	enum cursor_type grab_cursor;
 
 	int painted;
+
+	/* decoded once for all backgrounds, at its native size */
+	struct image_loader_pool *image_pool;
+	struct task image_task;
+	cairo_surface_t *background_image;
+	bool background_image_loaded;
 };
 
 struct surface {
@@ -112,6 +120,7 @@ struct panel {
 struct background {
 	struct surface base;
 
+	struct desktop *desktop;
 	struct output *owner;
 
 	struct window *window;
@@ -121,6 +130,9 @@ struct background {
 	char *image;
 	int type;
 	uint32_t color;
+
+	/* the image is scaled by the compositor through wp_viewport */
+	int viewport;
 };
 
 struct output {
@@ -139,6 +151,7 @@ struct panel_launcher {
 	struct panel *panel;
 	cairo_surface_t *icon;
 	int focused, pressed;
+	int drawn_focused, drawn_pressed;
 	char *path;
 	struct wl_list link;
 	struct wl_array envp;
@@ -151,6 +164,7 @@ struct panel_clock {
 	struct toytimer timer;
 	char *format_string;
 	time_t refresh_timer;
+	char drawn[128];
 };
 
 struct unlock_dialog {
@@ -233,6 +247,31 @@ panel_launcher_activate(struct panel_launcher *widget)
 	}
 }
 
+static void
+set_hex_color(cairo_t *cr, uint32_t color)
+{
+	cairo_set_source_rgba(cr,
+			      ((color >> 16) & 0xff) / 255.0,
+			      ((color >>  8) & 0xff) / 255.0,
+			      ((color >>  0) & 0xff) / 255.0,
+			      ((color >> 24) & 0xff) / 255.0);
+}
+
+/* Refills the area of a panel child widget with the panel color, so that
+ * it can be drawn again over the retained panel content. */
+static void
+panel_clear_rectangle(struct panel *panel, cairo_t *cr,
+		      const struct rectangle *allocation)
+{
+	cairo_rectangle(cr, allocation->x, allocation->y,
+			allocation->width, allocation->height);
+	cairo_clip(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	set_hex_color(cr, panel->color);
+	cairo_paint(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+}
+
 static void
 panel_launcher_redraw_handler(struct widget *widget, void *data)
 {
@@ -240,9 +279,21 @@ panel_launcher_redraw_handler(struct widget *widget, void *data)
 	struct rectangle allocation;
 	cairo_t *cr;
 
+	if (widget_get_buffer_age(widget) == 1 &&
+	    launcher->drawn_focused == launcher->focused &&
+	    launcher->drawn_pressed == launcher->pressed)
+		return;
+
+	launcher->drawn_focused = launcher->focused;
+	launcher->drawn_pressed = launcher->pressed;
+
 	cr = widget_cairo_create(launcher->panel->widget);
 
 	widget_get_allocation(widget, &allocation);
+	panel_clear_rectangle(launcher->panel, cr, &allocation);
+	widget_damage(widget, allocation.x, allocation.y,
+		      allocation.width, allocation.height);
+
 	allocation.x += allocation.width / 2 -
 		cairo_image_surface_get_width(launcher->icon) / 2;
 	if (allocation.width > allocation.height)
@@ -280,16 +331,6 @@ panel_launcher_motion_handler(struct widget *widget, struct input *input,
 	return CURSOR_LEFT_PTR;
 }
 
-static void
-set_hex_color(cairo_t *cr, uint32_t color)
-{
-	cairo_set_source_rgba(cr,
-			      ((color >> 16) & 0xff) / 255.0,
-			      ((color >>  8) & 0xff) / 255.0,
-			      ((color >>  0) & 0xff) / 255.0,
-			      ((color >> 24) & 0xff) / 255.0);
-}
-
 static void
 panel_redraw_handler(struct widget *widget, void *data)
 {
@@ -297,12 +338,15 @@ panel_redraw_handler(struct widget *widget, void *data)
 	cairo_t *cr;
 	struct panel *panel = data;
 
-	cr = widget_cairo_create(panel->widget);
-	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
-	set_hex_color(cr, panel->color);
-	cairo_paint(cr);
+	/* The launchers and the clock redraw their own area when needed. */
+	if (widget_get_buffer_age(widget) == 0) {
+		cr = widget_cairo_create(panel->widget);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		set_hex_color(cr, panel->color);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+	}
 
-	cairo_destroy(cr);
 	surface = window_get_surface(panel->window);
 	cairo_surface_destroy(surface);
 	panel->painted = 1;
@@ -399,7 +443,17 @@ panel_clock_redraw_handler(struct widget *widget, void *data)
 	if (allocation.width == 0)
 		return;
 
+	if (widget_get_buffer_age(widget) == 1 &&
+	    strcmp(string, clock->drawn) == 0)
+		return;
+
+	memcpy(clock->drawn, string, sizeof clock->drawn);
+
 	cr = widget_cairo_create(clock->panel->widget);
+	panel_clear_rectangle(clock->panel, cr, &allocation);
+	widget_damage(widget, allocation.x, allocation.y,
+		      allocation.width, allocation.height);
+
 	cairo_set_font_size(cr, 14);
 	cairo_text_extents(cr, string, &extents);
 	if (allocation.x > 0)
@@ -474,6 +528,7 @@ panel_add_clock(struct panel *panel)
 
 	clock->widget = widget_add_widget(panel->widget, clock);
 	widget_set_redraw_handler(clock->widget, panel_clock_redraw_handler);
+	widget_set_partial_damage(clock->widget, 1);
 }
 
 static void
@@ -613,6 +668,7 @@ panel_create(struct desktop *desktop, struct output *output)
 
 	widget_set_redraw_handler(panel->widget, panel_redraw_handler);
 	widget_set_resize_handler(panel->widget, panel_resize_handler);
+	widget_set_partial_damage(panel->widget, 1);
 
 	panel->panel_position = desktop->panel_position;
 	panel->clock_format = desktop->clock_format;
@@ -735,6 +791,7 @@ panel_add_launcher(struct panel *panel, const char *icon, const char *path)
 				    panel_launcher_touch_up_handler);
 	widget_set_redraw_handler(launcher->widget,
 				  panel_launcher_redraw_handler);
+	widget_set_partial_damage(launcher->widget, 1);
 	widget_set_motion_handler(launcher->widget,
 				  panel_launcher_motion_handler);
 }
@@ -746,6 +803,19 @@ enum {
 	BACKGROUND_CENTERED
 };
 
+static cairo_surface_t *
+background_get_image(struct background *background)
+{
+	struct desktop *desktop = background->desktop;
+
+	/* The decoding started with the shell, it has had all the time
+	 * up to the first configure to complete. */
+	if (!desktop->background_image_loaded)
+		image_loader_pool_flush(desktop->image_pool);
+
+	return desktop->background_image;
+}
+
 static void
 background_draw(struct widget *widget, void *data)
 {
@@ -758,6 +828,7 @@ background_draw(struct widget *widget, void *data)
 	double sx, sy, s;
 	double tx, ty;
 	struct rectangle allocation;
+	int type;
 
 	surface = window_get_surface(background->window);
 
@@ -770,17 +841,13 @@ background_draw(struct widget *widget, void *data)
 	cairo_paint(cr);
 
 	widget_get_allocation(widget, &allocation);
-	image = NULL;
-	if (background->image)
-		image = load_cairo_surface(background->image);
-	else if (background->color == 0) {
-		char *name = file_name_with_datadir("pattern.png");
+	image = background_get_image(background);
 
-		image = load_cairo_surface(name);
-		free(name);
-	}
+	/* With a viewport, the surface is the size of the image and the
+	 * compositor does the cropping and scaling. */
+	type = background->viewport ? BACKGROUND_SCALE : background->type;
 
-	if (image && background->type != -1) {
+	if (image && type != -1) {
 		im_w = cairo_image_surface_get_width(image);
 		im_h = cairo_image_surface_get_height(image);
 		sx = im_w / allocation.width;
@@ -788,7 +855,7 @@ background_draw(struct widget *widget, void *data)
 
 		pattern = cairo_pattern_create_for_surface(image);
 
-		switch (background->type) {
+		switch (type) {
 		case BACKGROUND_SCALE:
 			cairo_matrix_init_scale(&matrix, sx, sy);
 			cairo_pattern_set_matrix(pattern, &matrix);
@@ -824,7 +891,6 @@ background_draw(struct widget *widget, void *data)
 
 		cairo_set_source(cr, pattern);
 		cairo_pattern_destroy (pattern);
-		cairo_surface_destroy(image);
 		cairo_mask(cr, pattern);
 	}
 
@@ -838,6 +904,69 @@ background_draw(struct widget *widget, void *data)
 static void
 background_destroy(struct background *background);
 
+/*
+ * Sets up the viewport that crops and scales the image to the output
+ * size, and returns the surface size that holds the image at its native
+ * resolution. Returns -1 when the image must be drawn by cairo instead.
+ */
+static int
+background_setup_viewport(struct background *background,
+			  int32_t width, int32_t height,
+			  int32_t *surface_width, int32_t *surface_height)
+{
+	cairo_surface_t *image = background_get_image(background);
+	int32_t scale = window_get_buffer_scale(background->window);
+	double im_w, im_h, sx, sy, s;
+	double fx, fy, src_x, src_y, src_w, src_h;
+
+	if (!image)
+		return -1;
+
+	im_w = cairo_image_surface_get_width(image);
+	im_h = cairo_image_surface_get_height(image);
+	sx = im_w / width;
+	sy = im_h / height;
+
+	switch (background->type) {
+	case BACKGROUND_SCALE:
+		s = 0.0;
+		break;
+	case BACKGROUND_CENTERED:
+		/* a smaller image is surrounded by the background color */
+		if (sx < 1.0 || sy < 1.0)
+			return -1;
+		/* fallthrough */
+	case BACKGROUND_SCALE_CROP:
+		s = MIN(sx, sy);
+		break;
+	default:
+		return -1;
+	}
+
+	*surface_width = MAX(1, (int32_t)im_w / scale);
+	*surface_height = MAX(1, (int32_t)im_h / scale);
+
+	if (widget_set_viewport_destination(background->widget,
+					    width, height) < 0)
+		return -1;
+
+	if (s == 0.0)
+		return widget_set_viewport_source(background->widget,
+						  -1, -1, -1, -1);
+
+	/* The visible part of the image, centered, in surface coordinates,
+	 * rounded down to wl_fixed_t so that it stays inside the surface. */
+	fx = *surface_width / im_w;
+	fy = *surface_height / im_h;
+	src_w = floor(s * width * fx * 256.0) / 256.0;
+	src_h = floor(s * height * fy * 256.0) / 256.0;
+	src_x = floor((*surface_width - src_w) * 0.5 * 256.0) / 256.0;
+	src_y = floor((*surface_height - src_h) * 0.5 * 256.0) / 256.0;
+
+	return widget_set_viewport_source(background->widget,
+					  src_x, src_y, src_w, src_h);
+}
+
 static void
 background_configure(void *data,
 		     struct weston_desktop_shell *desktop_shell,
@@ -860,6 +989,12 @@ background_configure(void *data,
 		widget_set_viewport_destination(background->widget, width, height);
 		width = 1;
 		height = 1;
+	} else if (background_setup_viewport(background, width, height,
+					     &width, &height) == 0) {
+		background->viewport = 1;
+	} else if (background->viewport) {
+		widget_set_viewport_destination(background->widget, -1, -1);
+		background->viewport = 0;
 	}
 
 	widget_schedule_resize(background->widget, width, height);
@@ -1142,6 +1277,7 @@ background_create(struct desktop *desktop, struct output *output)
 	char *type;
 
 	background = xzalloc(sizeof *background);
+	background->desktop = desktop;
 	background->owner = output;
 	background->base.configure = background_configure;
 	background->window = window_create_custom(desktop->display);
@@ -1512,6 +1648,59 @@ parse_clock_format(struct desktop *desktop, struct weston_config_section *s)
 	free(clock_format);
 }
 
+static void
+background_image_loaded(pixman_image_t *image, void *data)
+{
+	struct desktop *desktop = data;
+
+	if (image)
+		desktop->background_image =
+			create_cairo_surface_for_image(image);
+	desktop->background_image_loaded = true;
+}
+
+static void
+image_pool_func(struct task *task, uint32_t events)
+{
+	struct desktop *desktop =
+		container_of(task, struct desktop, image_task);
+
+	image_loader_pool_dispatch(desktop->image_pool);
+}
+
+/* Starts decoding the background image on a worker thread, so that it
+ * overlaps with connecting to the compositor and creating the panels. */
+static void
+desktop_load_background_image(struct desktop *desktop)
+{
+	struct weston_config_section *s;
+	uint32_t color;
+	char *name;
+
+	s = weston_config_get_section(desktop->config, "shell", NULL, NULL);
+	weston_config_section_get_string(s, "background-image", &name, NULL);
+	weston_config_section_get_color(s, "background-color",
+					&color, 0x00000000);
+
+	if (!name && color == 0)
+		name = file_name_with_datadir("pattern.png");
+
+	if (!name) {
+		desktop->background_image_loaded = true;
+		return;
+	}
+
+	desktop->image_pool = image_loader_pool_create(1);
+	if (!desktop->image_pool ||
+	    load_image_async(desktop->image_pool, name,
+			     background_image_loaded, desktop) < 0) {
+		desktop->background_image = load_cairo_surface(name);
+		desktop->background_image_loaded = true;
+	}
+
+	free(name);
+}
+
 int main(int argc, char *argv[])
 {
 	struct desktop desktop = { 0 };
@@ -1520,6 +1709,7 @@ int main(int argc, char *argv[])
 	const char *config_file;
 
 	desktop.unlock_task.run = unlock_dialog_finish;
+	desktop.image_task.run = image_pool_func;
 	wl_list_init(&desktop.outputs);
 
 	config_file = weston_config_get_name_from_env();
@@ -1528,15 +1718,23 @@ int main(int argc, char *argv[])
 	weston_config_section_get_bool(s, "locking", &desktop.locking, true);
 	parse_panel_position(&desktop, s);
 	parse_clock_format(&desktop, s);
+	desktop_load_background_image(&desktop);
 
 	desktop.display = display_create(&argc, argv);
 	if (desktop.display == NULL) {
 		fprintf(stderr, "failed to create display: %s\n",
 			strerror(errno));
+		if (desktop.image_pool)
+			image_loader_pool_destroy(desktop.image_pool);
 		weston_config_destroy(desktop.config);
 		return -1;
 	}
 
+	if (desktop.image_pool)
+		display_watch_fd(desktop.display,
+				 image_loader_pool_get_fd(desktop.image_pool),
+				 EPOLLIN, &desktop.image_task);
+
 	display_set_user_data(desktop.display, &desktop);
 	display_set_global_handler(desktop.display, global_handler);
 	display_set_global_handler_remove(desktop.display, global_handler_remove);
@@ -1561,6 +1759,13 @@ int main(int argc, char *argv[])
 	if (desktop.unlock_dialog)
 		unlock_dialog_destroy(desktop.unlock_dialog);
 	weston_desktop_shell_destroy(desktop.shell);
+	if (desktop.image_pool) {
+		display_unwatch_fd(desktop.display,
+				   image_loader_pool_get_fd(desktop.image_pool));
+		image_loader_pool_destroy(desktop.image_pool);
+	}
+	if (desktop.background_image)
+		cairo_surface_destroy(desktop.background_image);
 	display_destroy(desktop.display);
 	weston_config_destroy(desktop.config);
 
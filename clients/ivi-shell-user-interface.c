@@ -39,6 +39,7 @@
 #include <wayland-cursor.h>
 #include <wayland-client-protocol.h>
 #include "shared/cairo-util.h"
+#include "shared/image-loader.h"
 #include <libweston/config-parser.h>
 #include "shared/helpers.h"
 #include "shared/os-compatibility.h"
@@ -112,6 +113,7 @@ struct wlContextCommon {
 	struct wl_surface		*pointer_surface;
 	enum   cursor_type		current_cursor;
 	uint32_t			enter_serial;
+	struct image_loader_pool	*image_pool;
 };
 
 struct wlContextStruct {
@@ -930,13 +932,60 @@ create_ivisurface(struct wlContextStruct *p_wlCtx,
 	drawImage(p_wlCtx);
 }
 
+struct image_request {
+	struct wlContextStruct	*p_wlCtx;
+	uint32_t		id_surface;
+	char			*imageFile;
+};
+
+static void
+image_request_loaded(pixman_image_t *image, void *data)
+{
+	struct image_request *request = data;
+	cairo_surface_t *surface = NULL;
+
+	if (image)
+		surface = create_cairo_surface_for_image(image);
+
+	if (NULL == surface)
+		fprintf(stderr, "Failed to load_cairo_surface %s\n",
+			request->imageFile);
+	else
+		create_ivisurface(request->p_wlCtx, request->id_surface,
+				  surface);
+
+	free(request->imageFile);
+	free(request);
+}
+
+/**
+ * The images are decoded in parallel by the image loader pool, and the
+ * surface is created once its image is ready; see main().
+ */
 static void
 create_ivisurfaceFromFile(struct wlContextStruct *p_wlCtx,
 			  uint32_t id_surface,
 			  const char *imageFile)
 {
-	cairo_surface_t *surface = load_cairo_surface(imageFile);
+	struct image_loader_pool *pool = p_wlCtx->cmm->image_pool;
+	struct image_request *request;
+	cairo_surface_t *surface;
+
+	if (pool && imageFile) {
+		request = xzalloc(sizeof(*request));
+		request->p_wlCtx = p_wlCtx;
+		request->id_surface = id_surface;
+		request->imageFile = xstrdup(imageFile);
+
+		if (load_image_async(pool, imageFile,
+				     image_request_loaded, request) == 0)
+			return;
 
+		free(request->imageFile);
+		free(request);
+	}
+
+	surface = load_cairo_surface(imageFile);
 	if (NULL == surface) {
 		fprintf(stderr, "Failed to load_cairo_surface %s\n", imageFile);
 		return;
@@ -1286,6 +1335,9 @@ int main(int argc, char **argv)
 	wlCtx_HomeButton.cmm = &wlCtxCommon;
 	wlCtx_WorkSpaceBackGround.cmm = &wlCtxCommon;
 
+	/* decode the images of the desktop widgets in parallel */
+	wlCtxCommon.image_pool = image_loader_pool_create(0);
+
 	/* create desktop widgets */
 	for (i = 0; i < hmi_setting->screen_num; i++) {
 		wlCtx_BackGround[i].cmm = &wlCtxCommon;
@@ -1320,6 +1372,13 @@ int main(int argc, char **argv)
 	create_home_button(&wlCtx_HomeButton, hmi_setting->home.id,
 			   hmi_setting->home.filePath);
 
+	/* all the surfaces exist before the UI is declared ready */
+	if (wlCtxCommon.image_pool) {
+		image_loader_pool_flush(wlCtxCommon.image_pool);
+		image_loader_pool_destroy(wlCtxCommon.image_pool);
+		wlCtxCommon.image_pool = NULL;
+	}
+
 	UI_ready(wlCtxCommon.hmiCtrl);
 
 	while (ret != -1)
@@ -90,6 +90,11 @@ terminal_run(struct terminal *terminal, const char *path);
 #define MAX_RESPONSE		256
 #define MAX_ESCAPE		255
 
+/* Size of a single read from the pty, and the maximum amount of output
+ * parsed per wakeup. */
+#define TERMINAL_READ_CHUNK	(64 * 1024)
+#define TERMINAL_READ_BUDGET	(1024 * 1024)
+
 /* Terminal modes */
 #define MODE_SHOW_CURSOR	0x00000001
 #define MODE_INVERSE		0x00000002
@@ -484,6 +489,18 @@ struct terminal {
 	int selection_end_row, selection_end_col;
 	struct wl_list link;
 	int pace_pipe;
+
+	/* What the last redraw showed, to find the rows that changed.
+	 * row_changed holds the redraw_count of the last change of each
+	 * row, layout_changed the one of the last change of the grid
+	 * geometry. */
+	union utf8_char *drawn_data;
+	union decoded_attr *drawn_attr;
+	int *drawn_cursor;
+	uint32_t *row_changed;
+	int drawn_width, drawn_height;
+	struct rectangle drawn_allocation;
+	uint32_t redraw_count, layout_changed;
 };
 
 /* Create default tab stops, every 8 characters */
@@ -1037,131 +1054,247 @@ glyph_run_add(struct glyph_run *run, int x, int y, union utf8_char *c)
 }
 
 
+/* Compares the visible rows with what was drawn last, and records in
+ * which redraw each row changed. The decoded attributes include the
+ * selection and the focused cursor; the outline of the unfocused cursor
+ * is tracked separately. */
+static void
+terminal_update_drawn_rows(struct terminal *terminal,
+			   const struct rectangle *allocation)
+{
+	union utf8_char *p_row, *drawn_row;
+	union decoded_attr attr, *drawn_attr_row;
+	int row, col, cursor, changed;
+	size_t cells;
+
+	if (terminal->drawn_width != terminal->width ||
+	    terminal->drawn_height != terminal->height ||
+	    memcmp(&terminal->drawn_allocation, allocation,
+		   sizeof *allocation) != 0) {
+		free(terminal->drawn_data);
+		free(terminal->drawn_attr);
+		free(terminal->drawn_cursor);
+		free(terminal->row_changed);
+
+		cells = terminal->width * terminal->height;
+		terminal->drawn_data = xzalloc(cells * sizeof(union utf8_char));
+		terminal->drawn_attr =
+			xzalloc(cells * sizeof(union decoded_attr));
+		terminal->drawn_cursor =
+			xzalloc(terminal->height * sizeof(int));
+		terminal->row_changed =
+			xzalloc(terminal->height * sizeof(uint32_t));
+
+		terminal->drawn_width = terminal->width;
+		terminal->drawn_height = terminal->height;
+		terminal->drawn_allocation = *allocation;
+		terminal->layout_changed = terminal->redraw_count;
+	}
+
+	for (row = 0; row < terminal->height; row++) {
+		p_row = terminal_get_row(terminal, row);
+		drawn_row = &terminal->drawn_data[row * terminal->width];
+		drawn_attr_row = &terminal->drawn_attr[row * terminal->width];
+		changed = 0;
+
+		for (col = 0; col < terminal->width; col++) {
+			terminal_decode_attr(terminal, row, col, &attr);
+			if (drawn_row[col].ch != p_row[col].ch ||
+			    drawn_attr_row[col].key != attr.key) {
+				drawn_row[col] = p_row[col];
+				drawn_attr_row[col] = attr;
+				changed = 1;
+			}
+		}
+
+		cursor = -1;
+		if ((terminal->mode & MODE_SHOW_CURSOR) &&
+		    !window_has_focus(terminal->window) &&
+		    terminal->row == row)
+			cursor = terminal->column;
+		if (terminal->drawn_cursor[row] != cursor) {
+			terminal->drawn_cursor[row] = cursor;
+			changed = 1;
+		}
+
+		if (changed)
+			terminal->row_changed[row] = terminal->redraw_count;
+	}
+}
+
+/* The rows are drawn on whole pixel rows, so that redrawing one does not
+ * blend with its neighbours. */
+static int
+terminal_row_top(struct terminal *terminal, int row)
+{
+	return floor(row * terminal->extents.height);
+}
+
+/* Draws one row from the drawn_* copy, clipped to its band. x and width
+ * span the whole widget, margins included. */
 static void
-redraw_handler(struct widget *widget, void *data)
+terminal_draw_row(struct terminal *terminal, cairo_t *cr, int row,
+		  int x, int width)
 {
-	struct terminal *terminal = data;
-	struct rectangle allocation;
-	cairo_t *cr;
-	int top_margin, side_margin;
-	int row, col, cursor_x, cursor_y;
-	union utf8_char *p_row;
+	union utf8_char *p_row = &terminal->drawn_data[row * terminal->width];
+	union decoded_attr *attr_row =
+		&terminal->drawn_attr[row * terminal->width];
+	double average_width = terminal->average_width;
+	int top = terminal_row_top(terminal, row);
+	int bottom = terminal_row_top(terminal, row + 1);
+	int col, text_x, text_y;
 	union decoded_attr attr;
-	int text_x, text_y;
-	cairo_surface_t *surface;
-	double d;
 	struct glyph_run run;
-	cairo_font_extents_t extents;
-	double average_width;
 	double unichar_width;
+	double d;
 
-	surface = window_get_surface(terminal->window);
-	widget_get_allocation(terminal->widget, &allocation);
-	cr = widget_cairo_create(terminal->widget);
-	cairo_rectangle(cr, allocation.x, allocation.y,
-			allocation.width, allocation.height);
+	cairo_save(cr);
+	cairo_rectangle(cr, x, top, width, bottom - top);
 	cairo_clip(cr);
-	cairo_push_group(cr);
 
+	/* paint the background */
 	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
 	terminal_set_color(terminal, cr, terminal->color_scheme->border);
 	cairo_paint(cr);
 
-	cairo_set_scaled_font(cr, terminal->font_normal);
-
-	extents = terminal->extents;
-	average_width = terminal->average_width;
-	side_margin = (allocation.width - terminal->width * average_width) / 2;
-	top_margin = (allocation.height - terminal->height * extents.height) / 2;
-
-	cairo_set_line_width(cr, 1.0);
-	cairo_translate(cr, allocation.x + side_margin,
-			allocation.y + top_margin);
-	/* paint the background */
-	for (row = 0; row < terminal->height; row++) {
-		p_row = terminal_get_row(terminal, row);
-		for (col = 0; col < terminal->width; col++) {
-			/* get the attributes for this character cell */
-			terminal_decode_attr(terminal, row, col, &attr);
+	for (col = 0; col < terminal->width; col++) {
+		attr = attr_row[col];
 
-			if (attr.attr.bg == terminal->color_scheme->border)
-				continue;
+		if (attr.attr.bg == terminal->color_scheme->border)
+			continue;
 
-			if (is_wide(p_row[col]))
-				unichar_width = 2 * average_width;
-			else
-				unichar_width = average_width;
+		if (is_wide(p_row[col]))
+			unichar_width = 2 * average_width;
+		else
+			unichar_width = average_width;
 
-			terminal_set_color(terminal, cr, attr.attr.bg);
-			cairo_move_to(cr, col * average_width,
-				      row * extents.height);
-			cairo_rel_line_to(cr, unichar_width, 0);
-			cairo_rel_line_to(cr, 0, extents.height);
-			cairo_rel_line_to(cr, -unichar_width, 0);
-			cairo_close_path(cr);
-			cairo_fill(cr);
-		}
+		terminal_set_color(terminal, cr, attr.attr.bg);
+		cairo_rectangle(cr, col * average_width, top,
+				unichar_width, bottom - top);
+		cairo_fill(cr);
 	}
 
 	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
 
 	/* paint the foreground */
 	glyph_run_init(&run, terminal, cr);
-	for (row = 0; row < terminal->height; row++) {
-		p_row = terminal_get_row(terminal, row);
-		for (col = 0; col < terminal->width; col++) {
-			/* get the attributes for this character cell */
-			terminal_decode_attr(terminal, row, col, &attr);
-
-			glyph_run_flush(&run, attr);
-
-			text_x = col * average_width;
-			text_y = extents.ascent + row * extents.height;
-			if (attr.attr.a & ATTRMASK_UNDERLINE) {
-				terminal_set_color(terminal, cr, attr.attr.fg);
-				cairo_move_to(cr, text_x, (double)text_y + 1.5);
-				cairo_line_to(cr, text_x + average_width, (double) text_y + 1.5);
-				cairo_stroke(cr);
-			}
+	for (col = 0; col < terminal->width; col++) {
+		attr = attr_row[col];
+
+		glyph_run_flush(&run, attr);
+
+		text_x = col * average_width;
+		text_y = terminal->extents.ascent + row * terminal->extents.height;
+		if (attr.attr.a & ATTRMASK_UNDERLINE) {
+			terminal_set_color(terminal, cr, attr.attr.fg);
+			cairo_move_to(cr, text_x, (double)text_y + 1.5);
+			cairo_line_to(cr, text_x + average_width, (double) text_y + 1.5);
+			cairo_stroke(cr);
+		}
 
-                        /* skip space glyph (RLE) we use as a placeholder of
-                           the right half of a double-width character,
-                           because RLE is not available in every font. */
-			if (p_row[col].ch == 0x200B)
-				continue;
+                /* skip space glyph (RLE) we use as a placeholder of
+                   the right half of a double-width character,
+                   because RLE is not available in every font. */
+		if (p_row[col].ch == 0x200B)
+			continue;
 
-			glyph_run_add(&run, text_x, text_y, &p_row[col]);
-		}
+		glyph_run_add(&run, text_x, text_y, &p_row[col]);
 	}
 
 	attr.key = ~0;
 	glyph_run_flush(&run, attr);
 
-	if ((terminal->mode & MODE_SHOW_CURSOR) &&
-	    !window_has_focus(terminal->window)) {
+	if (terminal->drawn_cursor[row] >= 0) {
 		d = 0.5;
 
 		cairo_set_line_width(cr, 1);
-		cairo_move_to(cr, terminal->column * average_width + d,
-			      terminal->row * extents.height + d);
+		cairo_move_to(cr, terminal->drawn_cursor[row] * average_width + d,
+			      row * terminal->extents.height + d);
 		cairo_rel_line_to(cr, average_width - 2 * d, 0);
-		cairo_rel_line_to(cr, 0, extents.height - 2 * d);
+		cairo_rel_line_to(cr, 0, terminal->extents.height - 2 * d);
 		cairo_rel_line_to(cr, -average_width + 2 * d, 0);
 		cairo_close_path(cr);
 
 		cairo_stroke(cr);
 	}
 
-	cairo_pop_group_to_source(cr);
-	cairo_paint(cr);
+	cairo_restore(cr);
+}
+
+static void
+redraw_handler(struct widget *widget, void *data)
+{
+	struct terminal *terminal = data;
+	struct rectangle allocation;
+	cairo_t *cr;
+	int top_margin, side_margin;
+	int row, first, cursor_x, cursor_y;
+	int age, full;
+	uint32_t count;
+
+	widget_get_allocation(terminal->widget, &allocation);
+	cr = widget_cairo_create(terminal->widget);
+	age = widget_get_buffer_age(terminal->widget);
+
+	count = ++terminal->redraw_count;
+	terminal_update_drawn_rows(terminal, &allocation);
+
+	/* The buffer holds what was drawn age redraws ago: redraw the rows
+	 * that changed since, or everything if it is older than the
+	 * geometry. */
+	full = age == 0 || count - terminal->layout_changed < (uint32_t) age;
+
+	cairo_rectangle(cr, allocation.x, allocation.y,
+			allocation.width, allocation.height);
+	cairo_clip(cr);
+
+	if (full) {
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		terminal_set_color(terminal, cr, terminal->color_scheme->border);
+		cairo_paint(cr);
+		widget_damage(widget, allocation.x, allocation.y,
+			      allocation.width, allocation.height);
+	}
+
+	cairo_set_scaled_font(cr, terminal->font_normal);
+
+	side_margin = (allocation.width - terminal->width * terminal->average_width) / 2;
+	top_margin = (allocation.height - terminal->height * terminal->extents.height) / 2;
+
+	cairo_set_line_width(cr, 1.0);
+	cairo_translate(cr, allocation.x + side_margin,
+			allocation.y + top_margin);
+
+	/* Damage runs of consecutive redrawn rows as one rectangle. */
+	first = -1;
+	for (row = 0; row <= terminal->height; row++) {
+		if (row < terminal->height &&
+		    (full || count - terminal->row_changed[row] < (uint32_t) age)) {
+			terminal_draw_row(terminal, cr, row,
+					  -side_margin, allocation.width);
+			if (first < 0)
+				first = row;
+			continue;
+		}
+
+		if (first >= 0 && !full) {
+			widget_damage(widget, allocation.x,
+				      allocation.y + top_margin +
+				      terminal_row_top(terminal, first),
+				      allocation.width,
+				      terminal_row_top(terminal, row) -
+				      terminal_row_top(terminal, first));
+		}
+		first = -1;
+	}
+
 	cairo_destroy(cr);
-	cairo_surface_destroy(surface);
 
 	if (terminal->send_cursor_position) {
 		cursor_x = side_margin + allocation.x +
-				terminal->column * average_width;
+				terminal->column * terminal->average_width;
 		cursor_y = top_margin + allocation.y +
-				terminal->row * extents.height;
+				terminal->row * terminal->extents.height;
 		window_set_text_cursor_position(terminal->window,
 						cursor_x, cursor_y);
 		terminal->send_cursor_position = 0;
@@ -2015,6 +2148,96 @@ handle_char(struct terminal *terminal, union utf8_char utf8)
 		terminal->last_char = utf8;
 }
 
+/* Returns the number of printable ASCII characters (0x20 to 0x7e) at the
+ * start of data. The bulk of the run is checked eight bytes at a time: a
+ * word is accepted if no byte has the high bit set, is below 0x20 or is
+ * 0x7f (DEL). A rejected word is rescanned byte by byte.
+ */
+static size_t
+ascii_run_length(const char *data, size_t length)
+{
+	const uint64_t ones = UINT64_C(0x0101010101010101);
+	const uint64_t highs = UINT64_C(0x8080808080808080);
+	uint64_t word, del;
+	size_t i = 0;
+
+	while (i + sizeof word <= length) {
+		memcpy(&word, data + i, sizeof word);
+		del = word ^ (ones * 0x7f);
+		if ((word & highs) ||
+		    ((word - ones * 0x20) & ~word & highs) ||
+		    ((del - ones) & ~del & highs))
+			break;
+		i += sizeof word;
+	}
+
+	while (i < length &&
+	       (unsigned char) data[i] >= 0x20 &&
+	       (unsigned char) data[i] < 0x7f)
+		i++;
+
+	return i;
+}
+
+/* Fast path of terminal_data() for runs of printable ASCII. Outside of
+ * escape sequences and with the US character set, these bytes are stored
+ * as they are: they are neither special, wide nor part of a multi-byte
+ * sequence. The run is cut at the right margin, so that handle_char()
+ * takes care of wrapping.
+ *
+ * Returns the number of bytes consumed, 0 if the next byte has to go
+ * through the slow path.
+ */
+static size_t
+terminal_data_ascii(struct terminal *terminal, const char *data, size_t length)
+{
+	union utf8_char *row;
+	struct attr *attr_row;
+	size_t n, i;
+
+	if (terminal->state != escape_state_normal ||
+	    terminal->cs != CS_US ||
+	    (terminal->mode & MODE_IRM) ||
+	    terminal->column >= terminal->width)
+		return 0;
+
+	switch (terminal->state_machine.state) {
+	case utf8state_start:
+	case utf8state_accept:
+	case utf8state_reject:
+		break;
+	default:
+		return 0;
+	}
+
+	n = ascii_run_length(data,
+			     MIN(length, (size_t) (terminal->width -
+						   terminal->column)));
+	if (n == 0)
+		return 0;
+
+	row = terminal_get_row(terminal, terminal->row);
+	attr_row = terminal_get_attr_row(terminal, terminal->row);
+
+	for (i = 0; i < n; i++) {
+		row[terminal->column + i].ch = 0;
+		row[terminal->column + i].byte[0] = data[i];
+		attr_row[terminal->column + i] = terminal->curr_attr;
+	}
+	terminal->column += n;
+
+	if (terminal->row + terminal->start + 1 > terminal->end)
+		terminal->end = terminal->row + terminal->start + 1;
+	if (terminal->end == terminal->buffer_height)
+		terminal->log_size = terminal->buffer_height;
+	else if (terminal->log_size < terminal->buffer_height)
+		terminal->log_size = terminal->end;
+
+	terminal->last_char = row[terminal->column - 1];
+
+	return n;
+}
+
 static void
 escape_append_utf8(struct terminal *terminal, union utf8_char utf8)
 {
@@ -2038,11 +2261,18 @@ escape_append_utf8(struct terminal *terminal, union utf8_char utf8)
 static void
 terminal_data(struct terminal *terminal, const char *data, size_t length)
 {
-	unsigned int i;
+	size_t i, n;
 	union utf8_char utf8;
 	enum utf8_state parser_state;
 
 	for (i = 0; i < length; i++) {
+		n = terminal_data_ascii(terminal, data + i, length - i);
+		if (n > 0) {
+			/* the loop increment accounts for the last byte */
+			i += n - 1;
+			continue;
+		}
+
 		parser_state =
 			utf8_next_char(&terminal->state_machine, data[i]);
 		switch(parser_state) {
@@ -2181,8 +2411,6 @@ terminal_data(struct terminal *terminal, const char *data, size_t length)
 			handle_char(terminal, utf8);
 		} /* if */
 	} /* for */
-
-	window_schedule_redraw(terminal->window);
 }
 
 static void
@@ -2972,6 +3200,7 @@ terminal_create(struct display *display)
 	window_set_drop_handler(terminal->window, drop_handler);
 
 	widget_set_redraw_handler(terminal->widget, redraw_handler);
+	widget_set_partial_damage(terminal->widget, 1);
 	widget_set_resize_handler(terminal->widget, resize_handler);
 	widget_set_button_handler(terminal->widget, button_handler);
 	widget_set_enter_handler(terminal->widget, enter_handler);
@@ -3028,6 +3257,10 @@ terminal_destroy(struct terminal *terminal)
 	if (wl_list_empty(&terminal_list))
 		display_exit(terminal->display);
 
+	free(terminal->drawn_data);
+	free(terminal->drawn_attr);
+	free(terminal->drawn_cursor);
+	free(terminal->row_changed);
 	free(terminal->title);
 	free(terminal);
 }
@@ -3037,19 +3270,37 @@ io_handler(struct task *task, uint32_t events)
 {
 	struct terminal *terminal =
 		container_of(task, struct terminal, io_task);
-	char buffer[256];
-	int len;
+	static char buffer[TERMINAL_READ_CHUNK];
+	size_t total = 0;
+	ssize_t len;
+
+	/* Drain the pty until it is empty or the budget is spent. The
+	 * budget bounds the time spent here, so that input and frame
+	 * callbacks are still dispatched while a program floods the
+	 * terminal; the rest is read on the next wakeup. The redraw is
+	 * scheduled once for everything that was read, and toytoolkit
+	 * defers it until the previous frame callback is done.
+	 *
+	 * After a hangup, the remaining output is still read before the
+	 * terminal goes away: the read fails only once it is drained.
+	 */
+	while (total < TERMINAL_READ_BUDGET) {
+		len = read(terminal->master, buffer, sizeof buffer);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && errno == EAGAIN && !(events & EPOLLHUP))
+			break;
+		if (len <= 0) {
+			terminal_destroy(terminal);
+			return;
+		}
 
-	if (events & EPOLLHUP) {
-		terminal_destroy(terminal);
-		return;
+		terminal_data(terminal, buffer, len);
+		total += len;
 	}
 
-	len = read(terminal->master, buffer, sizeof buffer);
-	if (len < 0)
-		terminal_destroy(terminal);
-	else
-		terminal_data(terminal, buffer, len);
+	if (total > 0)
+		window_schedule_redraw(terminal->window);
 }
 
 static int
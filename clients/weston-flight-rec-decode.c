@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "libweston/weston-log-flight-rec.h"
+
+static void
+print_usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-i] FILE\n"
+		"Prints the contents of a flight recorder file written by\n"
+		"weston --flight-rec-file=FILE, oldest message first.\n"
+		"  -i\tprint only information about the recording\n",
+		prog);
+}
+
+static int
+write_all(const char *data, size_t len)
+{
+	size_t written;
+
+	written = fwrite(data, 1, len, stdout);
+	return written == len ? 0 : -1;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct weston_flight_rec_contents contents;
+	const char *path = NULL;
+	bool info_only = false;
+	const char *error;
+	struct stat st;
+	void *map;
+	int ret = 0;
+	int fd, i;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-i") == 0) {
+			info_only = true;
+		} else if (!path && argv[i][0] != '-') {
+			path = argv[i];
+		} else {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!path) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (st.st_size == 0) {
+		fprintf(stderr, "%s: too short for a flight recorder\n", path);
+		close(fd);
+		return EXIT_FAILURE;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Cannot map %s: %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	error = weston_flight_rec_parse(map, st.st_size, &contents);
+	if (error) {
+		fprintf(stderr, "%s: %s\n", path, error);
+		ret = EXIT_FAILURE;
+		goto out;
+	}
+
+	fprintf(stderr, "%s: generation %" PRIu32 ", %" PRIu64 " bytes of "
+		"%" PRIu64 "%s\n", path, contents.generation,
+		contents.len[0] + contents.len[1], contents.size,
+		contents.overlap ? ", wrapped around" : "");
+
+	if (info_only)
+		goto out;
+
+	for (i = 0; i < 2; i++) {
+		if (write_all(contents.data[i], contents.len[i]) < 0)
+			ret = EXIT_FAILURE;
+	}
+
+out:
+	munmap(map, st.st_size);
+
+	return ret;
+}
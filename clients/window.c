@@ -37,11 +37,17 @@
 #include <assert.h>
 #include <time.h>
 #include <cairo.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
 #include <stdbool.h>
 
+#ifdef HAVE_LINUX_UDMABUF_H
+#include <linux/dma-buf.h>
+#include <linux/udmabuf.h>
+#endif
+
 #ifdef HAVE_CAIRO_EGL
 #include <wayland-egl.h>
 
@@ -80,9 +86,11 @@ typedef void *EGLContext;
 #include "relative-pointer-unstable-v1-client-protocol.h"
 #include "shared/os-compatibility.h"
 #include "shared/string-helpers.h"
+#include "shared/weston-drm-fourcc.h"
 
 #include "window.h"
 #include "viewporter-client-protocol.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
 
 #define ZWP_RELATIVE_POINTER_MANAGER_V1_VERSION 1
 #define ZWP_POINTER_CONSTRAINTS_V1_VERSION 1
@@ -98,10 +106,22 @@ struct global {
 	struct wl_list link;
 };
 
+/* How far the compositor is known to take udmabufs of a format */
+enum udmabuf_state {
+	UDMABUF_UNSUPPORTED = 0,
+	/* advertised as linear, not tried yet */
+	UDMABUF_ADVERTISED,
+	/* a first import is on its way */
+	UDMABUF_TESTING,
+	/* a first import succeeded */
+	UDMABUF_IMPORTED,
+};
+
 struct display {
 	struct wl_display *display;
 	struct wl_registry *registry;
 	struct wl_compositor *compositor;
+	uint32_t compositor_version;
 	struct wl_subcompositor *subcompositor;
 	struct wl_shm *shm;
 	struct wl_data_device_manager *data_device_manager;
@@ -148,6 +168,16 @@ struct display {
 
 	int data_device_manager_version;
 	struct wp_viewporter *viewporter;
+
+	/* SHM pools exported as dmabufs through /dev/udmabuf, see
+	 * TOYTOOLKIT_UDMABUF */
+	struct zwp_linux_dmabuf_v1 *dmabuf;
+	int udmabuf_fd;
+	enum udmabuf_state udmabuf_xrgb8888;
+	enum udmabuf_state udmabuf_argb8888;
+	/* the import testing a format, at most one at a time */
+	struct zwp_linux_buffer_params_v1 *udmabuf_test;
+	enum udmabuf_state *udmabuf_test_state;
 };
 
 struct window_output {
@@ -173,11 +203,29 @@ struct toysurface {
 	 * Post the surface to the server, returning the server allocation
 	 * rectangle. The Cairo surface from prepare() must be destroyed
 	 * after calling this.
+	 * damage is an array of n_damage rectangles in surface coordinates,
+	 * or NULL to damage the whole surface.
 	 */
 	void (*swap)(struct toysurface *base,
 		     enum wl_output_transform buffer_transform, int32_t buffer_scale,
+		     const struct rectangle *damage, int n_damage,
 		     struct rectangle *server_allocation);
 
+	/*
+	 * Returns the age of the Cairo surface returned by the last
+	 * prepare(): the number of swaps since its content was posted, or
+	 * 0 if its content is undefined.
+	 */
+	int (*get_buffer_age)(struct toysurface *base);
+
+	/*
+	 * Make the Cairo surface returned by the last prepare() hold the
+	 * content of the last posted buffer, copying only what changed
+	 * since its own content was posted. Returns the new buffer age:
+	 * 1, or 0 if there is nothing to copy from.
+	 */
+	int (*retain)(struct toysurface *base);
+
 	/*
 	 * Make the toysurface current with the given EGL context.
 	 * Returns 0 on success, and negative on failure.
@@ -197,6 +245,8 @@ struct toysurface {
 	void (*destroy)(struct toysurface *base);
 };
 
+#define MAX_DAMAGE_RECTS 8
+
 struct surface {
 	struct window *window;
 
@@ -222,6 +272,17 @@ struct surface {
 
 	cairo_surface_t *cairo_surface;
 
+	/* Age of cairo_surface, 0 once its content must be redrawn
+	 * entirely. swap_count counts the posted buffers. */
+	int buffer_age;
+	uint32_t swap_count;
+
+	/* Damage reported by the widgets for the next swap, in surface
+	 * coordinates. */
+	struct rectangle damage[MAX_DAMAGE_RECTS];
+	int n_damage;
+	int damage_all;
+
 	struct wl_list link;
 	struct wp_viewport *viewport;
 };
@@ -320,8 +381,14 @@ struct widget {
 	 * redraw handler is going to do completely custom rendering
 	 * such as using EGL directly */
 	int use_cairo;
+	/* If this is set, the redraw handler reports what it drew with
+	 * widget_damage(). Otherwise, drawing it damages the whole
+	 * surface. */
+	int partial_damage;
 	int viewport_dest_width;
 	int viewport_dest_height;
+	wl_fixed_t viewport_src_x, viewport_src_y;
+	wl_fixed_t viewport_src_width, viewport_src_height;
 };
 
 struct touch_point {
@@ -413,6 +480,8 @@ struct window_frame {
 	struct widget *widget;
 	struct widget *child;
 	struct frame *frame;
+	/* surface swap_count when the frame was last repainted */
+	uint32_t repaint_count;
 
 	uint32_t last_time;
 	uint32_t did_double, double_click;
@@ -446,6 +515,8 @@ struct shm_pool {
 	size_t size;
 	size_t used;
 	void *data;
+	/* the memfd, kept only for udmabuf export, -1 otherwise */
+	int fd;
 };
 
 enum {
@@ -577,6 +648,7 @@ egl_window_surface_prepare(struct toysurface *base, int dx, int dy,
 static void
 egl_window_surface_swap(struct toysurface *base,
 			enum wl_output_transform buffer_transform, int32_t buffer_scale,
+			const struct rectangle *damage, int n_damage,
 			struct rectangle *server_allocation)
 {
 	struct egl_window_surface *surface = to_egl_window_surface(base);
@@ -591,6 +663,18 @@ egl_window_surface_swap(struct toysurface *base,
 				&server_allocation->height);
 }
 
+static int
+egl_window_surface_get_buffer_age(struct toysurface *base)
+{
+	return 0;
+}
+
+static int
+egl_window_surface_retain(struct toysurface *base)
+{
+	return 0;
+}
+
 static int
 egl_window_surface_acquire(struct toysurface *base, EGLContext ctx)
 {
@@ -665,6 +749,8 @@ egl_window_surface_create(struct display *display,
 
 	surface->base.prepare = egl_window_surface_prepare;
 	surface->base.swap = egl_window_surface_swap;
+	surface->base.get_buffer_age = egl_window_surface_get_buffer_age;
+	surface->base.retain = egl_window_surface_retain;
 	surface->base.acquire = egl_window_surface_acquire;
 	surface->base.release = egl_window_surface_release;
 	surface->base.destroy = egl_window_surface_destroy;
@@ -706,6 +792,11 @@ egl_window_surface_create(struct display *display,
 struct shm_surface_data {
 	struct wl_buffer *buffer;
 	struct shm_pool *pool;
+	/* the dmabuf the buffer was made from, -1 for wl_shm */
+	int dmabuf_fd;
+	/* wl_shm while the format was not known to import yet, the state
+	 * to check for a udmabuf now; NULL otherwise */
+	enum udmabuf_state *udmabuf_retry;
 };
 
 struct wl_buffer *
@@ -730,12 +821,14 @@ shm_surface_data_destroy(void *p)
 	wl_buffer_destroy(data->buffer);
 	if (data->pool)
 		shm_pool_destroy(data->pool);
+	if (data->dmabuf_fd >= 0)
+		close(data->dmabuf_fd);
 
 	free(data);
 }
 
 static struct wl_shm_pool *
-make_shm_pool(struct display *display, int size, void **data)
+make_shm_pool(struct display *display, int size, void **data, int *fd_ret)
 {
 	struct wl_shm_pool *pool;
 	int fd;
@@ -756,7 +849,10 @@ make_shm_pool(struct display *display, int size, void **data)
 
 	pool = wl_shm_create_pool(display->shm, fd, size);
 
-	close(fd);
+	if (fd_ret)
+		*fd_ret = fd;
+	else
+		close(fd);
 
 	return pool;
 }
@@ -765,11 +861,20 @@ static struct shm_pool *
 shm_pool_create(struct display *display, size_t size)
 {
 	struct shm_pool *pool = malloc(sizeof *pool);
+	size_t page_size = getpagesize();
 
 	if (!pool)
 		return NULL;
 
-	pool->pool = make_shm_pool(display, size, &pool->data);
+	pool->fd = -1;
+	if (display->udmabuf_fd >= 0) {
+		/* udmabuf only exports whole pages */
+		size = (size + page_size - 1) & ~(page_size - 1);
+		pool->pool = make_shm_pool(display, size, &pool->data,
+					   &pool->fd);
+	} else {
+		pool->pool = make_shm_pool(display, size, &pool->data, NULL);
+	}
 	if (!pool->pool) {
 		free(pool);
 		return NULL;
@@ -799,6 +904,8 @@ shm_pool_destroy(struct shm_pool *pool)
 {
 	munmap(pool->data, pool->size);
 	wl_shm_pool_destroy(pool->pool);
+	if (pool->fd >= 0)
+		close(pool->fd);
 	free(pool);
 }
 
@@ -819,13 +926,175 @@ data_length_for_shm_surface(struct rectangle *rect)
 	return stride * rect->height;
 }
 
+#ifdef HAVE_LINUX_UDMABUF_H
+static void
+display_disable_udmabuf(struct display *display, const char *reason)
+{
+	fprintf(stderr, "toytoolkit: not using udmabuf: %s\n", reason);
+	close(display->udmabuf_fd);
+	display->udmabuf_fd = -1;
+}
+
+static void
+udmabuf_test_created(void *data, struct zwp_linux_buffer_params_v1 *params,
+		     struct wl_buffer *buffer)
+{
+	struct display *display = data;
+
+	*display->udmabuf_test_state = UDMABUF_IMPORTED;
+	wl_buffer_destroy(buffer);
+	zwp_linux_buffer_params_v1_destroy(params);
+	display->udmabuf_test = NULL;
+}
+
+static void
+udmabuf_test_failed(void *data, struct zwp_linux_buffer_params_v1 *params)
+{
+	struct display *display = data;
+
+	*display->udmabuf_test_state = UDMABUF_UNSUPPORTED;
+	zwp_linux_buffer_params_v1_destroy(params);
+	display->udmabuf_test = NULL;
+	display_disable_udmabuf(display, "dmabuf import failed");
+}
+
+static const struct zwp_linux_buffer_params_v1_listener udmabuf_test_listener = {
+	udmabuf_test_created,
+	udmabuf_test_failed
+};
+#endif
+
+static enum udmabuf_state *
+display_udmabuf_state(struct display *display, uint32_t format)
+{
+	if (format == DRM_FORMAT_XRGB8888)
+		return &display->udmabuf_xrgb8888;
+	if (format == DRM_FORMAT_ARGB8888)
+		return &display->udmabuf_argb8888;
+
+	return NULL;
+}
+
+/* Wrap a part of the pool in a dmabuf, so that the compositor can put it
+ * on a hardware plane instead of copying it. A failed create_immed is a
+ * protocol error, so the first buffer of each format is only sent with an
+ * asynchronous create, as a test, and the caller uses wl_shm for it.
+ * Once the compositor has taken one, later buffers of that format are
+ * created immediately, without waiting for a reply. Returns NULL if the
+ * caller is to use wl_shm, otherwise the buffer and in dmabuf_fd_ret the
+ * dmabuf to bracket CPU access with. */
+static struct wl_buffer *
+shm_pool_create_udmabuf_buffer(struct display *display, struct shm_pool *pool,
+			       int offset, int width, int height, int stride,
+			       uint32_t format, int *dmabuf_fd_ret)
+{
+#ifdef HAVE_LINUX_UDMABUF_H
+	struct zwp_linux_buffer_params_v1 *params;
+	struct udmabuf_create create = { 0 };
+	enum udmabuf_state *state;
+	struct wl_buffer *buffer;
+	size_t page_size = getpagesize();
+	size_t start, end;
+	int dmabuf_fd;
+
+	if (pool->fd < 0 || display->udmabuf_fd < 0)
+		return NULL;
+
+	state = display_udmabuf_state(display, format);
+	if (!state || *state == UDMABUF_UNSUPPORTED ||
+	    *state == UDMABUF_TESTING ||
+	    (*state == UDMABUF_ADVERTISED && display->udmabuf_test))
+		return NULL;
+
+	start = offset & ~(page_size - 1);
+	end = ((size_t)offset + (size_t)stride * height + page_size - 1) &
+	      ~(page_size - 1);
+	assert(end <= pool->size);
+
+	create.memfd = pool->fd;
+	create.flags = UDMABUF_FLAGS_CLOEXEC;
+	create.offset = start;
+	create.size = end - start;
+	dmabuf_fd = ioctl(display->udmabuf_fd, UDMABUF_CREATE, &create);
+	if (dmabuf_fd < 0) {
+		display_disable_udmabuf(display, strerror(errno));
+		return NULL;
+	}
+
+	params = zwp_linux_dmabuf_v1_create_params(display->dmabuf);
+	zwp_linux_buffer_params_v1_add(params, dmabuf_fd, 0, offset - start,
+				       stride, DRM_FORMAT_MOD_LINEAR >> 32,
+				       DRM_FORMAT_MOD_LINEAR & 0xffffffff);
+
+	if (*state == UDMABUF_ADVERTISED) {
+		*state = UDMABUF_TESTING;
+		display->udmabuf_test = params;
+		display->udmabuf_test_state = state;
+		zwp_linux_buffer_params_v1_add_listener(params,
+							&udmabuf_test_listener,
+							display);
+		zwp_linux_buffer_params_v1_create(params, width, height,
+						  format, 0);
+		close(dmabuf_fd);
+		return NULL;
+	}
+
+	buffer = zwp_linux_buffer_params_v1_create_immed(params, width, height,
+							 format, 0);
+	zwp_linux_buffer_params_v1_destroy(params);
+	*dmabuf_fd_ret = dmabuf_fd;
+
+	return buffer;
+#else
+	return NULL;
+#endif
+}
+
+static void
+shm_surface_data_sync(struct shm_surface_data *data, bool start)
+{
+#ifdef HAVE_LINUX_UDMABUF_H
+	struct dma_buf_sync sync = { 0 };
+	int ret;
+
+	if (data->dmabuf_fd < 0)
+		return;
+
+	sync.flags = DMA_BUF_SYNC_RW |
+		     (start ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END);
+	do {
+		ret = ioctl(data->dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync);
+	} while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+#endif
+}
+
+/* The CPU access to a buffer made from a udmabuf goes between these, so
+ * that the kernel keeps the caches coherent with the display hardware
+ * reading it. They do nothing for wl_shm buffers. */
+static void
+shm_surface_data_begin_access(struct shm_surface_data *data)
+{
+	shm_surface_data_sync(data, true);
+}
+
+static void
+shm_surface_data_end_access(struct shm_surface_data *data)
+{
+	shm_surface_data_sync(data, false);
+}
+
+/* With dmabuf set, the buffer may be made from a udmabuf, and then the
+ * caller must bracket its drawing with shm_surface_data_begin_access()
+ * and shm_surface_data_end_access(). */
 static cairo_surface_t *
 display_create_shm_surface_from_pool(struct display *display,
 				     struct rectangle *rectangle,
-				     uint32_t flags, struct shm_pool *pool)
+				     uint32_t flags, struct shm_pool *pool,
+				     bool dmabuf)
 {
 	struct shm_surface_data *data;
-	uint32_t format;
+	uint32_t format, drm_format;
+	enum udmabuf_state *state;
 	cairo_surface_t *surface;
 	int stride, length, offset;
 	void *map;
@@ -838,6 +1107,9 @@ display_create_shm_surface_from_pool(struct display *display,
 						rectangle->width);
 	length = stride * rectangle->height;
 	data->pool = NULL;
+	data->buffer = NULL;
+	data->dmabuf_fd = -1;
+	data->udmabuf_retry = NULL;
 	map = shm_pool_allocate(pool, length, &offset);
 
 	if (!map) {
@@ -854,15 +1126,32 @@ display_create_shm_surface_from_pool(struct display *display,
 	cairo_surface_set_user_data(surface, &shm_surface_data_key,
 				    data, shm_surface_data_destroy);
 
-	if (flags & SURFACE_OPAQUE)
+	if (flags & SURFACE_OPAQUE) {
 		format = WL_SHM_FORMAT_XRGB8888;
-	else
+		drm_format = DRM_FORMAT_XRGB8888;
+	} else {
 		format = WL_SHM_FORMAT_ARGB8888;
+		drm_format = DRM_FORMAT_ARGB8888;
+	}
 
-	data->buffer = wl_shm_pool_create_buffer(pool->pool, offset,
-						 rectangle->width,
-						 rectangle->height,
-						 stride, format);
+	if (dmabuf) {
+		data->buffer =
+			shm_pool_create_udmabuf_buffer(display, pool, offset,
+						       rectangle->width,
+						       rectangle->height,
+						       stride, drm_format,
+						       &data->dmabuf_fd);
+		state = display_udmabuf_state(display, drm_format);
+		if (!data->buffer && display->udmabuf_fd >= 0 && state &&
+		    (*state == UDMABUF_ADVERTISED ||
+		     *state == UDMABUF_TESTING))
+			data->udmabuf_retry = state;
+	}
+	if (!data->buffer)
+		data->buffer = wl_shm_pool_create_buffer(pool->pool, offset,
+							 rectangle->width,
+							 rectangle->height,
+							 stride, format);
 
 	return surface;
 }
@@ -871,7 +1160,7 @@ static cairo_surface_t *
 display_create_shm_surface(struct display *display,
 			   struct rectangle *rectangle, uint32_t flags,
 			   struct shm_pool *alternate_pool,
-			   struct shm_surface_data **data_ret)
+			   struct shm_surface_data **data_ret, bool dmabuf)
 {
 	struct shm_surface_data *data;
 	struct shm_pool *pool;
@@ -882,7 +1171,8 @@ display_create_shm_surface(struct display *display,
 		surface = display_create_shm_surface_from_pool(display,
 							       rectangle,
 							       flags,
-							       alternate_pool);
+							       alternate_pool,
+							       dmabuf);
 		if (surface) {
 			data = cairo_surface_get_user_data(surface,
 							   &shm_surface_data_key);
@@ -896,7 +1186,7 @@ display_create_shm_surface(struct display *display,
 
 	surface =
 		display_create_shm_surface_from_pool(display, rectangle,
-						     flags, pool);
+						     flags, pool, dmabuf);
 
 	if (!surface) {
 		shm_pool_destroy(pool);
@@ -936,7 +1226,7 @@ display_create_surface(struct display *display,
 
 	assert(flags & SURFACE_SHM);
 	return display_create_shm_surface(display, rectangle, flags,
-					  NULL, NULL);
+					  NULL, NULL, false);
 }
 
 struct shm_surface_leaf {
@@ -946,6 +1236,8 @@ struct shm_surface_leaf {
 
 	struct shm_pool *resize_pool;
 	int busy;
+	/* number of swaps since this leaf was posted, 0 if never */
+	int age;
 };
 
 static void
@@ -963,6 +1255,12 @@ shm_surface_leaf_release(struct shm_surface_leaf *leaf)
 
 #define MAX_LEAVES 3
 
+/* Damage of one swap in buffer coordinates, n < 0 for everything */
+struct shm_surface_damage {
+	struct rectangle rects[MAX_DAMAGE_RECTS];
+	int n;
+};
+
 struct shm_surface {
 	struct toysurface base;
 	struct display *display;
@@ -972,6 +1270,9 @@ struct shm_surface {
 
 	struct shm_surface_leaf leaf[MAX_LEAVES];
 	struct shm_surface_leaf *current;
+
+	/* damage of the last swaps, the most recent first */
+	struct shm_surface_damage damage_history[MAX_LEAVES];
 };
 
 static struct shm_surface *
@@ -1008,9 +1309,8 @@ static void
 shm_surface_buffer_release(void *data, struct wl_buffer *buffer)
 {
 	struct shm_surface *surface = data;
-	struct shm_surface_leaf *leaf;
+	struct shm_surface_leaf *leaf, *keep;
 	int i;
-	int free_found;
 
 	shm_surface_buffer_state_debug(surface, "buffer_release before");
 
@@ -1023,17 +1323,24 @@ shm_surface_buffer_release(void *data, struct wl_buffer *buffer)
 	}
 	assert(i < MAX_LEAVES && "unknown buffer released");
 
-	/* Leave one free leaf with storage, release others */
-	free_found = 0;
+	/* Leave one free leaf with storage, release others. Keep the most
+	 * recently posted one, its content is the cheapest to retain. */
+	keep = NULL;
 	for (i = 0; i < MAX_LEAVES; i++) {
 		leaf = &surface->leaf[i];
 
 		if (!leaf->cairo_surface || leaf->busy)
 			continue;
 
-		if (!free_found)
-			free_found = 1;
-		else
+		if (!keep || (leaf->age > 0 &&
+			      (keep->age == 0 || leaf->age < keep->age)))
+			keep = leaf;
+	}
+
+	for (i = 0; i < MAX_LEAVES; i++) {
+		leaf = &surface->leaf[i];
+
+		if (leaf->cairo_surface && !leaf->busy && leaf != keep)
 			shm_surface_leaf_release(leaf);
 	}
 
@@ -1085,9 +1392,13 @@ shm_surface_prepare(struct toysurface *base, int dx, int dy,
 
 	surface_to_buffer_size (buffer_transform, buffer_scale, &width, &height);
 
+	/* A leaf that got wl_shm while the udmabuf import was being tested
+	 * is made again once the import worked. */
 	if (leaf->cairo_surface &&
 	    cairo_image_surface_get_width(leaf->cairo_surface) == width &&
-	    cairo_image_surface_get_height(leaf->cairo_surface) == height)
+	    cairo_image_surface_get_height(leaf->cairo_surface) == height &&
+	    !(leaf->data->udmabuf_retry &&
+	      *leaf->data->udmabuf_retry == UDMABUF_IMPORTED))
 		goto out;
 
 	if (leaf->cairo_surface)
@@ -1113,26 +1424,50 @@ shm_surface_prepare(struct toysurface *base, int dx, int dy,
 		display_create_shm_surface(surface->display, &rect,
 					   surface->flags,
 					   leaf->resize_pool,
-					   &leaf->data);
+					   &leaf->data, true);
 	if (!leaf->cairo_surface)
 		return NULL;
 
 	wl_buffer_add_listener(leaf->data->buffer,
 			       &shm_surface_buffer_listener, surface);
+	leaf->age = 0;
 
 out:
 	surface->current = leaf;
+	shm_surface_data_begin_access(leaf->data);
 
 	return cairo_surface_reference(leaf->cairo_surface);
 }
 
+static void
+shm_surface_damage(struct shm_surface *surface,
+		   enum wl_output_transform buffer_transform, int32_t buffer_scale,
+		   const struct rectangle *rect)
+{
+	if (surface->display->compositor_version >=
+	    WL_SURFACE_DAMAGE_BUFFER_SINCE_VERSION &&
+	    buffer_transform == WL_OUTPUT_TRANSFORM_NORMAL) {
+		wl_surface_damage_buffer(surface->surface,
+					 rect->x * buffer_scale,
+					 rect->y * buffer_scale,
+					 rect->width * buffer_scale,
+					 rect->height * buffer_scale);
+	} else {
+		wl_surface_damage(surface->surface, rect->x, rect->y,
+				  rect->width, rect->height);
+	}
+}
+
 static void
 shm_surface_swap(struct toysurface *base,
 		 enum wl_output_transform buffer_transform, int32_t buffer_scale,
+		 const struct rectangle *damage, int n_damage,
 		 struct rectangle *server_allocation)
 {
 	struct shm_surface *surface = to_shm_surface(base);
 	struct shm_surface_leaf *leaf = surface->current;
+	struct shm_surface_damage *history;
+	int i;
 
 	server_allocation->width =
 		cairo_image_surface_get_width(leaf->cairo_surface);
@@ -1143,19 +1478,140 @@ shm_surface_swap(struct toysurface *base,
 				&server_allocation->width,
 				&server_allocation->height);
 
+	shm_surface_data_end_access(leaf->data);
 	wl_surface_attach(surface->surface, leaf->data->buffer,
 			  surface->dx, surface->dy);
-	wl_surface_damage(surface->surface, 0, 0,
-			  server_allocation->width, server_allocation->height);
+	if (damage) {
+		for (i = 0; i < n_damage; i++)
+			shm_surface_damage(surface, buffer_transform,
+					   buffer_scale, &damage[i]);
+	} else {
+		wl_surface_damage(surface->surface, 0, 0,
+				  server_allocation->width,
+				  server_allocation->height);
+	}
 	wl_surface_commit(surface->surface);
 
+	memmove(&surface->damage_history[1], &surface->damage_history[0],
+		(MAX_LEAVES - 1) * sizeof surface->damage_history[0]);
+	history = &surface->damage_history[0];
+	history->n = -1;
+	if (damage && buffer_transform == WL_OUTPUT_TRANSFORM_NORMAL) {
+		history->n = n_damage;
+		for (i = 0; i < n_damage; i++) {
+			history->rects[i].x = damage[i].x * buffer_scale;
+			history->rects[i].y = damage[i].y * buffer_scale;
+			history->rects[i].width = damage[i].width * buffer_scale;
+			history->rects[i].height = damage[i].height * buffer_scale;
+		}
+	}
+
 	DBG_OBJ(surface->surface, "leaf %d busy\n",
 		(int)(leaf - &surface->leaf[0]));
 
+	for (i = 0; i < MAX_LEAVES; i++) {
+		if (surface->leaf[i].age > 0)
+			surface->leaf[i].age++;
+	}
+
+	leaf->age = 1;
 	leaf->busy = 1;
 	surface->current = NULL;
 }
 
+static int
+shm_surface_get_buffer_age(struct toysurface *base)
+{
+	struct shm_surface *surface = to_shm_surface(base);
+
+	return surface->current ? surface->current->age : 0;
+}
+
+static void
+shm_surface_copy_rect(cairo_surface_t *dst, cairo_surface_t *src,
+		      const struct rectangle *rect)
+{
+	int width = cairo_image_surface_get_width(dst);
+	int height = cairo_image_surface_get_height(dst);
+	int stride = cairo_image_surface_get_stride(dst);
+	unsigned char *dst_data = cairo_image_surface_get_data(dst);
+	unsigned char *src_data = cairo_image_surface_get_data(src);
+	int x1, y1, x2, y2, y;
+
+	x1 = MAX(rect->x, 0);
+	y1 = MAX(rect->y, 0);
+	x2 = MIN(rect->x + rect->width, width);
+	y2 = MIN(rect->y + rect->height, height);
+
+	for (y = y1; y < y2 && x1 < x2; y++)
+		memcpy(dst_data + y * stride + x1 * 4,
+		       src_data + y * stride + x1 * 4,
+		       (x2 - x1) * 4);
+}
+
+static int
+shm_surface_retain(struct toysurface *base)
+{
+	struct shm_surface *surface = to_shm_surface(base);
+	struct shm_surface_leaf *leaf = surface->current;
+	struct shm_surface_leaf *prev = NULL;
+	struct shm_surface_damage *history;
+	struct rectangle all;
+	int i, j;
+
+	if (!leaf)
+		return 0;
+
+	if (leaf->age == 1)
+		return 1;
+
+	/* the last posted leaf, if it still has storage */
+	for (i = 0; i < MAX_LEAVES; i++) {
+		if (surface->leaf[i].age == 1)
+			prev = &surface->leaf[i];
+	}
+
+	if (!prev ||
+	    cairo_image_surface_get_width(prev->cairo_surface) !=
+	    cairo_image_surface_get_width(leaf->cairo_surface) ||
+	    cairo_image_surface_get_height(prev->cairo_surface) !=
+	    cairo_image_surface_get_height(leaf->cairo_surface))
+		return 0;
+
+	all.x = 0;
+	all.y = 0;
+	all.width = cairo_image_surface_get_width(leaf->cairo_surface);
+	all.height = cairo_image_surface_get_height(leaf->cairo_surface);
+
+	cairo_surface_flush(leaf->cairo_surface);
+
+	/* The leaf lacks the damage of the age - 1 swaps after its own. */
+	if (leaf->age == 0 || leaf->age - 1 > MAX_LEAVES) {
+		shm_surface_copy_rect(leaf->cairo_surface,
+				      prev->cairo_surface, &all);
+	} else {
+		for (i = 0; i < leaf->age - 1; i++) {
+			history = &surface->damage_history[i];
+			if (history->n < 0) {
+				shm_surface_copy_rect(leaf->cairo_surface,
+						      prev->cairo_surface,
+						      &all);
+				break;
+			}
+
+			for (j = 0; j < history->n; j++)
+				shm_surface_copy_rect(leaf->cairo_surface,
+						      prev->cairo_surface,
+						      &history->rects[j]);
+		}
+	}
+
+	cairo_surface_mark_dirty(leaf->cairo_surface);
+	leaf->age = 1;
+
+	return 1;
+}
+
 static int
 shm_surface_acquire(struct toysurface *base, EGLContext ctx)
 {
@@ -1189,6 +1645,8 @@ shm_surface_create(struct display *display, struct wl_surface *wl_surface,
 	surface = xzalloc(sizeof *surface);
 	surface->base.prepare = shm_surface_prepare;
 	surface->base.swap = shm_surface_swap;
+	surface->base.get_buffer_age = shm_surface_get_buffer_age;
+	surface->base.retain = shm_surface_retain;
 	surface->base.acquire = shm_surface_acquire;
 	surface->base.release = shm_surface_release;
 	surface->base.destroy = shm_surface_destroy;
@@ -1410,6 +1868,11 @@ surface_flush(struct surface *surface)
 	}
 
 	if (surface->viewport) {
+		wp_viewport_set_source(surface->viewport,
+				       widget->viewport_src_x,
+				       widget->viewport_src_y,
+				       widget->viewport_src_width,
+				       widget->viewport_src_height);
 		wp_viewport_set_destination(surface->viewport,
 					    widget->viewport_dest_width,
 					    widget->viewport_dest_height);
@@ -1417,7 +1880,10 @@ surface_flush(struct surface *surface)
 
 	surface->toysurface->swap(surface->toysurface,
 				  surface->buffer_transform, surface->buffer_scale,
+				  surface->damage_all ? NULL : surface->damage,
+				  surface->n_damage,
 				  &surface->server_allocation);
+	surface->swap_count++;
 
 	cairo_surface_destroy(surface->cairo_surface);
 	surface->cairo_surface = NULL;
@@ -1444,6 +1910,24 @@ window_get_display(struct window *window)
 	return window->display;
 }
 
+/* Whether every widget drawing on this surface uses partial damage, so
+ * the surface content can be carried over from one buffer to the next. */
+static bool
+widget_tree_has_partial_damage(struct widget *widget)
+{
+	struct widget *child;
+
+	if (widget->redraw_handler && !widget->partial_damage)
+		return false;
+
+	wl_list_for_each(child, &widget->child_list, link) {
+		if (!widget_tree_has_partial_damage(child))
+			return false;
+	}
+
+	return true;
+}
+
 static void
 surface_create_surface(struct surface *surface, uint32_t flags)
 {
@@ -1468,6 +1952,24 @@ surface_create_surface(struct surface *surface, uint32_t flags)
 		surface->toysurface, 0, 0,
 		allocation.width, allocation.height, flags,
 		surface->buffer_transform, surface->buffer_scale);
+
+	surface->buffer_age =
+		surface->toysurface->get_buffer_age(surface->toysurface);
+	if (surface->buffer_age != 1 &&
+	    widget_tree_has_partial_damage(surface->widget))
+		surface->buffer_age =
+			surface->toysurface->retain(surface->toysurface);
+	surface->n_damage = 0;
+	surface->damage_all = surface->buffer_age == 0;
+}
+
+/* The surface content must be redrawn entirely: widgets drawn after
+ * this see a buffer age of 0, and the whole surface is damaged. */
+static void
+surface_invalidate(struct surface *surface)
+{
+	surface->buffer_age = 0;
+	surface->damage_all = 1;
 }
 
 static void
@@ -1683,6 +2185,10 @@ widget_create(struct window *window, struct surface *surface, void *data)
 	widget->use_cairo = 1;
 	widget->viewport_dest_width = -1;
 	widget->viewport_dest_height = -1;
+	widget->viewport_src_x = wl_fixed_from_int(-1);
+	widget->viewport_src_y = wl_fixed_from_int(-1);
+	widget->viewport_src_width = wl_fixed_from_int(-1);
+	widget->viewport_src_height = wl_fixed_from_int(-1);
 
 	return widget;
 }
@@ -2040,6 +2546,67 @@ widget_set_use_cairo(struct widget *widget,
 	widget->use_cairo = use_cairo;
 }
 
+void
+widget_set_partial_damage(struct widget *widget, int partial_damage)
+{
+	widget->partial_damage = partial_damage;
+}
+
+/*
+ * Returns the age of the buffer the widget is drawn into: the content
+ * posted buffer_age swaps ago is still there, so only what changed since
+ * then needs to be drawn. 0 means everything must be drawn.
+ *
+ * When all the widgets of a surface use partial damage, the content of
+ * the previous buffer is carried over, and the age is either 1 or 0.
+ */
+int
+widget_get_buffer_age(struct widget *widget)
+{
+	if (widget->use_cairo && !widget_get_cairo_surface(widget))
+		return 0;
+
+	return widget->surface->buffer_age;
+}
+
+/*
+ * Adds a rectangle, in the same coordinates as the widget allocation, to
+ * the damage of the next commit of the widget's surface. Only redraw
+ * handlers of widgets with partial damage enabled need to call this.
+ */
+void
+widget_damage(struct widget *widget,
+	      int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	struct surface *surface = widget->surface;
+	struct rectangle *r;
+	int32_t x2, y2;
+
+	if (surface->damage_all || width <= 0 || height <= 0)
+		return;
+
+	x -= surface->allocation.x;
+	y -= surface->allocation.y;
+
+	if (surface->n_damage < MAX_DAMAGE_RECTS) {
+		r = &surface->damage[surface->n_damage++];
+		r->x = x;
+		r->y = y;
+		r->width = width;
+		r->height = height;
+		return;
+	}
+
+	/* Out of rectangles, grow the last one to cover the new one. */
+	r = &surface->damage[MAX_DAMAGE_RECTS - 1];
+	x2 = MAX(r->x + r->width, x + width);
+	y2 = MAX(r->y + r->height, y + height);
+	r->x = MIN(r->x, x);
+	r->y = MIN(r->y, y);
+	r->width = x2 - r->x;
+	r->height = y2 - r->y;
+}
+
 int
 widget_set_viewport_destination(struct widget *widget, int width, int height)
 {
@@ -2057,6 +2624,10 @@ widget_set_viewport_destination(struct widget *widget, int width, int height)
 
 		widget->viewport_dest_width = -1;
 		widget->viewport_dest_height = -1;
+		widget->viewport_src_x = wl_fixed_from_int(-1);
+		widget->viewport_src_y = wl_fixed_from_int(-1);
+		widget->viewport_src_width = wl_fixed_from_int(-1);
+		widget->viewport_src_height = wl_fixed_from_int(-1);
 		return 0;
 	}
 
@@ -2073,6 +2644,32 @@ widget_set_viewport_destination(struct widget *widget, int width, int height)
 	return 0;
 }
 
+int
+widget_set_viewport_source(struct widget *widget, double x, double y,
+			   double width, double height)
+{
+	struct window *window = widget->window;
+	struct display *display = window->display;
+	struct surface *surface = widget->surface;
+
+	if (!display->viewporter)
+		return -1;
+
+	if (!surface->viewport) {
+		surface->viewport = wp_viewporter_get_viewport(display->viewporter,
+				surface->surface);
+		if (!surface->viewport)
+			return -1;
+	}
+
+	widget->viewport_src_x = wl_fixed_from_double(x);
+	widget->viewport_src_y = wl_fixed_from_double(y);
+	widget->viewport_src_width = wl_fixed_from_double(width);
+	widget->viewport_src_height = wl_fixed_from_double(height);
+
+	return 0;
+}
+
 cairo_surface_t *
 window_get_surface(struct window *window)
 {
@@ -2310,15 +2907,31 @@ frame_redraw_handler(struct widget *widget, void *data)
 	cairo_t *cr;
 	struct window_frame *frame = data;
 	struct window *window = widget->window;
+	int age;
 
 	if (window->fullscreen)
 		return;
 
+	/* The frame clears the whole surface, so skip it if the buffer
+	 * already holds the current frame and the child only redraws what
+	 * changed. */
+	if (frame->child->partial_damage &&
+	    !(frame_status(frame->frame) & FRAME_STATUS_REPAINT)) {
+		age = widget_get_buffer_age(widget);
+		if (age > 0 &&
+		    widget->surface->swap_count - frame->repaint_count >=
+		    (uint32_t) age)
+			return;
+	}
+
 	cr = widget_cairo_create(widget);
 
 	frame_repaint(frame->frame, cr);
 
 	cairo_destroy(cr);
+
+	frame->repaint_count = widget->surface->swap_count;
+	surface_invalidate(widget->surface);
 }
 
 static int
@@ -2587,6 +3200,7 @@ window_frame_create(struct window *window, void *data)
 	frame->child = widget_add_widget(frame->widget, data);
 
 	widget_set_redraw_handler(frame->widget, frame_redraw_handler);
+	widget_set_partial_damage(frame->widget, 1);
 	widget_set_resize_handler(frame->widget, frame_resize_handler);
 	widget_set_enter_handler(frame->widget, frame_enter_handler);
 	widget_set_leave_handler(frame->widget, frame_leave_handler);
@@ -4526,8 +5140,11 @@ widget_redraw(struct widget *widget)
 {
 	struct widget *child;
 
-	if (widget->redraw_handler)
+	if (widget->redraw_handler) {
 		widget->redraw_handler(widget, widget->user_data);
+		if (!widget->partial_damage)
+			widget->surface->damage_all = 1;
+	}
 	wl_list_for_each(child, &widget->child_list, link)
 		widget_redraw(child);
 }
@@ -6014,6 +6631,59 @@ global_destroy(struct display *disp, struct global *g)
 	free(g);
 }
 
+static void
+dmabuf_format(void *data, struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf,
+	      uint32_t format)
+{
+	/* deprecated, modifiers are advertised since version 3 */
+}
+
+static void
+dmabuf_modifier(void *data, struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf,
+		uint32_t format, uint32_t modifier_hi, uint32_t modifier_lo)
+{
+	struct display *d = data;
+	uint64_t modifier = ((uint64_t) modifier_hi << 32) | modifier_lo;
+
+	if (modifier != DRM_FORMAT_MOD_LINEAR)
+		return;
+
+	if (format == DRM_FORMAT_XRGB8888 &&
+	    d->udmabuf_xrgb8888 == UDMABUF_UNSUPPORTED)
+		d->udmabuf_xrgb8888 = UDMABUF_ADVERTISED;
+	else if (format == DRM_FORMAT_ARGB8888 &&
+		 d->udmabuf_argb8888 == UDMABUF_UNSUPPORTED)
+		d->udmabuf_argb8888 = UDMABUF_ADVERTISED;
+}
+
+static const struct zwp_linux_dmabuf_v1_listener dmabuf_listener = {
+	dmabuf_format,
+	dmabuf_modifier
+};
+
+/* With TOYTOOLKIT_UDMABUF set in the environment, SHM buffers are sent as
+ * linear dmabufs made from their memfd by /dev/udmabuf. The compositor can
+ * then scan them out directly instead of compositing a copy. */
+static void
+display_add_dmabuf(struct display *d, uint32_t id)
+{
+#ifdef HAVE_LINUX_UDMABUF_H
+	if (d->dmabuf || !getenv("TOYTOOLKIT_UDMABUF"))
+		return;
+
+	d->udmabuf_fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (d->udmabuf_fd < 0) {
+		fprintf(stderr, "toytoolkit: cannot open /dev/udmabuf: %s\n",
+			strerror(errno));
+		return;
+	}
+
+	d->dmabuf = wl_registry_bind(d->registry, id,
+				     &zwp_linux_dmabuf_v1_interface, 3);
+	zwp_linux_dmabuf_v1_add_listener(d->dmabuf, &dmabuf_listener, d);
+#endif
+}
+
 static void
 registry_handle_global(void *data, struct wl_registry *registry, uint32_t id,
 		       const char *interface, uint32_t version)
@@ -6028,8 +6698,10 @@ registry_handle_global(void *data, struct wl_registry *registry, uint32_t id,
 	wl_list_insert(d->global_list.prev, &global->link);
 
 	if (strcmp(interface, "wl_compositor") == 0) {
+		d->compositor_version = MIN(version, 4);
 		d->compositor = wl_registry_bind(registry, id,
-						 &wl_compositor_interface, 3);
+						 &wl_compositor_interface,
+						 d->compositor_version);
 	} else if (strcmp(interface, "wl_output") == 0) {
 		display_add_output(d, id);
 	} else if (strcmp(interface, "wl_seat") == 0) {
@@ -6066,6 +6738,9 @@ registry_handle_global(void *data, struct wl_registry *registry, uint32_t id,
 		d->viewporter =
 			wl_registry_bind(registry, id,
 					&wp_viewporter_interface, 1);
+	} else if (!strcmp(interface, "zwp_linux_dmabuf_v1") &&
+		   version >= 3) {
+		display_add_dmabuf(d, id);
 	}
 
 	if (d->global_handler)
@@ -6260,6 +6935,7 @@ display_create(int *argc, char *argv[])
 	wl_list_init(&d->input_list);
 	wl_list_init(&d->output_list);
 	wl_list_init(&d->global_list);
+	d->udmabuf_fd = -1;
 
 	d->display = wl_display_connect(NULL);
 	if (d->display == NULL) {
@@ -6370,6 +7046,13 @@ display_destroy(struct display *display)
 	if (display->viewporter)
 		wp_viewporter_destroy(display->viewporter);
 
+	if (display->udmabuf_test)
+		zwp_linux_buffer_params_v1_destroy(display->udmabuf_test);
+	if (display->dmabuf)
+		zwp_linux_dmabuf_v1_destroy(display->dmabuf);
+	if (display->udmabuf_fd >= 0)
+		close(display->udmabuf_fd);
+
 	if (display->subcompositor)
 		wl_subcompositor_destroy(display->subcompositor);
 
@@ -601,6 +601,13 @@ void
 widget_schedule_redraw(struct widget *widget);
 void
 widget_set_use_cairo(struct widget *widget, int use_cairo);
+void
+widget_set_partial_damage(struct widget *widget, int partial_damage);
+int
+widget_get_buffer_age(struct widget *widget);
+void
+widget_damage(struct widget *widget,
+	      int32_t x, int32_t y, int32_t width, int32_t height);
 
 /*
  * Sets the viewport destination for the widget's surface
@@ -610,6 +617,15 @@ widget_set_use_cairo(struct widget *widget, int use_cairo);
 int
 widget_set_viewport_destination(struct widget *widget, int width, int height);
 
+/*
+ * Sets the viewport source rectangle for the widget's surface, in surface
+ * coordinates. Return 0 on success and -1 on failure. Set all values to
+ * -1 to use the whole surface.
+ */
+int
+widget_set_viewport_source(struct widget *widget, double x, double y,
+			   double width, double height);
+
 struct widget *
 window_frame_create(struct window *window, void *data);
 
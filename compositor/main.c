@@ -69,12 +69,14 @@
 #define WINDOW_TITLE "Weston Compositor"
 /* flight recorder size (in bytes) */
 #define DEFAULT_FLIGHT_REC_SIZE (5 * 1024 * 1024)
+#define DEFAULT_LOG_RING_SIZE (1024 * 1024)
 
 struct wet_output_config {
 	int width;
 	int height;
 	int32_t scale;
 	uint32_t transform;
+	char *refresh_rate;
 };
 
 struct wet_compositor;
@@ -667,6 +669,10 @@ usage(int error_code)
 #endif
 		"  --modules\t\tLoad the comma-separated list of modules\n"
 		"  --log=FILE\t\tLog to the given file\n"
+		"  --log-async\t\tWrite the log file from a separate writer\n"
+		"\t\t\tthread; queued messages are lost on a crash\n"
+		"  --log-rotate-size=KIB\tRotate the log file to FILE.1 when it\n"
+		"\t\t\tgrows past KIB kibibytes, needs --log-async\n"
 		"  -c, --config=FILE\tConfig file to load, defaults to weston.ini\n"
 		"  --no-config\t\tDo not read weston.ini\n"
 		"  --wait-for-debugger\tRaise SIGSTOP on start-up\n"
@@ -677,6 +683,9 @@ usage(int error_code)
 		"  -f, --flight-rec-scopes=SCOPE\n\t\t\tSpecify log scopes to "
 			"subscribe to.\n\t\t\tCan specify multiple scopes, "
 			"each followed by comma\n"
+		"  --flight-rec-file=FILE\n\t\t\tKeep the flight recorder in FILE, "
+			"to recover it\n\t\t\twith weston-flight-rec-decode "
+			"after a crash\n"
 		"  -h, --help\t\tThis help message\n\n");
 
 #if defined(BUILD_DRM_COMPOSITOR)
@@ -710,6 +719,8 @@ usage(int error_code)
 		"  --use-pixman\t\tUse the pixman (CPU) renderer (default: no rendering)\n"
 		"  --use-gl\t\tUse the GL renderer (default: no rendering)\n"
 		"  --no-outputs\t\tDo not create any virtual outputs\n"
+		"  --refresh-rate=HZ\tRefresh rate of the virtual outputs, 0 for\n"
+		"\t\t\tfree-running (default: 60)\n"
 		"\n");
 #endif
 
@@ -1137,6 +1148,20 @@ weston_compositor_init_config(struct weston_compositor *ec,
 	weston_log("Output repaint window is %d ms maximum.\n",
 		   ec->repaint_msec);
 
+	weston_config_section_get_bool(s, "coalesce-pointer-motion",
+				       &ec->coalesce_pointer_motion, false);
+
+	weston_config_section_get_int(s, "upload-damage-max-rects",
+				      &ec->upload_damage_policy.max_rects, 0);
+	weston_config_section_get_int(s, "upload-damage-max-waste",
+				      &ec->upload_damage_policy.max_waste_percent,
+				      0);
+	weston_config_section_get_int(s, "composite-damage-max-rects",
+				      &ec->composite_damage_policy.max_rects, 0);
+	weston_config_section_get_int(s, "composite-damage-max-waste",
+				      &ec->composite_damage_policy.max_waste_percent,
+				      0);
+
 	weston_config_section_get_bool(s, "color-management",
 				       &color_management, false);
 	if (color_management) {
@@ -2287,7 +2312,7 @@ drm_backend_remoted_output_configure(struct weston_output *output,
 	char *seat = NULL;
 	char *host = NULL;
 	char *pipeline = NULL;
-	int port, ret;
+	int port, max_queued_frames, ret;
 
 	ret = api->set_mode(output, modeline);
 	if (ret < 0) {
@@ -2314,6 +2339,10 @@ drm_backend_remoted_output_configure(struct weston_output *output,
 	api->set_seat(output, seat);
 	free(seat);
 
+	weston_config_section_get_int(section, "max-queued-frames",
+				      &max_queued_frames, 2);
+	api->set_max_queued_frames(output, max_queued_frames);
+
 	weston_config_section_get_string(section, "gst-pipeline", &pipeline,
 					 NULL);
 	if (pipeline) {
@@ -2619,6 +2648,25 @@ load_drm_backend(struct weston_compositor *c,
 	return ret;
 }
 
+static int
+parse_refresh_rate(const char *str, int *refresh)
+{
+	char *end;
+	double hz;
+
+	errno = 0;
+	hz = strtod(str, &end);
+	if (errno != 0 || end == str || *end != '\0' ||
+	    hz < 0.0 || hz > 1000.0)
+		return -1;
+
+	*refresh = (int)(hz * 1000.0 + 0.5);
+	if (hz > 0.0 && *refresh == 0)
+		return -1;
+
+	return 0;
+}
+
 static int
 headless_backend_output_configure(struct weston_output *output)
 {
@@ -2628,8 +2676,46 @@ headless_backend_output_configure(struct weston_output *output)
 		.scale = 1,
 		.transform = WL_OUTPUT_TRANSFORM_NORMAL
 	};
+	struct wet_compositor *compositor = to_wet_compositor(output->compositor);
+	struct wet_output_config *parsed_options = compositor->parsed_options;
+	const struct weston_headless_output_api *api;
+	struct weston_config_section *section;
+	char *refresh_rate = NULL;
+	int refresh;
+	int ret = 0;
 
-	return wet_configure_windowed_output_from_config(output, &defaults);
+	if (wet_configure_windowed_output_from_config(output, &defaults) < 0)
+		return -1;
+
+	section = weston_config_get_section(wet_get_config(output->compositor),
+					    "output", "name", output->name);
+	weston_config_section_get_string(section, "refresh-rate",
+					 &refresh_rate, NULL);
+	if (parsed_options->refresh_rate) {
+		free(refresh_rate);
+		refresh_rate = strdup(parsed_options->refresh_rate);
+	}
+
+	if (!refresh_rate)
+		return 0;
+
+	api = weston_headless_output_get_api(output->compositor);
+	if (!api) {
+		weston_log("Cannot use weston_headless_output_api.\n");
+		ret = -1;
+	} else if (parse_refresh_rate(refresh_rate, &refresh) < 0) {
+		weston_log("Invalid refresh rate \"%s\" for output %s\n",
+			   refresh_rate, output->name);
+		ret = -1;
+	} else if (api->output_set_refresh_rate(output, refresh) < 0) {
+		weston_log("Cannot set refresh rate of output %s\n",
+			   output->name);
+		ret = -1;
+	}
+
+	free(refresh_rate);
+
+	return ret;
 }
 
 static int
@@ -2661,6 +2747,7 @@ load_headless_backend(struct weston_compositor *c,
 		{ WESTON_OPTION_BOOLEAN, "use-gl", 0, &config.use_gl },
 		{ WESTON_OPTION_STRING, "transform", 0, &transform },
 		{ WESTON_OPTION_BOOLEAN, "no-outputs", 0, &no_outputs },
+		{ WESTON_OPTION_STRING, "refresh-rate", 0, &parsed_options->refresh_rate },
 	};
 
 	parse_options(options, ARRAY_LENGTH(options), argc, argv);
@@ -3164,6 +3251,40 @@ out:
 	return ret;
 }
 
+static int
+wet_configure_debug_streams(struct weston_compositor *compositor,
+			    struct weston_config_section *section)
+{
+	enum weston_log_overflow_policy policy;
+	uint32_t size_kib;
+	char *overflow;
+	int ret = 0;
+
+	weston_config_section_get_uint(section, "debug-stream-buffer-size",
+				       &size_kib,
+				       WESTON_LOG_STREAM_BUFFER_SIZE_DEFAULT / 1024);
+	weston_config_section_get_string(section, "debug-stream-overflow",
+					 &overflow, "drop-oldest");
+
+	if (strcmp(overflow, "drop-oldest") == 0) {
+		policy = WESTON_LOG_OVERFLOW_DROP_OLDEST;
+	} else if (strcmp(overflow, "disconnect") == 0) {
+		policy = WESTON_LOG_OVERFLOW_DISCONNECT;
+	} else {
+		weston_log("fatal: invalid debug-stream-overflow \"%s\"\n",
+			   overflow);
+		ret = -1;
+	}
+
+	if (ret == 0)
+		weston_compositor_set_debug_stream_limits(compositor,
+							  (size_t)size_kib * 1024,
+							  policy);
+	free(overflow);
+
+	return ret;
+}
+
 static void
 weston_log_setup_scopes(struct weston_log_context *log_ctx,
 			struct weston_log_subscriber *subscriber,
@@ -3228,6 +3349,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	char *log = NULL;
 	char *log_scopes = NULL;
 	char *flight_rec_scopes = NULL;
+	char *flight_rec_file = NULL;
 	char *server_socket = NULL;
 	int32_t idle_time = -1;
 	int32_t help = 0;
@@ -3235,6 +3357,8 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	int32_t version = 0;
 	int32_t noconfig = 0;
 	int32_t debug_protocol = 0;
+	bool log_async = false;
+	int32_t log_rotate_kib = 0;
 	bool numlock_on;
 	char *config_file = NULL;
 	struct weston_config *config = NULL;
@@ -3261,6 +3385,8 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 #endif
 		{ WESTON_OPTION_STRING, "modules", 0, &option_modules },
 		{ WESTON_OPTION_STRING, "log", 0, &log },
+		{ WESTON_OPTION_BOOLEAN, "log-async", 0, &log_async },
+		{ WESTON_OPTION_INTEGER, "log-rotate-size", 0, &log_rotate_kib },
 		{ WESTON_OPTION_BOOLEAN, "help", 'h', &help },
 		{ WESTON_OPTION_BOOLEAN, "version", 0, &version },
 		{ WESTON_OPTION_BOOLEAN, "no-config", 0, &noconfig },
@@ -3269,6 +3395,7 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 		{ WESTON_OPTION_BOOLEAN, "debug", 0, &debug_protocol },
 		{ WESTON_OPTION_STRING, "logger-scopes", 'l', &log_scopes },
 		{ WESTON_OPTION_STRING, "flight-rec-scopes", 'f', &flight_rec_scopes },
+		{ WESTON_OPTION_STRING, "flight-rec-file", 0, &flight_rec_file },
 	};
 
 	wl_list_init(&wet.layoutput_list);
@@ -3299,13 +3426,40 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	log_scope = weston_log_ctx_add_log_scope(log_ctx, "log",
 			"Weston and Wayland log\n", NULL, NULL, NULL);
 
-	if (!weston_log_file_open(log))
+	if (log_rotate_kib < 0 || (log_rotate_kib > 0 && (!log || !log_async))) {
+		fprintf(stderr, "--log-rotate-size needs --log and --log-async\n");
 		return EXIT_FAILURE;
+	}
+
+	/* On request, a log file is written from its own thread so that slow
+	 * storage does not stall the compositor. Messages still queued when
+	 * the compositor crashes are lost, so this is not the default. */
+	if (log && log_async) {
+		if (!weston_log_file_open(NULL))
+			return EXIT_FAILURE;
+
+		logger = weston_log_subscriber_create_log_async(log,
+						DEFAULT_LOG_RING_SIZE,
+						(size_t)log_rotate_kib * 1024);
+		if (!logger)
+			return EXIT_FAILURE;
+	} else {
+		if (!weston_log_file_open(log))
+			return EXIT_FAILURE;
+
+		logger = weston_log_subscriber_create_log(weston_logfile);
+	}
 
 	weston_log_set_handler(vlog, vlog_continue);
 
-	logger = weston_log_subscriber_create_log(weston_logfile);
-	flight_rec = weston_log_subscriber_create_flight_rec(DEFAULT_FLIGHT_REC_SIZE);
+	if (flight_rec_file) {
+		flight_rec = weston_log_subscriber_create_flight_rec_file(flight_rec_file,
+									   DEFAULT_FLIGHT_REC_SIZE);
+		if (!flight_rec)
+			return EXIT_FAILURE;
+	} else {
+		flight_rec = weston_log_subscriber_create_flight_rec(DEFAULT_FLIGHT_REC_SIZE);
+	}
 
 	weston_log_subscribe_to_scopes(log_ctx, logger, flight_rec,
 				       log_scopes, flight_rec_scopes);
@@ -3390,8 +3544,11 @@ wet_main(int argc, char *argv[], const struct weston_testsuite_data *test_data)
 	protologger = wl_display_add_protocol_logger(display,
 						     protocol_log_fn,
 						     NULL);
-	if (debug_protocol)
+	if (debug_protocol) {
 		weston_compositor_enable_debug_protocol(wet.compositor);
+		if (wet_configure_debug_streams(wet.compositor, section) < 0)
+			goto out;
+	}
 
 	weston_compositor_add_debug_binding(wet.compositor, KEY_D,
 					    flight_rec_key_binding_handler,
@@ -3514,6 +3671,8 @@ out:
 	wet_compositor_destroy_layout(&wet);
 
 	/* free(NULL) is valid, and it won't be NULL if it's used */
+	if (wet.parsed_options)
+		free(wet.parsed_options->refresh_rate);
 	free(wet.parsed_options);
 
 	if (protologger)
@@ -3547,6 +3706,7 @@ out_display:
 	free(option_modules);
 	free(log);
 	free(log_scopes);
+	free(flight_rec_file);
 	free(modules);
 
 	return ret;
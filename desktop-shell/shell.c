@@ -593,8 +593,7 @@ create_focus_surface(struct weston_compositor *ec,
 	pixman_region32_fini(&surface->opaque);
 	pixman_region32_init_rect(&surface->opaque, output->x, output->y,
 				  output->width, output->height);
-	pixman_region32_fini(&surface->input);
-	pixman_region32_init(&surface->input);
+	weston_surface_set_input_region(surface, NULL);
 
 	wl_list_init(&fsurf->workspace_transform.link);
 
@@ -2122,6 +2121,7 @@ create_black_surface(struct weston_compositor *ec,
 {
 	struct weston_surface *surface = NULL;
 	struct weston_view *view;
+	pixman_region32_t input;
 
 	surface = weston_surface_create(ec);
 	if (surface == NULL) {
@@ -2141,8 +2141,9 @@ create_black_surface(struct weston_compositor *ec,
 	weston_surface_set_color(surface, 0.0, 0.0, 0.0, 1);
 	pixman_region32_fini(&surface->opaque);
 	pixman_region32_init_rect(&surface->opaque, 0, 0, w, h);
-	pixman_region32_fini(&surface->input);
-	pixman_region32_init_rect(&surface->input, 0, 0, w, h);
+	pixman_region32_init_rect(&input, 0, 0, w, h);
+	weston_surface_set_input_region(surface, &input);
+	pixman_region32_fini(&input);
 
 	weston_surface_set_size(surface, w, h);
 	weston_view_set_position(view, x, y);
@@ -2466,8 +2467,7 @@ desktop_surface_removed(struct weston_desktop_surface *desktop_surface,
 	    shsurf->shell->win_close_animation_type == ANIMATION_FADE) {
 		pixman_region32_fini(&surface->pending.input);
 		pixman_region32_init(&surface->pending.input);
-		pixman_region32_fini(&surface->input);
-		pixman_region32_init(&surface->input);
+		weston_surface_set_input_region(surface, NULL);
 		weston_fade_run(shsurf->view, 1.0, 0.0, 300.0,
 				fade_out_done, shsurf);
 	} else {
@@ -4071,7 +4071,7 @@ shell_fade_create_surface_for_output(struct desktop_shell *shell, struct shell_o
 	weston_surface_set_color(surface, 0.0, 0.0, 0.0, 1.0);
 	weston_layer_entry_insert(&compositor->fade_layer.view_list,
 				  &view->layer_link);
-	pixman_region32_init(&surface->input);
+	weston_surface_set_input_region(surface, NULL);
 	surface->is_mapped = true;
 	view->is_mapped = true;
 
@@ -232,6 +232,7 @@ create_black_surface(struct weston_compositor *ec, struct fs_output *fsout,
 {
 	struct weston_surface *surface = NULL;
 	struct weston_view *view;
+	pixman_region32_t input;
 
 	surface = weston_surface_create(ec);
 	if (surface == NULL) {
@@ -250,8 +251,9 @@ create_black_surface(struct weston_compositor *ec, struct fs_output *fsout,
 	weston_surface_set_color(surface, 0.0f, 0.0f, 0.0f, 1.0f);
 	pixman_region32_fini(&surface->opaque);
 	pixman_region32_init_rect(&surface->opaque, 0, 0, w, h);
-	pixman_region32_fini(&surface->input);
-	pixman_region32_init_rect(&surface->input, 0, 0, w, h);
+	pixman_region32_init_rect(&input, 0, 0, w, h);
+	weston_surface_set_input_region(surface, &input);
+	pixman_region32_fini(&input);
 
 	weston_surface_set_size(surface, w, h);
 	weston_view_set_position(view, x, y);
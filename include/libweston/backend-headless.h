@@ -33,6 +33,36 @@ extern "C" {
 #include <stdint.h>
 
 #include <libweston/libweston.h>
+#include <libweston/plugin-registry.h>
+
+#define WESTON_HEADLESS_OUTPUT_API_NAME "weston_headless_output_api_v1"
+
+struct weston_headless_output_api {
+	/** Set the refresh rate of a headless output.
+	 *
+	 * \param output The output, after its size has been set.
+	 * \param refresh The refresh rate in mHz, or 0 to let the output
+	 * complete frames as fast as they are repainted (free-running).
+	 *
+	 * Presentation timestamps of a clocked output are aligned to a
+	 * virtual vblank that starts when the output is enabled, and carry a
+	 * matching MSC. The default is 60 Hz.
+	 *
+	 * Returns 0 on success, -1 on failure.
+	 */
+	int (*output_set_refresh_rate)(struct weston_output *output,
+				       int refresh);
+};
+
+static inline const struct weston_headless_output_api *
+weston_headless_output_get_api(struct weston_compositor *compositor)
+{
+	const void *api;
+	api = weston_plugin_api_get(compositor, WESTON_HEADLESS_OUTPUT_API_NAME,
+				    sizeof(struct weston_headless_output_api));
+
+	return (const struct weston_headless_output_api *)api;
+}
 
 #define WESTON_HEADLESS_BACKEND_CONFIG_VERSION 2
 
@@ -180,6 +180,13 @@ enum dpms_enum {
  * values of the 'type' enum of the protocol.
  */
 
+/** Called with the image captured from an output, or NULL on failure.
+ *
+ * The image belongs to the backend and is only valid during the call.
+ */
+typedef void (*weston_output_capture_done_func_t)(void *data,
+						  pixman_image_t *image);
+
 enum weston_hdcp_protection {
 	WESTON_HDCP_DISABLE = 0,
 	WESTON_HDCP_ENABLE_TYPE_0,
@@ -301,6 +308,13 @@ struct weston_output {
 	/** Output area in global coordinates, simple rect */
 	pixman_region32_t region;
 
+	/** Temporaries of weston_output_repaint(), kept across repaints
+	 *  so that their rectangle arrays are reused. */
+	pixman_region32_t repaint_damage;
+	pixman_region32_t repaint_opaque;
+	pixman_region32_t repaint_clip;
+	pixman_region32_t repaint_scratch;
+
 	/** True if damage has occurred since the last repaint for this output;
 	 *  if set, a repaint will eventually occur. */
 	bool repaint_needed;
@@ -363,6 +377,20 @@ struct weston_output {
 	void (*set_backlight)(struct weston_output *output, uint32_t value);
 	void (*set_dpms)(struct weston_output *output, enum dpms_enum level);
 
+	/** Capture the next frame shown by the display hardware
+	 *
+	 * @param output The output to capture.
+	 * @param done Called with the image, in the size of the current
+	 * mode and the x8r8g8b8 format, once the frame has been scanned out.
+	 * @param data User data for @c done.
+	 * @return 0 if @c done will be called, -1 otherwise.
+	 *
+	 * The capture includes the content of every hardware plane and
+	 * costs the renderer nothing. NULL if the backend cannot capture.
+	 */
+	int (*capture)(struct weston_output *output,
+		       weston_output_capture_done_func_t done, void *data);
+
 	uint16_t gamma_size;
 	void (*set_gamma)(struct weston_output *output,
 			  uint16_t size,
@@ -562,6 +590,14 @@ struct weston_pointer {
 	struct wl_listener output_destroy_listener;
 
 	struct wl_list timestamps_list;
+
+	/* Relative motion held back until the next repaint, when
+	 * weston_compositor::coalesce_pointer_motion is set. pending_motion
+	 * has the clamped position and the summed deltas. */
+	bool motion_pending;
+	bool frame_pending;
+	struct weston_pointer_motion_event pending_motion;
+	struct timespec pending_time;
 };
 
 /** libinput style calibration matrix
@@ -932,6 +968,28 @@ struct weston_plane {
 	struct wl_list link;
 };
 
+/** Simplification of damage regions into fewer, larger rectangles
+ *
+ * Many tiny damage rectangles, as terminals and text editors submit, each
+ * cost a texture upload or a draw call. A policy trades some extra pixels
+ * for fewer rectangles. Both criteria are disabled when 0.
+ *
+ * \ingroup compositor
+ */
+struct weston_damage_policy {
+	/** Above this number of rectangles, the region is replaced by its
+	 *  extents after merging what max_waste_percent allows. */
+	int max_rects;
+	/** Rectangles are merged as long as the pixels that were not
+	 *  damaged stay within this percentage of the merged area. */
+	int max_waste_percent;
+
+	/* Statistics, printed by the "damage" log scope. */
+	uint64_t n_regions;
+	uint64_t n_rects_in;
+	uint64_t n_rects_out;
+};
+
 struct weston_drm_format_array;
 
 struct weston_renderer {
@@ -1099,6 +1157,10 @@ struct weston_compositor {
 	struct wl_list seat_list;
 	struct wl_list layer_list;	/* struct weston_layer::link */
 	struct wl_list view_list;	/* struct weston_view::link */
+	/* Bumped whenever picking a view could give a different result,
+	 * see weston_compositor_scene_changed(). */
+	uint64_t scene_generation;
+	uint64_t repick_generation;
 	struct wl_list plane_list;
 	struct wl_list key_binding_list;
 	struct wl_list modifier_binding_list;
@@ -1155,6 +1217,10 @@ struct weston_compositor {
 	/* Whether to let the compositor run without any input device. */
 	bool require_input;
 
+	/* Whether relative pointer motion is delivered once per repaint,
+	 * rather than once per input event. */
+	bool coalesce_pointer_motion;
+
 	/* Test suite data */
 	struct weston_testsuite_data test_data;
 
@@ -1174,8 +1240,15 @@ struct weston_compositor {
 	struct weston_log_context *weston_log_ctx;
 	struct weston_log_scope *debug_scene;
 	struct weston_log_scope *timeline;
+	struct weston_log_scope *debug_commits;
+	struct weston_log_scope *debug_damage;
 
 	struct content_protection *content_protection;
+
+	/** Applied to surface damage before the renderer uploads it. */
+	struct weston_damage_policy upload_damage_policy;
+	/** Applied to the output damage before it is repainted. */
+	struct weston_damage_policy composite_damage_policy;
 };
 
 struct weston_buffer {
@@ -1404,6 +1477,9 @@ struct weston_surface_state {
 
 	/* weston_protected_surface.enforced/relaxed */
 	enum weston_surface_protection_mode protection_mode;
+
+	/* wp_tearing_control_v1.set_presentation_hint */
+	bool tearing;
 };
 
 struct weston_surface_activation_data {
@@ -1538,6 +1614,9 @@ struct weston_surface {
 	enum weston_hdcp_protection desired_protection;
 	enum weston_hdcp_protection current_protection;
 	enum weston_surface_protection_mode protection_mode;
+
+	/* The client accepts tearing to get its content out sooner */
+	bool tearing;
 };
 
 struct weston_subsurface {
@@ -1660,6 +1739,11 @@ weston_layer_mask_is_infinite(struct weston_layer *layer);
 /* An invalid flag in presented_flags to catch logic errors. */
 #define WP_PRESENTATION_FEEDBACK_INVALID (1U << 31)
 
+/* A flag in presented_flags for frames that were flipped without waiting
+ * for vblank. The stamp must still be the last vblank, clients are sent
+ * the completion time instead. The flag itself is not sent to clients. */
+#define WESTON_FINISH_FRAME_TEARING (1U << 30)
+
 void
 weston_output_schedule_repaint(struct weston_output *output);
 void
@@ -1781,6 +1865,10 @@ void
 weston_surface_set_size(struct weston_surface *surface,
 			int32_t width, int32_t height);
 
+void
+weston_surface_set_input_region(struct weston_surface *surface,
+				pixman_region32_t *region);
+
 void
 weston_surface_damage(struct weston_surface *surface);
 
@@ -63,6 +63,15 @@ struct weston_remoting_api {
 	/** Set the pipeline for gstreamer */
 	void (*set_gst_pipeline)(struct weston_output *output,
 				 char *gst_pipeline);
+
+	/** Set how many frames may wait in the encoder queue
+	 *
+	 * While more frames than this are queued, newly repainted frames
+	 * replace each other instead of being queued, and their damage is
+	 * merged. Zero or less means no limit.
+	 */
+	void (*set_max_queued_frames)(struct weston_output *output,
+				      int max_queued_frames);
 };
 
 static inline const struct weston_remoting_api *
@@ -42,12 +42,28 @@ struct wl_display;
 struct weston_log_subscriber;
 struct weston_log_subscription;
 
+/** Default per-stream queue size of weston-debug streams */
+#define WESTON_LOG_STREAM_BUFFER_SIZE_DEFAULT (1024 * 1024)
+
+/** What a weston-debug stream does when its queue is full */
+enum weston_log_overflow_policy {
+	/** Drop the oldest queued messages, keeping count of them */
+	WESTON_LOG_OVERFLOW_DROP_OLDEST = 0,
+	/** Close the stream and send a failure event to the client */
+	WESTON_LOG_OVERFLOW_DISCONNECT,
+};
+
 void
 weston_compositor_enable_debug_protocol(struct weston_compositor *);
 
 bool
 weston_compositor_is_debug_protocol_enabled(struct weston_compositor *);
 
+void
+weston_compositor_set_debug_stream_limits(struct weston_compositor *compositor,
+					  size_t buffer_size,
+					  enum weston_log_overflow_policy policy);
+
 struct weston_log_scope;
 struct weston_debug_stream;
 
@@ -121,9 +137,29 @@ weston_log_subscribe(struct weston_log_context *log_ctx,
 struct weston_log_subscriber *
 weston_log_subscriber_create_log(FILE *dump_to);
 
+/** Counters of an asynchronous file subscriber */
+struct weston_log_async_stats {
+	uint64_t messages;		/**< written to the file */
+	uint64_t dropped;		/**< lost because the ring was full */
+	uint64_t latency_avg_usec;	/**< from logging to written */
+	uint64_t latency_max_usec;
+	uint64_t rotations;		/**< times the file was rotated */
+};
+
+struct weston_log_subscriber *
+weston_log_subscriber_create_log_async(const char *path, size_t ring_size,
+				       size_t rotate_size);
+
+bool
+weston_log_subscriber_get_async_stats(struct weston_log_subscriber *sub,
+				      struct weston_log_async_stats *stats);
+
 struct weston_log_subscriber *
 weston_log_subscriber_create_flight_rec(size_t size);
 
+struct weston_log_subscriber *
+weston_log_subscriber_create_flight_rec_file(const char *path, size_t size);
+
 void
 weston_log_subscriber_display_flight_rec(struct weston_log_subscriber *sub);
 
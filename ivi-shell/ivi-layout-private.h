@@ -47,9 +47,12 @@ struct ivi_layout_view {
 
 struct ivi_layout_surface {
 	struct wl_list link;	/* ivi_layout::surface_list */
+	struct wl_list dirty_link;	/* ivi_layout::dirty_surface_list */
 	struct wl_signal property_changed;
 	int32_t update_count;
 	uint32_t id_surface;
+	uint32_t seq;	/* creation order, sorts dirty_surface_list */
+	bool dirty;	/* pending properties set since the last commit */
 
 	struct ivi_layout *layout;
 	struct weston_surface *surface;
@@ -66,8 +69,11 @@ struct ivi_layout_surface {
 
 struct ivi_layout_layer {
 	struct wl_list link;	/* ivi_layout::layer_list */
+	struct wl_list dirty_link;	/* ivi_layout::dirty_layer_list */
 	struct wl_signal property_changed;
 	uint32_t id_layer;
+	uint32_t seq;	/* creation order, sorts dirty_layer_list */
+	bool dirty;	/* pending properties or order set since the last commit */
 
 	struct ivi_layout *layout;
 	struct ivi_layout_screen *on_screen;
@@ -97,6 +103,15 @@ struct ivi_layout {
 	struct wl_list screen_list;	/* ivi_layout_screen::link */
 	struct wl_list view_list;	/* ivi_layout_view::link */
 
+	/* Only these are looked at by ivi_layout_commit_changes(). They hold
+	 * the objects with pending changes, and those whose notification mask
+	 * still has to be reset by the next commit. */
+	struct wl_list dirty_surface_list;	/* ivi_layout_surface::dirty_link */
+	struct wl_list dirty_layer_list;	/* ivi_layout_layer::dirty_link */
+	uint32_t seq;	/* last ivi_layout_surface/layer::seq handed out */
+	/* layout_layer has to be rebuilt from the screen and layer orders */
+	bool view_list_dirty;
+
 	struct {
 		struct wl_signal created;
 		struct wl_signal removed;
@@ -120,8 +135,13 @@ struct ivi_layout *get_instance(void);
 struct ivi_layout_transition;
 
 struct ivi_layout_transition_set {
-	struct wl_event_source  *event_source;
+	struct weston_compositor *compositor;
 	struct wl_list          transition_list;
+
+	/* the output whose frames run the transitions, NULL when idle */
+	struct weston_output    *output;
+	struct weston_animation animation;	/* in output::animation_list */
+	struct wl_listener      output_destroy_listener;
 };
 
 typedef void (*ivi_layout_transition_destroy_user_func)(void *user_data);
@@ -129,6 +149,9 @@ typedef void (*ivi_layout_transition_destroy_user_func)(void *user_data);
 struct ivi_layout_transition_set *
 ivi_layout_transition_set_create(struct weston_compositor *ec);
 
+void
+ivi_layout_transition_set_run(struct ivi_layout_transition_set *transitions);
+
 void
 ivi_layout_transition_move_resize_view(struct ivi_layout_surface *surface,
 				       int32_t dest_x, int32_t dest_y,
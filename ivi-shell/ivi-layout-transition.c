@@ -35,6 +35,8 @@
 #include "ivi-shell.h"
 #include "ivi-layout-export.h"
 #include "ivi-layout-private.h"
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 struct ivi_layout_transition;
 
@@ -156,39 +158,98 @@ do_transition_frame(struct ivi_layout_transition *transition,
 		layout_transition_destroy(transition);
 }
 
-static int32_t
-layout_transition_frame(void *data)
+static void
+layout_transition_set_stop(struct ivi_layout_transition_set *transitions)
 {
-	struct ivi_layout_transition_set *transitions = data;
-	uint32_t fps = 30;
-	struct timespec timestamp = {};
-	uint32_t msec = 0;
+	wl_list_remove(&transitions->animation.link);
+	wl_list_init(&transitions->animation.link);
+	wl_list_remove(&transitions->output_destroy_listener.link);
+	wl_list_init(&transitions->output_destroy_listener.link);
+	transitions->output = NULL;
+}
+
+/*
+ * Called once per repaint of the output the transitions are clocked by,
+ * with the presentation time of its last frame. Every transition advances
+ * exactly one step per displayed frame, and the output keeps repainting
+ * until the last transition is done.
+ */
+static void
+layout_transition_frame(struct weston_animation *animation,
+			struct weston_output *output,
+			const struct timespec *time)
+{
+	struct ivi_layout_transition_set *transitions =
+		container_of(animation, struct ivi_layout_transition_set,
+			     animation);
+	uint32_t msec = timespec_to_msec(time);
 	struct transition_node *node = NULL;
 	struct transition_node *next = NULL;
 
-	if (wl_list_empty(&transitions->transition_list)) {
-		wl_event_source_timer_update(transitions->event_source, 0);
-		return 1;
-	}
-
-	wl_event_source_timer_update(transitions->event_source, 1000 / fps);
-
-	clock_gettime(CLOCK_MONOTONIC, &timestamp);/* FIXME */
-	msec = (1e+3 * timestamp.tv_sec + 1e-6 * timestamp.tv_nsec);
+	/* time_start 0 means not started yet */
+	if (msec == 0)
+		msec = 1;
 
 	wl_list_for_each_safe(node, next, &transitions->transition_list, link) {
 		do_transition_frame(node->transition, msec);
 	}
 
 	ivi_layout_commit_changes();
-	return 1;
+
+	if (wl_list_empty(&transitions->transition_list))
+		layout_transition_set_stop(transitions);
+	else
+		weston_output_schedule_repaint(output);
+}
+
+static void
+layout_transition_set_start(struct ivi_layout_transition_set *transitions,
+			    struct weston_output *output)
+{
+	transitions->output = output;
+	transitions->animation.frame_counter = 0;
+	wl_list_insert(output->animation_list.prev,
+		       &transitions->animation.link);
+	wl_signal_add(&output->destroy_signal,
+		      &transitions->output_destroy_listener);
+
+	weston_output_schedule_repaint(output);
+}
+
+static void
+layout_transition_output_destroyed(struct wl_listener *listener, void *data)
+{
+	struct ivi_layout_transition_set *transitions =
+		container_of(listener, struct ivi_layout_transition_set,
+			     output_destroy_listener);
+
+	layout_transition_set_stop(transitions);
+	ivi_layout_transition_set_run(transitions);
+}
+
+/**
+ * Start clocking the transitions, if any, by the frames of the first
+ * output. Does nothing if they are already running.
+ */
+void
+ivi_layout_transition_set_run(struct ivi_layout_transition_set *transitions)
+{
+	struct weston_output *output;
+
+	if (transitions->output ||
+	    wl_list_empty(&transitions->transition_list) ||
+	    wl_list_empty(&transitions->compositor->output_list))
+		return;
+
+	output = container_of(transitions->compositor->output_list.next,
+			      struct weston_output, link);
+	layout_transition_set_start(transitions, output);
 }
 
 struct ivi_layout_transition_set *
 ivi_layout_transition_set_create(struct weston_compositor *ec)
 {
 	struct ivi_layout_transition_set *transitions;
-	struct wl_event_loop *loop;
 
 	transitions = malloc(sizeof(*transitions));
 	if (transitions == NULL) {
@@ -198,10 +259,13 @@ ivi_layout_transition_set_create(struct weston_compositor *ec)
 
 	wl_list_init(&transitions->transition_list);
 
-	loop = wl_display_get_event_loop(ec->wl_display);
-	transitions->event_source =
-		wl_event_loop_add_timer(loop, layout_transition_frame,
-					transitions);
+	transitions->compositor = ec;
+	transitions->output = NULL;
+	transitions->animation.frame = layout_transition_frame;
+	wl_list_init(&transitions->animation.link);
+	transitions->output_destroy_listener.notify =
+		layout_transition_output_destroyed;
+	wl_list_init(&transitions->output_destroy_listener.link);
 
 	return transitions;
 }
@@ -231,6 +231,48 @@ get_screen_from_output(struct weston_output *output)
 	return NULL;
 }
 
+/**
+ * Internal API to queue an ivi_surface/ivi_layer for the next commit.
+ * ivi_layout_commit_changes only walks these, so every function updating
+ * pending properties or orders has to call one of them.
+ */
+static void
+surface_mark_dirty(struct ivi_layout_surface *ivisurf)
+{
+	struct wl_list *list = &ivisurf->layout->dirty_surface_list;
+	struct ivi_layout_surface *pos;
+
+	ivisurf->dirty = true;
+
+	if (!wl_list_empty(&ivisurf->dirty_link))
+		return;
+
+	/* Kept in creation order, which is the order of the notifications. */
+	wl_list_for_each_reverse(pos, list, dirty_link) {
+		if (pos->seq < ivisurf->seq)
+			break;
+	}
+	wl_list_insert(&pos->dirty_link, &ivisurf->dirty_link);
+}
+
+static void
+layer_mark_dirty(struct ivi_layout_layer *ivilayer)
+{
+	struct wl_list *list = &ivilayer->layout->dirty_layer_list;
+	struct ivi_layout_layer *pos;
+
+	ivilayer->dirty = true;
+
+	if (!wl_list_empty(&ivilayer->dirty_link))
+		return;
+
+	wl_list_for_each_reverse(pos, list, dirty_link) {
+		if (pos->seq < ivilayer->seq)
+			break;
+	}
+	wl_list_insert(&pos->dirty_link, &ivilayer->dirty_link);
+}
+
 /**
  * Called at destruction of wl_surface/ivi_surface
  */
@@ -246,6 +288,7 @@ ivi_layout_surface_destroy(struct ivi_layout_surface *ivisurf)
 	}
 
 	wl_list_remove(&ivisurf->link);
+	wl_list_remove(&ivisurf->dirty_link);
 
 	wl_list_for_each_safe(ivi_view, next, &ivisurf->view_list, surf_link) {
 		ivi_view_destroy(ivi_view);
@@ -610,17 +653,38 @@ ivi_view_is_mapped(struct ivi_layout_view *ivi_view)
 static void
 commit_changes(struct ivi_layout *layout)
 {
+	struct ivi_layout_layer *ivilayer = NULL;
+	struct ivi_layout_surface *ivisurf = NULL;
 	struct ivi_layout_view *ivi_view  = NULL;
 
-	wl_list_for_each(ivi_view, &layout->view_list, link) {
-		/*
-		 * If the view is not on the currently rendered scenegraph,
-		 * we do not need to update its properties.
-		 */
-		if (!ivi_view_is_mapped(ivi_view))
+	/*
+	 * Only views of changed ivi_layers and ivi_surfaces need their
+	 * properties recomputed. If the view is not on the currently rendered
+	 * scenegraph, we do not need to update its properties.
+	 */
+	wl_list_for_each(ivilayer, &layout->dirty_layer_list, dirty_link) {
+		if (!ivilayer->prop.event_mask)
+			continue;
+
+		wl_list_for_each(ivi_view, &ivilayer->order.view_list,
+				 order_link) {
+			if (ivi_view_is_mapped(ivi_view))
+				update_prop(ivi_view);
+		}
+	}
+
+	wl_list_for_each(ivisurf, &layout->dirty_surface_list, dirty_link) {
+		if (!ivisurf->prop.event_mask)
 			continue;
 
-		update_prop(ivi_view);
+		wl_list_for_each(ivi_view, &ivisurf->view_list, surf_link) {
+			/* already updated along with its layer */
+			if (ivi_view->on_layer->prop.event_mask)
+				continue;
+
+			if (ivi_view_is_mapped(ivi_view))
+				update_prop(ivi_view);
+		}
 	}
 }
 
@@ -633,8 +697,12 @@ commit_surface_list(struct ivi_layout *layout)
 	int32_t dest_width = 0;
 	int32_t dest_height = 0;
 	int32_t configured = 0;
+	bool visibility;
+
+	wl_list_for_each(ivisurf, &layout->dirty_surface_list, dirty_link) {
+		ivisurf->dirty = false;
+		visibility = ivisurf->prop.visibility;
 
-	wl_list_for_each(ivisurf, &layout->surface_list, link) {
 		if (ivisurf->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_VIEW_DEFAULT) {
 			dest_x = ivisurf->prop.dest_x;
 			dest_y = ivisurf->prop.dest_y;
@@ -723,6 +791,9 @@ commit_surface_list(struct ivi_layout *layout)
 							    ivisurf->prop.dest_height);
 			}
 		}
+
+		if (ivisurf->prop.visibility != visibility)
+			layout->view_list_dirty = true;
 	}
 }
 
@@ -733,7 +804,12 @@ commit_layer_list(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_view *next     = NULL;
 
-	wl_list_for_each(ivilayer, &layout->layer_list, link) {
+	wl_list_for_each(ivilayer, &layout->dirty_layer_list, dirty_link) {
+		ivilayer->dirty = false;
+
+		if (ivilayer->prop.visibility != ivilayer->pending.prop.visibility)
+			layout->view_list_dirty = true;
+
 		if (ivilayer->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_LAYER_MOVE) {
 			ivi_layout_transition_move_layer(ivilayer, ivilayer->pending.prop.dest_x, ivilayer->pending.prop.dest_y, ivilayer->pending.prop.transition_duration);
 		} else if (ivilayer->pending.prop.transition_type == IVI_LAYOUT_TRANSITION_LAYER_FADE) {
@@ -755,6 +831,7 @@ commit_layer_list(struct ivi_layout *layout)
 			wl_list_remove(&ivi_view->order_link);
 			wl_list_init(&ivi_view->order_link);
 			ivi_view->ivisurf->prop.event_mask |= IVI_NOTIFICATION_REMOVE;
+			surface_mark_dirty(ivi_view->ivisurf);
 		}
 
 		assert(wl_list_empty(&ivilayer->order.view_list));
@@ -764,9 +841,11 @@ commit_layer_list(struct ivi_layout *layout)
 			wl_list_remove(&ivi_view->order_link);
 			wl_list_insert(&ivilayer->order.view_list, &ivi_view->order_link);
 			ivi_view->ivisurf->prop.event_mask |= IVI_NOTIFICATION_ADD;
+			surface_mark_dirty(ivi_view->ivisurf);
 		}
 
 		ivilayer->order.dirty = 0;
+		layout->view_list_dirty = true;
 	}
 }
 
@@ -785,6 +864,7 @@ commit_screen_list(struct ivi_layout *layout)
 				wl_list_remove(&ivilayer->order.link);
 				wl_list_init(&ivilayer->order.link);
 				ivilayer->prop.event_mask |= IVI_NOTIFICATION_REMOVE;
+				layer_mark_dirty(ivilayer);
 			}
 
 			assert(wl_list_empty(&iviscrn->order.layer_list));
@@ -798,9 +878,11 @@ commit_screen_list(struct ivi_layout *layout)
 					       &ivilayer->order.link);
 				ivilayer->on_screen = iviscrn;
 				ivilayer->prop.event_mask |= IVI_NOTIFICATION_ADD;
+				layer_mark_dirty(ivilayer);
 			}
 
 			iviscrn->order.dirty = 0;
+			layout->view_list_dirty = true;
 		}
 	}
 }
@@ -812,6 +894,10 @@ build_view_list(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer;
 	struct ivi_layout_view   *ivi_view;
 
+	/* Nothing was added, removed, reordered, shown or hidden */
+	if (!layout->view_list_dirty)
+		return;
+
 	/* If ivi_view is not part of the scenegrapgh, we have to unmap
 	 * weston_views
 	 */
@@ -840,6 +926,8 @@ build_view_list(struct ivi_layout *layout)
 			}
 		}
 	}
+
+	layout->view_list_dirty = false;
 }
 
 static void
@@ -854,7 +942,7 @@ commit_transition(struct ivi_layout* layout)
 
 	wl_list_init(&layout->pending_transition_list);
 
-	wl_event_source_timer_update(layout->transitions->event_source, 1);
+	ivi_layout_transition_set_run(layout->transitions);
 }
 
 static void
@@ -877,17 +965,55 @@ send_prop(struct ivi_layout *layout)
 	struct ivi_layout_layer   *ivilayer = NULL;
 	struct ivi_layout_surface *ivisurf  = NULL;
 
-	wl_list_for_each_reverse(ivilayer, &layout->layer_list, link) {
+	wl_list_for_each(ivilayer, &layout->dirty_layer_list, dirty_link) {
 		if (ivilayer->prop.event_mask)
 			send_layer_prop(ivilayer);
 	}
 
-	wl_list_for_each_reverse(ivisurf, &layout->surface_list, link) {
+	wl_list_for_each(ivisurf, &layout->dirty_surface_list, dirty_link) {
 		if (ivisurf->prop.event_mask)
 			send_surface_prop(ivisurf);
 	}
 }
 
+/*
+ * After a commit, an ivi_surface/ivi_layer stays queued while it has a
+ * notification mask to be reset by the next commit, or pending properties
+ * that were not applied yet. The latter happens when a transition keeps the
+ * current destination rectangle, or when a listener changed it in send_prop.
+ */
+static void
+prune_dirty_lists(struct ivi_layout *layout)
+{
+	struct ivi_layout_layer   *ivilayer, *next_layer;
+	struct ivi_layout_surface *ivisurf, *next_surf;
+	const struct ivi_layout_surface_properties *pending;
+
+	wl_list_for_each_safe(ivilayer, next_layer,
+			      &layout->dirty_layer_list, dirty_link) {
+		if (ivilayer->dirty || ivilayer->prop.event_mask)
+			continue;
+
+		wl_list_remove(&ivilayer->dirty_link);
+		wl_list_init(&ivilayer->dirty_link);
+	}
+
+	wl_list_for_each_safe(ivisurf, next_surf,
+			      &layout->dirty_surface_list, dirty_link) {
+		pending = &ivisurf->pending.prop;
+
+		if (ivisurf->dirty || ivisurf->prop.event_mask ||
+		    ivisurf->prop.dest_x != pending->dest_x ||
+		    ivisurf->prop.dest_y != pending->dest_y ||
+		    ivisurf->prop.dest_width != pending->dest_width ||
+		    ivisurf->prop.dest_height != pending->dest_height)
+			continue;
+
+		wl_list_remove(&ivisurf->dirty_link);
+		wl_list_init(&ivisurf->dirty_link);
+	}
+}
+
 static void
 clear_view_pending_list(struct ivi_layout_layer *ivilayer)
 {
@@ -1296,6 +1422,7 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 	wl_signal_init(&ivilayer->property_changed);
 	ivilayer->layout = layout;
 	ivilayer->id_layer = id_layer;
+	ivilayer->seq = ++layout->seq;
 
 	init_layer_properties(&ivilayer->prop, width, height);
 
@@ -1305,6 +1432,7 @@ ivi_layout_layer_create_with_dimension(uint32_t id_layer,
 
 	wl_list_init(&ivilayer->order.view_list);
 	wl_list_init(&ivilayer->order.link);
+	wl_list_init(&ivilayer->dirty_link);
 
 	wl_list_insert(&layout->layer_list, &ivilayer->link);
 
@@ -1337,6 +1465,7 @@ ivi_layout_layer_destroy(struct ivi_layout_layer *ivilayer)
 
 	wl_list_remove(&ivilayer->pending.link);
 	wl_list_remove(&ivilayer->order.link);
+	wl_list_remove(&ivilayer->dirty_link);
 	wl_list_remove(&ivilayer->link);
 
 	free(ivilayer);
@@ -1361,6 +1490,8 @@ ivi_layout_layer_set_visibility(struct ivi_layout_layer *ivilayer,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_VISIBILITY;
 
+	layer_mark_dirty(ivilayer);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1385,6 +1516,8 @@ ivi_layout_layer_set_opacity(struct ivi_layout_layer *ivilayer,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_OPACITY;
 
+	layer_mark_dirty(ivilayer);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1413,6 +1546,8 @@ ivi_layout_layer_set_source_rectangle(struct ivi_layout_layer *ivilayer,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_SOURCE_RECT;
 
+	layer_mark_dirty(ivilayer);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1441,6 +1576,8 @@ ivi_layout_layer_set_destination_rectangle(struct ivi_layout_layer *ivilayer,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_DEST_RECT;
 
+	layer_mark_dirty(ivilayer);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1471,6 +1608,7 @@ ivi_layout_layer_set_render_order(struct ivi_layout_layer *ivilayer,
 	}
 
 	ivilayer->order.dirty = 1;
+	layer_mark_dirty(ivilayer);
 
 	return IVI_SUCCEEDED;
 }
@@ -1494,6 +1632,8 @@ ivi_layout_surface_set_visibility(struct ivi_layout_surface *ivisurf,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_VISIBILITY;
 
+	surface_mark_dirty(ivisurf);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1518,6 +1658,8 @@ ivi_layout_surface_set_opacity(struct ivi_layout_surface *ivisurf,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_OPACITY;
 
+	surface_mark_dirty(ivisurf);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1550,6 +1692,8 @@ ivi_layout_surface_set_destination_rectangle(struct ivi_layout_surface *ivisurf,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_DEST_RECT;
 
+	surface_mark_dirty(ivisurf);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1732,6 +1876,7 @@ ivi_layout_layer_add_surface(struct ivi_layout_layer *ivilayer,
 	wl_list_insert(&ivilayer->pending.view_list, &ivi_view->pending_link);
 
 	ivilayer->order.dirty = 1;
+	layer_mark_dirty(ivilayer);
 
 	return IVI_SUCCEEDED;
 }
@@ -1753,6 +1898,7 @@ ivi_layout_layer_remove_surface(struct ivi_layout_layer *ivilayer,
 		wl_list_init(&ivi_view->pending_link);
 
 		ivilayer->order.dirty = 1;
+		layer_mark_dirty(ivilayer);
 	}
 }
 
@@ -1781,6 +1927,8 @@ ivi_layout_surface_set_source_rectangle(struct ivi_layout_surface *ivisurf,
 	else
 		prop->event_mask &= ~IVI_NOTIFICATION_SOURCE_RECT;
 
+	surface_mark_dirty(ivisurf);
+
 	return IVI_SUCCEEDED;
 }
 
@@ -1798,6 +1946,7 @@ ivi_layout_commit_changes(void)
 
 	commit_changes(layout);
 	send_prop(layout);
+	prune_dirty_lists(layout);
 
 	return IVI_SUCCEEDED;
 }
@@ -1815,6 +1964,8 @@ ivi_layout_layer_set_transition(struct ivi_layout_layer *ivilayer,
 	ivilayer->pending.prop.transition_type = type;
 	ivilayer->pending.prop.transition_duration = duration;
 
+	layer_mark_dirty(ivilayer);
+
 	return 0;
 }
 
@@ -1832,6 +1983,8 @@ ivi_layout_layer_set_fade_info(struct ivi_layout_layer* ivilayer,
 	ivilayer->pending.prop.start_alpha = start_alpha;
 	ivilayer->pending.prop.end_alpha = end_alpha;
 
+	layer_mark_dirty(ivilayer);
+
 	return 0;
 }
 
@@ -1848,6 +2001,7 @@ ivi_layout_surface_set_transition_duration(struct ivi_layout_surface *ivisurf,
 
 	prop = &ivisurf->pending.prop;
 	prop->transition_duration = duration*10;
+	surface_mark_dirty(ivisurf);
 	return 0;
 }
 
@@ -1904,6 +2058,7 @@ ivi_layout_surface_set_transition(struct ivi_layout_surface *ivisurf,
 	prop = &ivisurf->pending.prop;
 	prop->transition_type = type;
 	prop->transition_duration = duration;
+	surface_mark_dirty(ivisurf);
 	return 0;
 }
 
@@ -1950,6 +2105,7 @@ surface_create(struct weston_surface *wl_surface, uint32_t id_surface)
 	wl_signal_init(&ivisurf->property_changed);
 	ivisurf->id_surface = id_surface;
 	ivisurf->layout = layout;
+	ivisurf->seq = ++layout->seq;
 
 	ivisurf->surface = wl_surface;
 
@@ -1961,6 +2117,7 @@ surface_create(struct weston_surface *wl_surface, uint32_t id_surface)
 	ivisurf->pending.prop = ivisurf->prop;
 
 	wl_list_init(&ivisurf->view_list);
+	wl_list_init(&ivisurf->dirty_link);
 
 	wl_list_insert(&layout->surface_list, &ivisurf->link);
 
@@ -1995,6 +2152,28 @@ ivi_layout_surface_configure(struct ivi_layout_surface *ivisurf,
 		       ivisurf);
 }
 
+/**
+ * Called on every commit of the weston_surface. Attaching a NULL buffer
+ * unmaps all views of the weston_surface, so those on the scenegraph have to
+ * be put back into layout_layer by the next ivi_layout_commit_changes.
+ */
+void
+ivi_layout_surface_committed(struct ivi_layout_surface *ivisurf)
+{
+	struct ivi_layout_view *ivi_view;
+
+	if (ivisurf->layout->view_list_dirty)
+		return;
+
+	wl_list_for_each(ivi_view, &ivisurf->view_list, surf_link) {
+		if (ivi_view_is_mapped(ivi_view) &&
+		    !weston_view_is_mapped(ivi_view->view)) {
+			ivisurf->layout->view_list_dirty = true;
+			return;
+		}
+	}
+}
+
 struct ivi_layout_surface*
 ivi_layout_surface_create(struct weston_surface *wl_surface,
 			  uint32_t id_surface)
@@ -2029,6 +2208,8 @@ ivi_layout_init_with_compositor(struct weston_compositor *ec)
 	wl_list_init(&layout->layer_list);
 	wl_list_init(&layout->screen_list);
 	wl_list_init(&layout->view_list);
+	wl_list_init(&layout->dirty_surface_list);
+	wl_list_init(&layout->dirty_layer_list);
 
 	wl_signal_init(&layout->layer_notification.created);
 	wl_signal_init(&layout->layer_notification.removed);
@@ -139,6 +139,7 @@ create_colored_surface(struct weston_compositor *compositor,
 {
 	struct weston_surface *surface = NULL;
 	struct weston_view *view;
+	pixman_region32_t input;
 
 	surface = weston_surface_create(compositor);
 	if (surface == NULL) {
@@ -158,8 +159,9 @@ create_colored_surface(struct weston_compositor *compositor,
 	weston_surface_set_color(surface, r, g, b, 1.0);
 	pixman_region32_fini(&surface->opaque);
 	pixman_region32_init_rect(&surface->opaque, 0, 0, w, h);
-	pixman_region32_fini(&surface->input);
-	pixman_region32_init_rect(&surface->input, 0, 0, w, h);
+	pixman_region32_init_rect(&input, 0, 0, w, h);
+	weston_surface_set_input_region(surface, &input);
+	pixman_region32_fini(&input);
 
 	weston_surface_set_size(surface, w, h);
 	weston_view_set_position(view, x, y);
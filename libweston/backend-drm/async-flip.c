@@ -0,0 +1,69 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "async-flip.h"
+
+/**
+ * Commits an atomic request, without waiting for vblank if asked to.
+ *
+ * Only a page flip may skip vblank: test commits and modesets always wait,
+ * and clear *async. Otherwise, if *async is set, the request is committed
+ * with DRM_MODE_PAGE_FLIP_ASYNC first. The driver has the last word on
+ * what may change without vblank; if it refuses, the same request is
+ * committed in sync with vblank and *async is cleared, so the frame is
+ * shown late rather than not at all.
+ *
+ * Returns the result of drmModeAtomicCommit() for the last commit made.
+ */
+int
+drm_atomic_commit_try_async(int fd, drmModeAtomicReq *req, uint32_t flags,
+			    void *user_data, bool *async)
+{
+	int ret;
+
+	if (!(flags & DRM_MODE_PAGE_FLIP_EVENT) ||
+	    (flags & (DRM_MODE_ATOMIC_TEST_ONLY |
+		      DRM_MODE_ATOMIC_ALLOW_MODESET)))
+		*async = false;
+
+	if (!*async)
+		return drmModeAtomicCommit(fd, req, flags, user_data);
+
+	ret = drmModeAtomicCommit(fd, req, flags | DRM_MODE_PAGE_FLIP_ASYNC,
+				  user_data);
+	if (ret == 0)
+		return 0;
+
+	*async = false;
+	return drmModeAtomicCommit(fd, req, flags, user_data);
+}
@@ -72,6 +72,10 @@
 #define DRM_PLANE_ZPOS_INVALID_PLANE	0xffffffffffffffffULL
 #endif
 
+#ifndef DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP
+#define DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP	0x15
+#endif
+
 /**
  * A small wrapper to print information into the 'drm-backend' debug scope.
  *
@@ -186,6 +190,9 @@ enum wdrm_connector_property {
 	WDRM_CONNECTOR_CONTENT_PROTECTION,
 	WDRM_CONNECTOR_HDCP_CONTENT_TYPE,
 	WDRM_CONNECTOR_PANEL_ORIENTATION,
+	WDRM_CONNECTOR_WRITEBACK_PIXEL_FORMATS,
+	WDRM_CONNECTOR_WRITEBACK_FB_ID,
+	WDRM_CONNECTOR_WRITEBACK_OUT_FENCE_PTR,
 	WDRM_CONNECTOR__COUNT
 };
 
@@ -270,6 +277,7 @@ struct drm_backend {
 	bool cursors_are_broken;
 
 	bool atomic_modeset;
+	bool atomic_async_page_flip;
 
 	bool use_pixman;
 	bool use_pixman_shadow;
@@ -287,6 +295,9 @@ struct drm_backend {
 
 	bool fb_modifiers;
 
+	/* CLOCK_MONOTONIC time of backend creation, for the startup log */
+	struct timespec start_time;
+
 	struct weston_log_scope *debug;
 };
 
@@ -365,6 +376,8 @@ struct drm_output_state {
 	enum dpms_enum dpms;
 	enum weston_hdcp_protection protection;
 	struct wl_list plane_list;
+	/* flip without waiting for vblank, see drm_output_state_can_tear */
+	bool tearing;
 };
 
 /**
@@ -466,6 +479,35 @@ struct drm_writeback {
 
 	struct drm_backend *backend;
 	struct drm_connector connector;
+
+	/* The output whose CRTC the connector is routed to, if any */
+	struct drm_output *output;
+	/* Whether the kernel state has the connector on that CRTC; it
+	 * stays there until the output is off, as routing it takes a
+	 * modeset. */
+	bool attached;
+};
+
+enum drm_writeback_capture_state {
+	/* to be added to the next commit of the output */
+	DRM_WRITEBACK_CAPTURE_PENDING = 0,
+	/* committed, waiting for the writeback out-fence */
+	DRM_WRITEBACK_CAPTURE_COMMITTED,
+};
+
+/* A capture of an output frame through a writeback connector */
+struct drm_writeback_capture {
+	struct drm_output *output;
+	struct drm_writeback *writeback;
+	struct drm_fb *fb;
+	enum drm_writeback_capture_state state;
+
+	/* written by the kernel through WRITEBACK_OUT_FENCE_PTR */
+	int32_t out_fence_fd;
+	struct wl_event_source *fence_source;
+
+	weston_output_capture_done_func_t done;
+	void *data;
 };
 
 struct drm_head {
@@ -535,8 +577,18 @@ struct drm_output {
 	struct vaapi_recorder *recorder;
 	struct wl_listener recorder_frame_listener;
 
+	struct drm_writeback_capture *wb_capture;
+
 	struct wl_event_source *pageflip_timer;
 
+	/* Startup breakdown, logged once the first frame is shown; all
+	 * CLOCK_MONOTONIC. commit_time is zero until the first commit. */
+	struct timespec enable_time;
+	struct timespec commit_time;
+	int64_t commit_nsec;
+	bool inherits_mode;
+	bool lit;
+
 	bool virtual;
 
 	submit_frame_cb virtual_submit_frame;
@@ -610,6 +662,10 @@ drm_view_transform_supported(struct weston_view *ev, struct weston_output *outpu
 int
 drm_mode_ensure_blob(struct drm_backend *backend, struct drm_mode *mode);
 
+bool
+drm_mode_info_same_timings(const drmModeModeInfo *a,
+			   const drmModeModeInfo *b);
+
 struct drm_mode *
 drm_output_choose_mode(struct drm_output *output,
 		       struct weston_mode *target_mode);
@@ -677,6 +733,11 @@ drm_output_update_complete(struct drm_output *output, uint32_t flags,
 int
 on_drm_input(int fd, uint32_t mask, void *data);
 
+void
+drm_writeback_capture_committed(struct drm_output_state *state);
+void
+drm_writeback_capture_fail(struct drm_writeback_capture *capture);
+
 struct drm_fb *
 drm_fb_ref(struct drm_fb *fb);
 void
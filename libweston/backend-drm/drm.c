@@ -259,6 +259,38 @@ drm_output_get_disable_state(struct drm_pending_state *pending_state,
 	return output_state;
 }
 
+static double
+drm_backend_msec_since_start(struct drm_backend *b, const struct timespec *ts)
+{
+	return timespec_sub_to_nsec(ts, &b->start_time) / 1e6;
+}
+
+/* Log, once per enable, where the time went before the output showed its
+ * first frame. */
+static void
+drm_output_log_startup(struct drm_output *output)
+{
+	struct drm_backend *b = to_drm_backend(output->base.compositor);
+	struct timespec now;
+
+	if (output->lit || output->virtual ||
+	    (output->commit_time.tv_sec == 0 &&
+	     output->commit_time.tv_nsec == 0))
+		return;
+
+	output->lit = true;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	weston_log("DRM: output %s startup: enabled at %.1f ms, "
+		   "first commit at %.1f ms (%.1f ms in the kernel, %s), "
+		   "first frame at %.1f ms after backend start\n",
+		   output->base.name,
+		   drm_backend_msec_since_start(b, &output->enable_time),
+		   drm_backend_msec_since_start(b, &output->commit_time),
+		   output->commit_nsec / 1e6,
+		   output->inherits_mode ? "mode inherited" : "full modeset",
+		   drm_backend_msec_since_start(b, &now));
+}
 
 /**
  * Mark a drm_output_state (the output's last state) as complete. This handles
@@ -310,6 +342,8 @@ drm_output_update_complete(struct drm_output *output, uint32_t flags,
 		return;
 	}
 
+	drm_output_log_startup(output);
+
 	ts.tv_sec = sec;
 	ts.tv_nsec = usec * 1000;
 	weston_output_finish_frame(&output->base, &ts, flags);
@@ -399,8 +433,10 @@ drm_output_render(struct drm_output_state *state, pixman_region32_t *damage)
 	scanout_state->dest_w = output->base.current_mode->width;
 	scanout_state->dest_h = output->base.current_mode->height;
 
-	pixman_region32_subtract(&c->primary_plane.damage,
+	pixman_region32_subtract(&output->base.repaint_scratch,
 				 &c->primary_plane.damage, damage);
+	weston_region_swap(&c->primary_plane.damage,
+			   &output->base.repaint_scratch);
 
 	/* Don't bother calculating plane damage if the plane doesn't support it */
 	if (damage_info->prop_id == 0)
@@ -1706,6 +1742,252 @@ drm_output_detach_crtc(struct drm_output *output)
 	b->state_invalid = true;
 }
 
+static void
+drm_writeback_capture_finish(struct drm_writeback_capture *capture,
+			     bool success)
+{
+	struct drm_output *output = capture->output;
+	struct drm_fb *fb = capture->fb;
+	pixman_image_t *image = NULL;
+
+	drm_debug(output->backend, "[writeback] capture of output %s %s\n",
+		  output->base.name, success ? "done" : "failed");
+
+	if (success)
+		image = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+						 fb->width, fb->height,
+						 fb->map, fb->strides[0]);
+
+	capture->done(capture->data, image);
+
+	if (image)
+		pixman_image_unref(image);
+	if (!capture->writeback->attached)
+		capture->writeback->output = NULL;
+	if (capture->fence_source)
+		wl_event_source_remove(capture->fence_source);
+	if (capture->out_fence_fd >= 0)
+		close(capture->out_fence_fd);
+	drm_fb_unref(fb);
+
+	output->wb_capture = NULL;
+	free(capture);
+}
+
+/** Give up on a capture that could not be committed
+ *
+ * @param capture The capture, still pending.
+ *
+ * The done callback is told of the failure, so that the caller can fall
+ * back to reading the renderer output back.
+ */
+void
+drm_writeback_capture_fail(struct drm_writeback_capture *capture)
+{
+	drm_writeback_capture_finish(capture, false);
+}
+
+static int
+drm_writeback_capture_fence_handler(int fd, uint32_t mask, void *data)
+{
+	struct drm_writeback_capture *capture = data;
+
+	/* The out-fence signals once the frame is in the framebuffer. */
+	drm_writeback_capture_finish(capture, mask & WL_EVENT_READABLE);
+
+	return 0;
+}
+
+/** Start waiting for the capture of an output after a successful commit
+ *
+ * @param state The output state that was just committed.
+ */
+void
+drm_writeback_capture_committed(struct drm_output_state *state)
+{
+	struct drm_output *output = state->output;
+	struct drm_writeback_capture *capture = output->wb_capture;
+	struct wl_event_loop *loop;
+
+	if (!capture || capture->state != DRM_WRITEBACK_CAPTURE_PENDING)
+		return;
+
+	if (state->dpms != WESTON_DPMS_ON || capture->out_fence_fd < 0) {
+		drm_writeback_capture_finish(capture, false);
+		return;
+	}
+
+	capture->writeback->attached = true;
+	capture->state = DRM_WRITEBACK_CAPTURE_COMMITTED;
+
+	loop = wl_display_get_event_loop(output->base.compositor->wl_display);
+	capture->fence_source =
+		wl_event_loop_add_fd(loop, capture->out_fence_fd,
+				     WL_EVENT_READABLE,
+				     drm_writeback_capture_fence_handler,
+				     capture);
+	if (!capture->fence_source)
+		drm_writeback_capture_finish(capture, false);
+}
+
+static bool
+drm_writeback_supports_crtc(struct drm_writeback *writeback,
+			    struct drm_crtc *crtc)
+{
+	drmModeConnector *conn = writeback->connector.conn;
+	drmModeEncoder *encoder;
+	bool ret = false;
+	int i;
+
+	for (i = 0; i < conn->count_encoders && !ret; i++) {
+		encoder = drmModeGetEncoder(writeback->backend->drm.fd,
+					    conn->encoders[i]);
+		if (!encoder)
+			continue;
+
+		ret = encoder->possible_crtcs & (1u << crtc->pipe);
+		drmModeFreeEncoder(encoder);
+	}
+
+	return ret;
+}
+
+static bool
+drm_writeback_supports_format(struct drm_writeback *writeback,
+			      uint32_t format)
+{
+	struct drm_connector *connector = &writeback->connector;
+	drmModePropertyBlobRes *blob;
+	const uint32_t *formats;
+	uint64_t blob_id;
+	bool ret = false;
+	unsigned int i;
+
+	blob_id = drm_property_get_value(
+			&connector->props[WDRM_CONNECTOR_WRITEBACK_PIXEL_FORMATS],
+			connector->props_drm, 0);
+	if (blob_id == 0)
+		return false;
+
+	blob = drmModeGetPropertyBlob(writeback->backend->drm.fd, blob_id);
+	if (!blob)
+		return false;
+
+	formats = blob->data;
+	for (i = 0; i < blob->length / sizeof(*formats) && !ret; i++)
+		ret = formats[i] == format;
+
+	drmModeFreePropertyBlob(blob);
+
+	return ret;
+}
+
+static struct drm_writeback *
+drm_output_find_writeback(struct drm_output *output)
+{
+	struct drm_backend *b = output->backend;
+	struct drm_writeback *writeback;
+
+	/* The one already routed to the CRTC needs no modeset. */
+	wl_list_for_each(writeback, &b->writeback_connector_list, link) {
+		if (writeback->output == output)
+			return writeback;
+	}
+
+	wl_list_for_each(writeback, &b->writeback_connector_list, link) {
+		struct drm_connector *connector = &writeback->connector;
+
+		if (writeback->output ||
+		    connector->props[WDRM_CONNECTOR_WRITEBACK_FB_ID].prop_id == 0 ||
+		    connector->props[WDRM_CONNECTOR_WRITEBACK_OUT_FENCE_PTR].prop_id == 0)
+			continue;
+
+		if (drm_writeback_supports_crtc(writeback, output->crtc) &&
+		    drm_writeback_supports_format(writeback,
+						  DRM_FORMAT_XRGB8888))
+			return writeback;
+	}
+
+	return NULL;
+}
+
+/** Capture the next frame of an output through a writeback connector
+ *
+ * The writeback connector is added to the next commit of the output with
+ * a dumb framebuffer, and the kernel writes the blended result of all
+ * the planes into it.
+ */
+static int
+drm_output_capture(struct weston_output *base,
+		   weston_output_capture_done_func_t done, void *data)
+{
+	struct drm_output *output = to_drm_output(base);
+	struct drm_backend *b = output->backend;
+	struct drm_writeback_capture *capture;
+	struct drm_writeback *writeback;
+
+	if (output->wb_capture || !output->crtc ||
+	    output->state_cur->dpms != WESTON_DPMS_ON)
+		return -1;
+
+	writeback = drm_output_find_writeback(output);
+	if (!writeback) {
+		drm_debug(b, "[writeback] no writeback connector for "
+			     "output %s\n", base->name);
+		return -1;
+	}
+
+	capture = zalloc(sizeof *capture);
+	if (!capture)
+		return -1;
+
+	capture->fb = drm_fb_create_dumb(b, base->current_mode->width,
+					 base->current_mode->height,
+					 DRM_FORMAT_XRGB8888);
+	if (!capture->fb) {
+		free(capture);
+		return -1;
+	}
+
+	capture->output = output;
+	capture->writeback = writeback;
+	capture->state = DRM_WRITEBACK_CAPTURE_PENDING;
+	capture->out_fence_fd = -1;
+	capture->done = done;
+	capture->data = data;
+
+	writeback->output = output;
+	output->wb_capture = capture;
+
+	drm_debug(b, "[writeback] capturing output %s with connector %u\n",
+		  base->name, writeback->connector.connector_id);
+
+	weston_output_schedule_repaint(base);
+
+	return 0;
+}
+
+/* Whether the CRTC already shows our mode on all our connectors, left there
+ * by the firmware or a previous DRM master. The first commit then only
+ * needs to swap the buffers. */
+static bool
+drm_output_inherits_mode(struct drm_output *output)
+{
+	struct drm_mode *mode = to_drm_mode(output->base.current_mode);
+	struct weston_head *base;
+	struct drm_head *head;
+
+	wl_list_for_each(base, &output->base.head_list, output_link) {
+		head = to_drm_head(base);
+		if (head->inherited_crtc_id != output->crtc->crtc_id ||
+		    !drm_mode_info_same_timings(&head->inherited_mode,
+						&mode->mode_info))
+			return false;
+	}
+
+	return true;
+}
+
 static int
 drm_output_enable(struct weston_output *base)
 {
@@ -1715,10 +1997,17 @@ drm_output_enable(struct weston_output *base)
 
 	assert(!output->virtual);
 
+	clock_gettime(CLOCK_MONOTONIC, &output->enable_time);
+	output->commit_time.tv_sec = 0;
+	output->commit_time.tv_nsec = 0;
+	output->lit = false;
+
 	ret = drm_output_attach_crtc(output);
 	if (ret < 0)
 		return -1;
 
+	output->inherits_mode = drm_output_inherits_mode(output);
+
 	ret = drm_output_init_planes(output);
 	if (ret < 0)
 		goto err_crtc;
@@ -1747,6 +2036,8 @@ drm_output_enable(struct weston_output *base)
 	output->base.set_dpms = drm_set_dpms;
 	output->base.switch_mode = drm_output_switch_mode;
 	output->base.set_gamma = drm_output_set_gamma;
+	if (b->atomic_modeset)
+		output->base.capture = drm_output_capture;
 
 	weston_log("Output %s (crtc %d) video modes:\n",
 		   output->base.name, output->crtc->crtc_id);
@@ -1766,6 +2057,17 @@ drm_output_deinit(struct weston_output *base)
 {
 	struct drm_output *output = to_drm_output(base);
 	struct drm_backend *b = to_drm_backend(base->compositor);
+	struct drm_writeback *writeback;
+
+	if (output->wb_capture)
+		drm_writeback_capture_finish(output->wb_capture, false);
+
+	wl_list_for_each(writeback, &b->writeback_connector_list, link) {
+		if (writeback->output != output)
+			continue;
+		writeback->output = NULL;
+		writeback->attached = false;
+	}
 
 	if (b->use_pixman)
 		drm_output_fini_pixman(output);
@@ -2207,6 +2509,12 @@ err:
 static void
 drm_writeback_destroy(struct drm_writeback *writeback)
 {
+	struct drm_output *output = writeback->output;
+
+	if (output && output->wb_capture &&
+	    output->wb_capture->writeback == writeback)
+		drm_writeback_capture_finish(output->wb_capture, false);
+
 	drm_connector_fini(&writeback->connector);
 	wl_list_remove(&writeback->link);
 
@@ -2930,6 +3238,7 @@ drm_backend_create(struct weston_compositor *compositor,
 
 	b->state_invalid = true;
 	b->drm.fd = -1;
+	clock_gettime(CLOCK_MONOTONIC, &b->start_time);
 
 	b->compositor = compositor;
 	b->use_pixman = config->use_pixman;
@@ -3082,6 +3391,14 @@ drm_backend_create(struct weston_compositor *compositor,
 				   "support failed.\n");
 	}
 
+#ifdef HAVE_WP_TEARING_CONTROL
+	if (b->atomic_async_page_flip) {
+		if (weston_tearing_control_setup(compositor) < 0)
+			weston_log("Error: initializing tearing control "
+				   "support failed.\n");
+	}
+#endif
+
 	if (compositor->capabilities & WESTON_CAP_EXPLICIT_SYNC) {
 		if (linux_explicit_synchronization_setup(compositor) < 0)
 			weston_log("Error: initializing explicit "
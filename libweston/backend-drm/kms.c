@@ -30,6 +30,7 @@
 #include "config.h"
 
 #include <stdint.h>
+#include <time.h>
 
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -37,8 +38,10 @@
 #include <libweston/libweston.h>
 #include <libweston/backend-drm.h>
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 #include "shared/weston-drm-fourcc.h"
 #include "drm-internal.h"
+#include "async-flip.h"
 #include "pixel-formats.h"
 #include "presentation-time-server-protocol.h"
 
@@ -143,6 +146,13 @@ const struct drm_property_info connector_props[] = {
 		.enum_values = panel_orientation_enums,
 		.num_enum_values = WDRM_PANEL_ORIENTATION__COUNT,
 	},
+	[WDRM_CONNECTOR_WRITEBACK_PIXEL_FORMATS] = {
+		.name = "WRITEBACK_PIXEL_FORMATS",
+	},
+	[WDRM_CONNECTOR_WRITEBACK_FB_ID] = { .name = "WRITEBACK_FB_ID", },
+	[WDRM_CONNECTOR_WRITEBACK_OUT_FENCE_PTR] = {
+		.name = "WRITEBACK_OUT_FENCE_PTR",
+	},
 };
 
 const struct drm_property_info crtc_props[] = {
@@ -921,6 +931,89 @@ drm_connector_set_hdcp_property(struct drm_connector *connector,
 	assert(ret == 0);
 }
 
+/* Routes the writeback connector of a pending capture to the CRTC with
+ * its framebuffer, or takes an idle one off the CRTC of a disabled
+ * output.
+ *
+ * The capture is left out of test commits, so that plane assignment does
+ * not depend on it. Routing the connector changes the connectors of the
+ * CRTC, which the kernel only accepts in a modeset, so the first capture
+ * of an output allows one. The connector then stays routed until the
+ * output is turned off, and later captures need no modeset. If the
+ * kernel refuses the commit with the capture, the capture fails and the
+ * frame is committed without it, see drm_pending_state_drop_captures(). */
+static int
+drm_output_apply_writeback_atomic(struct drm_output_state *state,
+				  drmModeAtomicReq *req, uint32_t *flags)
+{
+	struct drm_output *output = state->output;
+	struct drm_writeback_capture *capture = output->wb_capture;
+	struct drm_backend *b = output->backend;
+	struct drm_writeback *writeback;
+	int ret = 0;
+
+	if (state->dpms != WESTON_DPMS_ON) {
+		wl_list_for_each(writeback, &b->writeback_connector_list, link) {
+			if (writeback->output != output || !writeback->attached)
+				continue;
+
+			ret |= connector_add_prop(req, &writeback->connector,
+						  WDRM_CONNECTOR_CRTC_ID, 0);
+			if (!(*flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+				writeback->attached = false;
+				if (!capture || capture->writeback != writeback)
+					writeback->output = NULL;
+			}
+		}
+		return ret;
+	}
+
+	if (!capture || capture->state != DRM_WRITEBACK_CAPTURE_PENDING ||
+	    (*flags & DRM_MODE_ATOMIC_TEST_ONLY))
+		return 0;
+
+	writeback = capture->writeback;
+	if (!writeback->attached) {
+		drm_debug(b, "\t\t\t[atomic] routing writeback connector, "
+			     "modeset OK\n");
+		*flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+	}
+
+	ret |= connector_add_prop(req, &writeback->connector,
+				  WDRM_CONNECTOR_CRTC_ID,
+				  output->crtc->crtc_id);
+	ret |= connector_add_prop(req, &writeback->connector,
+				  WDRM_CONNECTOR_WRITEBACK_FB_ID,
+				  capture->fb->fb_id);
+	ret |= connector_add_prop(req, &writeback->connector,
+				  WDRM_CONNECTOR_WRITEBACK_OUT_FENCE_PTR,
+				  (uintptr_t) &capture->out_fence_fd);
+
+	return ret;
+}
+
+/* Fails the captures a commit of the pending state includes, so that the
+ * frame can be committed without them. Returns whether there were any. */
+static bool
+drm_pending_state_drop_captures(struct drm_pending_state *pending_state)
+{
+	struct drm_output_state *output_state;
+	struct drm_writeback_capture *capture;
+	bool dropped = false;
+
+	wl_list_for_each(output_state, &pending_state->output_list, link) {
+		capture = output_state->output->wb_capture;
+		if (output_state->dpms != WESTON_DPMS_ON || !capture ||
+		    capture->state != DRM_WRITEBACK_CAPTURE_PENDING)
+			continue;
+
+		drm_writeback_capture_fail(capture);
+		dropped = true;
+	}
+
+	return dropped;
+}
+
 static int
 drm_output_apply_state_atomic(struct drm_output_state *state,
 			      drmModeAtomicReq *req,
@@ -974,6 +1067,8 @@ drm_output_apply_state_atomic(struct drm_output_state *state,
 		drm_connector_set_hdcp_property(&head->connector,
 						state->protection, req);
 
+	ret |= drm_output_apply_writeback_atomic(state, req, flags);
+
 	if (ret != 0) {
 		weston_log("couldn't set atomic CRTC/connector state\n");
 		return ret;
@@ -1036,6 +1131,42 @@ drm_output_apply_state_atomic(struct drm_output_state *state,
 	return 0;
 }
 
+/* Remember when the first commit after enabling the output went in. */
+static void
+drm_output_note_commit(struct drm_output *output,
+		       const struct timespec *begin,
+		       const struct timespec *end)
+{
+	if (output->lit ||
+	    output->commit_time.tv_sec != 0 || output->commit_time.tv_nsec != 0)
+		return;
+
+	output->commit_time = *begin;
+	output->commit_nsec = timespec_sub_to_nsec(end, begin);
+}
+
+/**
+ * Whether a commit of the pending state may skip waiting for vblank: all
+ * of its outputs must want to tear. drm_atomic_commit_try_async() rules out
+ * modesets.
+ */
+static bool
+drm_pending_state_can_tear(struct drm_pending_state *pending_state)
+{
+	struct drm_output_state *output_state;
+	bool tearing = false;
+
+	wl_list_for_each(output_state, &pending_state->output_list, link) {
+		if (output_state->output->virtual)
+			continue;
+		if (!output_state->tearing)
+			return false;
+		tearing = true;
+	}
+
+	return tearing;
+}
+
 /**
  * Helper function used only by drm_pending_state_apply, with the same
  * guarantees and constraints as that function.
@@ -1048,7 +1179,10 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 	struct drm_output_state *output_state, *tmp;
 	struct drm_plane *plane;
 	drmModeAtomicReq *req = drmModeAtomicAlloc();
+	struct timespec begin, end;
+	int n_outputs = 0;
 	uint32_t flags;
+	bool tearing;
 	int ret = 0;
 
 	if (!req)
@@ -1068,6 +1202,7 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 
 	if (b->state_invalid) {
 		struct weston_head *head_base;
+		struct drm_writeback *writeback;
 		struct drm_head *head;
 		struct drm_crtc *crtc;
 		uint32_t connector_id;
@@ -1137,6 +1272,17 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 			ret |= crtc_add_prop(req, crtc, WDRM_CRTC_MODE_ID, 0);
 		}
 
+		/* Take writeback connectors not routed by an output off
+		 * whatever CRTC they were left on. */
+		wl_list_for_each(writeback, &b->writeback_connector_list,
+				 link) {
+			if (writeback->output)
+				continue;
+
+			ret |= connector_add_prop(req, &writeback->connector,
+						  WDRM_CONNECTOR_CRTC_ID, 0);
+		}
+
 		/* Disable all the planes; planes which are being used will
 		 * override this state in the output-state application. */
 		wl_list_for_each(plane, &b->plane_list, link) {
@@ -1162,8 +1308,27 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 		goto out;
 	}
 
-	ret = drmModeAtomicCommit(b->drm.fd, req, flags, b);
-	drm_debug(b, "[atomic] drmModeAtomicCommit\n");
+	tearing = mode == DRM_STATE_APPLY_ASYNC &&
+		  drm_pending_state_can_tear(pending_state);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	if (tearing) {
+		ret = drm_atomic_commit_try_async(b->drm.fd, req, flags, b,
+						  &tearing);
+		drm_debug(b, "[atomic] drmModeAtomicCommit %s\n",
+			  tearing ? "without waiting for vblank" :
+				    "in sync with vblank, async refused");
+	} else {
+		ret = drmModeAtomicCommit(b->drm.fd, req, flags, b);
+		drm_debug(b, "[atomic] drmModeAtomicCommit\n");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (!tearing) {
+		wl_list_for_each(output_state, &pending_state->output_list,
+				 link)
+			output_state->tearing = false;
+	}
 
 	/* Test commits do not take ownership of the state; return
 	 * without freeing here. */
@@ -1173,14 +1338,39 @@ drm_pending_state_apply_atomic(struct drm_pending_state *pending_state,
 	}
 
 	if (ret != 0) {
+		int err = errno;
+
+		/* A capture must not hold up the frame: give it up, and
+		 * commit the frame alone. */
+		if (drm_pending_state_drop_captures(pending_state)) {
+			drm_debug(b, "[atomic] commit with writeback failed "
+				     "(%s), retrying without\n", strerror(err));
+			drmModeAtomicFree(req);
+			return drm_pending_state_apply_atomic(pending_state,
+							      mode);
+		}
+
 		weston_log("atomic: couldn't commit new state: %s\n",
-			   strerror(errno));
+			   strerror(err));
 		goto out;
 	}
 
 	wl_list_for_each_safe(output_state, tmp, &pending_state->output_list,
-			      link)
+			      link) {
+		if (!output_state->output->virtual) {
+			drm_output_note_commit(output_state->output,
+					       &begin, &end);
+			n_outputs++;
+		}
+		drm_writeback_capture_committed(output_state);
 		drm_output_assign_state(output_state, mode);
+	}
+
+	/* All outputs repainted together share one modeset. */
+	if (flags & DRM_MODE_ATOMIC_ALLOW_MODESET)
+		weston_log("DRM: modeset of %d output%s took %.1f ms\n",
+			   n_outputs, n_outputs == 1 ? "" : "s",
+			   timespec_sub_to_nsec(&end, &begin) / 1e6);
 
 	b->state_invalid = false;
 
@@ -1259,6 +1449,7 @@ drm_pending_state_apply(struct drm_pending_state *pending_state)
 	wl_list_for_each_safe(output_state, tmp, &pending_state->output_list,
 			      link) {
 		struct drm_output *output = output_state->output;
+		struct timespec begin, end;
 		int ret;
 
 		if (output->virtual) {
@@ -1267,10 +1458,14 @@ drm_pending_state_apply(struct drm_pending_state *pending_state)
 			continue;
 		}
 
+		clock_gettime(CLOCK_MONOTONIC, &begin);
 		ret = drm_output_apply_state_legacy(output_state);
+		clock_gettime(CLOCK_MONOTONIC, &end);
 		if (ret != 0) {
 			weston_log("Couldn't apply state for output %s\n",
 				   output->base.name);
+		} else {
+			drm_output_note_commit(output, &begin, &end);
 		}
 	}
 
@@ -1395,6 +1590,14 @@ atomic_flip_handler(int fd, unsigned int frame, unsigned int sec,
 	assert(output->atomic_complete_pending);
 	output->atomic_complete_pending = false;
 
+	/* An async flip completes whenever the hardware latches it, the
+	 * event only carries the time of the last vblank. That timestamp
+	 * stays the timebase of the repaint loop, the core reports the
+	 * completion time to clients instead. */
+	if (output->state_cur->tearing)
+		flags = WP_PRESENTATION_FEEDBACK_KIND_HW_COMPLETION |
+			WESTON_FINISH_FRAME_TEARING;
+
 	drm_output_update_complete(output, flags, sec, usec);
 	drm_debug(b, "[atomic][CRTC:%u] flip processing completed\n", crtc_id);
 }
@@ -1463,6 +1666,14 @@ init_kms_caps(struct drm_backend *b)
 	weston_log("DRM: %s atomic modesetting\n",
 		   b->atomic_modeset ? "supports" : "does not support");
 
+	if (b->atomic_modeset) {
+		ret = drmGetCap(b->drm.fd, DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP, &cap);
+		b->atomic_async_page_flip = (ret == 0 && cap == 1);
+		weston_log("DRM: %s atomic async page flips\n",
+			   b->atomic_async_page_flip ?
+			   "supports" : "does not support");
+	}
+
 	if (!getenv("WESTON_DISABLE_GBM_MODIFIERS")) {
 		ret = drmGetCap(b->drm.fd, DRM_CAP_ADDFB2_MODIFIERS, &cap);
 		if (ret == 0)
@@ -533,6 +533,29 @@ update_head_from_connector(struct drm_head *head)
 				conn->connection == DRM_MODE_CONNECTED);
 }
 
+/** Whether two modes drive the sink the same way
+ *
+ * The name and the type bits of a mode read back from a CRTC may differ
+ * from the connector's copy of the same mode. The kernel ignores them when
+ * deciding whether a commit needs a modeset, and so do we.
+ */
+bool
+drm_mode_info_same_timings(const drmModeModeInfo *a, const drmModeModeInfo *b)
+{
+	return a->clock == b->clock &&
+	       a->hdisplay == b->hdisplay &&
+	       a->hsync_start == b->hsync_start &&
+	       a->hsync_end == b->hsync_end &&
+	       a->htotal == b->htotal &&
+	       a->hskew == b->hskew &&
+	       a->vdisplay == b->vdisplay &&
+	       a->vsync_start == b->vsync_start &&
+	       a->vsync_end == b->vsync_end &&
+	       a->vtotal == b->vtotal &&
+	       a->vscan == b->vscan &&
+	       a->flags == b->flags;
+}
+
 /**
  * Choose suitable mode for an output
  *
@@ -609,8 +632,9 @@ drm_output_choose_initial_mode(struct drm_backend *backend,
 				config_fall_back = drm_mode;
 		}
 
-		if (memcmp(current_mode, &drm_mode->mode_info,
-			   sizeof *current_mode) == 0)
+		if (current_mode->clock != 0 &&
+		    drm_mode_info_same_timings(current_mode,
+					       &drm_mode->mode_info))
 			current = drm_mode;
 
 		if (drm_mode->base.flags & WL_OUTPUT_MODE_PREFERRED)
@@ -628,6 +652,15 @@ drm_output_choose_initial_mode(struct drm_backend *backend,
 	if (mode == WESTON_DRM_BACKEND_OUTPUT_CURRENT)
 		configured = current;
 
+	/* Of the modes matching a WxH[@R] configuration, prefer the one
+	 * already on screen: keeping it avoids a modeset at handover. */
+	if (configured && current && configured != current && width > 0 &&
+	    current->base.width == width && current->base.height == height &&
+	    (refresh == 0 || refresh == current->mode_info.vrefresh) &&
+	    (!backend->aspect_ratio_supported ||
+	     current->base.aspect_ratio == configured->base.aspect_ratio))
+		configured = current;
+
 	if (configured)
 		return configured;
 
@@ -365,6 +365,7 @@ drm_output_state_duplicate(struct drm_output_state *src,
 		wl_list_init(&dst->link);
 
 	wl_list_init(&dst->plane_list);
+	dst->tearing = false;
 
 	wl_list_for_each(ps, &src->plane_list, link) {
 		/* Don't carry planes which are now disabled; these should be
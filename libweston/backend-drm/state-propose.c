@@ -1038,6 +1038,48 @@ err:
 	return NULL;
 }
 
+/* Whether the output may flip to this state without waiting for vblank.
+ * The kernel only accepts an asynchronous commit when nothing but the
+ * buffer of the primary plane changes, so this is limited to one client
+ * buffer which asked for tearing, alone on the output. */
+static bool
+drm_output_state_can_tear(struct drm_output_state *state,
+			  enum drm_output_propose_state_mode mode)
+{
+	struct drm_output *output = state->output;
+	struct drm_backend *b = to_drm_backend(output->base.compositor);
+	struct drm_plane_state *ps;
+	struct weston_view *scanout_view = NULL;
+
+	if (!b->atomic_async_page_flip || b->state_invalid ||
+	    mode != DRM_OUTPUT_PROPOSE_STATE_PLANES_ONLY ||
+	    output->wb_capture)
+		return false;
+
+	/* coming back from DPMS off needs a modeset */
+	if (output->state_cur->dpms != WESTON_DPMS_ON)
+		return false;
+
+	wl_list_for_each(ps, &state->plane_list, link) {
+		if (!ps->fb)
+			continue;
+		if (ps->plane != output->scanout_plane || !ps->ev)
+			return false;
+		scanout_view = ps->ev;
+	}
+
+	if (!scanout_view || !scanout_view->surface->tearing)
+		return false;
+
+	/* turning another plane off is a change, too */
+	wl_list_for_each(ps, &output->state_cur->plane_list, link) {
+		if (ps->fb && ps->plane != output->scanout_plane)
+			return false;
+	}
+
+	return true;
+}
+
 void
 drm_assign_planes(struct weston_output *output_base, void *repaint_data)
 {
@@ -1082,6 +1124,10 @@ drm_assign_planes(struct weston_output *output_base, void *repaint_data)
 	drm_debug(b, "\t[repaint] Using %s composition\n",
 		  drm_propose_state_mode_to_string(mode));
 
+	state->tearing = drm_output_state_can_tear(state, mode);
+	if (state->tearing)
+		drm_debug(b, "\t[repaint] flipping without waiting for vblank\n");
+
 	wl_list_for_each(pnode, &output->base.paint_node_z_order_list,
 			 z_order_link) {
 		struct weston_view *ev = pnode->view;
@@ -36,6 +36,7 @@
 #include <libweston/libweston.h>
 #include <libweston/backend-headless.h>
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 #include "linux-explicit-synchronization.h"
 #include "pixman-renderer.h"
 #include "renderer-gl/gl-renderer.h"
@@ -45,6 +46,13 @@
 #include "presentation-time-server-protocol.h"
 #include <libweston/windowed-output-api.h>
 
+#define HEADLESS_DEFAULT_REFRESH 60000
+
+/* The mode advertised by a free-running output. The core schedules the next
+ * repaint one refresh period minus repaint-window after the last one; with
+ * a period this short that is always immediately. */
+#define HEADLESS_FREE_RUNNING_REFRESH 1000000
+
 enum headless_renderer_type {
 	HEADLESS_NOOP,
 	HEADLESS_PIXMAN,
@@ -70,6 +78,13 @@ struct headless_output {
 
 	struct weston_mode mode;
 	struct wl_event_source *finish_frame_timer;
+	struct wl_event_source *finish_frame_idle;
+	bool free_running;
+
+	/* virtual vblank clock: vblank n happens at vblank_base + n * period */
+	struct timespec vblank_base;
+	uint64_t vblank_msc;
+
 	uint32_t *image_buf;
 	pixman_image_t *image;
 };
@@ -97,13 +112,53 @@ to_headless_backend(struct weston_compositor *base)
 	return container_of(base->backend, struct headless_backend, base);
 }
 
+/* Returns the number of the last virtual vblank at or before now. */
+static uint64_t
+headless_output_vblank_before(struct headless_output *output,
+			      const struct timespec *now)
+{
+	int64_t period = millihz_to_nsec(output->mode.refresh);
+	int64_t elapsed = timespec_sub_to_nsec(now, &output->vblank_base);
+
+	if (elapsed < 0)
+		return 0;
+
+	return elapsed / period;
+}
+
+static void
+headless_output_vblank_time(struct headless_output *output, uint64_t msc,
+			    struct timespec *ts)
+{
+	int64_t period = millihz_to_nsec(output->mode.refresh);
+
+	timespec_add_nsec(ts, &output->vblank_base, msc * period);
+}
+
 static int
-headless_output_start_repaint_loop(struct weston_output *output)
+headless_output_start_repaint_loop(struct weston_output *output_base)
 {
+	struct headless_output *output = to_headless_output(output_base);
 	struct timespec ts;
+	uint64_t msc;
+
+	weston_compositor_read_presentation_clock(output->base.compositor, &ts);
+
+	if (!output->free_running) {
+		msc = headless_output_vblank_before(output, &ts);
+		/* Timestamps must not go backwards. */
+		if (msc > output->vblank_msc) {
+			output->vblank_msc = msc;
+			headless_output_vblank_time(output, msc, &ts);
+		} else {
+			headless_output_vblank_time(output, output->vblank_msc,
+						    &ts);
+		}
+	}
 
-	weston_compositor_read_presentation_clock(output->compositor, &ts);
-	weston_output_finish_frame(output, &ts, WP_PRESENTATION_FEEDBACK_INVALID);
+	output->base.msc = output->vblank_msc;
+	weston_output_finish_frame(&output->base, &ts,
+				   WP_PRESENTATION_FEEDBACK_INVALID);
 
 	return 0;
 }
@@ -114,10 +169,58 @@ finish_frame_handler(void *data)
 	struct headless_output *output = data;
 	struct timespec ts;
 
+	headless_output_vblank_time(output, output->vblank_msc, &ts);
+	output->base.msc = output->vblank_msc;
+	weston_output_finish_frame(&output->base, &ts,
+				   WP_PRESENTATION_FEEDBACK_KIND_VSYNC);
+
+	return 1;
+}
+
+static void
+free_running_finish_frame(void *data)
+{
+	struct headless_output *output = data;
+	struct timespec ts;
+
+	output->finish_frame_idle = NULL;
+
 	weston_compositor_read_presentation_clock(output->base.compositor, &ts);
+	output->base.msc = ++output->vblank_msc;
 	weston_output_finish_frame(&output->base, &ts, 0);
+}
 
-	return 1;
+static void
+headless_output_schedule_finish_frame(struct headless_output *output)
+{
+	struct wl_event_loop *loop;
+	struct timespec now, vblank;
+	int64_t delay_nsec;
+	uint64_t msc;
+
+	if (output->free_running) {
+		loop = wl_display_get_event_loop(output->base.compositor->wl_display);
+		output->finish_frame_idle =
+			wl_event_loop_add_idle(loop, free_running_finish_frame,
+					       output);
+		return;
+	}
+
+	/* Complete the frame on the first virtual vblank after now, never on
+	 * the one that was already reported. */
+	weston_compositor_read_presentation_clock(output->base.compositor, &now);
+	msc = headless_output_vblank_before(output, &now) + 1;
+	if (msc <= output->vblank_msc)
+		msc = output->vblank_msc + 1;
+	output->vblank_msc = msc;
+
+	headless_output_vblank_time(output, msc, &vblank);
+	delay_nsec = timespec_sub_to_nsec(&vblank, &now);
+
+	/* The timer has millisecond resolution; round up so that it never
+	 * fires before the vblank it reports. A zero delay would disarm it. */
+	wl_event_source_timer_update(output->finish_frame_timer,
+				     MAX(1, (delay_nsec + 999999) / 1000000));
 }
 
 static int
@@ -130,10 +233,12 @@ headless_output_repaint(struct weston_output *output_base,
 
 	ec->renderer->repaint_output(&output->base, damage);
 
-	pixman_region32_subtract(&ec->primary_plane.damage,
+	pixman_region32_subtract(&output_base->repaint_scratch,
 				 &ec->primary_plane.damage, damage);
+	weston_region_swap(&ec->primary_plane.damage,
+			   &output_base->repaint_scratch);
 
-	wl_event_source_timer_update(output->finish_frame_timer, 16);
+	headless_output_schedule_finish_frame(output);
 
 	return 0;
 }
@@ -165,6 +270,10 @@ headless_output_disable(struct weston_output *base)
 		return 0;
 
 	wl_event_source_remove(output->finish_frame_timer);
+	if (output->finish_frame_idle) {
+		wl_event_source_remove(output->finish_frame_idle);
+		output->finish_frame_idle = NULL;
+	}
 
 	switch (b->renderer_type) {
 	case HEADLESS_GL:
@@ -276,6 +385,10 @@ headless_output_enable(struct weston_output *base)
 		return -1;
 	}
 
+	weston_compositor_read_presentation_clock(b->compositor,
+						  &output->vblank_base);
+	output->vblank_msc = 0;
+
 	return 0;
 }
 
@@ -308,7 +421,7 @@ headless_output_set_size(struct weston_output *base,
 		WL_OUTPUT_MODE_CURRENT | WL_OUTPUT_MODE_PREFERRED;
 	output->mode.width = output_width;
 	output->mode.height = output_height;
-	output->mode.refresh = 60000;
+	output->mode.refresh = HEADLESS_DEFAULT_REFRESH;
 	wl_list_insert(&output->base.mode_list, &output->mode.link);
 
 	output->base.current_mode = &output->mode;
@@ -323,6 +436,25 @@ headless_output_set_size(struct weston_output *base,
 	return 0;
 }
 
+static int
+headless_output_set_refresh_rate(struct weston_output *base, int refresh)
+{
+	struct headless_output *output = to_headless_output(base);
+
+	/* Needs the mode from set_size(), and cannot change once enabled. */
+	if (!output->base.current_mode || output->base.enabled)
+		return -1;
+
+	if (refresh < 0)
+		return -1;
+
+	output->free_running = (refresh == 0);
+	output->mode.refresh = output->free_running ?
+			       HEADLESS_FREE_RUNNING_REFRESH : refresh;
+
+	return 0;
+}
+
 static struct weston_output *
 headless_output_create(struct weston_compositor *compositor, const char *name)
 {
@@ -417,6 +549,10 @@ static const struct weston_windowed_output_api api = {
 	headless_head_create,
 };
 
+static const struct weston_headless_output_api headless_api = {
+	headless_output_set_refresh_rate,
+};
+
 static struct headless_backend *
 headless_backend_create(struct weston_compositor *compositor,
 			struct weston_headless_backend_config *config)
@@ -487,6 +623,15 @@ headless_backend_create(struct weston_compositor *compositor,
 		goto err_input;
 	}
 
+	ret = weston_plugin_api_register(compositor,
+					 WESTON_HEADLESS_OUTPUT_API_NAME,
+					 &headless_api, sizeof(headless_api));
+
+	if (ret < 0) {
+		weston_log("Failed to register headless output API.\n");
+		goto err_input;
+	}
+
 	return b;
 
 err_input:
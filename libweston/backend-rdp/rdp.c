@@ -30,6 +30,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include <linux/input.h>
 
 #include <freerdp/version.h>
@@ -98,6 +102,49 @@ struct rdp_output {
 	struct wl_list peers;
 };
 
+enum rdp_encoder_codec {
+	RDP_ENCODER_CODEC_RFX,
+	RDP_ENCODER_CODEC_NSC,
+};
+
+/* Each peer encodes RemoteFX/NSCodec frames on its own worker thread, so
+ * that a slow encode does not stall the compositor nor the other peers.
+ *
+ * The main thread snapshots the damaged part of the shadow surface and
+ * queues it as a job. While a job is in flight, further damage is merged
+ * into pending_damage and the frame is skipped for this peer; the merged
+ * damage goes out as the next job once the previous one has been sent.
+ * The encoded stream is always sent from the main thread, FreeRDP peers
+ * are not thread-safe.
+ */
+struct rdp_encoder {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool thread_running;
+	bool quit;		/* protected by mutex */
+	bool job_queued;	/* protected by mutex */
+
+	int done_fd;
+	struct wl_event_source *done_source;
+
+	/* Main thread only: a job is queued, encoding or not yet sent. The
+	 * fields below are owned by the worker while this is set. */
+	bool busy;
+	enum rdp_encoder_codec codec;
+	pixman_image_t *snapshot;
+	pixman_region32_t job_damage;
+
+	/* Main thread only: damage not yet handed to the worker. */
+	pixman_region32_t pending_damage;
+
+	/* Statistics, protected by mutex. */
+	uint32_t frames_encoded;
+	uint32_t frames_skipped;
+	uint64_t encode_time_total_ns;
+	uint64_t encode_time_max_ns;
+};
+
 struct rdp_peer_context {
 	rdpContext _p;
 
@@ -107,6 +154,7 @@ struct rdp_peer_context {
 	wStream *encode_stream;
 	RFX_RECT *rfx_rects;
 	NSC_CONTEXT *nsc_context;
+	struct rdp_encoder encoder;
 
 	struct rdp_peers_item item;
 };
@@ -131,14 +179,12 @@ to_rdp_backend(struct weston_compositor *base)
 }
 
 static void
-rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+rdp_peer_encode_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
 {
 	int width, height, nrects, i;
 	pixman_box32_t *region, *rects;
 	uint32_t *ptr;
 	RFX_RECT *rfxRect;
-	rdpUpdate *update = peer->update;
-	SURFACE_BITS_COMMAND cmd = { 0 };
 	RdpPeerContext *context = (RdpPeerContext *)peer->context;
 
 	Stream_Clear(context->encode_stream);
@@ -147,17 +193,6 @@ rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	width = (damage->extents.x2 - damage->extents.x1);
 	height = (damage->extents.y2 - damage->extents.y1);
 
-	cmd.skipCompression = TRUE;
-	cmd.cmdType = CMDTYPE_STREAM_SURFACE_BITS;
-	cmd.destLeft = damage->extents.x1;
-	cmd.destTop = damage->extents.y1;
-	cmd.destRight = damage->extents.x2;
-	cmd.destBottom = damage->extents.y2;
-	cmd.bmp.bpp = 32;
-	cmd.bmp.codecID = peer->settings->RemoteFxCodecId;
-	cmd.bmp.width = width;
-	cmd.bmp.height = height;
-
 	ptr = pixman_image_get_data(image) + damage->extents.x1 +
 				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
 
@@ -178,21 +213,13 @@ rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 			(BYTE *)ptr, width, height,
 			pixman_image_get_stride(image)
 	);
-
-	cmd.bmp.bitmapDataLength = Stream_GetPosition(context->encode_stream);
-	cmd.bmp.bitmapData = Stream_Buffer(context->encode_stream);
-
-	update->SurfaceBits(update->context, &cmd);
 }
 
-
 static void
-rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+rdp_peer_encode_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
 {
 	int width, height;
 	uint32_t *ptr;
-	rdpUpdate *update = peer->update;
-	SURFACE_BITS_COMMAND cmd = { 0 };
 	RdpPeerContext *context = (RdpPeerContext *)peer->context;
 
 	Stream_Clear(context->encode_stream);
@@ -201,23 +228,41 @@ rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	width = (damage->extents.x2 - damage->extents.x1);
 	height = (damage->extents.y2 - damage->extents.y1);
 
-	cmd.cmdType = CMDTYPE_SET_SURFACE_BITS;
-	cmd.skipCompression = TRUE;
-	cmd.destLeft = damage->extents.x1;
-	cmd.destTop = damage->extents.y1;
-	cmd.destRight = damage->extents.x2;
-	cmd.destBottom = damage->extents.y2;
-	cmd.bmp.bpp = 32;
-	cmd.bmp.codecID = peer->settings->NSCodecId;
-	cmd.bmp.width = width;
-	cmd.bmp.height = height;
-
 	ptr = pixman_image_get_data(image) + damage->extents.x1 +
 				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
 
 	nsc_compose_message(context->nsc_context, context->encode_stream, (BYTE *)ptr,
 			width, height,
 			pixman_image_get_stride(image));
+}
+
+static void
+rdp_peer_send_encoded(pixman_region32_t *damage, enum rdp_encoder_codec codec,
+		      freerdp_peer *peer)
+{
+	rdpUpdate *update = peer->update;
+	SURFACE_BITS_COMMAND cmd = { 0 };
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+
+	cmd.skipCompression = TRUE;
+	cmd.destLeft = damage->extents.x1;
+	cmd.destTop = damage->extents.y1;
+	cmd.destRight = damage->extents.x2;
+	cmd.destBottom = damage->extents.y2;
+	cmd.bmp.bpp = 32;
+	cmd.bmp.width = (damage->extents.x2 - damage->extents.x1);
+	cmd.bmp.height = (damage->extents.y2 - damage->extents.y1);
+
+	switch (codec) {
+	case RDP_ENCODER_CODEC_RFX:
+		cmd.cmdType = CMDTYPE_STREAM_SURFACE_BITS;
+		cmd.bmp.codecID = peer->settings->RemoteFxCodecId;
+		break;
+	case RDP_ENCODER_CODEC_NSC:
+		cmd.cmdType = CMDTYPE_SET_SURFACE_BITS;
+		cmd.bmp.codecID = peer->settings->NSCodecId;
+		break;
+	}
 
 	cmd.bmp.bitmapDataLength = Stream_GetPosition(context->encode_stream);
 	cmd.bmp.bitmapData = Stream_Buffer(context->encode_stream);
@@ -225,6 +270,236 @@ rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 	update->SurfaceBits(update->context, &cmd);
 }
 
+static void *
+rdp_encoder_thread(void *data)
+{
+	freerdp_peer *peer = data;
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	struct rdp_encoder *encoder = &context->encoder;
+	struct timespec begin, end;
+	uint64_t elapsed, one = 1;
+	ssize_t ret;
+
+	for (;;) {
+		pthread_mutex_lock(&encoder->mutex);
+		while (!encoder->job_queued && !encoder->quit)
+			pthread_cond_wait(&encoder->cond, &encoder->mutex);
+		if (encoder->quit) {
+			pthread_mutex_unlock(&encoder->mutex);
+			break;
+		}
+		pthread_mutex_unlock(&encoder->mutex);
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		if (encoder->codec == RDP_ENCODER_CODEC_RFX)
+			rdp_peer_encode_rfx(&encoder->job_damage,
+					    encoder->snapshot, peer);
+		else
+			rdp_peer_encode_nsc(&encoder->job_damage,
+					    encoder->snapshot, peer);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		elapsed = timespec_sub_to_nsec(&end, &begin);
+
+		pthread_mutex_lock(&encoder->mutex);
+		encoder->job_queued = false;
+		encoder->frames_encoded++;
+		encoder->encode_time_total_ns += elapsed;
+		if (elapsed > encoder->encode_time_max_ns)
+			encoder->encode_time_max_ns = elapsed;
+
+		/* Signal while holding the mutex, so rdp_encoder_drain() is
+		 * guaranteed to consume this completion. */
+		ret = write(encoder->done_fd, &one, sizeof one);
+		if (ret != sizeof one)
+			weston_log("RDP encoder: failed to signal completion\n");
+
+		pthread_cond_broadcast(&encoder->cond);
+		pthread_mutex_unlock(&encoder->mutex);
+	}
+
+	return NULL;
+}
+
+/* Wait until the worker is done with the current job, if any. The encoded
+ * result is discarded; callers follow up with a full refresh. */
+static void
+rdp_encoder_drain(struct rdp_encoder *encoder)
+{
+	uint64_t count;
+
+	if (!encoder->busy)
+		return;
+
+	pthread_mutex_lock(&encoder->mutex);
+	while (encoder->job_queued)
+		pthread_cond_wait(&encoder->cond, &encoder->mutex);
+	pthread_mutex_unlock(&encoder->mutex);
+
+	if (read(encoder->done_fd, &count, sizeof count) < 0 && errno != EAGAIN)
+		weston_log("RDP encoder: failed to read completion\n");
+	encoder->busy = false;
+}
+
+static void
+rdp_encoder_queue_job(freerdp_peer *peer, pixman_image_t *image,
+		      enum rdp_encoder_codec codec)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	struct rdp_encoder *encoder = &context->encoder;
+	int width = pixman_image_get_width(image);
+	int height = pixman_image_get_height(image);
+	pixman_box32_t *rects;
+	int nrects, i;
+
+	if (encoder->busy || !pixman_region32_not_empty(&encoder->pending_damage))
+		return;
+
+	if (!encoder->snapshot ||
+	    pixman_image_get_width(encoder->snapshot) != width ||
+	    pixman_image_get_height(encoder->snapshot) != height) {
+		if (encoder->snapshot)
+			pixman_image_unref(encoder->snapshot);
+		encoder->snapshot = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+							     width, height,
+							     NULL, width * 4);
+		if (!encoder->snapshot) {
+			weston_log("RDP encoder: failed to allocate snapshot\n");
+			return;
+		}
+	}
+
+	/* The shadow surface gets overwritten by the next repaint, so hand
+	 * the worker a private copy of the damaged area. */
+	pixman_region32_intersect_rect(&encoder->pending_damage,
+				       &encoder->pending_damage,
+				       0, 0, width, height);
+	rects = pixman_region32_rectangles(&encoder->pending_damage, &nrects);
+	for (i = 0; i < nrects; i++)
+		pixman_image_composite32(PIXMAN_OP_SRC, image, NULL,
+					 encoder->snapshot,
+					 rects[i].x1, rects[i].y1, 0, 0,
+					 rects[i].x1, rects[i].y1,
+					 rects[i].x2 - rects[i].x1,
+					 rects[i].y2 - rects[i].y1);
+
+	pixman_region32_copy(&encoder->job_damage, &encoder->pending_damage);
+	pixman_region32_clear(&encoder->pending_damage);
+	encoder->codec = codec;
+	encoder->busy = true;
+
+	pthread_mutex_lock(&encoder->mutex);
+	encoder->job_queued = true;
+	pthread_cond_signal(&encoder->cond);
+	pthread_mutex_unlock(&encoder->mutex);
+}
+
+static enum rdp_encoder_codec
+rdp_peer_get_codec(freerdp_peer *peer)
+{
+	if (peer->settings->RemoteFxCodec)
+		return RDP_ENCODER_CODEC_RFX;
+
+	return RDP_ENCODER_CODEC_NSC;
+}
+
+static int
+rdp_encoder_done(int fd, uint32_t mask, void *data)
+{
+	freerdp_peer *peer = data;
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	struct rdp_encoder *encoder = &context->encoder;
+	struct rdp_output *output = context->rdpBackend->output;
+	uint64_t count;
+
+	if (read(fd, &count, sizeof count) < 0 || !encoder->busy)
+		return 0;
+
+	if ((context->item.flags & RDP_PEER_ACTIVATED) &&
+	    (context->item.flags & RDP_PEER_OUTPUT_ENABLED))
+		rdp_peer_send_encoded(&encoder->job_damage, encoder->codec, peer);
+
+	encoder->busy = false;
+
+	/* Catch up with the damage merged while this job was in flight. */
+	rdp_encoder_queue_job(peer, output->shadow_surface,
+			      rdp_peer_get_codec(peer));
+
+	return 0;
+}
+
+static void
+rdp_encoder_init_state(struct rdp_encoder *encoder)
+{
+	pixman_region32_init(&encoder->job_damage);
+	pixman_region32_init(&encoder->pending_damage);
+	pthread_mutex_init(&encoder->mutex, NULL);
+	pthread_cond_init(&encoder->cond, NULL);
+	encoder->done_fd = -1;
+}
+
+static int
+rdp_encoder_init(freerdp_peer *peer, struct rdp_backend *b)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	struct rdp_encoder *encoder = &context->encoder;
+	struct wl_event_loop *loop;
+
+	encoder->done_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (encoder->done_fd < 0)
+		return -1;
+
+	loop = wl_display_get_event_loop(b->compositor->wl_display);
+	encoder->done_source = wl_event_loop_add_fd(loop, encoder->done_fd,
+						    WL_EVENT_READABLE,
+						    rdp_encoder_done, peer);
+	if (!encoder->done_source)
+		return -1;
+
+	if (pthread_create(&encoder->thread, NULL, rdp_encoder_thread, peer) != 0)
+		return -1;
+	encoder->thread_running = true;
+
+	return 0;
+}
+
+static void
+rdp_encoder_destroy(freerdp_peer *peer)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	struct rdp_encoder *encoder = &context->encoder;
+
+	if (encoder->thread_running) {
+		pthread_mutex_lock(&encoder->mutex);
+		encoder->quit = true;
+		pthread_cond_signal(&encoder->cond);
+		pthread_mutex_unlock(&encoder->mutex);
+
+		pthread_join(encoder->thread, NULL);
+
+		weston_log("RDP peer %s: %u frames encoded, %u skipped, "
+			   "encode time avg %.2f ms, max %.2f ms\n",
+			   peer->settings->ClientAddress ?
+				peer->settings->ClientAddress : "(unknown)",
+			   encoder->frames_encoded, encoder->frames_skipped,
+			   encoder->frames_encoded ?
+				encoder->encode_time_total_ns /
+				(encoder->frames_encoded * 1000000.0) : 0.0,
+			   encoder->encode_time_max_ns / 1000000.0);
+	}
+
+	if (encoder->done_source)
+		wl_event_source_remove(encoder->done_source);
+	if (encoder->done_fd >= 0)
+		close(encoder->done_fd);
+	if (encoder->snapshot)
+		pixman_image_unref(encoder->snapshot);
+
+	pixman_region32_fini(&encoder->job_damage);
+	pixman_region32_fini(&encoder->pending_damage);
+	pthread_mutex_destroy(&encoder->mutex);
+	pthread_cond_destroy(&encoder->cond);
+}
+
 static void
 pixman_image_flipped_subrect(const pixman_box32_t *rect, pixman_image_t *img, BYTE *dest)
 {
@@ -306,12 +581,25 @@ rdp_peer_refresh_region(pixman_region32_t *region, freerdp_peer *peer)
 	struct rdp_output *output = context->rdpBackend->output;
 	rdpSettings *settings = peer->settings;
 
-	if (settings->RemoteFxCodec)
-		rdp_peer_refresh_rfx(region, output->shadow_surface, peer);
-	else if (settings->NSCodec)
-		rdp_peer_refresh_nsc(region, output->shadow_surface, peer);
-	else
+	struct rdp_encoder *encoder = &context->encoder;
+
+	if (!settings->RemoteFxCodec && !settings->NSCodec) {
 		rdp_peer_refresh_raw(region, output->shadow_surface, peer);
+		return;
+	}
+
+	pixman_region32_union(&encoder->pending_damage,
+			      &encoder->pending_damage, region);
+
+	if (encoder->busy) {
+		pthread_mutex_lock(&encoder->mutex);
+		encoder->frames_skipped++;
+		pthread_mutex_unlock(&encoder->mutex);
+		return;
+	}
+
+	rdp_encoder_queue_job(peer, output->shadow_surface,
+			      rdp_peer_get_codec(peer));
 }
 
 static int
@@ -690,6 +978,8 @@ rdp_peer_context_new(freerdp_peer* client, RdpPeerContext* context)
 	if (!context->encode_stream)
 		goto out_error_stream;
 
+	rdp_encoder_init_state(&context->encoder);
+
 	return TRUE;
 
 out_error_nsc:
@@ -719,6 +1009,8 @@ rdp_peer_context_free(freerdp_peer* client, RdpPeerContext* context)
 		free(context->item.seat);
 	}
 
+	rdp_encoder_destroy(client);
+
 	Stream_Free(context->encode_stream, TRUE);
 	nsc_context_free(context->nsc_context);
 	rfx_context_free(context->rfx_context);
@@ -949,6 +1241,7 @@ xf_peer_activate(freerdp_peer* client)
 	}
 
 	weston_output = &output->base;
+	rdp_encoder_drain(&peerCtx->encoder);
 	rfx_context_reset(peerCtx->rfx_context, weston_output->width, weston_output->height);
 	nsc_context_reset(peerCtx->nsc_context, weston_output->width, weston_output->height);
 
@@ -1209,6 +1502,11 @@ rdp_peer_init(freerdp_peer *client, struct rdp_backend *b)
 	peerCtx = (RdpPeerContext *) client->context;
 	peerCtx->rdpBackend = b;
 
+	if (rdp_encoder_init(client, b) < 0) {
+		weston_log("unable to start the peer encoder\n");
+		goto error_initialize;
+	}
+
 	settings = client->settings;
 	/* configure security settings */
 	if (b->rdp_key)
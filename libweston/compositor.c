@@ -75,6 +75,7 @@
 #include "backend.h"
 #include "libweston-internal.h"
 #include "color.h"
+#include "damage-policy.h"
 
 #include "weston-log-internal.h"
 
@@ -140,6 +141,8 @@ weston_paint_node_create(struct weston_surface *surface,
 
 	wl_list_init(&pnode->z_order_link);
 
+	pixman_region32_init(&pnode->damage);
+
 	return pnode;
 }
 
@@ -153,6 +156,7 @@ weston_paint_node_destroy(struct weston_paint_node *pnode)
 	wl_list_remove(&pnode->z_order_link);
 	assert(pnode->surf_xform_valid || !pnode->surf_xform.transform);
 	weston_surface_color_transform_fini(&pnode->surf_xform);
+	pixman_region32_fini(&pnode->damage);
 	free(pnode);
 }
 
@@ -544,6 +548,8 @@ weston_surface_state_init(struct weston_surface_state *state)
 
 	state->desired_protection = WESTON_HDCP_DISABLE;
 	state->protection_mode = WESTON_SURFACE_PROTECTION_MODE_RELAXED;
+
+	state->tearing = false;
 }
 
 static void
@@ -863,6 +869,7 @@ weston_transformed_region(int width, int height,
 			  int32_t scale,
 			  pixman_region32_t *src, pixman_region32_t *dest)
 {
+	pixman_box32_t stack_rects[16];
 	pixman_box32_t *src_rects, *dest_rects;
 	int nrects, i;
 
@@ -873,7 +880,10 @@ weston_transformed_region(int width, int height,
 	}
 
 	src_rects = pixman_region32_rectangles(src, &nrects);
-	dest_rects = malloc(nrects * sizeof(*dest_rects));
+	if (nrects <= (int) ARRAY_LENGTH(stack_rects))
+		dest_rects = stack_rects;
+	else
+		dest_rects = malloc(nrects * sizeof(*dest_rects));
 	if (!dest_rects)
 		return;
 
@@ -946,7 +956,8 @@ weston_transformed_region(int width, int height,
 
 	pixman_region32_clear(dest);
 	pixman_region32_init_rects(dest, dest_rects, nrects);
-	free(dest_rects);
+	if (dest_rects != stack_rects)
+		free(dest_rects);
 }
 
 static void
@@ -1647,6 +1658,8 @@ weston_view_update_transform(struct weston_view *view)
 
 	weston_view_assign_output(view);
 
+	weston_compositor_scene_changed(view->surface->compositor);
+
 	wl_signal_emit(&view->surface->compositor->transform_signal,
 		       view->surface);
 }
@@ -1714,6 +1727,51 @@ weston_view_from_global_float(struct weston_view *view,
 	}
 }
 
+/** Transform arrays of points from surface to global coordinates
+ *
+ * \param view The view.
+ * \param sx The x coordinates in surface space.
+ * \param sy The y coordinates in surface space.
+ * \param x Where to store the global x coordinates, may be \c sx.
+ * \param y Where to store the global y coordinates, may be \c sy.
+ * \param n The number of points.
+ *
+ * The batched equivalent of weston_view_to_global_float(). It relies on
+ * the view transformation being up to date.
+ */
+WL_EXPORT void
+weston_view_to_global_points(struct weston_view *view,
+			     const float *sx, const float *sy,
+			     float *x, float *y, int n)
+{
+	int unstable;
+
+	unstable = weston_matrix_transform_points(&view->transform.matrix,
+						  sx, sy, x, y, n);
+	if (unstable > 0)
+		weston_log("warning: numerical instability in %s(), "
+			   "%d of %d points\n", __func__, unstable, n);
+}
+
+/** Transform arrays of points from global to surface coordinates
+ *
+ * The batched equivalent of weston_view_from_global_float(), see
+ * weston_view_to_global_points().
+ */
+WL_EXPORT void
+weston_view_from_global_points(struct weston_view *view,
+			       const float *x, const float *y,
+			       float *vx, float *vy, int n)
+{
+	int unstable;
+
+	unstable = weston_matrix_transform_points(&view->transform.inverse,
+						  x, y, vx, vy, n);
+	if (unstable > 0)
+		weston_log("warning: numerical instability in %s(), "
+			   "%d of %d points\n", __func__, unstable, n);
+}
+
 WL_EXPORT void
 weston_view_from_global_fixed(struct weston_view *view,
 			      wl_fixed_t x, wl_fixed_t y,
@@ -2067,6 +2125,33 @@ weston_surface_set_size(struct weston_surface *surface,
 	surface_set_size(surface, width, height);
 }
 
+/** Replace the input region of a surface
+ *
+ * \param surface The surface.
+ * \param region The new input region in surface-local coordinates, or NULL
+ * for a surface that takes no input.
+ *
+ * Shells use this for the surfaces they create themselves, or to make a
+ * client surface stop taking input. Pointer foci are picked again after the
+ * next repaint if the region changed.
+ */
+WL_EXPORT void
+weston_surface_set_input_region(struct weston_surface *surface,
+				pixman_region32_t *region)
+{
+	if (region && pixman_region32_equal(region, &surface->input))
+		return;
+	if (!region && !pixman_region32_not_empty(&surface->input))
+		return;
+
+	if (region)
+		pixman_region32_copy(&surface->input, region);
+	else
+		pixman_region32_clear(&surface->input);
+
+	weston_compositor_scene_changed(surface->compositor);
+}
+
 static int
 fixed_round_up_to_int(wl_fixed_t f)
 {
@@ -2198,6 +2283,20 @@ weston_compositor_pick_view(struct weston_compositor *compositor,
 	return NULL;
 }
 
+/** Note that the pointer focus of the seats may be stale
+ *
+ * \param compositor The compositor.
+ *
+ * To be called whenever a view moves, is restacked, (un)mapped or its
+ * surface changes its input region, or when a pointer lost its focus, so
+ * that weston_compositor_repick() picks again after the next repaint.
+ */
+void
+weston_compositor_scene_changed(struct weston_compositor *compositor)
+{
+	compositor->scene_generation++;
+}
+
 static void
 weston_compositor_repick(struct weston_compositor *compositor)
 {
@@ -2206,6 +2305,12 @@ weston_compositor_repick(struct weston_compositor *compositor)
 	if (!compositor->session_active)
 		return;
 
+	/* Nothing moved under the pointers since the last repick. */
+	if (compositor->repick_generation == compositor->scene_generation)
+		return;
+
+	compositor->repick_generation = compositor->scene_generation;
+
 	wl_list_for_each(seat, &compositor->seat_list, link)
 		weston_seat_repick(seat);
 }
@@ -2226,6 +2331,7 @@ weston_view_unmap(struct weston_view *view)
 	wl_list_remove(&view->link);
 	wl_list_init(&view->link);
 	view->output_mask = 0;
+	weston_compositor_scene_changed(view->surface->compositor);
 	weston_surface_assign_output(view->surface);
 
 	if (weston_surface_is_mapped(view->surface))
@@ -2255,6 +2361,7 @@ weston_surface_unmap(struct weston_surface *surface)
 	wl_list_for_each(view, &surface->views, surface_link)
 		weston_view_unmap(view);
 	surface->output = NULL;
+	weston_compositor_scene_changed(surface->compositor);
 }
 
 static void
@@ -2358,6 +2465,20 @@ destroy_surface(struct wl_resource *resource)
 
 	assert(surface);
 
+	if (weston_log_scope_is_enabled(surface->compositor->debug_commits)) {
+		struct timespec now;
+		pid_t pid;
+
+		weston_compositor_read_presentation_clock(surface->compositor,
+							  &now);
+		wl_client_get_credentials(wl_resource_get_client(resource),
+					  &pid, NULL, NULL);
+		weston_log_scope_printf(surface->compositor->debug_commits,
+					"%" PRId64 ".%09ld destroy %d/%u\n",
+					(int64_t)now.tv_sec, now.tv_nsec,
+					(int)pid, wl_resource_get_id(resource));
+	}
+
 	/* Set the resource to NULL, since we don't want to leave a
 	 * dangling pointer if the surface was refcounted and survives
 	 * the weston_surface_destroy() call. */
@@ -2554,8 +2675,12 @@ static void
 surface_flush_damage(struct weston_surface *surface)
 {
 	if (surface->buffer_ref.buffer &&
-	    wl_shm_buffer_get(surface->buffer_ref.buffer->resource))
+	    wl_shm_buffer_get(surface->buffer_ref.buffer->resource)) {
+		weston_damage_policy_apply(
+			&surface->compositor->upload_damage_policy,
+			&surface->damage);
 		surface->compositor->renderer->flush_damage(surface);
+	}
 
 	if (pixman_region32_not_empty(&surface->damage))
 		TL_POINT(surface->compositor, "core_flush_damage", TLP_SURFACE(surface),
@@ -2564,32 +2689,41 @@ surface_flush_damage(struct weston_surface *surface)
 	pixman_region32_clear(&surface->damage);
 }
 
+/* No operation is done in place, see weston_region_swap(): the results
+ * go to the paint node damage and to the output scratch region, which are
+ * then swapped with the accumulated regions. */
 static void
-view_accumulate_damage(struct weston_view *view,
+view_accumulate_damage(struct weston_paint_node *pnode,
 		       pixman_region32_t *opaque)
 {
-	pixman_region32_t damage;
+	struct weston_view *view = pnode->view;
+	pixman_region32_t *scratch = &pnode->output->repaint_scratch;
+	pixman_region32_t *damage = &pnode->damage;
 
-	pixman_region32_init(&damage);
 	if (view->transform.enabled) {
 		pixman_box32_t *extents;
+		pixman_region32_t bbox;
 
 		extents = pixman_region32_extents(&view->surface->damage);
-		view_compute_bbox(view, extents, &damage);
+		view_compute_bbox(view, extents, &bbox);
+		pixman_region32_intersect(damage, &bbox,
+					  &view->transform.boundingbox);
+		pixman_region32_fini(&bbox);
 	} else {
-		pixman_region32_copy(&damage, &view->surface->damage);
-		pixman_region32_translate(&damage,
+		pixman_region32_copy(scratch, &view->surface->damage);
+		pixman_region32_translate(scratch,
 					  view->geometry.x, view->geometry.y);
+		pixman_region32_intersect(damage, scratch,
+					  &view->transform.boundingbox);
 	}
 
-	pixman_region32_intersect(&damage, &damage,
-				  &view->transform.boundingbox);
-	pixman_region32_subtract(&damage, &damage, opaque);
-	pixman_region32_union(&view->plane->damage,
-			      &view->plane->damage, &damage);
-	pixman_region32_fini(&damage);
+	pixman_region32_subtract(scratch, damage, opaque);
+	pixman_region32_union(damage, &view->plane->damage, scratch);
+	weston_region_swap(&view->plane->damage, damage);
+
 	pixman_region32_copy(&view->clip, opaque);
-	pixman_region32_union(opaque, opaque, &view->transform.opaque);
+	pixman_region32_union(scratch, opaque, &view->transform.opaque);
+	weston_region_swap(opaque, scratch);
 }
 
 static void
@@ -2598,29 +2732,29 @@ output_accumulate_damage(struct weston_output *output)
 	struct weston_compositor *ec = output->compositor;
 	struct weston_plane *plane;
 	struct weston_paint_node *pnode;
-	pixman_region32_t opaque, clip;
+	pixman_region32_t *opaque = &output->repaint_opaque;
+	pixman_region32_t *clip = &output->repaint_clip;
+	pixman_region32_t *scratch = &output->repaint_scratch;
 
-	pixman_region32_init(&clip);
+	pixman_region32_clear(clip);
 
 	wl_list_for_each(plane, &ec->plane_list, link) {
-		pixman_region32_copy(&plane->clip, &clip);
+		pixman_region32_copy(&plane->clip, clip);
 
-		pixman_region32_init(&opaque);
+		pixman_region32_clear(opaque);
 
 		wl_list_for_each(pnode, &output->paint_node_z_order_list,
 				 z_order_link) {
 			if (pnode->view->plane != plane)
 				continue;
 
-			view_accumulate_damage(pnode->view, &opaque);
+			view_accumulate_damage(pnode, opaque);
 		}
 
-		pixman_region32_union(&clip, &clip, &opaque);
-		pixman_region32_fini(&opaque);
+		pixman_region32_union(scratch, clip, opaque);
+		weston_region_swap(clip, scratch);
 	}
 
-	pixman_region32_fini(&clip);
-
 	wl_list_for_each(pnode, &output->paint_node_z_order_list,
 			 z_order_link) {
 		pnode->surface->touched = false;
@@ -2872,7 +3006,8 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 	struct weston_animation *animation, *next;
 	struct weston_frame_callback *cb, *cnext;
 	struct wl_list frame_callback_list;
-	pixman_region32_t output_damage;
+	pixman_region32_t *output_damage = &output->repaint_damage;
+	pixman_region32_t *scratch = &output->repaint_scratch;
 	int r;
 	uint32_t frame_time_msec;
 	enum weston_hdcp_protection highest_requested = WESTON_HDCP_DISABLE;
@@ -2931,18 +3066,16 @@ weston_output_repaint(struct weston_output *output, void *repaint_data)
 
 	output_accumulate_damage(output);
 
-	pixman_region32_init(&output_damage);
-	pixman_region32_intersect(&output_damage,
+	pixman_region32_intersect(scratch,
 				  &ec->primary_plane.damage, &output->region);
-	pixman_region32_subtract(&output_damage,
-				 &output_damage, &ec->primary_plane.clip);
+	pixman_region32_subtract(output_damage,
+				 scratch, &ec->primary_plane.clip);
+	weston_damage_policy_apply(&ec->composite_damage_policy, output_damage);
 
 	if (output->dirty)
 		weston_output_update_matrix(output);
 
-	r = output->repaint(output, &output_damage, repaint_data);
-
-	pixman_region32_fini(&output_damage);
+	r = output->repaint(output, output_damage, repaint_data);
 
 	output->repaint_needed = false;
 	if (r == 0)
@@ -3071,6 +3204,8 @@ output_repaint_timer_handler(void *data)
 	weston_compositor_read_presentation_clock(compositor, &now);
 	compositor->last_repaint_start = now;
 
+	weston_compositor_flush_pointer_motion(compositor);
+
 	if (compositor->backend->repaint_begin)
 		repaint_data = compositor->backend->repaint_begin(compositor);
 
@@ -3150,10 +3285,13 @@ weston_output_finish_frame(struct weston_output *output,
 	int32_t refresh_nsec;
 	struct timespec now;
 	struct timespec vblank_monotonic;
+	bool tearing = presented_flags & WESTON_FINISH_FRAME_TEARING;
 	int64_t msec_rel;
 
 	assert(output->repaint_status == REPAINT_AWAITING_COMPLETION);
 
+	presented_flags &= ~WESTON_FINISH_FRAME_TEARING;
+
 	/*
 	 * If timestamp of latest vblank is given, it must always go forwards.
 	 * If not given, INVALID flag must be set.
@@ -3179,14 +3317,25 @@ weston_output_finish_frame(struct weston_output *output,
 	TL_POINT(compositor, "core_repaint_finished", TLP_OUTPUT(output),
 		 TLP_VBLANK(&vblank_monotonic), TLP_END);
 
+	/* A torn frame is visible once the flip completed, not at the last
+	 * vblank given in stamp. The latter still becomes frame_time, so
+	 * that the repaint loop stays on the vblank timebase. */
 	refresh_nsec = millihz_to_nsec(output->current_mode->refresh);
 	weston_presentation_feedback_present_list(&output->feedback_list,
-						  output, refresh_nsec, stamp,
+						  output, refresh_nsec,
+						  tearing ? &now : stamp,
 						  output->msc,
 						  presented_flags);
 
 	output->frame_time = *stamp;
 
+	/* A torn frame is not tied to the refresh cycle, so the next one can
+	 * go out as soon as there is something new to show. */
+	if (tearing) {
+		output->next_repaint = now;
+		goto out;
+	}
+
 	timespec_add_nsec(&output->next_repaint, stamp, refresh_nsec);
 	timespec_add_msec(&output->next_repaint, &output->next_repaint,
 			  -compositor->repaint_msec);
@@ -3241,11 +3390,15 @@ weston_layer_entry_insert(struct weston_layer_entry *list,
 {
 	wl_list_insert(&list->link, &entry->link);
 	entry->layer = list->layer;
+	weston_compositor_scene_changed(entry->layer->compositor);
 }
 
 WL_EXPORT void
 weston_layer_entry_remove(struct weston_layer_entry *entry)
 {
+	if (entry->layer)
+		weston_compositor_scene_changed(entry->layer->compositor);
+
 	wl_list_remove(&entry->link);
 	wl_list_init(&entry->link);
 	entry->layer = NULL;
@@ -3298,6 +3451,7 @@ weston_layer_set_position(struct weston_layer *layer,
 	struct weston_layer *below;
 
 	wl_list_remove(&layer->link);
+	weston_compositor_scene_changed(layer->compositor);
 
 	/* layer_list is ordered from top to bottom, the last layer being the
 	 * background with the smallest position value */
@@ -3322,6 +3476,7 @@ weston_layer_unset_position(struct weston_layer *layer)
 {
 	wl_list_remove(&layer->link);
 	wl_list_init(&layer->link);
+	weston_compositor_scene_changed(layer->compositor);
 }
 
 WL_EXPORT void
@@ -3569,8 +3724,10 @@ weston_surface_commit_subsurface_order(struct weston_surface *surface)
 		wl_list_remove(&sub->parent_link);
 		wl_list_insert(&surface->subsurface_list, &sub->parent_link);
 
-		if (sub->reordered)
+		if (sub->reordered) {
 			weston_surface_damage_subsurfaces(sub);
+			weston_compositor_scene_changed(surface->compositor);
+		}
 	}
 }
 
@@ -3803,6 +3960,7 @@ weston_surface_commit_state(struct weston_surface *surface,
 {
 	struct weston_view *view;
 	pixman_region32_t opaque;
+	pixman_region32_t input;
 
 	/* wl_surface.set_buffer_transform */
 	/* wl_surface.set_buffer_scale */
@@ -3868,9 +4026,13 @@ weston_surface_commit_state(struct weston_surface *surface,
 	pixman_region32_fini(&opaque);
 
 	/* wl_surface.set_input_region */
-	pixman_region32_intersect_rect(&surface->input, &state->input,
+	pixman_region32_init(&input);
+	pixman_region32_intersect_rect(&input, &state->input,
 				       0, 0, surface->width, surface->height);
 
+	weston_surface_set_input_region(surface, &input);
+	pixman_region32_fini(&input);
+
 	/* wl_surface.frame */
 	wl_list_insert_list(&surface->frame_callback_list,
 			    &state->frame_callback_list);
@@ -3894,6 +4056,9 @@ weston_surface_commit_state(struct weston_surface *surface,
 	/* weston_protected_surface.set_type */
 	weston_surface_set_desired_protection(surface, state->desired_protection);
 
+	/* wp_tearing_control_v1.set_presentation_hint */
+	surface->tearing = state->tearing;
+
 	wl_signal_emit(&surface->commit_signal, surface);
 }
 
@@ -3914,6 +4079,160 @@ static void
 weston_subsurface_parent_commit(struct weston_subsurface *sub,
 				int parent_is_synchronized);
 
+static void
+debug_commit_print_id(FILE *fp, struct weston_surface *surface)
+{
+	pid_t pid = 0;
+
+	if (!surface->resource) {
+		fprintf(fp, "0/0");
+		return;
+	}
+
+	wl_client_get_credentials(wl_resource_get_client(surface->resource),
+				  &pid, NULL, NULL);
+	fprintf(fp, "%d/%u", (int)pid, wl_resource_get_id(surface->resource));
+}
+
+static void
+debug_commit_print_region(FILE *fp, const char *key, pixman_region32_t *region)
+{
+	pixman_box32_t *rects;
+	int n_rects, i;
+
+	rects = pixman_region32_rectangles(region, &n_rects);
+	if (n_rects == 0)
+		return;
+
+	fprintf(fp, " %s=", key);
+	for (i = 0; i < n_rects; i++) {
+		fprintf(fp, "%s%d,%d,%d,%d", i ? ";" : "",
+			rects[i].x1, rects[i].y1,
+			rects[i].x2 - rects[i].x1, rects[i].y2 - rects[i].y1);
+	}
+}
+
+static void
+debug_commit_print_buffer(FILE *fp, struct weston_buffer *buffer)
+{
+	struct wl_shm_buffer *shm;
+	struct linux_dmabuf_buffer *dmabuf;
+
+	if (!buffer) {
+		fprintf(fp, " buffer=none");
+		return;
+	}
+
+	shm = wl_shm_buffer_get(buffer->resource);
+	if (shm) {
+		fprintf(fp, " buffer=%dx%d format=shm:0x%x",
+			wl_shm_buffer_get_width(shm),
+			wl_shm_buffer_get_height(shm),
+			wl_shm_buffer_get_format(shm));
+		return;
+	}
+
+	dmabuf = linux_dmabuf_buffer_get(buffer->resource);
+	if (dmabuf) {
+		fprintf(fp, " buffer=%dx%d format=dmabuf:0x%x",
+			dmabuf->attributes.width, dmabuf->attributes.height,
+			dmabuf->attributes.format);
+		return;
+	}
+
+	/* Other buffer types only get their size once attached. */
+	fprintf(fp, " buffer=%dx%d format=egl:0", buffer->width, buffer->height);
+}
+
+/* Record one wl_surface.commit request, with the pending state it carries,
+ * as a single line in the "commits" debug scope. Replaying these lines
+ * with weston-commit-replay reproduces the workload of the client. */
+static void
+debug_commit_record(struct weston_surface *surface)
+{
+	struct weston_compositor *compositor = surface->compositor;
+	struct weston_surface_state *state = &surface->pending;
+	struct weston_buffer_viewport *vp = &state->buffer_viewport;
+	struct weston_subsurface *sub = weston_surface_to_subsurface(surface);
+	struct weston_subsurface *child;
+	bool reordered = false;
+	bool positioned = false;
+	struct timespec now;
+	FILE *fp;
+	char *str;
+	size_t len;
+
+	fp = open_memstream(&str, &len);
+	if (!fp)
+		return;
+
+	weston_compositor_read_presentation_clock(compositor, &now);
+	fprintf(fp, "%" PRId64 ".%09ld commit ", (int64_t)now.tv_sec,
+		now.tv_nsec);
+	debug_commit_print_id(fp, surface);
+	fprintf(fp, " role=%s", surface->role_name ?: "none");
+
+	if (sub && sub->parent) {
+		fprintf(fp, " parent=");
+		debug_commit_print_id(fp, sub->parent);
+		fprintf(fp, " sync=%d", sub->synchronized);
+	}
+
+	if (state->newly_attached) {
+		debug_commit_print_buffer(fp, state->buffer);
+		if (state->sx != 0 || state->sy != 0)
+			fprintf(fp, " offset=%d,%d", state->sx, state->sy);
+	}
+
+	fprintf(fp, " scale=%d transform=%u", vp->buffer.scale,
+		vp->buffer.transform);
+	if (vp->buffer.src_width != wl_fixed_from_int(-1)) {
+		fprintf(fp, " src=%f,%f,%f,%f",
+			wl_fixed_to_double(vp->buffer.src_x),
+			wl_fixed_to_double(vp->buffer.src_y),
+			wl_fixed_to_double(vp->buffer.src_width),
+			wl_fixed_to_double(vp->buffer.src_height));
+	}
+	if (vp->surface.width != -1)
+		fprintf(fp, " dst=%d,%d", vp->surface.width, vp->surface.height);
+
+	debug_commit_print_region(fp, "damage", &state->damage_surface);
+	debug_commit_print_region(fp, "bdamage", &state->damage_buffer);
+
+	/* Sub-surface positions are applied by the commit of the parent. */
+	wl_list_for_each(child, &surface->subsurface_list_pending,
+			 parent_link_pending) {
+		reordered |= child->reordered;
+
+		if (child->surface == surface || !child->position.set)
+			continue;
+
+		fprintf(fp, positioned ? ";" : " pos=");
+		debug_commit_print_id(fp, child->surface);
+		fprintf(fp, ":%d,%d", child->position.x, child->position.y);
+		positioned = true;
+	}
+
+	/* Stacking order of the sub-surfaces, top-most first; the surface
+	 * itself is listed too. */
+	if (reordered) {
+		fprintf(fp, " order=");
+		wl_list_for_each(child, &surface->subsurface_list_pending,
+				 parent_link_pending) {
+			if (child->parent_link_pending.prev !=
+			    &surface->subsurface_list_pending)
+				fprintf(fp, ";");
+			debug_commit_print_id(fp, child->surface);
+		}
+	}
+
+	fprintf(fp, "\n");
+	fclose(fp);
+
+	weston_log_scope_write(compositor->debug_commits, str, len);
+	free(str);
+}
+
 static void
 surface_commit(struct wl_client *client, struct wl_resource *resource)
 {
@@ -3980,6 +4299,9 @@ surface_commit(struct wl_client *client, struct wl_resource *resource)
 		return;
 	}
 
+	if (weston_log_scope_is_enabled(surface->compositor->debug_commits))
+		debug_commit_record(surface);
+
 	if (sub) {
 		weston_subsurface_commit(sub);
 		return;
@@ -4195,6 +4517,7 @@ weston_subsurface_commit_to_cache(struct weston_subsurface *sub)
 	}
 	sub->cached.desired_protection = surface->pending.desired_protection;
 	sub->cached.protection_mode = surface->pending.protection_mode;
+	sub->cached.tearing = surface->pending.tearing;
 	assert(surface->pending.acquire_fence_fd == -1);
 	assert(surface->pending.buffer_release_ref.buffer_release == NULL);
 	sub->cached.sx += surface->pending.sx;
@@ -4329,6 +4652,7 @@ subsurface_committed(struct weston_surface *surface, int32_t dx, int32_t dy)
 
 	if (!weston_surface_is_mapped(surface)) {
 		surface->is_mapped = true;
+		weston_compositor_scene_changed(surface->compositor);
 
 		/* Cannot call weston_view_update_transform(),
 		 * because that would call it also for the parent surface,
@@ -6504,6 +6828,10 @@ weston_output_init(struct weston_output *output,
 	output->transform = UINT32_MAX;
 
 	pixman_region32_init(&output->region);
+	pixman_region32_init(&output->repaint_damage);
+	pixman_region32_init(&output->repaint_opaque);
+	pixman_region32_init(&output->repaint_clip);
+	pixman_region32_init(&output->repaint_scratch);
 	wl_list_init(&output->mode_list);
 }
 
@@ -6835,6 +7163,10 @@ weston_output_release(struct weston_output *output)
 	assert(wl_list_empty(&output->paint_node_list));
 
 	pixman_region32_fini(&output->region);
+	pixman_region32_fini(&output->repaint_damage);
+	pixman_region32_fini(&output->repaint_opaque);
+	pixman_region32_fini(&output->repaint_clip);
+	pixman_region32_fini(&output->repaint_scratch);
 	wl_list_remove(&output->link);
 
 	wl_list_for_each_safe(head, tmp, &output->head_list, output_link)
@@ -7592,6 +7924,34 @@ debug_scene_graph_cb(struct weston_log_subscription *sub, void *data)
 	weston_log_subscription_complete(sub);
 }
 
+static void
+debug_damage_print_policy(struct weston_log_subscription *sub,
+			  const char *name,
+			  const struct weston_damage_policy *policy)
+{
+	weston_log_subscription_printf(sub,
+		"%s: max-rects %d, max-waste %d%%, %" PRIu64 " regions, "
+		"%" PRIu64 " rectangles in, %" PRIu64 " out\n",
+		name, policy->max_rects, policy->max_waste_percent,
+		policy->n_regions, policy->n_rects_in, policy->n_rects_out);
+}
+
+/** Print the damage simplification statistics
+ *
+ * Only regions of more than one rectangle are counted, since there is
+ * nothing to simplify otherwise.
+ */
+static void
+debug_damage_cb(struct weston_log_subscription *sub, void *data)
+{
+	struct weston_compositor *ec = data;
+
+	debug_damage_print_policy(sub, "upload", &ec->upload_damage_policy);
+	debug_damage_print_policy(sub, "composite",
+				  &ec->composite_damage_policy);
+	weston_log_subscription_complete(sub);
+}
+
 /** Retrieve testsuite data from compositor
  *
  * The testsuite data can be defined by the test suite of projects that uses
@@ -7745,6 +8105,16 @@ weston_compositor_create(struct wl_display *display,
 						weston_timeline_create_subscription,
 						weston_timeline_destroy_subscription,
 						ec);
+
+	ec->debug_commits =
+		weston_compositor_add_log_scope(ec, "commits",
+						"Surface commit stream, for replay with weston-commit-replay\n",
+						NULL, NULL, ec);
+
+	ec->debug_damage =
+		weston_compositor_add_log_scope(ec, "damage",
+						"Damage simplification statistics\n",
+						debug_damage_cb, NULL, ec);
 	return ec;
 
 fail:
@@ -8123,6 +8493,12 @@ weston_compositor_destroy(struct weston_compositor *compositor)
 	weston_log_scope_destroy(compositor->debug_scene);
 	compositor->debug_scene = NULL;
 
+	weston_log_scope_destroy(compositor->debug_commits);
+	compositor->debug_commits = NULL;
+
+	weston_log_scope_destroy(compositor->debug_damage);
+	compositor->debug_damage = NULL;
+
 	weston_log_scope_destroy(compositor->timeline);
 	compositor->timeline = NULL;
 
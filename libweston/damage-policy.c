@@ -0,0 +1,151 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include "shared/helpers.h"
+
+#include "damage-policy.h"
+
+/* Greedily merges consecutive boxes while the merged box wastes at most
+ * max_waste_percent of its area. covered[] holds the damaged area of each
+ * box, boxes and covered are rewritten in place. Returns the new count. */
+static int
+damage_merge_boxes(pixman_box32_t *boxes, uint64_t *covered, int n,
+		   int max_waste_percent)
+{
+	pixman_box32_t acc, merged;
+	uint64_t acc_covered, area;
+	int i, out = 0;
+
+	acc = boxes[0];
+	acc_covered = covered[0];
+
+	for (i = 1; i < n; i++) {
+		merged.x1 = MIN(acc.x1, boxes[i].x1);
+		merged.y1 = MIN(acc.y1, boxes[i].y1);
+		merged.x2 = MAX(acc.x2, boxes[i].x2);
+		merged.y2 = MAX(acc.y2, boxes[i].y2);
+		area = (uint64_t)(merged.x2 - merged.x1) *
+		       (merged.y2 - merged.y1);
+
+		if ((area - MIN(area, acc_covered + covered[i])) * 100 <=
+		    area * max_waste_percent) {
+			acc = merged;
+			acc_covered += covered[i];
+			continue;
+		}
+
+		boxes[out] = acc;
+		covered[out] = acc_covered;
+		out++;
+		acc = boxes[i];
+		acc_covered = covered[i];
+	}
+
+	boxes[out] = acc;
+	covered[out] = acc_covered;
+
+	return out + 1;
+}
+
+/** Simplify a damage region according to a policy
+ *
+ * The region only grows: the result always contains the original.
+ * Merging first goes along the bands pixman keeps rectangles in, then
+ * across the resulting strips.
+ */
+void
+weston_damage_policy_apply(struct weston_damage_policy *policy,
+			   pixman_region32_t *region)
+{
+	pixman_box32_t stack_boxes[64];
+	uint64_t stack_covered[ARRAY_LENGTH(stack_boxes)];
+	pixman_box32_t *rects, *boxes = stack_boxes;
+	uint64_t *covered = stack_covered;
+	pixman_box32_t extents;
+	uint64_t area, damaged = 0;
+	int i, n, out;
+
+	if (policy->max_rects <= 0 && policy->max_waste_percent <= 0)
+		return;
+
+	rects = pixman_region32_rectangles(region, &n);
+	if (n <= 1)
+		return;
+
+	policy->n_regions++;
+	policy->n_rects_in += n;
+
+	extents = *pixman_region32_extents(region);
+	area = (uint64_t)(extents.x2 - extents.x1) * (extents.y2 - extents.y1);
+	for (i = 0; i < n; i++)
+		damaged += (uint64_t)(rects[i].x2 - rects[i].x1) *
+			   (rects[i].y2 - rects[i].y1);
+
+	if ((area - damaged) * 100 <= area * policy->max_waste_percent) {
+		pixman_region32_reset(region, &extents);
+	} else if (policy->max_waste_percent > 0) {
+		if (n > (int) ARRAY_LENGTH(stack_boxes)) {
+			boxes = malloc(n * sizeof *boxes);
+			covered = malloc(n * sizeof *covered);
+		}
+
+		if (boxes && covered) {
+			for (i = 0; i < n; i++) {
+				boxes[i] = rects[i];
+				covered[i] = (uint64_t)(rects[i].x2 - rects[i].x1) *
+					     (rects[i].y2 - rects[i].y1);
+			}
+
+			out = damage_merge_boxes(boxes, covered, n,
+						 policy->max_waste_percent);
+			out = damage_merge_boxes(boxes, covered, out,
+						 policy->max_waste_percent);
+			if (out < n) {
+				pixman_region32_fini(region);
+				pixman_region32_init_rects(region, boxes, out);
+			}
+		} else {
+			pixman_region32_reset(region, &extents);
+		}
+
+		if (boxes != stack_boxes) {
+			free(boxes);
+			free(covered);
+		}
+	}
+
+	/* Overlapping merged boxes may be split again into bands. */
+	if (policy->max_rects > 0 &&
+	    pixman_region32_n_rects(region) > policy->max_rects)
+		pixman_region32_reset(region, &extents);
+
+	policy->n_rects_out += pixman_region32_n_rects(region);
+}
@@ -1203,6 +1203,8 @@ static void
 weston_pointer_reset_state(struct weston_pointer *pointer)
 {
 	pointer->button_count = 0;
+	pointer->motion_pending = false;
+	pointer->frame_pending = false;
 }
 
 static void
@@ -1425,6 +1427,9 @@ weston_pointer_clear_focus(struct weston_pointer *pointer)
 	weston_pointer_set_focus(pointer, NULL,
 				 wl_fixed_from_int(-1000000),
 				 wl_fixed_from_int(-1000000));
+
+	/* Let the next repaint find a new focus. */
+	weston_compositor_scene_changed(pointer->seat->compositor);
 }
 
 WL_EXPORT void
@@ -1670,8 +1675,10 @@ weston_pointer_clamp_for_output(struct weston_pointer *pointer,
 					output->height - 1);
 }
 
-WL_EXPORT void
-weston_pointer_clamp(struct weston_pointer *pointer, wl_fixed_t *fx, wl_fixed_t *fy)
+static void
+weston_pointer_clamp_from(struct weston_pointer *pointer,
+			  wl_fixed_t old_fx, wl_fixed_t old_fy,
+			  wl_fixed_t *fx, wl_fixed_t *fy)
 {
 	struct weston_compositor *ec = pointer->seat->compositor;
 	struct weston_output *output, *prev = NULL;
@@ -1679,8 +1686,8 @@ weston_pointer_clamp(struct weston_pointer *pointer, wl_fixed_t *fx, wl_fixed_t
 
 	x = wl_fixed_to_int(*fx);
 	y = wl_fixed_to_int(*fy);
-	old_x = wl_fixed_to_int(pointer->x);
-	old_y = wl_fixed_to_int(pointer->y);
+	old_x = wl_fixed_to_int(old_fx);
+	old_y = wl_fixed_to_int(old_fy);
 
 	wl_list_for_each(output, &ec->output_list, link) {
 		if (pointer->seat->output && pointer->seat->output != output)
@@ -1700,6 +1707,139 @@ weston_pointer_clamp(struct weston_pointer *pointer, wl_fixed_t *fx, wl_fixed_t
 		weston_pointer_clamp_for_output(pointer, prev, fx, fy);
 }
 
+WL_EXPORT void
+weston_pointer_clamp(struct weston_pointer *pointer, wl_fixed_t *fx, wl_fixed_t *fy)
+{
+	weston_pointer_clamp_from(pointer, pointer->x, pointer->y, fx, fy);
+}
+
+/** Get the position the pointer will have after the coalesced motion
+ *
+ * \param pointer The pointer.
+ * \param x Returns the global x coordinate.
+ * \param y Returns the global y coordinate.
+ *
+ * This is weston_pointer::x and y, unless some motion is pending, see
+ * weston_compositor::coalesce_pointer_motion.
+ */
+WL_EXPORT void
+weston_pointer_get_pending_position(struct weston_pointer *pointer,
+				    wl_fixed_t *x, wl_fixed_t *y)
+{
+	if (pointer->motion_pending) {
+		*x = wl_fixed_from_double(pointer->pending_motion.x);
+		*y = wl_fixed_from_double(pointer->pending_motion.y);
+	} else {
+		*x = pointer->x;
+		*y = pointer->y;
+	}
+}
+
+/* Delivers the motion coalesced on the pointer, followed by the frame
+ * that came with it, if any. */
+static void
+weston_pointer_flush_motion(struct weston_pointer *pointer)
+{
+	struct weston_pointer_motion_event event;
+	struct timespec time;
+	bool frame;
+
+	if (!pointer->motion_pending)
+		return;
+
+	event = pointer->pending_motion;
+	time = pointer->pending_time;
+	frame = pointer->frame_pending;
+	pointer->motion_pending = false;
+	pointer->frame_pending = false;
+
+	pointer->grab->interface->motion(pointer->grab, &time, &event);
+	if (frame)
+		pointer->grab->interface->frame(pointer->grab);
+}
+
+/** Deliver the pointer motion coalesced since the last repaint
+ *
+ * \param compositor The compositor.
+ *
+ * Called at the start of every repaint cycle, so that each output frame
+ * costs at most one pick and one wl_pointer.motion per seat.
+ */
+void
+weston_compositor_flush_pointer_motion(struct weston_compositor *compositor)
+{
+	struct weston_seat *seat;
+
+	wl_list_for_each(seat, &compositor->seat_list, link) {
+		if (seat->pointer_state)
+			weston_pointer_flush_motion(seat->pointer_state);
+	}
+}
+
+/* Adds a relative motion event to the one pending on the pointer, and
+ * makes sure a repaint will deliver it. The position is clamped event by
+ * event like weston_pointer_move() does, and the deltas are summed, so
+ * relative-pointer clients receive the same total motion, accelerated
+ * or not. Returns false if the event has to be delivered right away. */
+static bool
+weston_pointer_coalesce_motion(struct weston_pointer *pointer,
+			       const struct timespec *time,
+			       struct weston_pointer_motion_event *event)
+{
+	struct weston_compositor *ec = pointer->seat->compositor;
+	struct weston_pointer_motion_event *pending = &pointer->pending_motion;
+	struct weston_output *output, *target = NULL;
+	double dx, dy, dx_unaccel, dy_unaccel;
+	wl_fixed_t old_x, old_y, x, y;
+
+	if (ec->state != WESTON_COMPOSITOR_ACTIVE ||
+	    !(event->mask & WESTON_POINTER_MOTION_REL) ||
+	    event->mask & WESTON_POINTER_MOTION_ABS)
+		return false;
+
+	weston_pointer_get_pending_position(pointer, &old_x, &old_y);
+	x = old_x + wl_fixed_from_double(event->dx);
+	y = old_y + wl_fixed_from_double(event->dy);
+	weston_pointer_clamp_from(pointer, old_x, old_y, &x, &y);
+
+	/* Without an output to repaint, nothing would deliver the motion. */
+	wl_list_for_each(output, &ec->output_list, link) {
+		if (pixman_region32_contains_point(&output->region,
+						   wl_fixed_to_int(x),
+						   wl_fixed_to_int(y), NULL)) {
+			target = output;
+			break;
+		}
+	}
+	if (!target)
+		return false;
+
+	weston_pointer_motion_to_rel(pointer, event, &dx, &dy,
+				     &dx_unaccel, &dy_unaccel);
+
+	if (!pointer->motion_pending) {
+		*pending = (struct weston_pointer_motion_event) {
+			.mask = WESTON_POINTER_MOTION_ABS |
+				WESTON_POINTER_MOTION_REL |
+				WESTON_POINTER_MOTION_REL_UNACCEL,
+		};
+		pointer->motion_pending = true;
+	}
+
+	pending->time = event->time;
+	pending->x = wl_fixed_to_double(x);
+	pending->y = wl_fixed_to_double(y);
+	pending->dx += dx;
+	pending->dy += dy;
+	pending->dx_unaccel += dx_unaccel;
+	pending->dy_unaccel += dy_unaccel;
+	pointer->pending_time = *time;
+
+	weston_output_schedule_repaint(target);
+
+	return true;
+}
+
 static void
 weston_pointer_move_to(struct weston_pointer *pointer,
 		       wl_fixed_t x, wl_fixed_t y)
@@ -1788,6 +1928,12 @@ notify_motion(struct weston_seat *seat,
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
 	weston_compositor_wake(ec);
+
+	if (ec->coalesce_pointer_motion &&
+	    weston_pointer_coalesce_motion(pointer, time, event))
+		return;
+
+	weston_pointer_flush_motion(pointer);
 	pointer->grab->interface->motion(pointer->grab, time, event);
 }
 
@@ -1843,6 +1989,7 @@ notify_motion_absolute(struct weston_seat *seat, const struct timespec *time,
 		.y = y,
 	};
 
+	weston_pointer_flush_motion(pointer);
 	pointer->grab->interface->motion(pointer->grab, time, &event);
 }
 
@@ -1882,6 +2029,8 @@ notify_button(struct weston_seat *seat, const struct timespec *time,
 	struct weston_compositor *compositor = seat->compositor;
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
+	weston_pointer_flush_motion(pointer);
+
 	if (state == WL_POINTER_BUTTON_STATE_PRESSED) {
 		weston_compositor_idle_inhibit(compositor);
 		if (pointer->button_count == 0) {
@@ -1914,6 +2063,7 @@ notify_axis(struct weston_seat *seat, const struct timespec *time,
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
 	weston_compositor_wake(compositor);
+	weston_pointer_flush_motion(pointer);
 
 	if (weston_compositor_run_axis_binding(compositor, pointer,
 					       time, event))
@@ -1929,6 +2079,7 @@ notify_axis_source(struct weston_seat *seat, uint32_t source)
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
 	weston_compositor_wake(compositor);
+	weston_pointer_flush_motion(pointer);
 
 	pointer->grab->interface->axis_source(pointer->grab, source);
 }
@@ -1941,6 +2092,12 @@ notify_pointer_frame(struct weston_seat *seat)
 
 	weston_compositor_wake(compositor);
 
+	/* The frame goes out with the motion it terminates. */
+	if (pointer->motion_pending) {
+		pointer->frame_pending = true;
+		return;
+	}
+
 	pointer->grab->interface->frame(pointer->grab);
 }
 
@@ -2249,6 +2406,7 @@ notify_pointer_focus(struct weston_seat *seat, struct weston_output *output,
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 
 	if (output) {
+		weston_pointer_flush_motion(pointer);
 		weston_pointer_move_to(pointer,
 				       wl_fixed_from_double(x),
 				       wl_fixed_from_double(y));
@@ -3338,8 +3496,10 @@ weston_seat_init_pointer(struct weston_seat *seat)
 
 	if (seat->pointer_state) {
 		seat->pointer_device_count += 1;
-		if (seat->pointer_device_count == 1)
+		if (seat->pointer_device_count == 1) {
 			seat_send_updated_caps(seat);
+			weston_compositor_scene_changed(seat->compositor);
+		}
 		return;
 	}
 
@@ -3352,6 +3512,7 @@ weston_seat_init_pointer(struct weston_seat *seat)
 	pointer->seat = seat;
 
 	seat_send_updated_caps(seat);
+	weston_compositor_scene_changed(seat->compositor);
 }
 
 WL_EXPORT void
@@ -150,9 +150,18 @@ weston_compositor_shutdown(struct weston_compositor *ec);
 void
 weston_compositor_xkb_destroy(struct weston_compositor *ec);
 
+int
+weston_tearing_control_setup(struct weston_compositor *compositor);
+
 int
 weston_input_init(struct weston_compositor *compositor);
 
+void
+weston_compositor_flush_pointer_motion(struct weston_compositor *compositor);
+
+void
+weston_compositor_scene_changed(struct weston_compositor *compositor);
+
 /* weston_output */
 
 void
@@ -218,6 +227,9 @@ void
 weston_pointer_clamp(struct weston_pointer *pointer,
 		     wl_fixed_t *fx, wl_fixed_t *fy);
 void
+weston_pointer_get_pending_position(struct weston_pointer *pointer,
+				    wl_fixed_t *x, wl_fixed_t *y);
+void
 weston_pointer_set_default_grab(struct weston_pointer *pointer,
 			        const struct weston_pointer_grab_interface *interface);
 
@@ -288,6 +300,14 @@ weston_view_to_global_fixed(struct weston_view *view,
 void
 weston_view_from_global_float(struct weston_view *view,
 			      float x, float y, float *vx, float *vy);
+void
+weston_view_to_global_points(struct weston_view *view,
+			     const float *sx, const float *sy,
+			     float *x, float *y, int n);
+void
+weston_view_from_global_points(struct weston_view *view,
+			       const float *x, const float *y,
+			       float *vx, float *vy, int n);
 bool
 weston_view_is_opaque(struct weston_view *ev, pixman_region32_t *region);
 
@@ -392,6 +412,22 @@ const uint64_t *
 weston_drm_format_get_modifiers(const struct weston_drm_format *format,
 				unsigned int *count_out);
 
+/** Exchange the contents of two regions
+ *
+ * pixman allocates a new rectangle array whenever an operation is done in
+ * place on a region of more than one rectangle. Computing into a scratch
+ * region kept across repaints and swapping it with the destination lets
+ * both rectangle arrays be reused instead.
+ */
+static inline void
+weston_region_swap(pixman_region32_t *a, pixman_region32_t *b)
+{
+	pixman_region32_t tmp = *a;
+
+	*a = *b;
+	*b = tmp;
+}
+
 /**
  * paint node
  *
@@ -419,6 +455,10 @@ struct weston_paint_node {
 
 	struct weston_surface_color_transform surf_xform;
 	bool surf_xform_valid;
+
+	/* Damage of the view in global coordinates, only meaningful while
+	 * the output accumulates damage; kept to reuse its rectangles. */
+	pixman_region32_t damage;
 };
 
 struct weston_paint_node *
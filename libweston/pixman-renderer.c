@@ -43,6 +43,14 @@ struct pixman_output_state {
 	pixman_image_t *shadow_image;
 	pixman_image_t *hw_buffer;
 	pixman_region32_t *hw_extra_damage;
+
+	/* Temporaries of the repaint, kept across repaints so that their
+	 * rectangle arrays are reused. */
+	pixman_region32_t hw_damage;
+	pixman_region32_t repaint;
+	pixman_region32_t repaint_output;
+	pixman_region32_t surface_blend;
+	pixman_region32_t scratch;
 };
 
 struct pixman_surface_state {
@@ -185,6 +193,7 @@ static void
 region_intersect_only_translation(pixman_region32_t *result_global,
 				  pixman_region32_t *global,
 				  pixman_region32_t *surf,
+				  pixman_region32_t *scratch,
 				  struct weston_view *view)
 {
 	float view_x, view_y;
@@ -192,11 +201,11 @@ region_intersect_only_translation(pixman_region32_t *result_global,
 	assert(view_transformation_is_translation(view));
 
 	/* Convert from surface to global coordinates */
-	pixman_region32_copy(result_global, surf);
+	pixman_region32_copy(scratch, surf);
 	weston_view_to_global_float(view, 0, 0, &view_x, &view_y);
-	pixman_region32_translate(result_global, (int)view_x, (int)view_y);
+	pixman_region32_translate(scratch, (int)view_x, (int)view_y);
 
-	pixman_region32_intersect(result_global, result_global, global);
+	pixman_region32_intersect(result_global, scratch, global);
 }
 
 static void
@@ -390,49 +399,51 @@ static void
 draw_view_translated(struct weston_view *view, struct weston_output *output,
 		     pixman_region32_t *repaint_global)
 {
+	struct pixman_output_state *po = get_output_state(output);
 	struct weston_surface *surface = view->surface;
 	/* non-opaque region in surface coordinates: */
-	pixman_region32_t surface_blend;
+	pixman_region32_t *surface_blend = &po->surface_blend;
 	/* region to be painted in output coordinates: */
-	pixman_region32_t repaint_output;
-
-	pixman_region32_init(&repaint_output);
+	pixman_region32_t *repaint_output = &po->repaint_output;
+	pixman_region32_t surface_rect;
 
 	/* Blended region is whole surface minus opaque region,
 	 * unless surface alpha forces us to blend all.
 	 */
-	pixman_region32_init_rect(&surface_blend, 0, 0,
+	pixman_region32_init_rect(&surface_rect, 0, 0,
 				  surface->width, surface->height);
 
 	if (!(view->alpha < 1.0)) {
-		pixman_region32_subtract(&surface_blend, &surface_blend,
+		pixman_region32_subtract(surface_blend, &surface_rect,
 					 &surface->opaque);
 
 		if (pixman_region32_not_empty(&surface->opaque)) {
-			region_intersect_only_translation(&repaint_output,
+			region_intersect_only_translation(repaint_output,
 							  repaint_global,
 							  &surface->opaque,
-							  view);
+							  &po->scratch, view);
 			weston_output_region_from_global(output,
-							 &repaint_output);
+							 repaint_output);
 
-			repaint_region(view, output, &repaint_output, NULL,
+			repaint_region(view, output, repaint_output, NULL,
 				       PIXMAN_OP_SRC);
 		}
+	} else {
+		pixman_region32_copy(surface_blend, &surface_rect);
 	}
 
-	if (pixman_region32_not_empty(&surface_blend)) {
-		region_intersect_only_translation(&repaint_output,
+	if (pixman_region32_not_empty(surface_blend)) {
+		region_intersect_only_translation(repaint_output,
 						  repaint_global,
-						  &surface_blend, view);
-		weston_output_region_from_global(output, &repaint_output);
+						  surface_blend,
+						  &po->scratch, view);
+		weston_output_region_from_global(output, repaint_output);
 
-		repaint_region(view, output, &repaint_output, NULL,
+		repaint_region(view, output, repaint_output, NULL,
 			       PIXMAN_OP_OVER);
 	}
 
-	pixman_region32_fini(&surface_blend);
-	pixman_region32_fini(&repaint_output);
+	pixman_region32_fini(&surface_rect);
 }
 
 static void
@@ -440,10 +451,11 @@ draw_view_source_clipped(struct weston_view *view,
 			 struct weston_output *output,
 			 pixman_region32_t *repaint_global)
 {
+	struct pixman_output_state *po = get_output_state(output);
 	struct weston_surface *surface = view->surface;
+	pixman_region32_t *repaint_output = &po->repaint_output;
 	pixman_region32_t surf_region;
 	pixman_region32_t buffer_region;
-	pixman_region32_t repaint_output;
 
 	/* Do not bother separating the opaque region from non-opaque.
 	 * Source clipping requires PIXMAN_OP_OVER in all cases, so painting
@@ -459,14 +471,12 @@ draw_view_source_clipped(struct weston_view *view,
 	pixman_region32_init(&buffer_region);
 	weston_surface_to_buffer_region(surface, &surf_region, &buffer_region);
 
-	pixman_region32_init(&repaint_output);
-	pixman_region32_copy(&repaint_output, repaint_global);
-	weston_output_region_from_global(output, &repaint_output);
+	pixman_region32_copy(repaint_output, repaint_global);
+	weston_output_region_from_global(output, repaint_output);
 
-	repaint_region(view, output, &repaint_output, &buffer_region,
+	repaint_region(view, output, repaint_output, &buffer_region,
 		       PIXMAN_OP_OVER);
 
-	pixman_region32_fini(&repaint_output);
 	pixman_region32_fini(&buffer_region);
 	pixman_region32_fini(&surf_region);
 }
@@ -476,8 +486,9 @@ draw_paint_node(struct weston_paint_node *pnode,
 		pixman_region32_t *damage /* in global coordinates */)
 {
 	struct pixman_surface_state *ps = get_surface_state(pnode->surface);
+	struct pixman_output_state *po = get_output_state(pnode->output);
 	/* repaint bounding region in global coordinates: */
-	pixman_region32_t repaint;
+	pixman_region32_t *repaint = &po->repaint;
 
 	if (!pnode->surf_xform_valid)
 		return;
@@ -488,13 +499,12 @@ draw_paint_node(struct weston_paint_node *pnode,
 	if (!ps->image)
 		return;
 
-	pixman_region32_init(&repaint);
-	pixman_region32_intersect(&repaint,
+	pixman_region32_intersect(&po->scratch,
 				  &pnode->view->transform.boundingbox, damage);
-	pixman_region32_subtract(&repaint, &repaint, &pnode->view->clip);
+	pixman_region32_subtract(repaint, &po->scratch, &pnode->view->clip);
 
-	if (!pixman_region32_not_empty(&repaint))
-		goto out;
+	if (!pixman_region32_not_empty(repaint))
+		return;
 
 	if (view_transformation_is_translation(pnode->view)) {
 		/* The simple case: The surface regions opaque, non-opaque,
@@ -504,7 +514,7 @@ draw_paint_node(struct weston_paint_node *pnode,
 		 * Also the boundingbox is accurate rather than an
 		 * approximation.
 		 */
-		draw_view_translated(pnode->view, pnode->output, &repaint);
+		draw_view_translated(pnode->view, pnode->output, repaint);
 	} else {
 		/* The complex case: the view transformation does not allow
 		 * converting opaque etc. regions into global coordinate space.
@@ -513,11 +523,8 @@ draw_paint_node(struct weston_paint_node *pnode,
 		 * to be used whole. Source clipping does not work with
 		 * PIXMAN_OP_SRC.
 		 */
-		draw_view_source_clipped(pnode->view, pnode->output, &repaint);
+		draw_view_source_clipped(pnode->view, pnode->output, repaint);
 	}
-
-out:
-	pixman_region32_fini(&repaint);
 }
 static void
 repaint_surfaces(struct weston_output *output, pixman_region32_t *damage)
@@ -536,15 +543,13 @@ static void
 copy_to_hw_buffer(struct weston_output *output, pixman_region32_t *region)
 {
 	struct pixman_output_state *po = get_output_state(output);
-	pixman_region32_t output_region;
+	pixman_region32_t *output_region = &po->repaint_output;
 
-	pixman_region32_init(&output_region);
-	pixman_region32_copy(&output_region, region);
+	pixman_region32_copy(output_region, region);
 
-	weston_output_region_from_global(output, &output_region);
+	weston_output_region_from_global(output, output_region);
 
-	pixman_image_set_clip_region32 (po->hw_buffer, &output_region);
-	pixman_region32_fini(&output_region);
+	pixman_image_set_clip_region32 (po->hw_buffer, output_region);
 
 	pixman_image_composite32(PIXMAN_OP_SRC,
 				 po->shadow_image, /* src */
@@ -564,7 +569,7 @@ pixman_renderer_repaint_output(struct weston_output *output,
 			       pixman_region32_t *output_damage)
 {
 	struct pixman_output_state *po = get_output_state(output);
-	pixman_region32_t hw_damage;
+	pixman_region32_t *hw_damage = &po->hw_damage;
 
 	assert(output->from_blend_to_output_by_backend ||
 	       output->from_blend_to_output == NULL);
@@ -574,22 +579,20 @@ pixman_renderer_repaint_output(struct weston_output *output,
  		return;
 	}
 
-	pixman_region32_init(&hw_damage);
 	if (po->hw_extra_damage) {
-		pixman_region32_union(&hw_damage,
+		pixman_region32_union(hw_damage,
 				      po->hw_extra_damage, output_damage);
 		po->hw_extra_damage = NULL;
 	} else {
-		pixman_region32_copy(&hw_damage, output_damage);
+		pixman_region32_copy(hw_damage, output_damage);
 	}
 
 	if (po->shadow_image) {
 		repaint_surfaces(output, output_damage);
-		copy_to_hw_buffer(output, &hw_damage);
+		copy_to_hw_buffer(output, hw_damage);
 	} else {
-		repaint_surfaces(output, &hw_damage);
+		repaint_surfaces(output, hw_damage);
 	}
-	pixman_region32_fini(&hw_damage);
 
 	wl_signal_emit(&output->frame_signal, output_damage);
 
@@ -932,6 +935,12 @@ pixman_renderer_output_create(struct weston_output *output,
 	if (po == NULL)
 		return -1;
 
+	pixman_region32_init(&po->hw_damage);
+	pixman_region32_init(&po->repaint);
+	pixman_region32_init(&po->repaint_output);
+	pixman_region32_init(&po->surface_blend);
+	pixman_region32_init(&po->scratch);
+
 	if (options->use_shadow) {
 		/* set shadow image transformation */
 		w = output->current_mode->width;
@@ -977,5 +986,11 @@ pixman_renderer_output_destroy(struct weston_output *output)
 	po->shadow_image = NULL;
 	po->hw_buffer = NULL;
 
+	pixman_region32_fini(&po->hw_damage);
+	pixman_region32_fini(&po->repaint);
+	pixman_region32_fini(&po->repaint_output);
+	pixman_region32_fini(&po->surface_blend);
+	pixman_region32_fini(&po->scratch);
+
 	free(po);
 }
@@ -103,6 +103,16 @@ struct gl_output_state {
 	struct wl_list timeline_render_point_list;
 
 	struct gl_fbo_texture shadow;
+
+	/* Temporaries of the repaint, kept across repaints so that their
+	 * rectangle arrays are reused. */
+	pixman_region32_t previous_damage;
+	pixman_region32_t total_damage;
+	pixman_region32_t repaint;
+	pixman_region32_t surface_opaque;
+	pixman_region32_t surface_blend;
+	pixman_region32_t scratch;
+	struct wl_array egl_rects; /* EGLint */
 };
 
 enum buffer_type {
@@ -438,81 +448,6 @@ dmabuf_image_destroy(struct dmabuf_image *image)
 	free(image);
 }
 
-#define max(a, b) (((a) > (b)) ? (a) : (b))
-#define min(a, b) (((a) > (b)) ? (b) : (a))
-
-/*
- * Compute the boundary vertices of the intersection of the global coordinate
- * aligned rectangle 'rect', and an arbitrary quadrilateral produced from
- * 'surf_rect' when transformed from surface coordinates into global coordinates.
- * The vertices are written to 'ex' and 'ey', and the return value is the
- * number of vertices. Vertices are produced in clockwise winding order.
- * Guarantees to produce either zero vertices, or 3-8 vertices with non-zero
- * polygon area.
- */
-static int
-calculate_edges(struct weston_view *ev, pixman_box32_t *rect,
-		pixman_box32_t *surf_rect, GLfloat *ex, GLfloat *ey)
-{
-
-	struct clip_context ctx;
-	int i, n;
-	GLfloat min_x, max_x, min_y, max_y;
-	struct polygon8 surf = {
-		{ surf_rect->x1, surf_rect->x2, surf_rect->x2, surf_rect->x1 },
-		{ surf_rect->y1, surf_rect->y1, surf_rect->y2, surf_rect->y2 },
-		4
-	};
-
-	ctx.clip.x1 = rect->x1;
-	ctx.clip.y1 = rect->y1;
-	ctx.clip.x2 = rect->x2;
-	ctx.clip.y2 = rect->y2;
-
-	/* transform surface to screen space: */
-	for (i = 0; i < surf.n; i++)
-		weston_view_to_global_float(ev, surf.x[i], surf.y[i],
-					    &surf.x[i], &surf.y[i]);
-
-	/* find bounding box: */
-	min_x = max_x = surf.x[0];
-	min_y = max_y = surf.y[0];
-
-	for (i = 1; i < surf.n; i++) {
-		min_x = min(min_x, surf.x[i]);
-		max_x = max(max_x, surf.x[i]);
-		min_y = min(min_y, surf.y[i]);
-		max_y = max(max_y, surf.y[i]);
-	}
-
-	/* First, simple bounding box check to discard early transformed
-	 * surface rects that do not intersect with the clip region:
-	 */
-	if ((min_x >= ctx.clip.x2) || (max_x <= ctx.clip.x1) ||
-	    (min_y >= ctx.clip.y2) || (max_y <= ctx.clip.y1))
-		return 0;
-
-	/* Simple case, bounding box edges are parallel to surface edges,
-	 * there will be only four edges.  We just need to clip the surface
-	 * vertices to the clip rect bounds:
-	 */
-	if (!ev->transform.enabled)
-		return clip_simple(&ctx, &surf, ex, ey);
-
-	/* Transformed case: use a general polygon clipping algorithm to
-	 * clip the surface rectangle with each side of 'rect'.
-	 * The algorithm is Sutherland-Hodgman, as explained in
-	 * http://www.codeguru.com/cpp/misc/misc/graphics/article.php/c8965/Polygon-Clipping.htm
-	 * but without looking at any of that code.
-	 */
-	n = clip_transformed(&ctx, &surf, ex, ey);
-
-	if (n < 3)
-		return 0;
-
-	return n;
-}
-
 static bool
 merge_down(pixman_box32_t *a, pixman_box32_t *b, pixman_box32_t *merge)
 {
@@ -573,8 +508,11 @@ texture_region(struct weston_view *ev,
 	unsigned int *vtxcnt, nvtx = 0;
 	pixman_box32_t *rects, *surf_rects;
 	pixman_box32_t *raw_rects;
-	int i, j, k, nrects, nsurf, raw_nrects;
+	int i, j, k, q, nrects, nsurf, raw_nrects, nquads;
 	bool used_band_compression;
+	/* corners of a batch of surface rects, in screen space */
+	GLfloat qx[CLIP_QUADS_MAX * 4], qy[CLIP_QUADS_MAX * 4];
+	struct polygon8 clipped[CLIP_QUADS_MAX];
 	raw_rects = pixman_region32_rectangles(region, &raw_nrects);
 	surf_rects = pixman_region32_rectangles(surf_region, &nsurf);
 
@@ -595,52 +533,85 @@ texture_region(struct weston_view *ev,
 	inv_width = 1.0 / gs->pitch;
         inv_height = 1.0 / gs->height;
 
-	for (i = 0; i < nrects; i++) {
-		pixman_box32_t *rect = &rects[i];
-		for (j = 0; j < nsurf; j++) {
-			pixman_box32_t *surf_rect = &surf_rects[j];
-			GLfloat sx, sy, bx, by;
-			GLfloat ex[8], ey[8];          /* edge points in screen space */
-			int n;
-
-			/* The transformed surface, after clipping to the clip region,
-			 * can have as many as eight sides, emitted as a triangle-fan.
-			 * The first vertex in the triangle fan can be chosen arbitrarily,
-			 * since the area is guaranteed to be convex.
+	/* The surface rects are transformed to screen space once per
+	 * batch, rather than once for every clip rect they meet.
+	 */
+	for (j = 0; j < nsurf; j += nquads) {
+		nquads = MIN(nsurf - j, CLIP_QUADS_MAX);
+
+		for (q = 0; q < nquads; q++) {
+			pixman_box32_t *surf_rect = &surf_rects[j + q];
+
+			qx[4 * q + 0] = surf_rect->x1;
+			qx[4 * q + 1] = surf_rect->x2;
+			qx[4 * q + 2] = surf_rect->x2;
+			qx[4 * q + 3] = surf_rect->x1;
+			qy[4 * q + 0] = surf_rect->y1;
+			qy[4 * q + 1] = surf_rect->y1;
+			qy[4 * q + 2] = surf_rect->y2;
+			qy[4 * q + 3] = surf_rect->y2;
+		}
+		weston_view_to_global_points(ev, qx, qy, qx, qy, 4 * nquads);
+
+		for (i = 0; i < nrects; i++) {
+			struct clip_context ctx;
+
+			ctx.clip.x1 = rects[i].x1;
+			ctx.clip.y1 = rects[i].y1;
+			ctx.clip.x2 = rects[i].x2;
+			ctx.clip.y2 = rects[i].y2;
+
+			/* The transformed surface, after clipping to the clip
+			 * region, can have as many as eight sides, emitted as
+			 * a triangle-fan. The first vertex in the triangle fan
+			 * can be chosen arbitrarily, since the area is
+			 * guaranteed to be convex.
 			 *
-			 * If a corner of the transformed surface falls outside of the
-			 * clip region, instead of emitting one vertex for the corner
-			 * of the surface, up to two are emitted for two corresponding
-			 * intersection point(s) between the surface and the clip region.
+			 * If a corner of the transformed surface falls outside
+			 * of the clip region, instead of emitting one vertex
+			 * for the corner of the surface, up to two are emitted
+			 * for two corresponding intersection point(s) between
+			 * the surface and the clip region.
 			 *
-			 * To do this, we first calculate the (up to eight) points that
-			 * form the intersection of the clip rect and the transformed
-			 * surface.
+			 * Without a transformation, the surface rects are
+			 * parallel to the clip rect, and clipping them only
+			 * clamps their corners.
 			 */
-			n = calculate_edges(ev, rect, surf_rect, ex, ey);
-			if (n < 3)
+			if (clip_quads(&ctx, qx, qy, nquads,
+				       ev->transform.enabled, clipped) == 0)
 				continue;
 
-			/* emit edge points: */
-			for (k = 0; k < n; k++) {
-				weston_view_from_global_float(ev, ex[k], ey[k],
-							      &sx, &sy);
-				/* position: */
-				*(v++) = ex[k];
-				*(v++) = ey[k];
-				/* texcoord: */
-				weston_surface_to_buffer_float(ev->surface,
-							       sx, sy,
-							       &bx, &by);
-				*(v++) = bx * inv_width;
-				if (gs->y_inverted) {
-					*(v++) = by * inv_height;
-				} else {
-					*(v++) = (gs->height - by) * inv_height;
+			for (q = 0; q < nquads; q++) {
+				GLfloat *ex = clipped[q].x, *ey = clipped[q].y;
+				GLfloat sx[8], sy[8];
+				int n = clipped[q].n;
+				GLfloat bx, by;
+
+				if (n == 0)
+					continue;
+
+				weston_view_from_global_points(ev, ex, ey,
+							       sx, sy, n);
+
+				/* emit edge points: */
+				for (k = 0; k < n; k++) {
+					/* position: */
+					*(v++) = ex[k];
+					*(v++) = ey[k];
+					/* texcoord: */
+					weston_surface_to_buffer_float(ev->surface,
+								       sx[k], sy[k],
+								       &bx, &by);
+					*(v++) = bx * inv_width;
+					if (gs->y_inverted) {
+						*(v++) = by * inv_height;
+					} else {
+						*(v++) = (gs->height - by) * inv_height;
+					}
 				}
-			}
 
-			vtxcnt[nvtx++] = n;
+				vtxcnt[nvtx++] = n;
+			}
 		}
 	}
 
@@ -1040,12 +1011,14 @@ draw_paint_node(struct weston_paint_node *pnode,
 {
 	struct gl_renderer *gr = get_renderer(pnode->surface->compositor);
 	struct gl_surface_state *gs = get_surface_state(pnode->surface);
+	struct gl_output_state *go = get_output_state(pnode->output);
 	/* repaint bounding region in global coordinates: */
-	pixman_region32_t repaint;
+	pixman_region32_t *repaint = &go->repaint;
 	/* opaque region in surface coordinates: */
-	pixman_region32_t surface_opaque;
+	pixman_region32_t *surface_opaque = &go->surface_opaque;
 	/* non-opaque region in surface coordinates: */
-	pixman_region32_t surface_blend;
+	pixman_region32_t *surface_blend = &go->surface_blend;
+	pixman_region32_t surface_rect;
 	GLint filter;
 	struct gl_shader_config sconf;
 
@@ -1055,16 +1028,15 @@ draw_paint_node(struct weston_paint_node *pnode,
 	if (gs->shader_variant == SHADER_VARIANT_NONE && !gs->direct_display)
 		return;
 
-	pixman_region32_init(&repaint);
-	pixman_region32_intersect(&repaint,
+	pixman_region32_intersect(&go->scratch,
 				  &pnode->view->transform.boundingbox, damage);
-	pixman_region32_subtract(&repaint, &repaint, &pnode->view->clip);
+	pixman_region32_subtract(repaint, &go->scratch, &pnode->view->clip);
 
-	if (!pixman_region32_not_empty(&repaint))
-		goto out;
+	if (!pixman_region32_not_empty(repaint))
+		return;
 
 	if (ensure_surface_buffer_is_ready(gr, gs) < 0)
-		goto out;
+		return;
 
 	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -1075,29 +1047,29 @@ draw_paint_node(struct weston_paint_node *pnode,
 		filter = GL_NEAREST;
 
 	if (!gl_shader_config_init_for_paint_node(&sconf, pnode, filter))
-		goto out;
+		return;
 
 	/* blended region is whole surface minus opaque region: */
-	pixman_region32_init_rect(&surface_blend, 0, 0,
+	pixman_region32_init_rect(&surface_rect, 0, 0,
 				  pnode->surface->width, pnode->surface->height);
 	if (pnode->view->geometry.scissor_enabled)
-		pixman_region32_intersect(&surface_blend, &surface_blend,
+		pixman_region32_intersect(&surface_rect, &surface_rect,
 					  &pnode->view->geometry.scissor);
-	pixman_region32_subtract(&surface_blend, &surface_blend,
+	pixman_region32_subtract(surface_blend, &surface_rect,
 				 &pnode->surface->opaque);
+	pixman_region32_fini(&surface_rect);
 
 	/* XXX: Should we be using ev->transform.opaque here? */
-	pixman_region32_init(&surface_opaque);
 	if (pnode->view->geometry.scissor_enabled)
-		pixman_region32_intersect(&surface_opaque,
+		pixman_region32_intersect(surface_opaque,
 					  &pnode->surface->opaque,
 					  &pnode->view->geometry.scissor);
 	else
-		pixman_region32_copy(&surface_opaque, &pnode->surface->opaque);
+		pixman_region32_copy(surface_opaque, &pnode->surface->opaque);
 
 	maybe_censor_override(&sconf, pnode->output, pnode->view);
 
-	if (pixman_region32_not_empty(&surface_opaque)) {
+	if (pixman_region32_not_empty(surface_opaque)) {
 		struct gl_shader_config alt = sconf;
 
 		if (alt.req.variant == SHADER_VARIANT_RGBA) {
@@ -1115,22 +1087,16 @@ draw_paint_node(struct weston_paint_node *pnode,
 			glDisable(GL_BLEND);
 
 		repaint_region(gr, pnode->view, pnode->output,
-			       &repaint, &surface_opaque, &alt);
+			       repaint, surface_opaque, &alt);
 		gs->used_in_output_repaint = true;
 	}
 
-	if (pixman_region32_not_empty(&surface_blend)) {
+	if (pixman_region32_not_empty(surface_blend)) {
 		glEnable(GL_BLEND);
 		repaint_region(gr, pnode->view, pnode->output,
-			       &repaint, &surface_blend, &sconf);
+			       repaint, surface_blend, &sconf);
 		gs->used_in_output_repaint = true;
 	}
-
-	pixman_region32_fini(&surface_blend);
-	pixman_region32_fini(&surface_opaque);
-
-out:
-	pixman_region32_fini(&repaint);
 }
 
 static void
@@ -1428,10 +1394,12 @@ output_get_damage(struct weston_output *output,
 			*border_damage |= BORDER_ALL_DIRTY;
 			pixman_region32_copy(buffer_damage, &output->region);
 		} else {
-			for (i = 0; i < buffer_age - 1; i++)
-				pixman_region32_union(buffer_damage,
+			for (i = 0; i < buffer_age - 1; i++) {
+				pixman_region32_union(&go->scratch,
 						      buffer_damage,
 						      &go->buffer_damage[(go->buffer_damage_index + i) % BUFFER_DAMAGE_COUNT]);
+				weston_region_swap(buffer_damage, &go->scratch);
+			}
 		}
 	}
 }
@@ -1467,7 +1435,8 @@ output_rotate_damage(struct weston_output *output,
  *
  * @param output The output whose co-ordinate space we are after
  * @param global_region The affected region in global co-ordinate space
- * @param[out] rects Y-inverted quads in {x,y,w,h} order; caller must free
+ * @param[out] rects Y-inverted quads in {x,y,w,h} order, owned by the
+ *                   output state until the next call
  * @param[out] nrects Number of quads (4x number of co-ordinates)
  */
 static void
@@ -1477,36 +1446,36 @@ pixman_region_to_egl_y_invert(struct weston_output *output,
 			      EGLint *nrects)
 {
 	struct gl_output_state *go = get_output_state(output);
-	pixman_region32_t transformed;
+	pixman_region32_t *transformed = &go->scratch;
 	struct pixman_box32 *box;
 	int buffer_height;
 	EGLint *d;
 	int i;
 
 	/* Translate from global to output co-ordinate space. */
-	pixman_region32_init(&transformed);
-	pixman_region32_copy(&transformed, global_region);
-	pixman_region32_translate(&transformed, -output->x, -output->y);
+	pixman_region32_copy(transformed, global_region);
+	pixman_region32_translate(transformed, -output->x, -output->y);
 	weston_transformed_region(output->width, output->height,
 				  output->transform,
 				  output->current_scale,
-				  &transformed, &transformed);
+				  transformed, transformed);
 
 	/* If we have borders drawn around the output, shift our output damage
 	 * to account for borders being drawn around the outside, adding any
 	 * damage resulting from borders being redrawn. */
 	if (output_has_borders(output)) {
-		pixman_region32_translate(&transformed,
+		pixman_region32_translate(transformed,
 					  go->borders[GL_RENDERER_BORDER_LEFT].width,
 					  go->borders[GL_RENDERER_BORDER_TOP].height);
 		output_get_border_damage(output, go->border_status,
-					 &transformed);
+					 transformed);
 	}
 
 	/* Convert from a Pixman region into {x,y,w,h} quads, flipping in the
 	 * Y axis to account for GL's lower-left-origin co-ordinate space. */
-	box = pixman_region32_rectangles(&transformed, nrects);
-	*rects = malloc(*nrects * 4 * sizeof(EGLint));
+	box = pixman_region32_rectangles(transformed, nrects);
+	go->egl_rects.size = 0;
+	*rects = wl_array_add(&go->egl_rects, *nrects * 4 * sizeof(EGLint));
 
 	buffer_height = go->borders[GL_RENDERER_BORDER_TOP].height +
 			output->current_mode->height +
@@ -1519,8 +1488,6 @@ pixman_region_to_egl_y_invert(struct weston_output *output,
 		*d++ = box[i].x2 - box[i].x1;
 		*d++ = box[i].y2 - box[i].y1;
 	}
-
-	pixman_region32_fini(&transformed);
 }
 
 static void
@@ -1617,9 +1584,9 @@ gl_renderer_repaint_output(struct weston_output *output,
 	EGLBoolean ret;
 	static int errored;
 	/* areas we've damaged since we last used this buffer */
-	pixman_region32_t previous_damage;
+	pixman_region32_t *previous_damage = &go->previous_damage;
 	/* total area we need to repaint this time */
-	pixman_region32_t total_damage;
+	pixman_region32_t *total_damage = &go->total_damage;
 	enum gl_border_status border_status = BORDER_STATUS_CLEAN;
 	struct weston_paint_node *pnode;
 
@@ -1689,18 +1656,17 @@ gl_renderer_repaint_output(struct weston_output *output,
 
 	/* previous_damage covers regions damaged in previous paints since we
 	 * last used this buffer */
-	pixman_region32_init(&previous_damage);
-	pixman_region32_init(&total_damage); /* total area to redraw */
+	pixman_region32_clear(previous_damage);
 
 	/* Update previous_damage using buffer_age (if available), and store
 	 * current damaged region for future use. */
-	output_get_damage(output, &previous_damage, &border_status);
+	output_get_damage(output, previous_damage, &border_status);
 	output_rotate_damage(output, output_damage, go->border_status);
 
 	/* Redraw both areas which have changed since we last used this buffer,
 	 * as well as the areas we now want to repaint, to make sure the
 	 * buffer is up to date. */
-	pixman_region32_union(&total_damage, &previous_damage, output_damage);
+	pixman_region32_union(total_damage, previous_damage, output_damage);
 	border_status |= go->border_status;
 
 	if (gr->has_egl_partial_update && !gr->fan_debug) {
@@ -1710,11 +1676,10 @@ gl_renderer_repaint_output(struct weston_output *output,
 		/* For partial_update, we need to pass the region which has
 		 * changed since we last rendered into this specific buffer;
 		 * this is total_damage. */
-		pixman_region_to_egl_y_invert(output, &total_damage,
+		pixman_region_to_egl_y_invert(output, total_damage,
 					      &egl_rects, &n_egl_rects);
 		gr->set_damage_region(gr->egl_display, go->egl_surface,
 				      egl_rects, n_egl_rects);
-		free(egl_rects);
 	}
 
 	if (shadow_exists(go)) {
@@ -1729,14 +1694,11 @@ gl_renderer_repaint_output(struct weston_output *output,
 			   go->borders[GL_RENDERER_BORDER_BOTTOM].height,
 			   output->current_mode->width,
 			   output->current_mode->height);
-		blit_shadow_to_output(output, &total_damage);
+		blit_shadow_to_output(output, total_damage);
 	} else {
-		repaint_views(output, &total_damage);
+		repaint_views(output, total_damage);
 	}
 
-	pixman_region32_fini(&total_damage);
-	pixman_region32_fini(&previous_damage);
-
 	draw_output_borders(output, border_status);
 
 	wl_signal_emit(&output->frame_signal, output_damage);
@@ -1755,7 +1717,6 @@ gl_renderer_repaint_output(struct weston_output *output,
 		ret = gr->swap_buffers_with_damage(gr->egl_display,
 						   go->egl_surface,
 						   egl_rects, n_egl_rects);
-		free(egl_rects);
 	} else {
 		ret = eglSwapBuffers(gr->egl_display, go->egl_surface);
 	}
@@ -3358,6 +3319,14 @@ gl_renderer_output_create(struct weston_output *output,
 	for (i = 0; i < BUFFER_DAMAGE_COUNT; i++)
 		pixman_region32_init(&go->buffer_damage[i]);
 
+	pixman_region32_init(&go->previous_damage);
+	pixman_region32_init(&go->total_damage);
+	pixman_region32_init(&go->repaint);
+	pixman_region32_init(&go->surface_opaque);
+	pixman_region32_init(&go->surface_blend);
+	pixman_region32_init(&go->scratch);
+	wl_array_init(&go->egl_rects);
+
 	wl_list_init(&go->timeline_render_point_list);
 
 	go->begin_render_sync = EGL_NO_SYNC_KHR;
@@ -3479,6 +3448,14 @@ gl_renderer_output_destroy(struct weston_output *output)
 	for (i = 0; i < 2; i++)
 		pixman_region32_fini(&go->buffer_damage[i]);
 
+	pixman_region32_fini(&go->previous_damage);
+	pixman_region32_fini(&go->total_damage);
+	pixman_region32_fini(&go->repaint);
+	pixman_region32_fini(&go->surface_opaque);
+	pixman_region32_fini(&go->surface_blend);
+	pixman_region32_fini(&go->scratch);
+	wl_array_release(&go->egl_rects);
+
 	if (shadow_exists(go))
 		gl_fbo_texture_fini(&go->shadow);
 
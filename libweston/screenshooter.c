@@ -27,6 +27,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <linux/input.h>
@@ -174,6 +175,61 @@ screenshooter_frame_notify(struct wl_listener *listener, void *data)
 	free(l);
 }
 
+static void
+screenshooter_read_from_renderer(struct screenshooter_frame_listener *l)
+{
+	struct weston_output *output = l->output;
+
+	l->listener.notify = screenshooter_frame_notify;
+	wl_signal_add(&output->frame_signal, &l->listener);
+	weston_output_disable_planes_incr(output);
+	weston_output_schedule_repaint(output);
+}
+
+static void
+screenshooter_capture_done(void *data, pixman_image_t *image)
+{
+	struct screenshooter_frame_listener *l = data;
+	struct weston_output *output = l->output;
+	int32_t width = output->current_mode->width;
+	int32_t height = output->current_mode->height;
+	int32_t src_stride, dst_stride;
+	uint32_t *src, *dst;
+	int32_t x, y;
+
+	if (!image) {
+		if (output->destroying) {
+			l->done(l->data, WESTON_SCREENSHOOTER_NO_MEMORY);
+			free(l);
+		} else {
+			screenshooter_read_from_renderer(l);
+		}
+		return;
+	}
+
+	src_stride = pixman_image_get_stride(image) / 4;
+	dst_stride = wl_shm_buffer_get_stride(l->buffer->shm_buffer) / 4;
+	width = MIN(width, pixman_image_get_width(image));
+	height = MIN(height, pixman_image_get_height(image));
+
+	wl_shm_buffer_begin_access(l->buffer->shm_buffer);
+
+	src = pixman_image_get_data(image);
+	dst = wl_shm_buffer_get_data(l->buffer->shm_buffer);
+	for (y = 0; y < height; y++) {
+		/* x8r8g8b8 to the a8r8g8b8 the renderer path gives */
+		for (x = 0; x < width; x++)
+			dst[x] = src[x] | 0xff000000;
+		src += src_stride;
+		dst += dst_stride;
+	}
+
+	wl_shm_buffer_end_access(l->buffer->shm_buffer);
+
+	l->done(l->data, WESTON_SCREENSHOOTER_SUCCESS);
+	free(l);
+}
+
 WL_EXPORT int
 weston_screenshooter_shoot(struct weston_output *output,
 			   struct weston_buffer *buffer,
@@ -206,10 +262,14 @@ weston_screenshooter_shoot(struct weston_output *output,
 	l->output = output;
 	l->done = done;
 	l->data = data;
-	l->listener.notify = screenshooter_frame_notify;
-	wl_signal_add(&output->frame_signal, &l->listener);
-	weston_output_disable_planes_incr(output);
-	weston_output_schedule_repaint(output);
+
+	/* Prefer what the display hardware shows, planes included, to
+	 * reading the renderer output back with all planes disabled. */
+	if (output->capture &&
+	    output->capture(output, screenshooter_capture_done, l) == 0)
+		return 0;
+
+	screenshooter_read_from_renderer(l);
 
 	return 0;
 }
@@ -222,6 +282,7 @@ struct weston_recorder {
 	int fd;
 	struct wl_listener frame_listener;
 	int count, destroying;
+	bool capture, capture_pending;
 };
 
 static uint32_t *
@@ -258,6 +319,58 @@ component_delta(uint32_t next, uint32_t prev)
 static void
 weston_recorder_destroy(struct weston_recorder *recorder);
 
+/* Encodes one rectangle of the frame as run-lengths of the change from the
+ * previous frame. Rows are walked from r->y2 - 1 upwards: src holds that
+ * row, and each next row is src_stride pixels on from the one before. */
+static void
+weston_recorder_encode_rect(struct weston_recorder *recorder,
+			    const pixman_box32_t *r, const uint32_t *src,
+			    ptrdiff_t src_stride, uint32_t *outbuf)
+{
+	struct weston_output *output = recorder->output;
+	int j, k, width, height, run, stride, y_orig;
+	uint32_t delta, prev, *d, *p, next;
+	const uint32_t *s;
+
+	width = r->x2 - r->x1;
+	height = r->y2 - r->y1;
+	stride = output->current_mode->width;
+
+	p = outbuf;
+	run = prev = 0; /* quiet gcc */
+	for (j = 0; j < height; j++) {
+		s = src + src_stride * j;
+		y_orig = r->y2 - j - 1;
+		d = recorder->frame + stride * y_orig + r->x1;
+
+		for (k = 0; k < width; k++) {
+			next = *s++;
+			delta = component_delta(next, *d);
+			*d++ = next;
+			if (run == 0 || delta == prev) {
+				run++;
+			} else {
+				p = output_run(p, prev, run);
+				run = 1;
+			}
+			prev = delta;
+		}
+	}
+
+	p = output_run(p, prev, run);
+
+	recorder->total += write(recorder->fd, outbuf, (p - outbuf) * 4);
+
+#if 0
+	fprintf(stderr,
+		"%dx%d at %d,%d rle from %d to %d bytes (%f) total %dM\n",
+		width, height, r->x1, r->y1,
+		width * height * 4, (int) (p - outbuf) * 4,
+		(float) (p - outbuf) / (width * height),
+		recorder->total / 1024 / 1024);
+#endif
+}
+
 static void
 weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 {
@@ -268,8 +381,7 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 	uint32_t msecs = timespec_to_msec(&output->frame_time);
 	pixman_box32_t *r;
 	pixman_region32_t damage, transformed_damage;
-	int i, j, k, n, width, height, run, stride;
-	uint32_t delta, prev, *d, *s, *p, next;
+	int i, n, width, height;
 	struct {
 		uint32_t msecs;
 		uint32_t nrects;
@@ -307,7 +419,6 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 	v[1].iov_base = r;
 	v[1].iov_len = n * sizeof *r;
 	recorder->total += writev(recorder->fd, v, 2);
-	stride = output->current_mode->width;
 
 	for (i = 0; i < n; i++) {
 		width = r[i].x2 - r[i].x1;
@@ -322,50 +433,109 @@ weston_recorder_frame_notify(struct wl_listener *listener, void *data)
 				compositor->read_format, recorder->rect,
 				r[i].x1, y_orig, width, height);
 
-		p = outbuf;
-		run = prev = 0; /* quiet gcc */
-		for (j = 0; j < height; j++) {
-			if (do_yflip)
-				s = recorder->rect + width * j;
-			else
-				s = recorder->rect + width * (height - j - 1);
-			y_orig = r[i].y2 - j - 1;
-			d = recorder->frame + stride * y_orig + r[i].x1;
-
-			for (k = 0; k < width; k++) {
-				next = *s++;
-				delta = component_delta(next, *d);
-				*d++ = next;
-				if (run == 0 || delta == prev) {
-					run++;
-				} else {
-					p = output_run(p, prev, run);
-					run = 1;
-				}
-				prev = delta;
-			}
-		}
+		if (do_yflip)
+			weston_recorder_encode_rect(recorder, &r[i],
+						    recorder->rect, width,
+						    outbuf);
+		else
+			weston_recorder_encode_rect(recorder, &r[i],
+						    recorder->rect +
+						    width * (height - 1),
+						    -width, outbuf);
+	}
 
-		p = output_run(p, prev, run);
+	pixman_region32_fini(&transformed_damage);
+	recorder->count++;
+
+	if (recorder->destroying)
+		weston_recorder_destroy(recorder);
+}
 
-		recorder->total += write(recorder->fd,
-					 outbuf, (p - outbuf) * 4);
+/* Records from what the renderer draws, with all planes disabled so that
+ * it draws everything. */
+static void
+weston_recorder_use_renderer(struct weston_recorder *recorder)
+{
+	struct weston_output *output = recorder->output;
 
-#if 0
-		fprintf(stderr,
-			"%dx%d at %d,%d rle from %d to %d bytes (%f) total %dM\n",
-			width, height, r[i].x1, r[i].y1,
-			width * height * 4, (int) (p - outbuf) * 4,
-			(float) (p - outbuf) / (width * height),
-			recorder->total / 1024 / 1024);
-#endif
+	recorder->capture = false;
+	recorder->frame_listener.notify = weston_recorder_frame_notify;
+	wl_signal_add(&output->frame_signal, &recorder->frame_listener);
+	weston_output_disable_planes_incr(output);
+	weston_output_damage(output);
+}
+
+static void
+weston_recorder_capture_done(void *data, pixman_image_t *image);
+
+static void
+weston_recorder_capture_next(struct weston_recorder *recorder)
+{
+	struct weston_output *output = recorder->output;
+
+	if (output->capture(output, weston_recorder_capture_done,
+			    recorder) == 0)
+		recorder->capture_pending = true;
+	else
+		weston_recorder_use_renderer(recorder);
+}
+
+/* A capture holds the whole frame, planes included. The damage the
+ * renderer reports only covers the primary plane, and the renderer does
+ * not run at all while a client buffer is scanned out, so every capture
+ * is recorded as one full frame rectangle. The run-length coding of the
+ * change from the previous frame keeps what did not change small. Each
+ * capture asks for the next, so the output repaints at its refresh rate
+ * while recording. */
+static void
+weston_recorder_capture_done(void *data, pixman_image_t *image)
+{
+	struct weston_recorder *recorder = data;
+	struct weston_output *output = recorder->output;
+	pixman_box32_t r;
+	struct {
+		uint32_t msecs;
+		uint32_t nrects;
+	} header;
+	struct iovec v[2];
+	int32_t stride;
+
+	recorder->capture_pending = false;
+
+	if (!image) {
+		if (recorder->destroying)
+			weston_recorder_destroy(recorder);
+		else if (!output->destroying)
+			weston_recorder_use_renderer(recorder);
+		return;
 	}
 
-	pixman_region32_fini(&transformed_damage);
+	r.x1 = 0;
+	r.y1 = 0;
+	r.x2 = MIN(output->current_mode->width,
+		   pixman_image_get_width(image));
+	r.y2 = MIN(output->current_mode->height,
+		   pixman_image_get_height(image));
+
+	header.msecs = timespec_to_msec(&output->frame_time);
+	header.nrects = 1;
+	v[0].iov_base = &header;
+	v[0].iov_len = sizeof header;
+	v[1].iov_base = &r;
+	v[1].iov_len = sizeof r;
+	recorder->total += writev(recorder->fd, v, 2);
+
+	stride = pixman_image_get_stride(image) / 4;
+	weston_recorder_encode_rect(recorder, &r,
+				    pixman_image_get_data(image) +
+				    stride * (r.y2 - 1),
+				    -stride, recorder->rect);
 	recorder->count++;
 
 	if (recorder->destroying)
 		weston_recorder_destroy(recorder);
+	else
+		weston_recorder_capture_next(recorder);
 }
 
 static void
@@ -444,10 +614,14 @@ weston_recorder_create(struct weston_output *output, const char *filename)
 	header.height = output->current_mode->height;
 	recorder->total += write(recorder->fd, &header, sizeof header);
 
-	recorder->frame_listener.notify = weston_recorder_frame_notify;
-	wl_signal_add(&output->frame_signal, &recorder->frame_listener);
-	weston_output_disable_planes_incr(output);
-	weston_output_damage(output);
+	/* Captures come in x8r8g8b8, so they can only be recorded, and the
+	 * renderer taken over from them if they fail, in that format. */
+	if (output->capture && header.format == WCAP_FORMAT_XRGB8888) {
+		recorder->capture = true;
+		weston_recorder_capture_next(recorder);
+	} else {
+		weston_recorder_use_renderer(recorder);
+	}
 
 	return recorder;
 
@@ -459,9 +633,11 @@ err_recorder:
 static void
 weston_recorder_destroy(struct weston_recorder *recorder)
 {
-	wl_list_remove(&recorder->frame_listener.link);
+	if (!recorder->capture) {
+		wl_list_remove(&recorder->frame_listener.link);
+		weston_output_disable_planes_decr(recorder->output);
+	}
 	close(recorder->fd);
-	weston_output_disable_planes_decr(recorder->output);
 	weston_recorder_free(recorder);
 }
 
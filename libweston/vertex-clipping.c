@@ -26,6 +26,10 @@
 #include <float.h>
 #include <math.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "vertex-clipping.h"
 
 float
@@ -328,3 +332,145 @@ clip_transformed(struct clip_context *ctx,
 
 	return n;
 }
+
+/* Writes to reject[] whether the bounding box of each of the n quads misses
+ * the clip rectangle. With SSE2, four quads are handled at once: their
+ * corners are transposed so that each vector holds one corner of four
+ * quads, and the bounding boxes fall out of three min and max each.
+ */
+static void
+clip_quads_reject(struct clip_context *ctx, const float *x, const float *y,
+		  int n, bool *reject)
+{
+	float min_x, max_x, min_y, max_y;
+	int i = 0;
+	int k;
+
+#ifdef __SSE2__
+	const __m128 x1 = _mm_set1_ps(ctx->clip.x1);
+	const __m128 y1 = _mm_set1_ps(ctx->clip.y1);
+	const __m128 x2 = _mm_set1_ps(ctx->clip.x2);
+	const __m128 y2 = _mm_set1_ps(ctx->clip.y2);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 c0, c1, c2, c3, lo_x, hi_x, lo_y, hi_y, out;
+		int mask;
+
+		c0 = _mm_loadu_ps(x + 4 * i);
+		c1 = _mm_loadu_ps(x + 4 * i + 4);
+		c2 = _mm_loadu_ps(x + 4 * i + 8);
+		c3 = _mm_loadu_ps(x + 4 * i + 12);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		lo_x = _mm_min_ps(_mm_min_ps(c0, c1), _mm_min_ps(c2, c3));
+		hi_x = _mm_max_ps(_mm_max_ps(c0, c1), _mm_max_ps(c2, c3));
+
+		c0 = _mm_loadu_ps(y + 4 * i);
+		c1 = _mm_loadu_ps(y + 4 * i + 4);
+		c2 = _mm_loadu_ps(y + 4 * i + 8);
+		c3 = _mm_loadu_ps(y + 4 * i + 12);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		lo_y = _mm_min_ps(_mm_min_ps(c0, c1), _mm_min_ps(c2, c3));
+		hi_y = _mm_max_ps(_mm_max_ps(c0, c1), _mm_max_ps(c2, c3));
+
+		out = _mm_or_ps(_mm_or_ps(_mm_cmpge_ps(lo_x, x2),
+					  _mm_cmple_ps(hi_x, x1)),
+				_mm_or_ps(_mm_cmpge_ps(lo_y, y2),
+					  _mm_cmple_ps(hi_y, y1)));
+		mask = _mm_movemask_ps(out);
+		for (k = 0; k < 4; k++)
+			reject[i + k] = (mask >> k) & 1;
+	}
+#endif
+
+	for (; i < n; i++) {
+		min_x = max_x = x[4 * i];
+		min_y = max_y = y[4 * i];
+		for (k = 1; k < 4; k++) {
+			min_x = min(min_x, x[4 * i + k]);
+			max_x = max(max_x, x[4 * i + k]);
+			min_y = min(min_y, y[4 * i + k]);
+			max_y = max(max_y, y[4 * i + k]);
+		}
+
+		reject[i] = (min_x >= ctx->clip.x2) || (max_x <= ctx->clip.x1) ||
+			    (min_y >= ctx->clip.y2) || (max_y <= ctx->clip.y1);
+	}
+}
+
+static void
+clip_quad_simple(struct clip_context *ctx, const float *x, const float *y,
+		 struct polygon8 *out)
+{
+#ifdef __SSE2__
+	__m128 vx = _mm_loadu_ps(x);
+	__m128 vy = _mm_loadu_ps(y);
+
+	vx = _mm_min_ps(_mm_max_ps(vx, _mm_set1_ps(ctx->clip.x1)),
+			_mm_set1_ps(ctx->clip.x2));
+	vy = _mm_min_ps(_mm_max_ps(vy, _mm_set1_ps(ctx->clip.y1)),
+			_mm_set1_ps(ctx->clip.y2));
+	_mm_storeu_ps(out->x, vx);
+	_mm_storeu_ps(out->y, vy);
+	out->n = 4;
+#else
+	struct polygon8 quad = {
+		{ x[0], x[1], x[2], x[3] },
+		{ y[0], y[1], y[2], y[3] },
+		4
+	};
+
+	out->n = clip_simple(ctx, &quad, out->x, out->y);
+#endif
+}
+
+/*
+ * Clip n quadrilaterals against the rectangle ctx->clip.
+ *
+ * The corners of quad i are (x[4 * i + k], y[4 * i + k]) for k = 0..3, in
+ * clockwise order. The clipped polygon of quad i is written to out[i], with
+ * out[i].n set to zero when the quad does not intersect the rectangle, or
+ * to 3-8 vertices otherwise. If 'transformed' is false, all quads must be
+ * axis aligned rectangles and clipping reduces to clamping their corners.
+ *
+ * Returns the number of quads that produced a polygon.
+ */
+int
+clip_quads(struct clip_context *ctx, const float *x, const float *y, int n,
+	   bool transformed, struct polygon8 *out)
+{
+	bool reject[CLIP_QUADS_MAX];
+	struct polygon8 quad;
+	int i, k, count = 0;
+
+	assert(n <= CLIP_QUADS_MAX);
+
+	clip_quads_reject(ctx, x, y, n, reject);
+
+	for (i = 0; i < n; i++) {
+		if (reject[i]) {
+			out[i].n = 0;
+			continue;
+		}
+
+		if (!transformed) {
+			clip_quad_simple(ctx, &x[4 * i], &y[4 * i], &out[i]);
+			count++;
+			continue;
+		}
+
+		/* clip_transformed() works in place on its input. */
+		for (k = 0; k < 4; k++) {
+			quad.x[k] = x[4 * i + k];
+			quad.y[k] = y[4 * i + k];
+		}
+		quad.n = 4;
+
+		out[i].n = clip_transformed(ctx, &quad, out[i].x, out[i].y);
+		if (out[i].n < 3)
+			out[i].n = 0;
+		else
+			count++;
+	}
+
+	return count;
+}
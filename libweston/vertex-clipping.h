@@ -25,6 +25,11 @@
 #ifndef _WESTON_VERTEX_CLIPPING_H
 #define _WESTON_VERTEX_CLIPPING_H
 
+#include <stdbool.h>
+
+/* The largest batch clip_quads() accepts. */
+#define CLIP_QUADS_MAX 16
+
 struct polygon8 {
 	float x[8];
 	float y[8];
@@ -61,6 +66,10 @@ int
 clip_transformed(struct clip_context *ctx,
 		 struct polygon8 *surf,
 		 float *ex,
-		 float *ey);\
+		 float *ey);
+
+int
+clip_quads(struct clip_context *ctx, const float *x, const float *y, int n,
+	   bool transformed, struct polygon8 *out);
 
 #endif
@@ -31,7 +31,18 @@
 
 #include "weston-log-internal.h"
 
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 /** File type of stream
  */
@@ -96,3 +107,451 @@ weston_log_subscriber_create_log(FILE *dump_to)
 
 	return &file->base;
 }
+
+/*
+ * Asynchronous file subscriber
+ *
+ * Messages are copied into a ring buffer and written to the file by a
+ * dedicated thread, so a slow storage device never stalls the threads that
+ * log. Any number of threads may log concurrently: space is reserved in the
+ * ring with a compare-and-swap on its head, and every record carries a state
+ * word that is set once the record is complete. The writer thread collects
+ * the completed records in order, writes them in one writev() call, then
+ * clears their space and releases it by advancing the tail.
+ *
+ * When the ring is full, messages are dropped and counted rather than
+ * waiting for the writer.
+ */
+
+#define ASYNC_RECORD_EMPTY	0
+#define ASYNC_RECORD_COMMITTED	1
+#define ASYNC_RECORD_PADDING	2	/* skip to the end of the ring */
+
+#define ASYNC_IOV_MAX		64
+#define ASYNC_RING_SIZE_MIN	(64 * 1024)
+
+struct async_record {
+	uint32_t len;		/**< bytes of data */
+	uint32_t state;		/**< ASYNC_RECORD_*, accessed atomically */
+	uint64_t stamp_nsec;	/**< CLOCK_MONOTONIC when logged */
+	char data[];
+};
+
+/* Records start on 16 byte boundaries, so padding always has room for a
+ * record header. */
+#define ASYNC_RECORD_SIZE(len) \
+	((sizeof(struct async_record) + (len) + 15) & ~(size_t)15)
+
+struct weston_debug_log_file_async {
+	struct weston_log_subscriber base;
+
+	char *path;
+	int fd;
+	size_t rotate_size;	/**< 0 for no rotation */
+	size_t file_size;
+
+	char *ring;
+	size_t ring_size;	/**< a power of two */
+	uint64_t head;		/**< next byte to reserve, atomic */
+	uint64_t tail;		/**< next byte to write, atomic */
+
+	pthread_t thread;
+	sem_t wakeup;
+	uint32_t sleeping;	/**< the writer waits on wakeup, atomic */
+	uint32_t quit;		/**< atomic */
+
+	/** Updated atomically by the writer; dropped by the loggers. */
+	struct weston_log_async_stats stats;
+	uint64_t latency_sum_usec;
+};
+
+static uint64_t
+async_now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static struct weston_debug_log_file_async *
+to_weston_debug_log_file_async(struct weston_log_subscriber *sub)
+{
+	return container_of(sub, struct weston_debug_log_file_async, base);
+}
+
+static void
+weston_log_file_async_write(struct weston_log_subscriber *sub,
+			    const char *data, size_t len)
+{
+	struct weston_debug_log_file_async *file =
+		to_weston_debug_log_file_async(sub);
+	size_t size = ASYNC_RECORD_SIZE(len);
+	struct async_record *rec;
+	uint64_t head, tail, pos, pad;
+
+	if (len == 0)
+		return;
+
+	if (size > file->ring_size) {
+		__atomic_fetch_add(&file->stats.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	head = __atomic_load_n(&file->head, __ATOMIC_ACQUIRE);
+	do {
+		pos = head & (file->ring_size - 1);
+		pad = pos + size > file->ring_size ? file->ring_size - pos : 0;
+		tail = __atomic_load_n(&file->tail, __ATOMIC_ACQUIRE);
+
+		/* The writer may have drained past a stale head by now, so
+		 * this must not subtract tail from head; the exchange below
+		 * fails for a stale head anyway. */
+		if (head + pad + size > tail + file->ring_size) {
+			__atomic_fetch_add(&file->stats.dropped, 1,
+					   __ATOMIC_RELAXED);
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&file->head, &head,
+					      head + pad + size, true,
+					      __ATOMIC_ACQ_REL,
+					      __ATOMIC_ACQUIRE));
+
+	if (pad) {
+		rec = (struct async_record *)(file->ring + pos);
+		__atomic_store_n(&rec->state, ASYNC_RECORD_PADDING,
+				 __ATOMIC_RELEASE);
+		pos = 0;
+	}
+
+	rec = (struct async_record *)(file->ring + pos);
+	rec->len = len;
+	rec->stamp_nsec = async_now_nsec();
+	memcpy(rec->data, data, len);
+
+	/* Pairs with the writer announcing it goes to sleep: either it sees
+	 * this record, or we see it sleeping. */
+	__atomic_store_n(&rec->state, ASYNC_RECORD_COMMITTED, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&file->sleeping, __ATOMIC_SEQ_CST))
+		sem_post(&file->wakeup);
+}
+
+/* Moves the file to path.1 and starts a new one. If that fails, the failure
+ * is written to the current file, which is kept; the next attempt is made
+ * once another rotate_size bytes have been written to it. */
+static void
+async_file_rotate(struct weston_debug_log_file_async *file)
+{
+	char *old;
+	char msg[256];
+	int fd, len;
+
+	file->file_size = 0;
+
+	if (asprintf(&old, "%s.1", file->path) < 0)
+		return;
+
+	if (rename(file->path, old) < 0) {
+		len = snprintf(msg, sizeof msg,
+			       "log: failed to rotate %s: %s\n",
+			       file->path, strerror(errno));
+		goto fail;
+	}
+
+	fd = open(file->path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+		  0644);
+	if (fd == -1) {
+		len = snprintf(msg, sizeof msg,
+			       "log: failed to rotate %s: %s\n",
+			       file->path, strerror(errno));
+		rename(old, file->path);
+		goto fail;
+	}
+
+	free(old);
+	close(file->fd);
+	file->fd = fd;
+	__atomic_fetch_add(&file->stats.rotations, 1, __ATOMIC_RELAXED);
+	return;
+
+fail:
+	free(old);
+	if (len > 0 && write(file->fd, msg, MIN((size_t)len, sizeof msg - 1)) > 0)
+		file->file_size += len;
+}
+
+static void
+async_file_writev(struct weston_debug_log_file_async *file,
+		  struct iovec *iov, int n)
+{
+	ssize_t ret;
+
+	while (n > 0 && file->fd != -1) {
+		ret = writev(file->fd, iov, n);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+
+		file->file_size += ret;
+		while (n > 0 && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			n--;
+		}
+		if (n > 0) {
+			iov->iov_base = (char *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+}
+
+static void
+async_ring_clear(struct weston_debug_log_file_async *file,
+		 uint64_t from, uint64_t to)
+{
+	size_t pos, len;
+
+	/* Record headers of the next lap may land anywhere in here. */
+	while (from != to) {
+		pos = from & (file->ring_size - 1);
+		len = MIN(to - from, file->ring_size - pos);
+		memset(file->ring + pos, 0, len);
+		from += len;
+	}
+}
+
+/* Writes out all completed records; returns false if there were none. */
+static bool
+async_file_drain(struct weston_debug_log_file_async *file)
+{
+	struct iovec iov[ASYNC_IOV_MAX];
+	uint64_t stamps[ASYNC_IOV_MAX];
+	struct async_record *rec;
+	uint64_t tail, scan, now, latency;
+	uint32_t state;
+	size_t pos;
+	int n = 0, i;
+
+	tail = __atomic_load_n(&file->tail, __ATOMIC_RELAXED);
+	scan = tail;
+
+	while (n < ASYNC_IOV_MAX) {
+		pos = scan & (file->ring_size - 1);
+		rec = (struct async_record *)(file->ring + pos);
+		state = __atomic_load_n(&rec->state, __ATOMIC_ACQUIRE);
+
+		if (state == ASYNC_RECORD_EMPTY)
+			break;
+
+		if (state == ASYNC_RECORD_PADDING) {
+			scan += file->ring_size - pos;
+			continue;
+		}
+
+		iov[n].iov_base = rec->data;
+		iov[n].iov_len = rec->len;
+		stamps[n] = rec->stamp_nsec;
+		n++;
+		scan += ASYNC_RECORD_SIZE(rec->len);
+	}
+
+	if (scan == tail)
+		return false;
+
+	async_file_writev(file, iov, n);
+
+	now = async_now_nsec();
+	for (i = 0; i < n; i++) {
+		latency = (now - stamps[i]) / 1000;
+		file->latency_sum_usec += latency;
+		if (latency > file->stats.latency_max_usec)
+			__atomic_store_n(&file->stats.latency_max_usec, latency,
+					 __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&file->stats.messages, file->stats.messages + n,
+			 __ATOMIC_RELAXED);
+	if (file->stats.messages > 0)
+		__atomic_store_n(&file->stats.latency_avg_usec,
+				 file->latency_sum_usec / file->stats.messages,
+				 __ATOMIC_RELAXED);
+
+	async_ring_clear(file, tail, scan);
+	__atomic_store_n(&file->tail, scan, __ATOMIC_RELEASE);
+
+	if (file->rotate_size > 0 && file->file_size >= file->rotate_size)
+		async_file_rotate(file);
+
+	return true;
+}
+
+static void *
+async_file_thread(void *data)
+{
+	struct weston_debug_log_file_async *file = data;
+	struct async_record *rec;
+	uint64_t tail;
+
+	for (;;) {
+		if (async_file_drain(file))
+			continue;
+
+		if (__atomic_load_n(&file->quit, __ATOMIC_SEQ_CST))
+			break;
+
+		__atomic_store_n(&file->sleeping, 1, __ATOMIC_SEQ_CST);
+
+		tail = __atomic_load_n(&file->tail, __ATOMIC_RELAXED);
+		rec = (struct async_record *)
+			(file->ring + (tail & (file->ring_size - 1)));
+		if (__atomic_load_n(&rec->state, __ATOMIC_SEQ_CST) ==
+		    ASYNC_RECORD_EMPTY &&
+		    !__atomic_load_n(&file->quit, __ATOMIC_SEQ_CST)) {
+			while (sem_wait(&file->wakeup) < 0 && errno == EINTR)
+				;
+		}
+
+		__atomic_store_n(&file->sleeping, 0, __ATOMIC_SEQ_CST);
+	}
+
+	return NULL;
+}
+
+static void
+weston_log_subscriber_destroy_log_async(struct weston_log_subscriber *subscriber)
+{
+	struct weston_debug_log_file_async *file =
+		to_weston_debug_log_file_async(subscriber);
+
+	weston_log_subscriber_release(subscriber);
+
+	__atomic_store_n(&file->quit, 1, __ATOMIC_SEQ_CST);
+	sem_post(&file->wakeup);
+	pthread_join(file->thread, NULL);
+
+	if (file->fd != -1) {
+		dprintf(file->fd, "log writer: %" PRIu64 " messages written, "
+			"%" PRIu64 " dropped, latency avg %" PRIu64 " us, "
+			"max %" PRIu64 " us\n",
+			file->stats.messages, file->stats.dropped,
+			file->stats.latency_avg_usec,
+			file->stats.latency_max_usec);
+		close(file->fd);
+	}
+
+	sem_destroy(&file->wakeup);
+	free(file->ring);
+	free(file->path);
+	free(file);
+}
+
+/** Creates a file type of subscriber that writes from a separate thread
+ *
+ * Should be destroyed using weston_log_subscriber_destroy()
+ *
+ * Logging only copies the message into a ring buffer; a writer thread
+ * appends the messages to the file in batches. Messages that do not fit in
+ * the ring, because the writer is behind, are dropped and counted.
+ *
+ * @param path The file to append to; created if it does not exist.
+ * @param ring_size Size of the ring buffer in bytes, rounded up to a power
+ * of two.
+ * @param rotate_size When the file grows past this many bytes, it is renamed
+ * to \c path.1, replacing any previous one, and a new file is started. 0
+ * disables rotation.
+ * @returns a weston_log_subscriber object or NULL in case of failure
+ *
+ * @sa weston_log_subscriber_destroy, weston_log_subscriber_get_async_stats
+ *
+ */
+WL_EXPORT struct weston_log_subscriber *
+weston_log_subscriber_create_log_async(const char *path, size_t ring_size,
+				       size_t rotate_size)
+{
+	struct weston_debug_log_file_async *file;
+	struct stat st;
+	size_t size = ASYNC_RING_SIZE_MIN;
+
+	while (size < ring_size)
+		size *= 2;
+
+	file = zalloc(sizeof(*file));
+	if (!file)
+		return NULL;
+
+	file->path = strdup(path);
+	file->ring = zalloc(size);
+	if (!file->path || !file->ring)
+		goto err_alloc;
+
+	file->ring_size = size;
+	file->rotate_size = rotate_size;
+
+	file->fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (file->fd == -1) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		goto err_alloc;
+	}
+
+	if (fstat(file->fd, &st) == 0)
+		file->file_size = st.st_size;
+
+	if (sem_init(&file->wakeup, 0, 0) < 0)
+		goto err_fd;
+
+	if (pthread_create(&file->thread, NULL, async_file_thread, file) != 0)
+		goto err_sem;
+
+	file->base.write = weston_log_file_async_write;
+	file->base.destroy = weston_log_subscriber_destroy_log_async;
+	file->base.destroy_subscription = NULL;
+	file->base.complete = NULL;
+
+	wl_list_init(&file->base.subscription_list);
+
+	return &file->base;
+
+err_sem:
+	sem_destroy(&file->wakeup);
+err_fd:
+	close(file->fd);
+err_alloc:
+	free(file->ring);
+	free(file->path);
+	free(file);
+	return NULL;
+}
+
+/** Get the counters of an asynchronous file subscriber
+ *
+ * @param sub A subscriber from weston_log_subscriber_create_log_async().
+ * @param stats Filled with the current counters.
+ * @returns false if \c sub is not an asynchronous file subscriber.
+ *
+ * The counters are updated by the writer thread, and may be behind by the
+ * messages it is writing.
+ */
+WL_EXPORT bool
+weston_log_subscriber_get_async_stats(struct weston_log_subscriber *sub,
+				      struct weston_log_async_stats *stats)
+{
+	struct weston_debug_log_file_async *file;
+
+	if (sub->write != weston_log_file_async_write)
+		return false;
+
+	file = to_weston_debug_log_file_async(sub);
+	stats->messages = __atomic_load_n(&file->stats.messages,
+					  __ATOMIC_RELAXED);
+	stats->dropped = __atomic_load_n(&file->stats.dropped,
+					 __ATOMIC_RELAXED);
+	stats->latency_avg_usec = __atomic_load_n(&file->stats.latency_avg_usec,
+						  __ATOMIC_RELAXED);
+	stats->latency_max_usec = __atomic_load_n(&file->stats.latency_max_usec,
+						  __ATOMIC_RELAXED);
+	stats->rotations = __atomic_load_n(&file->stats.rotations,
+					   __ATOMIC_RELAXED);
+
+	return true;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "weston-log-flight-rec.h"
+
+/** Find the messages in a mapped flight recorder file
+ *
+ * The file may come from a crashed process, so nothing in it is trusted:
+ * every offset is checked against \c map_size before use.
+ *
+ * @param map the file contents
+ * @param map_size the size of the file
+ * @param contents filled in on success
+ * @returns NULL on success, or why the file cannot be decoded
+ */
+const char *
+weston_flight_rec_parse(const void *map, uint64_t map_size,
+			struct weston_flight_rec_contents *contents)
+{
+	const struct weston_flight_rec_header *header = map;
+	const char *data;
+	uint64_t pos;
+
+	if (map_size < sizeof(*header))
+		return "too short for a flight recorder";
+
+	if (memcmp(header->magic, WESTON_FLIGHT_REC_MAGIC,
+		   sizeof(header->magic)) != 0)
+		return "not a flight recorder file";
+
+	if (header->version != WESTON_FLIGHT_REC_VERSION)
+		return "unsupported version";
+
+	/* Each check keeps the subtraction of the next one from wrapping. */
+	if (header->header_size < sizeof(*header) ||
+	    header->header_size > map_size ||
+	    header->size > map_size - header->header_size)
+		return "corrupt header";
+
+	/* Read the position once; a live recorder may still be writing. */
+	pos = __atomic_load_n(&header->append_pos, __ATOMIC_ACQUIRE);
+	if (pos > header->size)
+		return "corrupt header";
+
+	data = (const char *)map + header->header_size;
+
+	contents->generation = header->generation;
+	contents->size = header->size;
+	contents->overlap = header->overlap;
+	if (contents->overlap) {
+		contents->data[0] = data + pos;
+		contents->len[0] = header->size - pos;
+		contents->data[1] = data;
+		contents->len[1] = pos;
+	} else {
+		contents->data[0] = data;
+		contents->len[0] = pos;
+		contents->data[1] = data;
+		contents->len[1] = 0;
+	}
+
+	return NULL;
+}
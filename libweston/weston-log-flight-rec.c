@@ -30,12 +30,17 @@
 #include <libweston/libweston.h>
 
 #include "weston-log-internal.h"
+#include "weston-log-flight-rec.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 
 struct weston_ring_buffer {
@@ -44,6 +49,9 @@ struct weston_ring_buffer {
 	char *buf;		/**< the buffer itself */
 	FILE *file;		/**< where to write in case we need to dump the buf */
 	bool overlap;		/**< in case buff overlaps, hint from where to print buf contents */
+	/** mirrors append_pos and overlap when backed by a file, or NULL */
+	struct weston_flight_rec_header *header;
+	size_t map_size;	/**< size of the file mapping */
 };
 
 /** allows easy access to the ring buffer in case of a core dump
@@ -66,6 +74,8 @@ weston_ring_buffer_init(struct weston_ring_buffer *rb, size_t size, char *buf)
 	rb->buf = buf;
 	rb->overlap = false;
 	rb->file = stderr;
+	rb->header = NULL;
+	rb->map_size = 0;
 }
 
 static struct weston_debug_log_flight_recorder *
@@ -78,9 +88,11 @@ static void
 weston_log_flight_recorder_adjust_end(struct weston_ring_buffer *rb,
 				      size_t bytes_to_advance)
 {
-	if (rb->append_pos == rb->size - bytes_to_advance)
+	if (rb->append_pos == rb->size - bytes_to_advance) {
+		/* full: the oldest byte is now the one at append_pos */
 		rb->append_pos = 0;
-	else
+		rb->overlap = true;
+	} else
 		rb->append_pos += bytes_to_advance;
 }
 
@@ -100,6 +112,7 @@ weston_log_flight_recorder_write_chunks(struct weston_ring_buffer *rb,
 	while (nr_chunks-- > 0) {
 		memcpy(&rb->buf[rb->append_pos], c_data, rb->size);
 		c_data += rb->size;
+		rb->overlap = true;
 	}
 
 	if (bytes_left_last_chunk)
@@ -175,15 +188,19 @@ weston_log_flight_recorder_write(struct weston_log_subscriber *sub,
 		}
 	}
 
+	/* The data is in place before the position that covers it. */
+	if (rb->header) {
+		__atomic_store_n(&rb->header->overlap, rb->overlap,
+				 __ATOMIC_RELEASE);
+		__atomic_store_n(&rb->header->append_pos, rb->append_pos,
+				 __ATOMIC_RELEASE);
+	}
 }
 
 static void
 weston_log_flight_recorder_map_memory(struct weston_debug_log_flight_recorder *flight_rec)
 {
-	size_t i = 0;
-
-	for (i = 0; i < flight_rec->rb.size; i++)
-		flight_rec->rb.buf[i] = 0xff;
+	memset(flight_rec->rb.buf, 0xff, flight_rec->rb.size);
 }
 
 static void
@@ -229,7 +246,10 @@ weston_log_subscriber_destroy_flight_rec(struct weston_log_subscriber *sub)
 		weston_primary_flight_recorder_ring_buffer = NULL;
 
 	weston_log_subscriber_release(sub);
-	free(flight_rec->rb.buf);
+	if (flight_rec->rb.header)
+		munmap(flight_rec->rb.header, flight_rec->rb.map_size);
+	else
+		free(flight_rec->rb.buf);
 	free(flight_rec);
 }
 
@@ -276,6 +296,114 @@ weston_log_subscriber_create_flight_rec(size_t size)
 	return &flight_rec->base;
 }
 
+/** Read the generation of a previous flight recorder file, or 0. */
+static uint32_t
+flight_rec_file_generation(int fd)
+{
+	struct weston_flight_rec_header header;
+
+	if (pread(fd, &header, sizeof header, 0) != sizeof header)
+		return 0;
+
+	if (memcmp(header.magic, WESTON_FLIGHT_REC_MAGIC, sizeof header.magic))
+		return 0;
+
+	return header.generation;
+}
+
+/** Create a flight recorder type of subscriber backed by a file
+ *
+ * Like weston_log_subscriber_create_flight_rec(), but the ring buffer is a
+ * shared mapping of \c path, so its contents outlive the process: after a
+ * crash or SIGKILL, or a reboot for what had reached storage, the last
+ * messages can be recovered with weston-flight-rec-decode. On a tmpfs such
+ * as /dev/shm, nothing touches the disk and the contents survive
+ * everything but a reboot.
+ *
+ * An existing recorder file at \c path is first renamed to \c path.old, so
+ * that restarting after a crash does not overwrite the history of the crash.
+ *
+ * Writing costs the same as with anonymous memory, pages are only touched
+ * as the ring buffer fills up.
+ *
+ * @param path the file to create
+ * @param size specify the maximum size (in bytes) of the ring buffer
+ * @returns a weston_log_subscriber object or NULL in case of failure
+ */
+WL_EXPORT struct weston_log_subscriber *
+weston_log_subscriber_create_flight_rec_file(const char *path, size_t size)
+{
+	struct weston_debug_log_flight_recorder *flight_rec;
+	struct weston_flight_rec_header *header;
+	uint32_t generation = 0;
+	size_t map_size;
+	char *old;
+	int fd;
+
+	assert("Can't create more than one flight recorder." &&
+			!weston_primary_flight_recorder_ring_buffer);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		generation = flight_rec_file_generation(fd);
+		close(fd);
+
+		if (asprintf(&old, "%s.old", path) < 0)
+			return NULL;
+		rename(path, old);
+		free(old);
+	}
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	map_size = sizeof(*header) + size;
+	if (ftruncate(fd, map_size) < 0) {
+		fprintf(stderr, "Failed to size %s: %s\n", path, strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+	header = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED) {
+		fprintf(stderr, "Failed to map %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	flight_rec = zalloc(sizeof(*flight_rec));
+	if (!flight_rec) {
+		munmap(header, map_size);
+		return NULL;
+	}
+
+	flight_rec->base.write = weston_log_flight_recorder_write;
+	flight_rec->base.destroy = weston_log_subscriber_destroy_flight_rec;
+	flight_rec->base.destroy_subscription = NULL;
+	flight_rec->base.complete = NULL;
+	wl_list_init(&flight_rec->base.subscription_list);
+
+	weston_ring_buffer_init(&flight_rec->rb, size,
+				(char *)header + sizeof(*header));
+	flight_rec->rb.header = header;
+	flight_rec->rb.map_size = map_size;
+	weston_primary_flight_recorder_ring_buffer = &flight_rec->rb;
+
+	header->version = WESTON_FLIGHT_REC_VERSION;
+	header->header_size = sizeof(*header);
+	header->size = flight_rec->rb.size;
+	header->append_pos = 0;
+	header->overlap = 0;
+	header->generation = generation + 1;
+	/* The magic goes last: a file with it is complete. */
+	memcpy(header->magic, WESTON_FLIGHT_REC_MAGIC, sizeof(header->magic));
+
+	return &flight_rec->base;
+}
+
 /** Retrieve flight recorder ring buffer contents, could be useful when
  * implementing an assert()-like wrapper.
  *
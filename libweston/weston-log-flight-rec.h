@@ -0,0 +1,64 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WESTON_LOG_FLIGHT_REC_H
+#define WESTON_LOG_FLIGHT_REC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Layout of a file backed flight recorder, shared with
+ * weston-flight-rec-decode. The file is this header followed by the ring
+ * buffer data, in host byte order. */
+
+#define WESTON_FLIGHT_REC_MAGIC "WFLTREC\0"
+#define WESTON_FLIGHT_REC_VERSION 1
+
+struct weston_flight_rec_header {
+	char magic[8];		/**< WESTON_FLIGHT_REC_MAGIC */
+	uint32_t version;	/**< WESTON_FLIGHT_REC_VERSION */
+	uint32_t header_size;	/**< offset of the ring buffer data */
+	uint64_t size;		/**< bytes of ring buffer data in use */
+	uint64_t append_pos;	/**< where the next byte would be written */
+	uint32_t overlap;	/**< the ring buffer has wrapped around */
+	uint32_t generation;	/**< incremented by every recorder reusing the file */
+	uint64_t reserved[3];
+};
+
+/** What a flight recorder file holds, as found by weston_flight_rec_parse() */
+struct weston_flight_rec_contents {
+	uint32_t generation;
+	uint64_t size;		/**< capacity of the ring buffer */
+	bool overlap;		/**< the ring buffer has wrapped around */
+	/** the recorded bytes, oldest first, in up to two pieces */
+	const char *data[2];
+	uint64_t len[2];
+};
+
+const char *
+weston_flight_rec_parse(const void *map, uint64_t map_size,
+			struct weston_flight_rec_contents *contents);
+
+#endif /* WESTON_LOG_FLIGHT_REC_H */
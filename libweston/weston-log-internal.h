@@ -27,6 +27,8 @@
 
 #include "wayland-util.h"
 
+#include <libweston/weston-log.h>
+
 struct weston_log_subscription;
 
 /** Subscriber allows each type of stream to customize or to provide its own
@@ -88,6 +90,11 @@ weston_log_bind_weston_debug(struct wl_client *client,
 struct weston_log_scope *
 weston_log_get_scope(struct weston_log_context *log_ctx, const char *name);
 
+void
+weston_log_ctx_get_stream_limits(struct weston_log_context *log_ctx,
+				 size_t *buffer_size,
+				 enum weston_log_overflow_policy *policy);
+
 void
 weston_log_run_cb_new_subscription(struct weston_log_subscription *sub);
 
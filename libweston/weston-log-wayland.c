@@ -37,7 +37,26 @@
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+
+/** Maximum number of queued messages written by one writev() call */
+#define STREAM_IOV_MAX 64
+
+/** A message queued on a debug stream, waiting for the consumer */
+struct stream_chunk {
+	struct wl_list link;	/**< weston_log_debug_wayland::queue */
+	size_t len;
+	size_t offset;		/**< bytes of data already written */
+	char data[];
+};
 
 /** A debug stream created by a client
  *
@@ -46,14 +65,37 @@
  * scope name, and the scope provides the messages.  There can be several
  * streams for the same scope, all streams getting the same messages.
  *
+ * The file descriptor is written without blocking, yet without changing the
+ * flags the client shares: see stream_open_nonblocking(). Whatever the
+ * consumer does not take in right away is queued, up to a bounded number of
+ * bytes, and written from the event loop once the fd becomes writable
+ * again. When the queue is full, the overflow policy of the log context
+ * applies: either the oldest queued messages are dropped, or the stream is
+ * closed.
+ *
  * The following is specific to weston-debug protocol.
  * Subscription/unsubscription takes place in the stream_create(), respectively
  * in stream_destroy().
  */
 struct weston_log_debug_wayland {
 	struct weston_log_subscriber base;
-	int fd;				/**< client provided fd */
+	int fd;				/**< client provided fd, or our reopening */
+	bool nonblocking;		/**< fd has O_NONBLOCK of its own */
+	bool socket;			/**< written with MSG_DONTWAIT */
 	struct wl_resource *resource;	/**< weston_debug_stream_v1 object */
+	char *name;			/**< scope name, for reporting */
+
+	/** Watches fd while messages are queued; NULL when the fd cannot be
+	 * polled, e.g. a regular file, and writes never block anyway. */
+	struct wl_event_source *fd_source;
+	struct wl_list queue;		/**< stream_chunk::link, oldest first */
+	size_t queued;			/**< bytes in queue */
+	size_t max_queued;
+	enum weston_log_overflow_policy overflow;
+	bool completing;		/**< send complete once drained */
+
+	uint32_t dropped;		/**< messages dropped on overflow */
+	uint64_t dropped_bytes;
 };
 
 static struct weston_log_debug_wayland *
@@ -62,9 +104,28 @@ to_weston_log_debug_wayland(struct weston_log_subscriber *sub)
         return container_of(sub, struct weston_log_debug_wayland, base);
 }
 
+static void
+stream_chunk_destroy(struct weston_log_debug_wayland *stream,
+		     struct stream_chunk *chunk)
+{
+	stream->queued -= chunk->len - chunk->offset;
+	wl_list_remove(&chunk->link);
+	free(chunk);
+}
+
 static void
 stream_close_unlink(struct weston_log_debug_wayland *stream)
 {
+	struct stream_chunk *chunk, *tmp;
+
+	wl_list_for_each_safe(chunk, tmp, &stream->queue, link)
+		stream_chunk_destroy(stream, chunk);
+	stream->completing = false;
+
+	if (stream->fd_source)
+		wl_event_source_remove(stream->fd_source);
+	stream->fd_source = NULL;
+
 	if (stream->fd != -1)
 		close(stream->fd);
 	stream->fd = -1;
@@ -93,6 +154,234 @@ stream_close_on_failure(struct weston_log_debug_wayland *stream,
 	}
 }
 
+static void
+stream_update_fd_source(struct weston_log_debug_wayland *stream)
+{
+	if (!stream->fd_source)
+		return;
+
+	wl_event_source_fd_update(stream->fd_source,
+				  wl_list_empty(&stream->queue) ?
+				  0 : WL_EVENT_WRITABLE);
+}
+
+/** Get a stream fd that can be written without blocking
+ *
+ * O_NONBLOCK cannot be set on the client's fd: the flag belongs to the open
+ * file description the client shares, e.g. the terminal weston-debug writes
+ * to. Sockets are written with MSG_DONTWAIT instead. Pipes, FIFOs and
+ * terminals are opened again through /proc, which gives a description of
+ * our own with O_NONBLOCK set, and the client's fd is closed.
+ *
+ * If none of this applies, stream_writev() falls back to polling.
+ */
+static void
+stream_open_nonblocking(struct weston_log_debug_wayland *stream)
+{
+	char path[64];
+	struct stat st;
+	int fd;
+
+	if (fstat(stream->fd, &st) < 0)
+		return;
+
+	/* Regular files do not block. */
+	if (S_ISREG(st.st_mode))
+		return;
+
+	if (S_ISSOCK(st.st_mode)) {
+		stream->socket = true;
+		return;
+	}
+
+	snprintf(path, sizeof path, "/proc/self/fd/%d", stream->fd);
+	fd = open(path, O_WRONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	close(stream->fd);
+	stream->fd = fd;
+	stream->nonblocking = true;
+}
+
+/** Write to the stream fd without blocking
+ *
+ * See stream_open_nonblocking(). When the fd could not be made
+ * non-blocking, a write is only attempted when poll() says the consumer
+ * takes data, and it is capped to PIPE_BUF bytes, which a writable pipe is
+ * guaranteed to accept at once. Terminals make no such promise.
+ *
+ * Returns like writev(), with errno set to EAGAIN when the consumer is not
+ * ready.
+ */
+static ssize_t
+stream_writev(struct weston_log_debug_wayland *stream,
+	      const struct iovec *iov, int n)
+{
+	struct pollfd pfd = { .fd = stream->fd, .events = POLLOUT };
+	struct iovec capped[STREAM_IOV_MAX];
+	struct msghdr msg = { 0 };
+	size_t room = PIPE_BUF;
+	int i;
+
+	if (stream->socket) {
+		msg.msg_iov = (struct iovec *)iov;
+		msg.msg_iovlen = n;
+		return sendmsg(stream->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+	}
+
+	/* Regular files cannot be polled, and do not block either. */
+	if (stream->nonblocking || !stream->fd_source)
+		return writev(stream->fd, iov, n);
+
+	if (poll(&pfd, 1, 0) < 0)
+		return -1;
+
+	/* Errors and hang-ups are left for writev() to report. */
+	if (pfd.revents == 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	assert(n <= STREAM_IOV_MAX);
+	for (i = 0; i < n && room > 0; i++) {
+		capped[i] = iov[i];
+		if (capped[i].iov_len > room)
+			capped[i].iov_len = room;
+		room -= capped[i].iov_len;
+	}
+
+	return writev(stream->fd, capped, i);
+}
+
+/** Write as much of the queue as the consumer takes without blocking
+ *
+ * Returns -1 if the stream failed and got closed, 0 otherwise.
+ */
+static int
+stream_flush(struct weston_log_debug_wayland *stream)
+{
+	struct iovec iov[STREAM_IOV_MAX];
+	struct stream_chunk *chunk, *tmp;
+	ssize_t ret;
+	size_t done;
+	int n, e;
+
+	while (!wl_list_empty(&stream->queue)) {
+		n = 0;
+		wl_list_for_each(chunk, &stream->queue, link) {
+			if (n == STREAM_IOV_MAX)
+				break;
+			iov[n].iov_base = chunk->data + chunk->offset;
+			iov[n].iov_len = chunk->len - chunk->offset;
+			n++;
+		}
+
+		ret = stream_writev(stream, iov, n);
+		e = errno;
+		if (ret < 0) {
+			if (e == EINTR)
+				continue;
+			if (e == EAGAIN || e == EWOULDBLOCK)
+				break;
+
+			stream_close_on_failure(stream,
+					"Error writing %zu bytes: %s (%d)",
+					stream->queued, strerror(e), e);
+			return -1;
+		}
+
+		done = ret;
+		wl_list_for_each_safe(chunk, tmp, &stream->queue, link) {
+			size_t left = chunk->len - chunk->offset;
+
+			if (done < left) {
+				chunk->offset += done;
+				stream->queued -= done;
+				break;
+			}
+
+			done -= left;
+			stream_chunk_destroy(stream, chunk);
+		}
+	}
+
+	stream_update_fd_source(stream);
+
+	if (stream->completing && wl_list_empty(&stream->queue)) {
+		stream_close_unlink(stream);
+		weston_debug_stream_v1_send_complete(stream->resource);
+	}
+
+	return 0;
+}
+
+static int
+stream_fd_handler(int fd, uint32_t mask, void *data)
+{
+	struct weston_log_debug_wayland *stream = data;
+
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		stream_close_on_failure(stream, "Debug stream consumer hung up");
+		return 0;
+	}
+
+	stream_flush(stream);
+
+	return 0;
+}
+
+/** Make room for len more bytes in the queue
+ *
+ * Returns false if the message must not be queued.
+ */
+static bool
+stream_make_room(struct weston_log_debug_wayland *stream, size_t len)
+{
+	struct stream_chunk *chunk, *tmp;
+
+	if (stream->queued + len <= stream->max_queued)
+		return true;
+
+	/* The consumer may have caught up since the fd was last polled. */
+	if (stream_flush(stream) < 0)
+		return false;
+
+	if (stream->queued + len <= stream->max_queued)
+		return true;
+
+	switch (stream->overflow) {
+	case WESTON_LOG_OVERFLOW_DISCONNECT:
+		stream_close_on_failure(stream,
+					"Debug stream consumer too slow, "
+					"%zu bytes pending", stream->queued);
+		return false;
+	case WESTON_LOG_OVERFLOW_DROP_OLDEST:
+		break;
+	}
+
+	/* A partially written message must be completed, or the stream
+	 * would carry a torn message. */
+	wl_list_for_each_safe(chunk, tmp, &stream->queue, link) {
+		if (stream->queued + len <= stream->max_queued)
+			break;
+		if (chunk->offset > 0)
+			continue;
+
+		stream->dropped++;
+		stream->dropped_bytes += chunk->len;
+		stream_chunk_destroy(stream, chunk);
+	}
+
+	if (stream->queued + len <= stream->max_queued)
+		return true;
+
+	stream->dropped++;
+	stream->dropped_bytes += len;
+
+	return false;
+}
+
 /** Write data into a specific debug stream
  *
  * \param sub The subscriber's stream to write into; must not be NULL.
@@ -102,10 +391,11 @@ stream_close_on_failure(struct weston_log_debug_wayland *stream,
  * Writes the given data (binary verbatim) into the debug stream.
  * If \c len is zero or negative, the write is silently dropped.
  *
- * Writing is continued until all data has been written or
- * a write fails. If the write fails due to a signal, it is re-tried.
- * Otherwise on failure, the stream is closed and
- * \c weston_debug_stream_v1.failure event is sent to the client.
+ * The data is written right away as far as the consumer takes it in without
+ * blocking; the rest is queued and written from the event loop. If the
+ * write fails due to a signal, it is re-tried. Otherwise on failure, or
+ * if the queue overflows with the disconnect policy, the stream is closed
+ * and \c weston_debug_stream_v1.failure event is sent to the client.
  *
  * \memberof weston_log_debug_wayland
  */
@@ -117,26 +407,55 @@ weston_log_debug_wayland_write(struct weston_log_subscriber *sub,
 	ssize_t ret;
 	int e;
 	struct weston_log_debug_wayland *stream = to_weston_log_debug_wayland(sub);
+	struct stream_chunk *chunk;
+	struct iovec iov;
 
-	if (stream->fd == -1)
+	if (stream->fd == -1 || stream->completing)
 		return;
 
-	while (len_ > 0) {
-		ret = write(stream->fd, data, len_);
+	/* Keep the order of messages: nothing jumps the queue. */
+	while (len_ > 0 && wl_list_empty(&stream->queue)) {
+		iov.iov_base = (void *)data;
+		iov.iov_len = len_;
+		ret = stream_writev(stream, &iov, 1);
 		e = errno;
 		if (ret < 0) {
 			if (e == EINTR)
 				continue;
+			if ((e == EAGAIN || e == EWOULDBLOCK) &&
+			    stream->fd_source)
+				break;
 
 			stream_close_on_failure(stream,
 					"Error writing %zd bytes: %s (%d)",
 					len_, strerror(e), e);
-			break;
+			return;
 		}
 
 		len_ -= ret;
 		data += ret;
 	}
+
+	if (len_ <= 0)
+		return;
+
+	/* A message cut short must be finished regardless of the limit. */
+	if (len_ == (ssize_t)len && !stream_make_room(stream, len_))
+		return;
+
+	chunk = malloc(sizeof *chunk + len_);
+	if (!chunk) {
+		stream_close_on_failure(stream, "MEMFAIL");
+		return;
+	}
+
+	chunk->len = len_;
+	chunk->offset = 0;
+	memcpy(chunk->data, data, len_);
+	wl_list_insert(stream->queue.prev, &chunk->link);
+	stream->queued += len_;
+
+	stream_update_fd_source(stream);
 }
 
 /** Close the debug stream and send success event
@@ -154,6 +473,12 @@ weston_log_debug_wayland_complete(struct weston_log_subscriber *sub)
 {
 	struct weston_log_debug_wayland *stream = to_weston_log_debug_wayland(sub);
 
+	/* Let the queue drain first. */
+	if (!wl_list_empty(&stream->queue)) {
+		stream->completing = true;
+		return;
+	}
+
 	stream_close_unlink(stream);
 	weston_debug_stream_v1_send_complete(stream->resource);
 }
@@ -173,13 +498,30 @@ stream_create(struct weston_log_context *log_ctx, const char *name,
 {
 	struct weston_log_debug_wayland *stream;
 	struct weston_log_scope *scope;
+	struct wl_event_loop *loop;
 
 	stream = zalloc(sizeof *stream);
 	if (!stream)
 		return NULL;
 
+	stream->name = strdup(name);
+	if (!stream->name) {
+		free(stream);
+		return NULL;
+	}
+
 	stream->fd = streamfd;
 	stream->resource = stream_resource;
+	stream_open_nonblocking(stream);
+	wl_list_init(&stream->queue);
+	weston_log_ctx_get_stream_limits(log_ctx, &stream->max_queued,
+					 &stream->overflow);
+
+	/* Regular files cannot be polled, and do not block either. */
+	loop = wl_display_get_event_loop(
+		wl_client_get_display(wl_resource_get_client(stream_resource)));
+	stream->fd_source = wl_event_loop_add_fd(loop, stream->fd, 0,
+						 stream_fd_handler, stream);
 
 	stream->base.write = weston_log_debug_wayland_write;
 	stream->base.destroy = NULL;
@@ -207,6 +549,15 @@ stream_destroy(struct wl_resource *stream_resource)
 
 	stream_close_unlink(stream);
 	weston_log_subscriber_release(&stream->base);
+
+	if (stream->dropped > 0) {
+		weston_log("Debug stream '%s' dropped %" PRIu32 " messages "
+			   "(%" PRIu64 " bytes), its consumer was too slow.\n",
+			   stream->name, stream->dropped,
+			   stream->dropped_bytes);
+	}
+
+	free(stream->name);
 	free(stream);
 }
 
@@ -69,6 +69,8 @@ struct weston_log_context {
 	struct wl_listener compositor_destroy_listener;
 	struct wl_list scope_list; /**< weston_log_scope::compositor_link */
 	struct wl_list pending_subscription_list; /**< weston_log_subscription::source_link */
+	size_t stream_buffer_size; /**< per weston-debug stream, in bytes */
+	enum weston_log_overflow_policy stream_overflow;
 };
 
 /** weston-log message scope
@@ -416,6 +418,9 @@ weston_log_ctx_create(void)
 	wl_list_init(&log_ctx->pending_subscription_list);
 	wl_list_init(&log_ctx->compositor_destroy_listener.link);
 
+	log_ctx->stream_buffer_size = WESTON_LOG_STREAM_BUFFER_SIZE_DEFAULT;
+	log_ctx->stream_overflow = WESTON_LOG_OVERFLOW_DROP_OLDEST;
+
 	return log_ctx;
 }
 
@@ -477,9 +482,9 @@ compositor_destroy_listener(struct wl_listener *listener, void *data)
  * This enables the weston_debug_v1 Wayland protocol extension which any client
  * can use to get debug messages from the compositor.
  *
- * WARNING: This feature should not be used in production. If a client
- * provides a file descriptor that blocks writes, it will block the whole
- * compositor indefinitely.
+ * Messages are written to the client provided file descriptors without
+ * blocking. What a consumer cannot take in is queued, up to a bounded amount
+ * per stream; see weston_compositor_set_debug_stream_limits().
  *
  * There is no control on which client is allowed to subscribe to debug
  * messages. Any and all clients are allowed.
@@ -511,6 +516,37 @@ weston_compositor_enable_debug_protocol(struct weston_compositor *compositor)
 		   "information leak.\n");
 }
 
+/** Set how weston-debug streams cope with slow consumers
+ *
+ * \param compositor The libweston compositor.
+ * \param buffer_size The maximum number of bytes queued per stream.
+ * \param policy What to do with a message that does not fit.
+ *
+ * Applies to streams subscribed after the call.
+ *
+ * @ingroup debug-protocol
+ */
+WL_EXPORT void
+weston_compositor_set_debug_stream_limits(struct weston_compositor *compositor,
+					  size_t buffer_size,
+					  enum weston_log_overflow_policy policy)
+{
+	struct weston_log_context *log_ctx = compositor->weston_log_ctx;
+
+	assert(log_ctx);
+	log_ctx->stream_buffer_size = buffer_size;
+	log_ctx->stream_overflow = policy;
+}
+
+void
+weston_log_ctx_get_stream_limits(struct weston_log_context *log_ctx,
+				 size_t *buffer_size,
+				 enum weston_log_overflow_policy *policy)
+{
+	*buffer_size = log_ctx->stream_buffer_size;
+	*policy = log_ctx->stream_overflow;
+}
+
 /** Determine if the debug protocol has been enabled
  *
  * \param wc The libweston compositor to verify if debug protocol has been
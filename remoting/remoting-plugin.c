@@ -52,6 +52,14 @@
 
 #define MAX_RETRY_COUNT	3
 
+/* Default number of frames allowed to sit in the appsrc queue before newer
+ * frames get merged instead of queued */
+#define DEFAULT_MAX_QUEUED_FRAMES	2
+
+/* Above this many damage rectangles, only the extents are passed down the
+ * pipeline as region of interest */
+#define MAX_DAMAGE_ROI_RECTS	16
+
 struct weston_remoting {
 	struct weston_compositor *compositor;
 	struct wl_list output_list;
@@ -98,6 +106,9 @@ struct remoted_output {
 	int (*saved_enable)(struct weston_output *output);
 	int (*saved_disable)(struct weston_output *output);
 	int (*saved_start_repaint_loop)(struct weston_output *output);
+	int (*saved_repaint)(struct weston_output *output,
+			     pixman_region32_t *damage,
+			     void *repaint_data);
 
 	char *host;
 	int port;
@@ -108,6 +119,7 @@ struct remoted_output {
 
 	struct weston_remoting *remoting;
 	struct wl_event_source *finish_frame_timer;
+	bool finish_frame_timer_armed;
 	struct wl_list link;
 	bool submitted_frame;
 	int fence_sync_fd;
@@ -120,6 +132,20 @@ struct remoted_output {
 	GstClockTime start_time;
 	int retry_count;
 	enum dpms_enum dpms;
+
+	/* damage of the frame being repainted, in global coordinates */
+	pixman_region32_t repaint_damage;
+	/* damage not yet delivered to the pipeline, in buffer coordinates */
+	pixman_region32_t damage;
+	/* latest frame held back while the encoder is backed up */
+	GstBuffer *merged_buffer;
+	int max_queued_frames;
+	/* bytes in one frame as queued to appsrc, stride * height */
+	gsize frame_size;
+
+	uint32_t frames_pushed;
+	uint32_t frames_merged;
+	uint32_t frames_skipped;
 };
 
 struct mem_free_cb_data {
@@ -462,6 +488,40 @@ weston_remoting_get(struct weston_compositor *compositor)
 	return remoting;
 }
 
+static void
+remoting_output_arm_finish_frame_timer(struct remoted_output *output)
+{
+	int64_t msec;
+
+	if (output->dpms != WESTON_DPMS_ON) {
+		wl_event_source_timer_update(output->finish_frame_timer, 0);
+		output->finish_frame_timer_armed = false;
+		return;
+	}
+
+	msec = millihz_to_nsec(output->output->current_mode->refresh) / 1000000;
+	wl_event_source_timer_update(output->finish_frame_timer, msec);
+	output->finish_frame_timer_armed = true;
+}
+
+static bool
+remoting_output_encoder_backed_up(struct remoted_output *output)
+{
+	guint64 queued;
+
+	if (output->max_queued_frames <= 0 || output->frame_size == 0)
+		return false;
+
+	queued = gst_app_src_get_current_level_bytes(output->appsrc);
+
+	return queued >= (guint64)output->frame_size *
+			 output->max_queued_frames;
+}
+
+static void
+remoting_output_gst_deliver_buffer(struct remoted_output *output,
+				   GstBuffer *buffer);
+
 static int
 remoting_output_finish_frame_handler(void *data)
 {
@@ -469,21 +529,33 @@ remoting_output_finish_frame_handler(void *data)
 	const struct weston_drm_virtual_output_api *api
 		= output->remoting->virtual_output_api;
 	struct timespec now;
-	int64_t msec;
 
+	output->finish_frame_timer_armed = false;
+
+	/* Deliver a frame merged earlier once the encoder caught up. Its
+	 * repaint has already been completed, so this must not count as a
+	 * newly submitted frame. */
+	if (output->merged_buffer && output->appsrc &&
+	    !remoting_output_encoder_backed_up(output)) {
+		GstBuffer *buffer = output->merged_buffer;
+
+		output->merged_buffer = NULL;
+		remoting_output_gst_deliver_buffer(output, buffer);
+	}
+
+	/* Only complete the repaint actually in flight. */
 	if (output->submitted_frame) {
 		struct weston_compositor *c = output->remoting->compositor;
 		output->submitted_frame = false;
 		weston_compositor_read_presentation_clock(c, &now);
 		api->finish_frame(output->output, &now, 0);
+	} else if (!output->merged_buffer) {
+		/* Nothing was repainted during the last period: let the
+		 * timer idle until the repaint loop is started again. */
+		return 0;
 	}
 
-	if (output->dpms == WESTON_DPMS_ON) {
-		msec = millihz_to_nsec(output->output->current_mode->refresh) / 1000000;
-		wl_event_source_timer_update(output->finish_frame_timer, msec);
-	} else {
-		wl_event_source_timer_update(output->finish_frame_timer, 0);
-	}
+	remoting_output_arm_finish_frame_timer(output);
 	return 0;
 }
 
@@ -522,12 +594,46 @@ lookup_remoted_output(struct weston_output *output)
 }
 
 static void
-remoting_output_gst_push_buffer(struct remoted_output *output,
+remoting_output_frame_submitted(struct remoted_output *output)
+{
+	output->submitted_frame = true;
+	if (!output->finish_frame_timer_armed)
+		remoting_output_arm_finish_frame_timer(output);
+}
+
+static void
+remoting_output_add_damage_meta(struct remoted_output *output,
 				GstBuffer *buffer)
+{
+	pixman_box32_t *rects;
+	int n_rects, i;
+
+	rects = pixman_region32_rectangles(&output->damage, &n_rects);
+	if (n_rects > MAX_DAMAGE_ROI_RECTS) {
+		rects = pixman_region32_extents(&output->damage);
+		n_rects = 1;
+	}
+
+	for (i = 0; i < n_rects; i++)
+		gst_buffer_add_video_region_of_interest_meta(buffer, "damage",
+							     rects[i].x1,
+							     rects[i].y1,
+							     rects[i].x2 - rects[i].x1,
+							     rects[i].y2 - rects[i].y1);
+
+	pixman_region32_clear(&output->damage);
+}
+
+/* Hands a buffer to the pipeline, without any frame bookkeeping. */
+static void
+remoting_output_gst_deliver_buffer(struct remoted_output *output,
+				   GstBuffer *buffer)
 {
 	struct timespec current_frame_ts;
 	GstClockTime ts, current_frame_time;
 
+	remoting_output_add_damage_meta(output, buffer);
+
 	weston_compositor_read_presentation_clock(output->remoting->compositor,
 						  &current_frame_ts);
 	current_frame_time = GST_TIMESPEC_TO_TIME(current_frame_ts);
@@ -542,7 +648,26 @@ remoting_output_gst_push_buffer(struct remoted_output *output,
 	GST_BUFFER_DURATION(buffer) = GST_CLOCK_TIME_NONE;
 
 	gst_app_src_push_buffer(output->appsrc, buffer);
-	output->submitted_frame = true;
+	output->frames_pushed++;
+}
+
+static void
+remoting_output_gst_push_buffer(struct remoted_output *output,
+				GstBuffer *buffer)
+{
+	/* While the encoder is backed up, keep only the newest frame. Its
+	 * content supersedes any frame merged before, and the damage keeps
+	 * accumulating until it is finally pushed. */
+	if (remoting_output_encoder_backed_up(output)) {
+		if (output->merged_buffer)
+			gst_buffer_unref(output->merged_buffer);
+		output->merged_buffer = buffer;
+		output->frames_merged++;
+	} else {
+		remoting_output_gst_deliver_buffer(output, buffer);
+	}
+
+	remoting_output_frame_submitted(output);
 }
 
 static int
@@ -575,18 +700,38 @@ remoting_output_frame(struct weston_output *output_base, int fd, int stride,
 	gsize offset = 0;
 	struct mem_free_cb_data *cb_data;
 	struct gst_frame_buffer_data *frame_data;
+	pixman_region32_t damage;
+	bool has_damage;
 
 	if (!output)
 		return -1;
 
+	pixman_region32_init(&damage);
+	pixman_region32_copy(&damage, &output->repaint_damage);
+	weston_output_region_from_global(output->output, &damage);
+	pixman_region32_union(&output->damage, &output->damage, &damage);
+	has_damage = pixman_region32_not_empty(&damage);
+	pixman_region32_fini(&damage);
+
+	/* Nothing changed on screen: complete the frame without waking up
+	 * the pipeline at all. */
+	if (!has_damage) {
+		close(fd);
+		api->buffer_released(output_buffer);
+		output->frames_skipped++;
+		remoting_output_frame_submitted(output);
+		return 0;
+	}
+
 	cb_data = zalloc(sizeof *cb_data);
 	if (!cb_data)
 		return -1;
 
 	mode = output->output->current_mode;
+	output->frame_size = (gsize)stride * mode->height;
 	buf = gst_buffer_new();
 	mem = gst_dmabuf_allocator_alloc(remoting->allocator, fd,
-					 stride * mode->height);
+					 output->frame_size);
 	gst_buffer_append_memory(buf, mem);
 	gst_buffer_add_video_meta_full(buf,
 				       GST_VIDEO_FRAME_FLAG_NONE,
@@ -640,10 +785,18 @@ remoting_output_destroy(struct weston_output *output)
 		free(mode);
 	}
 
+	weston_log("remoting: output %s: %u frames pushed, %u merged, "
+		   "%u skipped without damage\n", output->name,
+		   remoted_output->frames_pushed,
+		   remoted_output->frames_merged,
+		   remoted_output->frames_skipped);
+
 	remoted_output->saved_destroy(output);
 
 	remoting_gst_pipeline_deinit(remoted_output);
 	remoting_gstpipe_release(&remoted_output->gstpipe);
+	pixman_region32_fini(&remoted_output->repaint_damage);
+	pixman_region32_fini(&remoted_output->damage);
 
 	if (remoted_output->host)
 		free(remoted_output->host);
@@ -660,17 +813,27 @@ static int
 remoting_output_start_repaint_loop(struct weston_output *output)
 {
 	struct remoted_output *remoted_output = lookup_remoted_output(output);
-	int64_t msec;
 
 	remoted_output->saved_start_repaint_loop(output);
 
-	msec = millihz_to_nsec(remoted_output->output->current_mode->refresh)
-			/ 1000000;
-	wl_event_source_timer_update(remoted_output->finish_frame_timer, msec);
+	remoting_output_arm_finish_frame_timer(remoted_output);
 
 	return 0;
 }
 
+static int
+remoting_output_repaint(struct weston_output *output,
+			pixman_region32_t *damage, void *repaint_data)
+{
+	struct remoted_output *remoted_output = lookup_remoted_output(output);
+
+	/* Stash the damage for remoting_output_frame(), which gets called
+	 * from within the virtual output's repaint. */
+	pixman_region32_copy(&remoted_output->repaint_damage, damage);
+
+	return remoted_output->saved_repaint(output, damage, repaint_data);
+}
+
 static void
 remoting_output_set_dpms(struct weston_output *base_output, enum dpms_enum level)
 {
@@ -701,6 +864,8 @@ remoting_output_enable(struct weston_output *output)
 
 	remoted_output->saved_start_repaint_loop = output->start_repaint_loop;
 	output->start_repaint_loop = remoting_output_start_repaint_loop;
+	remoted_output->saved_repaint = output->repaint;
+	output->repaint = remoting_output_repaint;
 	output->set_dpms = remoting_output_set_dpms;
 
 	ret = remoting_gst_pipeline_init(remoted_output);
@@ -725,6 +890,12 @@ remoting_output_disable(struct weston_output *output)
 	struct remoted_output *remoted_output = lookup_remoted_output(output);
 
 	wl_event_source_remove(remoted_output->finish_frame_timer);
+	remoted_output->finish_frame_timer_armed = false;
+	if (remoted_output->merged_buffer) {
+		gst_buffer_unref(remoted_output->merged_buffer);
+		remoted_output->merged_buffer = NULL;
+	}
+	pixman_region32_clear(&remoted_output->damage);
 	remoting_gst_pipeline_deinit(remoted_output);
 
 	return remoted_output->saved_disable(output);
@@ -774,6 +945,9 @@ remoting_output_create(struct weston_compositor *c, char *name)
 	output->saved_disable = output->output->disable;
 	output->output->disable = remoting_output_disable;
 	output->remoting = remoting;
+	output->max_queued_frames = DEFAULT_MAX_QUEUED_FRAMES;
+	pixman_region32_init(&output->repaint_damage);
+	pixman_region32_init(&output->damage);
 	wl_list_insert(remoting->output_list.prev, &output->link);
 
 	asprintf(&remoting_name, "%s-%s", connector_name, name);
@@ -909,6 +1083,16 @@ remoting_output_set_gst_pipeline(struct weston_output *output,
 	remoted_output->gst_pipeline = strdup(gst_pipeline);
 }
 
+static void
+remoting_output_set_max_queued_frames(struct weston_output *output,
+				      int max_queued_frames)
+{
+	struct remoted_output *remoted_output = lookup_remoted_output(output);
+
+	if (remoted_output)
+		remoted_output->max_queued_frames = max_queued_frames;
+}
+
 static const struct weston_remoting_api remoting_api = {
 	remoting_output_create,
 	remoting_output_is_remoted,
@@ -918,6 +1102,7 @@ static const struct weston_remoting_api remoting_api = {
 	remoting_output_set_host,
 	remoting_output_set_port,
 	remoting_output_set_gst_pipeline,
+	remoting_output_set_max_queued_frames,
 };
 
 WL_EXPORT int
@@ -26,6 +26,7 @@
 
 #include "config.h"
 
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -355,19 +356,13 @@ loaded_cairo_surface_destructor(void *data)
 static const cairo_user_data_key_t weston_cairo_util_load_cairo_surface_key;
 
 cairo_surface_t *
-load_cairo_surface(const char *filename)
+create_cairo_surface_for_image(pixman_image_t *image)
 {
 	cairo_surface_t *surface;
 	cairo_status_t ret;
-	pixman_image_t *image;
 	int width, height, stride;
 	void *data;
 
-	image = load_image(filename);
-	if (image == NULL) {
-		return NULL;
-	}
-
 	data = pixman_image_get_data(image);
 	width = pixman_image_get_width(image);
 	height = pixman_image_get_height(image);
@@ -394,6 +389,19 @@ fail:
 	return NULL;
 }
 
+cairo_surface_t *
+load_cairo_surface(const char *filename)
+{
+	pixman_image_t *image;
+
+	image = load_image(filename);
+	if (image == NULL) {
+		return NULL;
+	}
+
+	return create_cairo_surface_for_image(image);
+}
+
 void
 theme_set_background_source(struct theme *t, cairo_t *cr, uint32_t flags)
 {
@@ -516,15 +524,188 @@ create_layout(cairo_t *cr, const char *title)
 	cairo_show_text(cr, title)
 #endif
 
+/* Room around the cached title for glyphs overhanging their extents */
+#define TITLE_PAD 2
+
+void
+theme_title_cache_release(struct theme_title_cache *cache)
+{
+	if (cache->surface)
+		cairo_surface_destroy(cache->surface);
+	free(cache->title);
+	memset(cache, 0, sizeof *cache);
+}
+
+static int
+theme_title_cache_valid(const struct theme_title_cache *cache,
+			const char *title, int width, uint32_t flags,
+			double scale)
+{
+	return cache->surface &&
+	       strcmp(cache->title, title) == 0 &&
+	       !((cache->flags ^ flags) & THEME_FRAME_ACTIVE) &&
+	       cache->scale == scale &&
+	       width >= cache->min_width && width <= cache->max_width;
+}
+
+/* Lays out and renders the title once, at the resolution of the target. */
+static void
+theme_title_cache_update(struct theme_title_cache *cache, cairo_t *cr,
+			 const char *title, int width, uint32_t flags,
+			 double scale)
+{
+	cairo_font_options_t *options;
+	cairo_t *tcr;
+	int text_width, text_height, baseline;
+	int surface_width, surface_height;
+#ifdef HAVE_PANGO
+	PangoLayout *title_layout;
+	PangoRectangle logical;
+#else
+	cairo_text_extents_t extents;
+	cairo_font_extents_t font_extents;
+#endif
+
+	theme_title_cache_release(cache);
+
+#ifdef HAVE_PANGO
+	title_layout = create_layout(cr, title);
+
+	pango_layout_get_pixel_extents(title_layout, NULL, &logical);
+	text_width = MIN(width, logical.width);
+	text_height = logical.height;
+	if (text_width < logical.width) {
+		pango_layout_set_width(title_layout, text_width * PANGO_SCALE);
+		cache->min_width = width;
+		cache->max_width = width;
+	} else {
+		cache->min_width = logical.width;
+		cache->max_width = INT_MAX;
+	}
+
+	baseline = 0;
+	surface_width = text_width;
+	surface_height = text_height;
+#else
+	cairo_save(cr);
+	cairo_select_font_face(cr, "sans",
+			       CAIRO_FONT_SLANT_NORMAL,
+			       CAIRO_FONT_WEIGHT_BOLD);
+	cairo_set_font_size(cr, 14);
+	cairo_text_extents(cr, title, &extents);
+	cairo_font_extents(cr, &font_extents);
+	cairo_restore(cr);
+
+	text_width = extents.width;
+	text_height = font_extents.descent - font_extents.ascent;
+	cache->min_width = 0;
+	cache->max_width = INT_MAX;
+
+	baseline = ceil(font_extents.ascent);
+	surface_width = ceil(extents.x_bearing + extents.width);
+	surface_height = baseline + ceil(font_extents.descent);
+#endif
+
+	cache->surface =
+		cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+			ceil((surface_width + 1 + 2 * TITLE_PAD) * scale),
+			ceil((surface_height + 1 + 2 * TITLE_PAD) * scale));
+	tcr = cairo_create(cache->surface);
+	cairo_scale(tcr, scale, scale);
+
+	options = cairo_font_options_create();
+	cairo_get_font_options(cr, options);
+	cairo_set_font_options(tcr, options);
+	cairo_font_options_destroy(options);
+
+#ifdef HAVE_PANGO
+	pango_cairo_update_layout(tcr, title_layout);
+#else
+	cairo_select_font_face(tcr, "sans",
+			       CAIRO_FONT_SLANT_NORMAL,
+			       CAIRO_FONT_WEIGHT_BOLD);
+	cairo_set_font_size(tcr, 14);
+#endif
+
+	if (flags & THEME_FRAME_ACTIVE) {
+		cairo_move_to(tcr, TITLE_PAD + 1, TITLE_PAD + baseline + 1);
+		cairo_set_source_rgb(tcr, 1, 1, 1);
+		SHOW_TEXT(tcr);
+		cairo_move_to(tcr, TITLE_PAD, TITLE_PAD + baseline);
+		cairo_set_source_rgb(tcr, 0, 0, 0);
+		SHOW_TEXT(tcr);
+	} else {
+		cairo_move_to(tcr, TITLE_PAD, TITLE_PAD + baseline);
+		cairo_set_source_rgb(tcr, 0.4, 0.4, 0.4);
+		SHOW_TEXT(tcr);
+	}
+
+	cairo_destroy(tcr);
+#ifdef HAVE_PANGO
+	g_object_unref(title_layout);
+#endif
+
+	cache->title = strdup(title);
+	cache->flags = flags;
+	cache->scale = scale;
+	cache->text_width = text_width;
+	cache->text_height = text_height;
+	cache->baseline = baseline;
+
+	if (!cache->title ||
+	    cairo_surface_status(cache->surface) != CAIRO_STATUS_SUCCESS)
+		theme_title_cache_release(cache);
+}
+
+static void
+theme_render_title(struct theme *t, cairo_t *cr, int width, int margin,
+		   const char *title, cairo_rectangle_int_t *title_rect,
+		   struct theme_title_cache *cache, uint32_t flags)
+{
+	cairo_pattern_t *pattern;
+	cairo_matrix_t matrix;
+	double sx = 1.0, sy = 0.0;
+	double scale;
+	int x, y;
+
+	/* Render at the resolution of the target, whatever its transform */
+	cairo_user_to_device_distance(cr, &sx, &sy);
+	scale = hypot(sx, sy);
+
+	if (!theme_title_cache_valid(cache, title, title_rect->width,
+				     flags, scale))
+		theme_title_cache_update(cache, cr, title, title_rect->width,
+					 flags, scale);
+	if (!cache->surface)
+		return;
+
+	x = (width - cache->text_width) / 2;
+	y = margin + (t->titlebar_height - cache->text_height) / 2;
+	if (x < title_rect->x)
+		x = title_rect->x;
+	else if (x + cache->text_width > (title_rect->x + title_rect->width))
+		x = (title_rect->x + title_rect->width) - cache->text_width;
+
+	pattern = cairo_pattern_create_for_surface(cache->surface);
+	cairo_matrix_init_scale(&matrix, scale, scale);
+	cairo_matrix_translate(&matrix, -(x - TITLE_PAD),
+			       -(y - cache->baseline - TITLE_PAD));
+	cairo_pattern_set_matrix(pattern, &matrix);
+	cairo_set_source(cr, pattern);
+	cairo_pattern_destroy(pattern);
+	cairo_paint(cr);
+}
+
 void
 theme_render_frame(struct theme *t,
 		   cairo_t *cr, int width, int height,
 		   const char *title, cairo_rectangle_int_t *title_rect,
-		   struct wl_list *buttons, uint32_t flags)
+		   struct wl_list *buttons, struct theme_title_cache *cache,
+		   uint32_t flags)
 {
+	struct theme_title_cache uncached = { 0 };
 	cairo_surface_t *source;
-	int x, y, margin, top_margin;
-	int text_width, text_height;
+	int margin, top_margin;
 
 	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
 	cairo_set_source_rgba(cr, 0, 0, 0, 0);
@@ -554,58 +735,15 @@ theme_render_frame(struct theme *t,
 		    width - margin * 2, height - margin * 2,
 		    t->width, top_margin);
 
-	if (title || !wl_list_empty(buttons)) {
-
+	if (title) {
 		cairo_rectangle (cr, title_rect->x, title_rect->y,
 				 title_rect->width, title_rect->height);
 		cairo_clip(cr);
 		cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
 
-#ifdef HAVE_PANGO
-		PangoLayout *title_layout;
-		PangoRectangle logical;
-
-		title_layout = create_layout(cr, title);
-
-		pango_layout_get_pixel_extents (title_layout, NULL, &logical);
-		text_width = MIN(title_rect->width, logical.width);
-		text_height = logical.height;
-		if (text_width < logical.width)
-		  pango_layout_set_width (title_layout, text_width * PANGO_SCALE);
-
-#else
-		cairo_text_extents_t extents;
-		cairo_font_extents_t font_extents;
-
-		cairo_select_font_face(cr, "sans",
-				       CAIRO_FONT_SLANT_NORMAL,
-				       CAIRO_FONT_WEIGHT_BOLD);
-		cairo_set_font_size(cr, 14);
-		cairo_text_extents(cr, title, &extents);
-		cairo_font_extents (cr, &font_extents);
-		text_width = extents.width;
-		text_height = font_extents.descent - font_extents.ascent;
-#endif
-
-		x = (width - text_width) / 2;
-		y = margin + (t->titlebar_height - text_height) / 2;
-		if (x < title_rect->x)
-			x = title_rect->x;
-		else if (x + text_width > (title_rect->x + title_rect->width))
-			x = (title_rect->x + title_rect->width) - text_width;
-
-		if (flags & THEME_FRAME_ACTIVE) {
-			cairo_move_to(cr, x + 1, y  + 1);
-			cairo_set_source_rgb(cr, 1, 1, 1);
-			SHOW_TEXT(cr);
-			cairo_move_to(cr, x, y);
-			cairo_set_source_rgb(cr, 0, 0, 0);
-			SHOW_TEXT(cr);
-		} else {
-			cairo_move_to(cr, x, y);
-			cairo_set_source_rgb(cr, 0.4, 0.4, 0.4);
-			SHOW_TEXT(cr);
-		}
+		theme_render_title(t, cr, width, margin, title, title_rect,
+				   cache ? cache : &uncached, flags);
+		theme_title_cache_release(&uncached);
 	}
 }
 
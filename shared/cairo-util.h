@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 #include <cairo.h>
+#include <pixman.h>
 
 #include <wayland-client.h>
 #include <wayland-util.h>
@@ -49,6 +50,10 @@ rounded_rect(cairo_t *cr, int x0, int y0, int x1, int y1, int radius);
 cairo_surface_t *
 load_cairo_surface(const char *filename);
 
+/* Takes over the reference to the image. */
+cairo_surface_t *
+create_cairo_surface_for_image(pixman_image_t *image);
+
 struct theme {
 	cairo_surface_t *active_frame;
 	cairo_surface_t *inactive_frame;
@@ -70,13 +75,32 @@ enum {
 	THEME_FRAME_NO_TITLE = 4
 };
 
+/*
+ * The title text of a frame, laid out and rendered once. It is reused by
+ * theme_render_frame() until the title, the active state, the scale of
+ * the target or the room the text needs changes.
+ */
+struct theme_title_cache {
+	cairo_surface_t *surface;
+	char *title;
+	uint32_t flags;
+	double scale;
+	int min_width, max_width;
+	int text_width, text_height;
+	int baseline;
+};
+
+void
+theme_title_cache_release(struct theme_title_cache *cache);
+
 void
 theme_set_background_source(struct theme *t, cairo_t *cr, uint32_t flags);
 void
 theme_render_frame(struct theme *t,
 		   cairo_t *cr, int width, int height,
 		   const char *title, cairo_rectangle_int_t *title_rect,
-		   struct wl_list *buttons, uint32_t flags);
+		   struct wl_list *buttons, struct theme_title_cache *cache,
+		   uint32_t flags);
 
 enum theme_location {
 	THEME_LOCATION_INTERIOR = 0,
@@ -100,6 +100,7 @@ struct frame {
 	int geometry_dirty;
 
 	cairo_rectangle_int_t title_rect;
+	struct theme_title_cache title_cache;
 
 	uint32_t status;
 
@@ -319,6 +320,7 @@ frame_destroy(struct frame *frame)
 	wl_list_for_each_safe(pointer, next_pointer, &frame->pointers, link)
 		frame_pointer_destroy(pointer);
 
+	theme_title_cache_release(&frame->title_cache);
 	free(frame->title);
 	free(frame);
 }
@@ -433,6 +435,10 @@ frame_set_title(struct frame *frame, const char *title)
 {
 	char *dup = NULL;
 
+	if (frame->title == title ||
+	    (frame->title && title && strcmp(frame->title, title) == 0))
+		return 0;
+
 	if (title) {
 		dup = strdup(title);
 		if (!dup)
@@ -1011,7 +1017,7 @@ frame_repaint(struct frame *frame, cairo_t *cr)
 	cairo_save(cr);
 	theme_render_frame(frame->theme, cr, frame->width, frame->height,
 			   frame->title, &frame->title_rect,
-			   &frame->buttons, flags);
+			   &frame->buttons, &frame->title_cache, flags);
 	cairo_restore(cr);
 
 	wl_list_for_each(button, &frame->buttons, link)
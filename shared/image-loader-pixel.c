@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2008-2012 Kristian Høgsberg
+ * Copyright © 2012 Intel Corporation
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* SSSE3 is not part of the x86-64 baseline, so the SSSE3 code is built
+ * for it with a target attribute and only called if the CPU has it. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SSSE3_DISPATCH 1
+#include <tmmintrin.h>
+#endif
+
+#include "image-loader-pixel.h"
+
+static inline int
+multiply_alpha(int alpha, int color)
+{
+    int temp = (alpha * color) + 0x80;
+
+    return ((temp + (temp >> 8)) >> 8);
+}
+
+static inline uint32_t
+premultiply_pixel(const uint8_t *p)
+{
+	uint32_t alpha = p[3];
+	uint32_t red   = p[0];
+	uint32_t green = p[1];
+	uint32_t blue  = p[2];
+
+	if (alpha == 0)
+		return 0;
+
+	if (alpha != 0xff) {
+		red   = multiply_alpha(alpha, red);
+		green = multiply_alpha(alpha, green);
+		blue  = multiply_alpha(alpha, blue);
+	}
+
+	return (alpha << 24) | (red << 16) | (green << 8) | (blue << 0);
+}
+
+void
+premultiply_row_scalar(uint8_t *row, size_t width)
+{
+	size_t i;
+
+	for (i = 0; i < width; i++)
+		((uint32_t *) row)[i] = premultiply_pixel(row + i * 4);
+}
+
+#ifdef __SSE2__
+/* Premultiplies two RGBA pixels widened to 16 bits per channel and
+ * reorders them to BGRA, which is a8r8g8b8 in little-endian memory.
+ * The alpha channel is multiplied by 0xff, which multiply_alpha() keeps
+ * exact, so the result matches premultiply_pixel() bit for bit. */
+static inline __m128i
+premultiply_2x16(__m128i px)
+{
+	const __m128i color_mask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+	const __m128i alpha_one = _mm_set_epi16(0xff, 0, 0, 0, 0xff, 0, 0, 0);
+	__m128i a, t;
+
+	a = _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm_or_si128(_mm_and_si128(a, color_mask), alpha_one);
+
+	t = _mm_add_epi16(_mm_mullo_epi16(px, a), _mm_set1_epi16(0x80));
+	t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+
+	t = _mm_shufflelo_epi16(t, _MM_SHUFFLE(3, 0, 1, 2));
+	return _mm_shufflehi_epi16(t, _MM_SHUFFLE(3, 0, 1, 2));
+}
+#endif
+
+void
+premultiply_row(uint8_t *row, size_t width)
+{
+	size_t i = 0;
+
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	__m128i v, lo, hi;
+
+	for (; i + 4 <= width; i += 4) {
+		v = _mm_loadu_si128((const __m128i *) (row + i * 4));
+		lo = premultiply_2x16(_mm_unpacklo_epi8(v, zero));
+		hi = premultiply_2x16(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128((__m128i *) (row + i * 4),
+				 _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	premultiply_row_scalar(row + i * 4, width - i);
+}
+
+static inline void
+swizzle_pixel(uint8_t *row, size_t i)
+{
+	uint8_t *s = row + i * 3;
+
+	((uint32_t *) row)[i] =
+		0xff000000 | (s[0] << 16) | (s[1] << 8) | (s[2] << 0);
+}
+
+/* The row is walked backwards, so that no pixel is overwritten before it
+ * is read. */
+void
+swizzle_row_scalar(uint8_t *row, size_t width)
+{
+	size_t i;
+
+	for (i = width; i > 0; i--)
+		swizzle_pixel(row, i - 1);
+}
+
+#ifdef HAVE_SSSE3_DISPATCH
+__attribute__((target("ssse3")))
+static void
+swizzle_row_ssse3(uint8_t *row, size_t width)
+{
+	const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1,
+					      8, 7, 6, -1, 11, 10, 9, -1);
+	const __m128i opaque = _mm_set1_epi32(0xff000000);
+	size_t i = width;
+	__m128i v;
+
+	for (; i % 4 != 0; i--)
+		swizzle_pixel(row, i - 1);
+
+	/* Each load reads 4 bytes past its 12 bytes of RGB, which are
+	 * still inside the row and before anything already written. */
+	for (; i >= 4; i -= 4) {
+		v = _mm_loadu_si128((const __m128i *) (row + (i - 4) * 3));
+		v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), opaque);
+		_mm_storeu_si128((__m128i *) (row + (i - 4) * 4), v);
+	}
+}
+#endif
+
+void
+swizzle_row(uint8_t *row, size_t width)
+{
+#ifdef HAVE_SSSE3_DISPATCH
+	if (__builtin_cpu_supports("ssse3")) {
+		swizzle_row_ssse3(row, width);
+		return;
+	}
+#endif
+
+	swizzle_row_scalar(row, width);
+}
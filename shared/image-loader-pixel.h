@@ -0,0 +1,50 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _IMAGE_LOADER_PIXEL_H
+#define _IMAGE_LOADER_PIXEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Converts a row of non-premultiplied RGBA bytes, as libpng decodes
+ * them, to premultiplied a8r8g8b8 in place. */
+void
+premultiply_row(uint8_t *row, size_t width);
+
+/* Expands a row of RGB triplets to opaque a8r8g8b8 in place. The row
+ * must have room for width * 4 bytes. */
+void
+swizzle_row(uint8_t *row, size_t width);
+
+/* The plain C versions of the above, which the SIMD versions must match
+ * bit for bit. */
+void
+premultiply_row_scalar(uint8_t *row, size_t width);
+
+void
+swizzle_row_scalar(uint8_t *row, size_t width);
+
+#endif
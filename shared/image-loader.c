@@ -27,15 +27,22 @@
 #include "config.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <png.h>
 #include <pixman.h>
+#include <wayland-util.h>
 
 #include "shared/helpers.h"
 #include "image-loader.h"
+#include "image-loader-pixel.h"
 
 #ifdef HAVE_JPEG
 #include <jpeglib.h>
@@ -59,20 +66,14 @@ pixman_image_destroy_func(pixman_image_t *image, void *data)
 
 #ifdef HAVE_JPEG
 
-static void
-swizzle_row(JSAMPLE *row, JDIMENSION width)
-{
-	JSAMPLE *s;
-	uint32_t *d;
-
-	s = row + (width - 1) * 3;
-	d = (uint32_t *) (row + (width - 1) * 4);
-	while (s >= row) {
-		*d = 0xff000000 | (s[0] << 16) | (s[1] << 8) | (s[2] << 0);
-		s -= 3;
-		d--;
-	}
-}
+/* libjpeg-turbo can write a8r8g8b8 itself, with its own SIMD code. */
+#if defined(JCS_EXTENSIONS) && defined(__BYTE_ORDER__)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define JPEG_COLOR_SPACE_A8R8G8B8 JCS_EXT_BGRA
+#else
+#define JPEG_COLOR_SPACE_A8R8G8B8 JCS_EXT_ARGB
+#endif
+#endif
 
 static void
 error_exit(j_common_ptr cinfo)
@@ -103,7 +104,12 @@ load_jpeg(FILE *fp)
 
 	jpeg_read_header(&cinfo, TRUE);
 
+#ifdef JPEG_COLOR_SPACE_A8R8G8B8
+	/* The alpha byte of the extended color spaces is always 0xff. */
+	cinfo.out_color_space = JPEG_COLOR_SPACE_A8R8G8B8;
+#else
 	cinfo.out_color_space = JCS_RGB;
+#endif
 	jpeg_start_decompress(&cinfo);
 
 	stride = cinfo.output_width * 4;
@@ -119,8 +125,10 @@ load_jpeg(FILE *fp)
 			rows[i] = data + (first + i) * stride;
 
 		jpeg_read_scanlines(&cinfo, rows, ARRAY_LENGTH(rows));
+#ifndef JPEG_COLOR_SPACE_A8R8G8B8
 		for (i = 0; first + i < cinfo.output_scanline; i++)
 			swizzle_row(rows[i], cinfo.output_width);
+#endif
 	}
 
 	jpeg_finish_decompress(&cinfo);
@@ -149,43 +157,12 @@ load_jpeg(FILE *fp)
 
 #endif
 
-static inline int
-multiply_alpha(int alpha, int color)
-{
-    int temp = (alpha * color) + 0x80;
-
-    return ((temp + (temp >> 8)) >> 8);
-}
-
 static void
 premultiply_data(png_structp   png,
 		 png_row_infop row_info,
 		 png_bytep     data)
 {
-    unsigned int i;
-    png_bytep p;
-
-    for (i = 0, p = data; i < row_info->rowbytes; i += 4, p += 4) {
-	uint32_t alpha = p[3];
-	uint32_t w;
-
-	if (alpha == 0) {
-		w = 0;
-	} else {
-		uint32_t red   = p[0];
-		uint32_t green = p[1];
-		uint32_t blue  = p[2];
-
-		if (alpha != 0xff) {
-			red   = multiply_alpha(alpha, red);
-			green = multiply_alpha(alpha, green);
-			blue  = multiply_alpha(alpha, blue);
-		}
-		w = (alpha << 24) | (red << 16) | (green << 8) | (blue << 0);
-	}
-
-	* (uint32_t *) p = w;
-    }
+	premultiply_row(data, row_info->rowbytes / 4);
 }
 
 static void
@@ -438,3 +415,226 @@ load_image(const char *filename)
 
 	return image;
 }
+
+/* Decoding is mostly bound by memory bandwidth past a few threads. */
+#define IMAGE_LOADER_POOL_MAX_THREADS 4
+
+struct image_load {
+	struct wl_list link;
+	char *filename;
+	image_loaded_func_t func;
+	void *data;
+	pixman_image_t *image;
+};
+
+struct image_loader_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t job_cond;
+	pthread_cond_t done_cond;
+	struct wl_list pending;	/* image_load::link, not started yet */
+	struct wl_list done;	/* image_load::link, waiting for dispatch */
+	int busy;
+	bool quit;
+
+	/* Written once per decoded image, to wake up the main loop. */
+	int wakeup_fd[2];
+
+	pthread_t threads[IMAGE_LOADER_POOL_MAX_THREADS];
+	int n_threads;
+};
+
+static void
+image_load_destroy(struct image_load *load)
+{
+	if (load->image)
+		pixman_image_unref(load->image);
+	free(load->filename);
+	free(load);
+}
+
+static void *
+image_loader_pool_worker(void *data)
+{
+	struct image_loader_pool *pool = data;
+	struct image_load *load;
+	const char c = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (!pool->quit && wl_list_empty(&pool->pending))
+			pthread_cond_wait(&pool->job_cond, &pool->mutex);
+		if (pool->quit)
+			break;
+
+		load = wl_container_of(pool->pending.next, load, link);
+		wl_list_remove(&load->link);
+		pool->busy++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		load->image = load_image(load->filename);
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->busy--;
+		wl_list_insert(pool->done.prev, &load->link);
+		pthread_cond_broadcast(&pool->done_cond);
+
+		/* A full pipe already wakes up the main loop. */
+		while (write(pool->wakeup_fd[1], &c, 1) < 0 && errno == EINTR)
+			continue;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+struct image_loader_pool *
+image_loader_pool_create(int n_threads)
+{
+	struct image_loader_pool *pool;
+	sigset_t all, saved;
+	long n_cpus;
+
+	if (n_threads <= 0) {
+		n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		n_threads = n_cpus > 0 ? n_cpus : 1;
+	}
+	if (n_threads > IMAGE_LOADER_POOL_MAX_THREADS)
+		n_threads = IMAGE_LOADER_POOL_MAX_THREADS;
+
+	pool = calloc(1, sizeof *pool);
+	if (!pool)
+		return NULL;
+
+	if (pipe2(pool->wakeup_fd, O_CLOEXEC | O_NONBLOCK) < 0) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->job_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+	wl_list_init(&pool->pending);
+	wl_list_init(&pool->done);
+
+	/* Leave all signals to the thread running the main loop. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &saved);
+	while (pool->n_threads < n_threads &&
+	       pthread_create(&pool->threads[pool->n_threads], NULL,
+			      image_loader_pool_worker, pool) == 0)
+		pool->n_threads++;
+	pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+	if (pool->n_threads == 0) {
+		image_loader_pool_destroy(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void
+image_loader_pool_destroy(struct image_loader_pool *pool)
+{
+	struct image_load *load, *tmp;
+	int i;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->job_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->n_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	wl_list_for_each_safe(load, tmp, &pool->pending, link)
+		image_load_destroy(load);
+	wl_list_for_each_safe(load, tmp, &pool->done, link)
+		image_load_destroy(load);
+
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->job_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	close(pool->wakeup_fd[0]);
+	close(pool->wakeup_fd[1]);
+	free(pool);
+}
+
+int
+image_loader_pool_get_fd(struct image_loader_pool *pool)
+{
+	return pool->wakeup_fd[0];
+}
+
+int
+load_image_async(struct image_loader_pool *pool, const char *filename,
+		 image_loaded_func_t func, void *data)
+{
+	struct image_load *load;
+
+	load = calloc(1, sizeof *load);
+	if (!load)
+		return -1;
+
+	if (filename) {
+		load->filename = strdup(filename);
+		if (!load->filename) {
+			free(load);
+			return -1;
+		}
+	}
+	load->func = func;
+	load->data = data;
+
+	pthread_mutex_lock(&pool->mutex);
+	wl_list_insert(pool->pending.prev, &load->link);
+	pthread_cond_signal(&pool->job_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return 0;
+}
+
+int
+image_loader_pool_dispatch(struct image_loader_pool *pool)
+{
+	struct image_load *load, *tmp;
+	struct wl_list done;
+	char buf[64];
+	int count = 0;
+
+	/* Drain first: a wakeup that comes later is for a later image. */
+	while (read(pool->wakeup_fd[0], buf, sizeof buf) > 0)
+		continue;
+
+	wl_list_init(&done);
+	pthread_mutex_lock(&pool->mutex);
+	wl_list_insert_list(&done, &pool->done);
+	wl_list_init(&pool->done);
+	pthread_mutex_unlock(&pool->mutex);
+
+	wl_list_for_each_safe(load, tmp, &done, link) {
+		load->func(load->image, load->data);
+		load->image = NULL;
+		image_load_destroy(load);
+		count++;
+	}
+
+	return count;
+}
+
+void
+image_loader_pool_flush(struct image_loader_pool *pool)
+{
+	bool idle;
+
+	do {
+		pthread_mutex_lock(&pool->mutex);
+		while (wl_list_empty(&pool->done) &&
+		       (pool->busy > 0 || !wl_list_empty(&pool->pending)))
+			pthread_cond_wait(&pool->done_cond, &pool->mutex);
+		idle = wl_list_empty(&pool->done);
+		pthread_mutex_unlock(&pool->mutex);
+
+		image_loader_pool_dispatch(pool);
+	} while (!idle);
+}
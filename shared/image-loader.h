@@ -31,4 +31,37 @@
 pixman_image_t *
 load_image(const char *filename);
 
+/* Decodes images on worker threads. Results are delivered by
+ * image_loader_pool_dispatch(), in the thread calling it, to the callback
+ * given to load_image_async(). The callback takes over the reference to
+ * the image, which is NULL if decoding failed. */
+struct image_loader_pool;
+
+typedef void (*image_loaded_func_t)(pixman_image_t *image, void *data);
+
+/* n_threads <= 0 picks one thread per CPU, up to a small limit. */
+struct image_loader_pool *
+image_loader_pool_create(int n_threads);
+
+/* Drops the images not dispatched yet, without calling their callbacks. */
+void
+image_loader_pool_destroy(struct image_loader_pool *pool);
+
+/* Becomes readable when image_loader_pool_dispatch() has work to do. */
+int
+image_loader_pool_get_fd(struct image_loader_pool *pool);
+
+int
+load_image_async(struct image_loader_pool *pool, const char *filename,
+		 image_loaded_func_t func, void *data);
+
+/* Calls the callbacks of the decoded images, returns how many. */
+int
+image_loader_pool_dispatch(struct image_loader_pool *pool);
+
+/* Waits for and dispatches every image, including those requested by
+ * the callbacks themselves. */
+void
+image_loader_pool_flush(struct image_loader_pool *pool);
+
 #endif
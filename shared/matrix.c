@@ -31,6 +31,10 @@
 #include <stdlib.h>
 #include <math.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifdef UNIT_TEST
 #define WL_EXPORT
 #else
@@ -129,6 +133,202 @@ weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v)
 	*v = t;
 }
 
+/*
+ * Kernels of weston_matrix_transform_points(). The points are (x, y, 0, 1),
+ * so only the columns 0, 1 and 3 of the matrix are involved. Each kernel
+ * handles four points per iteration with SSE2 when available, and the
+ * remaining points with the same arithmetic in scalar code, so that the
+ * result does not depend on the position of a point in the array.
+ */
+
+static void
+transform_points_translate(const float *d, const float *x, const float *y,
+			   float *out_x, float *out_y, int n)
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128 tx = _mm_set1_ps(d[12]);
+	const __m128 ty = _mm_set1_ps(d[13]);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+
+		_mm_storeu_ps(out_x + i, _mm_add_ps(vx, tx));
+		_mm_storeu_ps(out_y + i, _mm_add_ps(vy, ty));
+	}
+#endif
+
+	for (; i < n; i++) {
+		out_x[i] = x[i] + d[12];
+		out_y[i] = y[i] + d[13];
+	}
+}
+
+static void
+transform_points_scale(const float *d, const float *x, const float *y,
+		       float *out_x, float *out_y, int n)
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128 sx = _mm_set1_ps(d[0]);
+	const __m128 sy = _mm_set1_ps(d[5]);
+	const __m128 tx = _mm_set1_ps(d[12]);
+	const __m128 ty = _mm_set1_ps(d[13]);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+
+		_mm_storeu_ps(out_x + i, _mm_add_ps(_mm_mul_ps(vx, sx), tx));
+		_mm_storeu_ps(out_y + i, _mm_add_ps(_mm_mul_ps(vy, sy), ty));
+	}
+#endif
+
+	for (; i < n; i++) {
+		out_x[i] = x[i] * d[0] + d[12];
+		out_y[i] = y[i] * d[5] + d[13];
+	}
+}
+
+static void
+transform_points_affine(const float *d, const float *x, const float *y,
+			float *out_x, float *out_y, int n)
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128 m0 = _mm_set1_ps(d[0]);
+	const __m128 m1 = _mm_set1_ps(d[1]);
+	const __m128 m4 = _mm_set1_ps(d[4]);
+	const __m128 m5 = _mm_set1_ps(d[5]);
+	const __m128 m12 = _mm_set1_ps(d[12]);
+	const __m128 m13 = _mm_set1_ps(d[13]);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		__m128 tx, ty;
+
+		tx = _mm_add_ps(_mm_mul_ps(vx, m0), _mm_mul_ps(vy, m4));
+		ty = _mm_add_ps(_mm_mul_ps(vx, m1), _mm_mul_ps(vy, m5));
+		_mm_storeu_ps(out_x + i, _mm_add_ps(tx, m12));
+		_mm_storeu_ps(out_y + i, _mm_add_ps(ty, m13));
+	}
+#endif
+
+	for (; i < n; i++) {
+		float px = x[i], py = y[i];
+
+		out_x[i] = px * d[0] + py * d[4] + d[12];
+		out_y[i] = px * d[1] + py * d[5] + d[13];
+	}
+}
+
+static int
+transform_points_projective(const float *d, const float *x, const float *y,
+			    float *out_x, float *out_y, int n)
+{
+	int unstable = 0;
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128 m0 = _mm_set1_ps(d[0]);
+	const __m128 m1 = _mm_set1_ps(d[1]);
+	const __m128 m3 = _mm_set1_ps(d[3]);
+	const __m128 m4 = _mm_set1_ps(d[4]);
+	const __m128 m5 = _mm_set1_ps(d[5]);
+	const __m128 m7 = _mm_set1_ps(d[7]);
+	const __m128 m12 = _mm_set1_ps(d[12]);
+	const __m128 m13 = _mm_set1_ps(d[13]);
+	const __m128 m15 = _mm_set1_ps(d[15]);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 min_w = _mm_set1_ps(1e-6f);
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		__m128 tx, ty, tw, stable;
+		int mask;
+
+		tx = _mm_add_ps(_mm_mul_ps(vx, m0), _mm_mul_ps(vy, m4));
+		ty = _mm_add_ps(_mm_mul_ps(vx, m1), _mm_mul_ps(vy, m5));
+		tw = _mm_add_ps(_mm_mul_ps(vx, m3), _mm_mul_ps(vy, m7));
+		tx = _mm_add_ps(tx, m12);
+		ty = _mm_add_ps(ty, m13);
+		tw = _mm_add_ps(tw, m15);
+
+		/* Lanes with a vanishing divisor produce 0, like the
+		 * scalar code below. */
+		stable = _mm_cmpge_ps(_mm_and_ps(tw, abs_mask), min_w);
+		_mm_storeu_ps(out_x + i, _mm_and_ps(_mm_div_ps(tx, tw), stable));
+		_mm_storeu_ps(out_y + i, _mm_and_ps(_mm_div_ps(ty, tw), stable));
+
+		mask = ~_mm_movemask_ps(stable);
+		unstable += (mask & 1) + ((mask >> 1) & 1) +
+			    ((mask >> 2) & 1) + ((mask >> 3) & 1);
+	}
+#endif
+
+	for (; i < n; i++) {
+		float px = x[i], py = y[i];
+		float w = px * d[3] + py * d[7] + d[15];
+
+		if (!(fabsf(w) >= 1e-6f)) {
+			out_x[i] = 0;
+			out_y[i] = 0;
+			unstable++;
+			continue;
+		}
+
+		out_x[i] = (px * d[0] + py * d[4] + d[12]) / w;
+		out_y[i] = (px * d[1] + py * d[5] + d[13]) / w;
+	}
+
+	return unstable;
+}
+
+/** Transform an array of 2D points
+ *
+ * \param matrix The transformation.
+ * \param x The x coordinates of the points.
+ * \param y The y coordinates of the points.
+ * \param out_x Where to store the transformed x coordinates, may be \c x.
+ * \param out_y Where to store the transformed y coordinates, may be \c y.
+ * \param n The number of points.
+ * \return The number of points whose divisor was too close to zero.
+ *
+ * Every point (x, y, 0, 1) is multiplied by \c matrix and divided by the
+ * resulting w, like weston_matrix_transform() would. Points whose w is
+ * smaller than 1e-6 in absolute value are set to (0, 0) and counted in the
+ * return value.
+ *
+ * The \c type of the matrix selects the arithmetic: a matrix without
+ * WESTON_MATRIX_TRANSFORM_OTHER is assumed affine, and only the
+ * combinations of translation and scaling skip the cross terms.
+ */
+WL_EXPORT int
+weston_matrix_transform_points(const struct weston_matrix *matrix,
+			       const float *x, const float *y,
+			       float *out_x, float *out_y, int n)
+{
+	const float *d = matrix->d;
+
+	if (matrix->type & WESTON_MATRIX_TRANSFORM_OTHER)
+		return transform_points_projective(d, x, y, out_x, out_y, n);
+
+	if (matrix->type & WESTON_MATRIX_TRANSFORM_ROTATE)
+		transform_points_affine(d, x, y, out_x, out_y, n);
+	else if (matrix->type & WESTON_MATRIX_TRANSFORM_SCALE)
+		transform_points_scale(d, x, y, out_x, out_y, n);
+	else
+		transform_points_translate(d, x, y, out_x, out_y, n);
+
+	return 0;
+}
+
 static inline void
 swap_rows(double *a, double *b)
 {
@@ -0,0 +1,247 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <libweston/libweston.h>
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "damage-policy.h"
+
+static void
+region_init_boxes(pixman_region32_t *region, const pixman_box32_t *boxes,
+		  int n)
+{
+	pixman_region32_init_rects(region, boxes, n);
+	assert(pixman_region32_selfcheck(region));
+}
+
+/* The policy output must be a valid region containing the input. */
+static void
+apply_and_check(struct weston_damage_policy *policy,
+		pixman_region32_t *region)
+{
+	pixman_region32_t original, missed;
+
+	pixman_region32_init(&original);
+	pixman_region32_copy(&original, region);
+
+	weston_damage_policy_apply(policy, region);
+
+	assert(pixman_region32_selfcheck(region));
+	pixman_region32_init(&missed);
+	pixman_region32_subtract(&missed, &original, region);
+	assert(!pixman_region32_not_empty(&missed));
+
+	pixman_region32_fini(&missed);
+	pixman_region32_fini(&original);
+}
+
+static void
+assert_region_is_boxes(pixman_region32_t *region,
+		       const pixman_box32_t *boxes, int n)
+{
+	pixman_region32_t expected;
+
+	region_init_boxes(&expected, boxes, n);
+	assert(pixman_region32_equal(region, &expected));
+	pixman_region32_fini(&expected);
+}
+
+TEST(damage_policy_disabled)
+{
+	static const pixman_box32_t boxes[] = {
+		{ 0, 0, 10, 10 },
+		{ 20, 0, 30, 10 },
+	};
+	struct weston_damage_policy policy = { 0 };
+	pixman_region32_t region;
+
+	region_init_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	apply_and_check(&policy, &region);
+
+	assert_region_is_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	assert(policy.n_regions == 0);
+
+	pixman_region32_fini(&region);
+}
+
+TEST(damage_policy_waste_budget)
+{
+	/* The extents waste 100 of 300 pixels, 33 %. */
+	static const pixman_box32_t boxes[] = {
+		{ 0, 0, 10, 10 },
+		{ 20, 0, 30, 10 },
+	};
+	static const pixman_box32_t extents = { 0, 0, 30, 10 };
+	struct weston_damage_policy policy = { 0 };
+	pixman_region32_t region;
+
+	policy.max_waste_percent = 30;
+	region_init_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	apply_and_check(&policy, &region);
+	assert_region_is_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	pixman_region32_fini(&region);
+
+	policy.max_waste_percent = 34;
+	region_init_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	apply_and_check(&policy, &region);
+	assert_region_is_boxes(&region, &extents, 1);
+	pixman_region32_fini(&region);
+
+	assert(policy.n_regions == 2);
+	assert(policy.n_rects_in == 4);
+	assert(policy.n_rects_out == 3);
+}
+
+TEST(damage_policy_merges_neighbours_only)
+{
+	/* The first two merge wasting 10 of 210 pixels, the third one is
+	 * too far from them. */
+	static const pixman_box32_t boxes[] = {
+		{ 0, 0, 10, 10 },
+		{ 11, 0, 21, 10 },
+		{ 100, 0, 110, 10 },
+	};
+	static const pixman_box32_t merged[] = {
+		{ 0, 0, 21, 10 },
+		{ 100, 0, 110, 10 },
+	};
+	struct weston_damage_policy policy = { .max_waste_percent = 10 };
+	pixman_region32_t region;
+
+	region_init_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	apply_and_check(&policy, &region);
+	assert_region_is_boxes(&region, merged, ARRAY_LENGTH(merged));
+
+	pixman_region32_fini(&region);
+}
+
+TEST(damage_policy_rebands_overlapping_boxes)
+{
+	/* The first band merges with the left rectangle of the second one,
+	 * giving a box that overlaps the right rectangle of that band. */
+	static const pixman_box32_t boxes[] = {
+		{ 0, 0, 20, 10 },
+		{ 0, 10, 5, 11 },
+		{ 15, 10, 30, 11 },
+	};
+	static const pixman_box32_t banded[] = {
+		{ 0, 0, 20, 10 },
+		{ 0, 10, 30, 11 },
+	};
+	static const pixman_box32_t extents = { 0, 0, 30, 11 };
+	struct weston_damage_policy policy = { .max_waste_percent = 10 };
+	pixman_region32_t region;
+
+	region_init_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	assert(pixman_region32_n_rects(&region) == 3);
+	apply_and_check(&policy, &region);
+	assert_region_is_boxes(&region, banded, ARRAY_LENGTH(banded));
+	assert(pixman_region32_n_rects(&region) == 2);
+	pixman_region32_fini(&region);
+
+	/* The rectangle limit counts the re-banded result. */
+	policy.max_rects = 2;
+	region_init_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	apply_and_check(&policy, &region);
+	assert(pixman_region32_n_rects(&region) == 2);
+	pixman_region32_fini(&region);
+
+	policy.max_rects = 1;
+	region_init_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	apply_and_check(&policy, &region);
+	assert_region_is_boxes(&region, &extents, 1);
+	pixman_region32_fini(&region);
+}
+
+TEST(damage_policy_max_rects_fallback)
+{
+	struct weston_damage_policy policy = { .max_rects = 4 };
+	pixman_box32_t boxes[100];
+	pixman_box32_t extents = { 0, 0, 991, 991 };
+	pixman_region32_t region;
+	int i;
+
+	/* A diagonal of pixels no waste budget would merge. */
+	for (i = 0; i < (int) ARRAY_LENGTH(boxes); i++)
+		boxes[i] = (pixman_box32_t) { i * 10, i * 10,
+					      i * 10 + 1, i * 10 + 1 };
+
+	region_init_boxes(&region, boxes, 4);
+	apply_and_check(&policy, &region);
+	assert(pixman_region32_n_rects(&region) == 4);
+	pixman_region32_fini(&region);
+
+	/* Above the limit, also past the on-stack box array. */
+	policy.max_waste_percent = 50;
+	region_init_boxes(&region, boxes, ARRAY_LENGTH(boxes));
+	apply_and_check(&policy, &region);
+	assert_region_is_boxes(&region, &extents, 1);
+	pixman_region32_fini(&region);
+}
+
+TEST(damage_policy_contains_original)
+{
+	static const struct weston_damage_policy policies[] = {
+		{ .max_waste_percent = 5 },
+		{ .max_waste_percent = 25 },
+		{ .max_waste_percent = 75 },
+		{ .max_rects = 8 },
+		{ .max_rects = 8, .max_waste_percent = 25 },
+	};
+	struct weston_damage_policy policy;
+	pixman_box32_t boxes[150];
+	pixman_region32_t region;
+	unsigned p;
+	int round, i, n, x, y;
+
+	srand(49);
+
+	for (round = 0; round < 200; round++) {
+		n = 1 + rand() % ARRAY_LENGTH(boxes);
+		for (i = 0; i < n; i++) {
+			x = rand() % 500;
+			y = rand() % 500;
+			boxes[i] = (pixman_box32_t) { x, y,
+						      x + 1 + rand() % 40,
+						      y + 1 + rand() % 20 };
+		}
+
+		for (p = 0; p < ARRAY_LENGTH(policies); p++) {
+			policy = policies[p];
+			region_init_boxes(&region, boxes, n);
+			apply_and_check(&policy, &region);
+			if (policy.max_rects > 0)
+				assert(pixman_region32_n_rects(&region) <=
+				       policy.max_rects);
+			pixman_region32_fini(&region);
+		}
+	}
+}
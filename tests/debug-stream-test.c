@@ -0,0 +1,215 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "weston-debug-client-protocol.h"
+
+/* Small enough for the stalled streams below to overflow quickly. */
+#define STREAM_BUFFER_KIB 16
+
+/* Each roundtrip logs three protocol messages, some 300 bytes, so this is
+ * far more than any pipe, terminal or socket buffer plus the stream
+ * buffer hold. */
+#define ROUNDTRIPS 2000
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("debug-stream-buffer-size=%d", STREAM_BUFFER_KIB),
+			 cfgln("debug-stream-overflow=drop-oldest"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+enum consumer_type {
+	CONSUMER_PIPE,
+	CONSUMER_PTY,
+	CONSUMER_SOCKET,
+};
+
+static const enum consumer_type consumer_types[] = {
+	CONSUMER_PIPE,
+	CONSUMER_PTY,
+	CONSUMER_SOCKET,
+};
+
+struct stream_state {
+	bool failed;
+	bool complete;
+};
+
+static void
+handle_stream_complete(void *data, struct weston_debug_stream_v1 *stream)
+{
+	struct stream_state *state = data;
+
+	state->complete = true;
+}
+
+static void
+handle_stream_failure(void *data, struct weston_debug_stream_v1 *stream,
+		      const char *message)
+{
+	struct stream_state *state = data;
+
+	testlog("debug stream failed: %s\n", message ? message : "");
+	state->failed = true;
+}
+
+static const struct weston_debug_stream_v1_listener stream_listener = {
+	handle_stream_complete,
+	handle_stream_failure,
+};
+
+/* Creates a consumer that nobody reads from yet: fds[0] is our end, fds[1]
+ * the blocking end handed to the compositor. */
+static void
+consumer_create(enum consumer_type type, int fds[2])
+{
+	struct termios tio;
+
+	switch (type) {
+	case CONSUMER_PIPE:
+		assert(pipe2(fds, O_CLOEXEC) == 0);
+		break;
+	case CONSUMER_PTY:
+		fds[0] = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+		assert(fds[0] >= 0);
+		assert(grantpt(fds[0]) == 0);
+		assert(unlockpt(fds[0]) == 0);
+		fds[1] = open(ptsname(fds[0]), O_RDWR | O_NOCTTY | O_CLOEXEC);
+		assert(fds[1] >= 0);
+
+		/* Keeps the bytes as they are, no \r\n. */
+		assert(tcgetattr(fds[1], &tio) == 0);
+		cfmakeraw(&tio);
+		assert(tcsetattr(fds[1], TCSANOW, &tio) == 0);
+		break;
+	case CONSUMER_SOCKET:
+		assert(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0,
+				  fds) == 0);
+		break;
+	}
+}
+
+/* Every complete line must be one whole protocol message: dropping
+ * messages on overflow must never tear one. */
+static void
+check_lines(const char *data, size_t len)
+{
+	const char *line = data, *end;
+	int n = 0;
+
+	while ((end = memchr(line, '\n', data + len - line))) {
+		assert(line[0] == '[');
+		assert(strstr(line, "[proto] client ") != NULL);
+		assert(strstr(line, "[proto] client ") < end);
+		assert(end[-1] == ')');
+
+		line = end + 1;
+		n++;
+	}
+
+	testlog("%d whole messages read back\n", n);
+	assert(n > 0);
+}
+
+TEST_P(debug_stream_consumer_stalled, consumer_types)
+{
+	const enum consumer_type *type = data;
+	struct stream_state state = { false, false };
+	struct weston_debug_v1 *debug;
+	struct weston_debug_stream_v1 *stream;
+	struct client *client;
+	char *buf;
+	size_t len = 0, size = 1024 * 1024;
+	ssize_t ret;
+	int fds[2];
+	int i;
+
+	client = create_client();
+	debug = bind_to_singleton_global(client, &weston_debug_v1_interface, 1);
+
+	consumer_create(*type, fds);
+	stream = weston_debug_v1_subscribe(debug, "proto", fds[1]);
+	weston_debug_stream_v1_add_listener(stream, &stream_listener, &state);
+
+	/* If the compositor blocked writing the stream, the roundtrips
+	 * would never return. */
+	for (i = 0; i < ROUNDTRIPS; i++)
+		client_roundtrip(client);
+	assert(!state.failed);
+	assert(!state.complete);
+
+	/* The compositor must not have made our end non-blocking: the
+	 * flag belongs to the open file description we share. */
+	assert((fcntl(fds[1], F_GETFL) & O_NONBLOCK) == 0);
+
+	/* What got through is whole messages, with the overflow dropped
+	 * in between rather than queued without bound. */
+	buf = xzalloc(size);
+	assert(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+	for (;;) {
+		ret = read(fds[0], buf + len, size - len);
+		if (ret < 0 && errno == EAGAIN)
+			break;
+		assert(ret > 0);
+		len += ret;
+		assert(len < size);
+	}
+	check_lines(buf, len);
+
+	/* The stream keeps going once the consumer reads again. */
+	client_roundtrip(client);
+	assert(!state.failed);
+
+	free(buf);
+	weston_debug_stream_v1_destroy(stream);
+	weston_debug_v1_destroy(debug);
+	close(fds[0]);
+	close(fds[1]);
+	client_destroy(client);
+}
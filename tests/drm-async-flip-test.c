@@ -0,0 +1,152 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "async-flip.h"
+
+/* What the kernel was asked to commit, and what it accepts. */
+static struct {
+	int n_commits;
+	uint32_t flags[4];
+	bool refuse_async;
+	bool refuse_all;
+} kms;
+
+/* Stands in for libdrm: records the commit flags instead of programming
+ * a device. */
+int
+drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags,
+		    void *user_data)
+{
+	assert(kms.n_commits < (int) ARRAY_LENGTH(kms.flags));
+	kms.flags[kms.n_commits++] = flags;
+
+	if (kms.refuse_all ||
+	    (kms.refuse_async && (flags & DRM_MODE_PAGE_FLIP_ASYNC))) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+#define FLIP_FLAGS (DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK)
+
+static void
+kms_reset(bool refuse_async, bool refuse_all)
+{
+	kms.n_commits = 0;
+	kms.refuse_async = refuse_async;
+	kms.refuse_all = refuse_all;
+}
+
+TEST(drm_async_flip_accepted)
+{
+	bool async = true;
+
+	kms_reset(false, false);
+	assert(drm_atomic_commit_try_async(-1, NULL, FLIP_FLAGS, NULL,
+					   &async) == 0);
+
+	assert(async);
+	assert(kms.n_commits == 1);
+	assert(kms.flags[0] == (FLIP_FLAGS | DRM_MODE_PAGE_FLIP_ASYNC));
+}
+
+TEST(drm_async_flip_refused_falls_back_to_vsync)
+{
+	bool async = true;
+
+	kms_reset(true, false);
+	assert(drm_atomic_commit_try_async(-1, NULL, FLIP_FLAGS, NULL,
+					   &async) == 0);
+
+	/* The same request, in sync with vblank. */
+	assert(!async);
+	assert(kms.n_commits == 2);
+	assert(kms.flags[0] == (FLIP_FLAGS | DRM_MODE_PAGE_FLIP_ASYNC));
+	assert(kms.flags[1] == FLIP_FLAGS);
+}
+
+TEST(drm_async_flip_fallback_failure_is_reported)
+{
+	bool async = true;
+
+	kms_reset(false, true);
+	assert(drm_atomic_commit_try_async(-1, NULL, FLIP_FLAGS, NULL,
+					   &async) < 0);
+
+	assert(!async);
+	assert(kms.n_commits == 2);
+	assert(kms.flags[1] == FLIP_FLAGS);
+}
+
+TEST(drm_async_flip_not_requested)
+{
+	bool async = false;
+
+	kms_reset(false, false);
+	assert(drm_atomic_commit_try_async(-1, NULL, FLIP_FLAGS, NULL,
+					   &async) == 0);
+
+	assert(!async);
+	assert(kms.n_commits == 1);
+	assert(kms.flags[0] == FLIP_FLAGS);
+}
+
+TEST(drm_async_flip_only_for_page_flips)
+{
+	static const uint32_t other_flags[] = {
+		0,
+		DRM_MODE_ATOMIC_TEST_ONLY,
+		FLIP_FLAGS | DRM_MODE_ATOMIC_ALLOW_MODESET,
+	};
+	bool async;
+	unsigned i;
+
+	for (i = 0; i < ARRAY_LENGTH(other_flags); i++) {
+		kms_reset(false, false);
+		async = true;
+
+		assert(drm_atomic_commit_try_async(-1, NULL, other_flags[i],
+						   NULL, &async) == 0);
+
+		assert(!async);
+		assert(kms.n_commits == 1);
+		assert(kms.flags[0] == other_flags[i]);
+	}
+}
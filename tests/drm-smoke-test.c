@@ -25,22 +25,250 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/input.h>
+
+#ifdef HAVE_LINUX_UDMABUF_H
+#include <linux/dma-buf.h>
+#include <linux/udmabuf.h>
+#endif
+
+#include "shared/os-compatibility.h"
+#include "shared/timespec-util.h"
+#include "shared/weston-drm-fourcc.h"
+#include "shared/xalloc.h"
 #include "weston-test-client-helper.h"
 #include "weston-test-fixture-compositor.h"
+#include "weston-debug-client-protocol.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+#include "wcap-decode.h"
+
+struct setup_args {
+	struct fixture_metadata meta;
+	enum renderer_type renderer;
+};
+
+/* Only the GL renderer puts views on the KMS cursor plane. */
+static const struct setup_args my_setup_args[] = {
+	{
+		.renderer = RENDERER_PIXMAN,
+		.meta.name = "pixman"
+	},
+	{
+		.renderer = RENDERER_GL,
+		.meta.name = "GL"
+	},
+};
 
 static enum test_result_code
-fixture_setup(struct weston_test_harness *harness)
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
 {
 	struct compositor_setup setup;
 
 	compositor_setup_defaults(&setup);
 	setup.shell = SHELL_TEST_DESKTOP;
 	setup.backend = WESTON_BACKEND_DRM;
-	setup.renderer = RENDERER_PIXMAN;
+	setup.renderer = arg->renderer;
 
 	return weston_test_harness_execute_as_client(harness, &setup);
 }
-DECLARE_FIXTURE_SETUP(fixture_setup);
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
+
+static const struct timespec t0 = { .tv_sec = 0, .tv_nsec = 0 };
+
+/* The "drm-backend" debug scope, read back to see which path the backend
+ * took. */
+struct drm_log {
+	struct weston_debug_v1 *debug;
+	struct weston_debug_stream_v1 *stream;
+	int fd;
+	char *data;
+	size_t len, size;
+};
+
+static void
+drm_log_start(struct client *client, struct drm_log *log)
+{
+	int fds[2];
+
+	memset(log, 0, sizeof *log);
+	log->debug = bind_to_singleton_global(client,
+					      &weston_debug_v1_interface, 1);
+
+	assert(pipe2(fds, O_CLOEXEC) == 0);
+	assert(fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0);
+	log->stream = weston_debug_v1_subscribe(log->debug, "drm-backend",
+						fds[1]);
+	client_roundtrip(client);
+	close(fds[1]);
+	log->fd = fds[0];
+}
+
+static void
+drm_log_stop(struct drm_log *log)
+{
+	weston_debug_stream_v1_destroy(log->stream);
+	weston_debug_v1_destroy(log->debug);
+	close(log->fd);
+	free(log->data);
+}
+
+/* Reads everything logged so far; the compositor writes each message
+ * whole. Returns where the new messages start. */
+static size_t
+drm_log_read(struct drm_log *log)
+{
+	size_t from = log->len;
+	ssize_t ret;
+
+	for (;;) {
+		if (log->size - log->len < 4096) {
+			log->size = log->size ? log->size * 2 : 64 * 1024;
+			log->data = realloc(log->data, log->size);
+			assert(log->data);
+		}
+
+		ret = read(log->fd, log->data + log->len,
+			   log->size - log->len - 1);
+		if (ret < 0 && errno == EAGAIN)
+			break;
+		assert(ret > 0);
+		log->len += ret;
+	}
+	log->data[log->len] = '\0';
+
+	return from;
+}
+
+/* Counts the messages logged from offset from on that start with prefix
+ * and end with suffix. */
+static int
+drm_log_count(struct drm_log *log, size_t from, const char *prefix,
+	      const char *suffix)
+{
+	const char *line = log->data + from, *end;
+	size_t suffix_len = strlen(suffix);
+	int n = 0;
+
+	while ((end = strchr(line, '\n'))) {
+		if (strncmp(line, prefix, strlen(prefix)) == 0 &&
+		    (size_t) (end - line) >= suffix_len &&
+		    strncmp(end - suffix_len, suffix, suffix_len) == 0)
+			n++;
+		line = end + 1;
+	}
+
+	return n;
+}
+
+static void
+drm_log_check_writeback(struct drm_log *log, size_t from)
+{
+	if (strstr(log->data + from, "[writeback] no writeback connector"))
+		skip("no writeback connector to capture with\n");
+}
+
+/* Takes a screenshot, and checks it came from the writeback connector
+ * rather than from the renderer. */
+static struct buffer *
+capture_through_writeback(struct client *client, struct drm_log *log)
+{
+	struct buffer *shot;
+	size_t from;
+
+	drm_log_read(log);
+	shot = capture_screenshot_of_output(client);
+	assert(shot);
+
+	from = drm_log_read(log);
+	drm_log_check_writeback(log, from);
+	assert(drm_log_count(log, from, "[writeback] capture of output ",
+			     " done") == 1);
+
+	return shot;
+}
+
+static uint32_t
+shot_pixel(struct buffer *shot, int x, int y)
+{
+	uint32_t *pixels = pixman_image_get_data(shot->image);
+	int stride = pixman_image_get_stride(shot->image) / 4;
+
+	return pixels[y * stride + x];
+}
+
+static void
+surface_commit_color(struct client *client, struct wl_surface *surface,
+		     struct buffer *buffer, pixman_color_t *color)
+{
+	int width = pixman_image_get_width(buffer->image);
+	int height = pixman_image_get_height(buffer->image);
+	int frame;
+
+	fill_image_with_color(buffer->image, color);
+	wl_surface_attach(surface, buffer->proxy, 0, 0);
+	wl_surface_damage(surface, 0, 0, width, height);
+	frame_callback_set(surface, &frame);
+	wl_surface_commit(surface);
+	frame_callback_wait(client, &frame);
+}
+
+/* Points at (x, y) with a cursor of the given color. The client's test
+ * surface must be there to get the pointer focus. */
+static struct surface *
+set_cursor_color(struct client *client, int x, int y, pixman_color_t *color)
+{
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+	struct surface *cursor;
+	struct buffer *buffer;
+
+	timespec_to_proto(&t0, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_move_pointer(client->test->weston_test, tv_sec_hi,
+				 tv_sec_lo, tv_nsec, x, y);
+	client_roundtrip(client);
+
+	cursor = create_test_surface(client);
+	buffer = create_shm_buffer_a8r8g8b8(client, 16, 16);
+	fill_image_with_color(buffer->image, color);
+	wl_surface_attach(cursor->wl_surface, buffer->proxy, 0, 0);
+	wl_surface_damage(cursor->wl_surface, 0, 0, 16, 16);
+	wl_surface_commit(cursor->wl_surface);
+	cursor->buffer = buffer;
+
+	wl_pointer_set_cursor(client->input->pointer->wl_pointer,
+			      client->input->pointer->serial,
+			      cursor->wl_surface, 0, 0);
+	client_roundtrip(client);
+
+	return cursor;
+}
+
+static void
+send_key(struct client *client, uint32_t key, uint32_t state)
+{
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	timespec_to_proto(&t0, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_send_key(client->test->weston_test, tv_sec_hi, tv_sec_lo,
+			     tv_nsec, key, state);
+	client_roundtrip(client);
+}
+
+/* Super+R starts and stops the wcap recorder. */
+static void
+toggle_recorder(struct client *client)
+{
+	send_key(client, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_PRESSED);
+	send_key(client, KEY_R, WL_KEYBOARD_KEY_STATE_PRESSED);
+	send_key(client, KEY_R, WL_KEYBOARD_KEY_STATE_RELEASED);
+	send_key(client, KEY_LEFTMETA, WL_KEYBOARD_KEY_STATE_RELEASED);
+}
 
 TEST(drm_smoke) {
 	struct client *client;
@@ -95,3 +323,315 @@ TEST(drm_screenshot_no_damage) {
 
 	client_destroy(client);
 }
+
+/*
+ * Screenshots on DRM are taken through a writeback connector when there is
+ * one. Every screenshot must complete with the right content, and the
+ * output must keep presenting frames afterwards.
+ */
+TEST(drm_screenshot_capture_completes) {
+	struct client *client;
+	struct buffer *buffer;
+	struct buffer *shot;
+	struct wl_surface *surface;
+	struct drm_log log;
+	pixman_color_t red;
+	int i;
+
+	color_rgb888(&red, 255, 0, 0);
+
+	client = create_client_and_test_surface(0, 0, 200, 200);
+	assert(client);
+	drm_log_start(client, &log);
+
+	surface = client->surface->wl_surface;
+	buffer = create_shm_buffer_a8r8g8b8(client, 200, 200);
+
+	for (i = 0; i < 3; i++) {
+		surface_commit_color(client, surface, buffer, &red);
+
+		shot = capture_through_writeback(client, &log);
+		assert(shot_pixel(shot, 100, 100) == 0xffff0000);
+		buffer_destroy(shot);
+	}
+
+	/* Still presenting after the captures. */
+	surface_commit_color(client, surface, buffer, &red);
+
+	drm_log_stop(&log);
+	buffer_destroy(buffer);
+	client_destroy(client);
+}
+
+/*
+ * What writeback captures is what the display shows, the cursor plane
+ * included, without the renderer drawing the cursor.
+ */
+TEST(drm_screenshot_capture_includes_cursor_plane) {
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	struct client *client;
+	struct buffer *buffer;
+	struct buffer *shot;
+	struct surface *cursor;
+	struct drm_log log;
+	pixman_color_t red, green;
+	size_t from;
+
+	if (args->renderer != RENDERER_GL) {
+		testlog("no cursor plane with the %s renderer\n",
+			args->meta.name);
+		return;
+	}
+
+	color_rgb888(&red, 255, 0, 0);
+	color_rgb888(&green, 0, 255, 0);
+
+	client = create_client_and_test_surface(0, 0, 200, 200);
+	assert(client);
+	drm_log_start(client, &log);
+
+	buffer = create_shm_buffer_a8r8g8b8(client, 200, 200);
+	surface_commit_color(client, client->surface->wl_surface, buffer,
+			     &red);
+	cursor = set_cursor_color(client, 100, 100, &green);
+
+	from = drm_log_read(&log);
+	shot = capture_through_writeback(client, &log);
+	assert(strstr(log.data + from,
+		      "has been placed to cursor plane") != NULL);
+
+	assert(shot_pixel(shot, 104, 104) == 0xff00ff00);
+	assert(shot_pixel(shot, 150, 150) == 0xffff0000);
+	buffer_destroy(shot);
+
+	surface_destroy(cursor);
+	drm_log_stop(&log);
+	buffer_destroy(buffer);
+	client_destroy(client);
+}
+
+/*
+ * The wcap recorder records what writeback captures when it can, planes
+ * included, frame after frame.
+ */
+TEST(drm_recorder_captures_frames) {
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	static const char filename[] = "capture.wcap";
+	struct wcap_decoder *decoder;
+	struct client *client;
+	struct buffer *buffer;
+	struct wl_surface *surface;
+	struct surface *cursor = NULL;
+	struct drm_log log;
+	pixman_color_t red, green, blue;
+	size_t start, stop;
+	uint32_t *frame;
+	int i, frames;
+
+	color_rgb888(&red, 255, 0, 0);
+	color_rgb888(&green, 0, 255, 0);
+	color_rgb888(&blue, 0, 0, 255);
+
+	unlink(filename);
+
+	client = create_client_and_test_surface(0, 0, 200, 200);
+	assert(client);
+	drm_log_start(client, &log);
+
+	surface = client->surface->wl_surface;
+	buffer = create_shm_buffer_a8r8g8b8(client, 200, 200);
+	surface_commit_color(client, surface, buffer, &red);
+	if (args->renderer == RENDERER_GL)
+		cursor = set_cursor_color(client, 100, 100, &green);
+
+	start = drm_log_read(&log);
+	toggle_recorder(client);
+	for (i = 0; i < 3; i++)
+		surface_commit_color(client, surface, buffer, &blue);
+
+	drm_log_read(&log);
+	drm_log_check_writeback(&log, start);
+	assert(drm_log_count(&log, start, "[writeback] capture of output ",
+			     " done") > 0);
+
+	/* The recorder finishes with the capture it has going. */
+	toggle_recorder(client);
+	stop = drm_log_read(&log);
+	for (i = 0; i < 10; i++) {
+		drm_log_read(&log);
+		if (drm_log_count(&log, stop, "[writeback] capture of output ",
+				  " done") > 0)
+			break;
+		surface_commit_color(client, surface, buffer, &blue);
+	}
+	client_roundtrip(client);
+
+	decoder = wcap_decoder_create(filename);
+	assert(decoder);
+	assert(decoder->format == WCAP_FORMAT_XRGB8888);
+
+	frames = 0;
+	while (wcap_decoder_get_frame(decoder))
+		frames++;
+	testlog("%d frames recorded\n", frames);
+	assert(frames > 1);
+
+	/* The last frame shows the blue surface, and the cursor if it
+	 * was on its plane. */
+	frame = decoder->frame;
+	assert((frame[150 * decoder->width + 150] & 0xffffff) == 0x0000ff);
+	if (args->renderer == RENDERER_GL)
+		assert((frame[104 * decoder->width + 104] & 0xffffff) ==
+		       0x00ff00);
+
+	wcap_decoder_destroy(decoder);
+	unlink(filename);
+
+	if (cursor)
+		surface_destroy(cursor);
+	drm_log_stop(&log);
+	buffer_destroy(buffer);
+	client_destroy(client);
+}
+
+#ifdef HAVE_LINUX_UDMABUF_H
+static void
+dmabuf_sync(int dmabuf_fd, uint64_t flags)
+{
+	struct dma_buf_sync sync = { .flags = flags | DMA_BUF_SYNC_WRITE };
+
+	assert(ioctl(dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync) == 0);
+}
+
+/* An XRGB8888 buffer in a memfd, sent as a linear dmabuf made by
+ * /dev/udmabuf, as toytoolkit sends its SHM buffers with
+ * TOYTOOLKIT_UDMABUF set. */
+static struct buffer *
+create_udmabuf_buffer(struct zwp_linux_dmabuf_v1 *dmabuf, int udmabuf_fd,
+		      int width, int height, pixman_color_t *color)
+{
+	struct udmabuf_create create = { 0 };
+	struct zwp_linux_buffer_params_v1 *params;
+	struct buffer *buf;
+	size_t stride = width * 4;
+	size_t size;
+	void *data;
+	int memfd, dmabuf_fd;
+
+	size = stride * height;
+	size = (size + getpagesize() - 1) & ~(size_t)(getpagesize() - 1);
+
+	memfd = memfd_create("weston-test-udmabuf", MFD_ALLOW_SEALING);
+	assert(memfd >= 0);
+	assert(ftruncate(memfd, size) == 0);
+	assert(fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) == 0);
+
+	create.memfd = memfd;
+	create.offset = 0;
+	create.size = size;
+	dmabuf_fd = ioctl(udmabuf_fd, UDMABUF_CREATE, &create);
+	assert(dmabuf_fd >= 0);
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	assert(data != MAP_FAILED);
+	close(memfd);
+
+	buf = xzalloc(sizeof *buf);
+	buf->len = size;
+	buf->image = pixman_image_create_bits(PIXMAN_x8r8g8b8, width, height,
+					      data, stride);
+	assert(buf->image);
+
+	dmabuf_sync(dmabuf_fd, DMA_BUF_SYNC_START);
+	fill_image_with_color(buf->image, color);
+	dmabuf_sync(dmabuf_fd, DMA_BUF_SYNC_END);
+
+	/* KMS only takes dmabufs with an explicit modifier. */
+	params = zwp_linux_dmabuf_v1_create_params(dmabuf);
+	zwp_linux_buffer_params_v1_add(params, dmabuf_fd, 0, 0, stride,
+				       DRM_FORMAT_MOD_LINEAR >> 32,
+				       DRM_FORMAT_MOD_LINEAR & 0xffffffff);
+	buf->proxy = zwp_linux_buffer_params_v1_create_immed(params, width,
+							     height,
+							     DRM_FORMAT_XRGB8888,
+							     0);
+	zwp_linux_buffer_params_v1_destroy(params);
+	close(dmabuf_fd);
+	assert(buf->proxy);
+
+	return buf;
+}
+#endif
+
+/*
+ * Memory a client draws into with the CPU reaches a KMS plane without a
+ * copy when it is sent as a udmabuf. A buffer covering the whole output is
+ * scanned out from the primary plane, and shows up as drawn.
+ */
+TEST(drm_udmabuf_scanout) {
+#ifndef HAVE_LINUX_UDMABUF_H
+	testlog("built without linux/udmabuf.h\n");
+#else
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	struct zwp_linux_dmabuf_v1 *dmabuf;
+	struct client *client;
+	struct buffer *buffer;
+	struct buffer *shot;
+	struct wl_surface *surface;
+	struct drm_log log;
+	pixman_color_t blue;
+	size_t from;
+	int udmabuf_fd;
+	int width, height;
+	int i, frame;
+
+	/* The pixman renderer takes no dmabufs. */
+	if (args->renderer != RENDERER_GL) {
+		testlog("no dmabuf import with the %s renderer\n",
+			args->meta.name);
+		return;
+	}
+
+	udmabuf_fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (udmabuf_fd < 0) {
+		testlog("cannot open /dev/udmabuf: %s\n", strerror(errno));
+		return;
+	}
+
+	color_rgb888(&blue, 0, 0, 255);
+
+	client = create_client();
+	width = client->output->width;
+	height = client->output->height;
+	client->surface = create_test_surface(client);
+	surface = client->surface->wl_surface;
+	weston_test_move_surface(client->test->weston_test, surface, 0, 0);
+	drm_log_start(client, &log);
+
+	dmabuf = bind_to_singleton_global(client,
+					  &zwp_linux_dmabuf_v1_interface, 3);
+	buffer = create_udmabuf_buffer(dmabuf, udmabuf_fd, width, height,
+				       &blue);
+
+	from = drm_log_read(&log);
+	for (i = 0; i < 3; i++) {
+		wl_surface_attach(surface, buffer->proxy, 0, 0);
+		wl_surface_damage(surface, 0, 0, width, height);
+		frame_callback_set(surface, &frame);
+		wl_surface_commit(surface);
+		frame_callback_wait(client, &frame);
+	}
+
+	shot = capture_through_writeback(client, &log);
+	assert(strstr(log.data + from,
+		      "has been placed to primary plane") != NULL);
+	assert(shot_pixel(shot, width / 2, height / 2) == 0xff0000ff);
+	buffer_destroy(shot);
+
+	drm_log_stop(&log);
+	buffer_destroy(buffer);
+	zwp_linux_dmabuf_v1_destroy(dmabuf);
+	close(udmabuf_fd);
+	client_destroy(client);
+#endif
+}
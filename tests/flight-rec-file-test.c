@@ -0,0 +1,248 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "weston-log-flight-rec.h"
+
+/* A file backed flight recorder subscribed to one scope, and a copy of
+ * everything written to it. */
+struct recording {
+	struct weston_log_context *log_ctx;
+	struct weston_log_scope *scope;
+	struct weston_log_subscriber *flight_rec;
+	char *path;
+
+	char *written;
+	size_t written_len;
+};
+
+static void
+recording_start(struct recording *r, size_t size)
+{
+	const char *dir = getenv("WESTON_TEST_OUTPUT_PATH");
+
+	if (!dir)
+		dir = ".";
+	assert(asprintf(&r->path, "%s/%s.flight-rec",
+			dir, get_test_name()) > 0);
+	unlink(r->path);
+
+	r->log_ctx = weston_log_ctx_create();
+	assert(r->log_ctx);
+	r->scope = weston_log_ctx_add_log_scope(r->log_ctx, "test",
+						"flight recorder test",
+						NULL, NULL, NULL);
+	assert(r->scope);
+	r->flight_rec = weston_log_subscriber_create_flight_rec_file(r->path,
+								     size);
+	assert(r->flight_rec);
+	weston_log_subscribe(r->log_ctx, r->flight_rec, "test");
+
+	r->written = NULL;
+	r->written_len = 0;
+}
+
+static void
+recording_write(struct recording *r, const char *data, size_t len)
+{
+	weston_log_scope_write(r->scope, data, len);
+
+	r->written = realloc(r->written, r->written_len + len);
+	assert(r->written);
+	memcpy(r->written + r->written_len, data, len);
+	r->written_len += len;
+}
+
+static void
+recording_write_lines(struct recording *r, int first, int count)
+{
+	char line[64];
+	int i, len;
+
+	for (i = first; i < first + count; i++) {
+		len = snprintf(line, sizeof line, "message %d\n", i);
+		recording_write(r, line, len);
+	}
+}
+
+/* Decodes the file as weston-flight-rec-decode does, while the recorder
+ * is still alive, and checks it holds the newest bytes written. */
+static void
+recording_check(struct recording *r, bool overlap)
+{
+	struct weston_flight_rec_contents contents;
+	size_t kept, decoded = 0;
+	struct stat st;
+	void *map;
+	int fd, i;
+
+	fd = open(r->path, O_RDONLY | O_CLOEXEC);
+	assert(fd >= 0);
+	assert(fstat(fd, &st) == 0);
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	assert(map != MAP_FAILED);
+	close(fd);
+
+	assert(weston_flight_rec_parse(map, st.st_size, &contents) == NULL);
+	assert(contents.overlap == overlap);
+	assert(contents.generation == 1);
+
+	kept = MIN(r->written_len, contents.size);
+	assert(contents.len[0] + contents.len[1] == kept);
+	for (i = 0; i < 2; i++) {
+		assert(memcmp(contents.data[i],
+			      r->written + r->written_len - kept + decoded,
+			      contents.len[i]) == 0);
+		decoded += contents.len[i];
+	}
+
+	munmap(map, st.st_size);
+}
+
+static void
+recording_stop(struct recording *r)
+{
+	weston_log_subscriber_destroy(r->flight_rec);
+	weston_log_scope_destroy(r->scope);
+	weston_log_ctx_destroy(r->log_ctx);
+	unlink(r->path);
+	free(r->path);
+	free(r->written);
+}
+
+TEST(flight_rec_file_linear)
+{
+	struct recording r;
+
+	recording_start(&r, 4096);
+
+	recording_write_lines(&r, 0, 20);
+	recording_check(&r, false);
+
+	recording_stop(&r);
+}
+
+TEST(flight_rec_file_wrapped)
+{
+	struct recording r;
+	char big[300];
+
+	/* Holds 99 bytes, a few lines. */
+	recording_start(&r, 100);
+
+	recording_write_lines(&r, 0, 5);
+	recording_check(&r, false);
+
+	/* Every position of the wrap point comes up. */
+	recording_write_lines(&r, 5, 50);
+	recording_check(&r, true);
+
+	/* Exactly up to the end of the buffer. */
+	memset(big, 'x', sizeof big);
+	recording_write(&r, big, 99 - (r.written_len % 99));
+	recording_check(&r, true);
+
+	/* A message longer than the whole buffer. */
+	recording_write(&r, big, sizeof big);
+	recording_check(&r, true);
+
+	recording_stop(&r);
+}
+
+TEST(flight_rec_file_bigger_than_buffer_first)
+{
+	struct recording r;
+	char big[250];
+	unsigned i;
+
+	for (i = 0; i < sizeof big; i++)
+		big[i] = 'a' + i % 26;
+
+	recording_start(&r, 100);
+	recording_write(&r, big, sizeof big);
+	recording_check(&r, true);
+	recording_stop(&r);
+}
+
+TEST(flight_rec_parse_rejects_corrupt_headers)
+{
+	struct {
+		struct weston_flight_rec_header header;
+		char data[64];
+	} file;
+	struct weston_flight_rec_contents contents;
+	const uint64_t file_size = sizeof file;
+
+	memset(&file, 0, sizeof file);
+	memcpy(file.header.magic, WESTON_FLIGHT_REC_MAGIC,
+	       sizeof file.header.magic);
+	file.header.version = WESTON_FLIGHT_REC_VERSION;
+	file.header.header_size = sizeof file.header;
+	file.header.size = sizeof file.data;
+	file.header.append_pos = 10;
+
+	assert(weston_flight_rec_parse(&file, file_size, &contents) == NULL);
+	assert(contents.len[0] == 10);
+
+	assert(weston_flight_rec_parse(&file, sizeof file.header - 1,
+				       &contents) != NULL);
+
+	/* header_size past the end of the file must not wrap size around. */
+	file.header.header_size = file_size + 1;
+	assert(weston_flight_rec_parse(&file, file_size, &contents) != NULL);
+	file.header.header_size = UINT32_MAX;
+	assert(weston_flight_rec_parse(&file, file_size, &contents) != NULL);
+	file.header.header_size = sizeof file.header;
+
+	file.header.size = sizeof file.data + 1;
+	assert(weston_flight_rec_parse(&file, file_size, &contents) != NULL);
+	file.header.size = sizeof file.data;
+
+	file.header.append_pos = sizeof file.data + 1;
+	assert(weston_flight_rec_parse(&file, file_size, &contents) != NULL);
+	file.header.append_pos = 0;
+
+	file.header.version = WESTON_FLIGHT_REC_VERSION + 1;
+	assert(weston_flight_rec_parse(&file, file_size, &contents) != NULL);
+	file.header.version = WESTON_FLIGHT_REC_VERSION;
+
+	file.header.magic[0] = 'X';
+	assert(weston_flight_rec_parse(&file, file_size, &contents) != NULL);
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Decoding benchmark of shared/image-loader.c over a corpus of large
+ * backgrounds.
+ *
+ * The corpus is a number of translucent 3840x2160 PNG files with some
+ * noise, so that both inflating and premultiplying cost something. They
+ * are decoded once with load_image() one after the other, as the shells
+ * used to, then all at once with load_image_async() on an image loader
+ * pool.
+ *
+ * The results are printed as TAP diagnostic lines of the form
+ * "# bench {json}", one per case.
+ *
+ * The WESTON_BENCH_IMAGES environment variable overrides the number of
+ * images, WESTON_BENCH_THREADS the number of threads of the pool.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cairo.h>
+
+#include "shared/helpers.h"
+#include "shared/image-loader.h"
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+#include "weston-bench-helper.h"
+#include "weston-test-client-helper.h"
+
+#define DEFAULT_IMAGES 4
+#define IMAGE_WIDTH 3840
+#define IMAGE_HEIGHT 2160
+
+static void
+write_background(const char *path, uint32_t seed)
+{
+	cairo_surface_t *surface;
+	unsigned char *data;
+	uint32_t *row;
+	uint32_t a, r, g, b, noise;
+	int stride, x, y;
+
+	surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+					     IMAGE_WIDTH, IMAGE_HEIGHT);
+	assert(cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS);
+	cairo_surface_flush(surface);
+	data = cairo_image_surface_get_data(surface);
+	stride = cairo_image_surface_get_stride(surface);
+
+	for (y = 0; y < IMAGE_HEIGHT; y++) {
+		row = (uint32_t *) (data + y * stride);
+		for (x = 0; x < IMAGE_WIDTH; x++) {
+			seed = seed * 1103515245 + 12345;
+			noise = (seed >> 16) & 0x1f;
+
+			a = 0xc0 + x * 0x3f / IMAGE_WIDTH;
+			r = ((x * 0xff / IMAGE_WIDTH) ^ noise) * a / 0xff;
+			g = ((y * 0xff / IMAGE_HEIGHT) ^ noise) * a / 0xff;
+			b = (0x80 ^ noise) * a / 0xff;
+			row[x] = (a << 24) | (r << 16) | (g << 8) | b;
+		}
+	}
+
+	cairo_surface_mark_dirty(surface);
+	assert(cairo_surface_write_to_png(surface, path) ==
+	       CAIRO_STATUS_SUCCESS);
+	cairo_surface_destroy(surface);
+}
+
+static void
+print_result(const char *name, int n_images, int n_threads, int64_t ns)
+{
+	double mpix = (double) n_images * IMAGE_WIDTH * IMAGE_HEIGHT / 1e6;
+
+	if (ns <= 0)
+		ns = 1;
+
+	printf("# bench {\"case\":\"%s\",\"images\":%d,\"threads\":%d,"
+	       "\"width\":%d,\"height\":%d,\"ms\":%.3f,"
+	       "\"mpix_per_s\":%.2f}\n",
+	       name, n_images, n_threads, IMAGE_WIDTH, IMAGE_HEIGHT,
+	       ns / 1e6, mpix / (ns / 1e9));
+	fflush(stdout);
+}
+
+static void
+image_loaded(pixman_image_t *image, void *data)
+{
+	int *n_loaded = data;
+
+	assert(image);
+	assert(pixman_image_get_width(image) == IMAGE_WIDTH);
+	assert(pixman_image_get_height(image) == IMAGE_HEIGHT);
+	pixman_image_unref(image);
+	(*n_loaded)++;
+}
+
+TEST(image_loader_benchmark)
+{
+	int n_images = getenv_int("WESTON_BENCH_IMAGES", DEFAULT_IMAGES);
+	int n_threads = getenv_int("WESTON_BENCH_THREADS", 0);
+	char dir[] = "/tmp/weston-image-bench-XXXXXX";
+	struct image_loader_pool *pool;
+	struct timespec begin, end;
+	pixman_image_t *image;
+	char **paths;
+	int n_loaded = 0;
+	int i;
+
+	assert(mkdtemp(dir));
+	paths = xzalloc(n_images * sizeof *paths);
+	for (i = 0; i < n_images; i++) {
+		str_printf(&paths[i], "%s/background-%d.png", dir, i);
+		assert(paths[i]);
+		write_background(paths[i], i + 1);
+	}
+
+	/* Warms up the page cache and the allocator. */
+	image = load_image(paths[0]);
+	assert(image);
+	pixman_image_unref(image);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < n_images; i++) {
+		image = load_image(paths[i]);
+		assert(image);
+		pixman_image_unref(image);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	print_result("serial", n_images, 1, timespec_sub_to_nsec(&end, &begin));
+
+	pool = image_loader_pool_create(n_threads);
+	assert(pool);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	for (i = 0; i < n_images; i++)
+		assert(load_image_async(pool, paths[i],
+					image_loaded, &n_loaded) == 0);
+	image_loader_pool_flush(pool);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	assert(n_loaded == n_images);
+	print_result("pool", n_images, n_threads,
+		     timespec_sub_to_nsec(&end, &begin));
+
+	image_loader_pool_destroy(pool);
+
+	for (i = 0; i < n_images; i++) {
+		unlink(paths[i]);
+		free(paths[i]);
+	}
+	free(paths);
+	rmdir(dir);
+}
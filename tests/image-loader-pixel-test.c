@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+#include "shared/image-loader-pixel.h"
+
+#define MAX_WIDTH 67
+
+/* Room for MAX_WIDTH pixels at any of the pixel offsets tried, so that
+ * the SIMD loads and stores also run off their 16 byte alignment. */
+static uint8_t row_simd[MAX_WIDTH * 4 + 16] __attribute__((aligned(16)));
+static uint8_t row_scalar[MAX_WIDTH * 4 + 16] __attribute__((aligned(16)));
+
+static uint32_t
+next_random(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+
+	return *state >> 8;
+}
+
+static void
+check_premultiply(const uint8_t *src, size_t width, size_t offset)
+{
+	memset(row_simd, 0x5a, sizeof row_simd);
+	memset(row_scalar, 0x5a, sizeof row_scalar);
+	memcpy(row_simd + offset, src, width * 4);
+	memcpy(row_scalar + offset, src, width * 4);
+
+	premultiply_row(row_simd + offset, width);
+	premultiply_row_scalar(row_scalar + offset, width);
+
+	/* Also compares the bytes around the row, which must be left
+	 * alone. */
+	assert(memcmp(row_simd, row_scalar, sizeof row_simd) == 0);
+}
+
+TEST(premultiply_every_alpha)
+{
+	uint8_t src[256 * 4];
+	int alpha, c;
+
+	/* One row per alpha value, with every colour value in each of the
+	 * three channels. */
+	for (alpha = 0; alpha < 256; alpha++) {
+		for (c = 0; c < 256; c++) {
+			src[c * 4 + 0] = c;
+			src[c * 4 + 1] = 255 - c;
+			src[c * 4 + 2] = c * 7;
+			src[c * 4 + 3] = alpha;
+		}
+
+		premultiply_row(src, 256);
+
+		for (c = 0; c < 256; c++) {
+			uint8_t expected[4] = { c, 255 - c, c * 7, alpha };
+
+			premultiply_row_scalar(expected, 1);
+			assert(memcmp(&src[c * 4], expected, 4) == 0);
+		}
+	}
+}
+
+TEST(premultiply_known_values)
+{
+	uint8_t px[4 * 4] = {
+		0xff, 0x80, 0x00, 0x80,
+		0x12, 0x34, 0x56, 0x00,
+		0x12, 0x34, 0x56, 0xff,
+		0xff, 0xff, 0xff, 0x01,
+	};
+	uint32_t *out = (uint32_t *) px;
+
+	premultiply_row(px, ARRAY_LENGTH(px) / 4);
+
+	assert(out[0] == 0x80804000);
+	assert(out[1] == 0x00000000);
+	assert(out[2] == 0xff123456);
+	assert(out[3] == 0x01010101);
+}
+
+TEST(premultiply_odd_widths_and_tails)
+{
+	uint8_t src[MAX_WIDTH * 4];
+	uint32_t state = 1;
+	size_t width, offset, i;
+
+	for (i = 0; i < sizeof src; i++)
+		src[i] = next_random(&state);
+
+	for (width = 0; width <= MAX_WIDTH; width++)
+		for (offset = 0; offset < 16; offset += 4)
+			check_premultiply(src, width, offset);
+}
+
+static void
+check_swizzle(const uint8_t *src, size_t width, size_t offset)
+{
+	size_t i;
+
+	/* Only the first width * 3 bytes of the row are RGB; the rest is
+	 * whatever the buffer held before. */
+	memset(row_simd, 0x5a, sizeof row_simd);
+	memset(row_scalar, 0x5a, sizeof row_scalar);
+	memcpy(row_simd + offset, src, width * 3);
+	memcpy(row_scalar + offset, src, width * 3);
+
+	swizzle_row(row_simd + offset, width);
+	swizzle_row_scalar(row_scalar + offset, width);
+
+	assert(memcmp(row_simd, row_scalar, sizeof row_simd) == 0);
+
+	for (i = 0; i < width; i++) {
+		uint32_t px;
+
+		memcpy(&px, row_scalar + offset + i * 4, sizeof px);
+		assert(px == (0xff000000u | src[i * 3] << 16 |
+			      src[i * 3 + 1] << 8 | src[i * 3 + 2]));
+	}
+}
+
+TEST(swizzle_odd_widths_and_tails)
+{
+	uint8_t src[MAX_WIDTH * 3];
+	uint32_t state = 7;
+	size_t width, offset, i;
+
+	for (i = 0; i < sizeof src; i++)
+		src[i] = next_random(&state);
+
+	for (width = 0; width <= MAX_WIDTH; width++)
+		for (offset = 0; offset < 16; offset += 4)
+			check_swizzle(src, width, offset);
+}
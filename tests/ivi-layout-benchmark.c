@@ -0,0 +1,108 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Benchmark of ivi_layout_commit_changes() with many ivi_surfaces.
+ *
+ * This client only creates the ivi_surfaces; the measurements are done
+ * compositor-side by the commit_benchmark RUNNER_TEST() in
+ * ivi-layout-test-plugin.c, which prints one "# bench {json}" TAP
+ * diagnostic line per case.
+ *
+ * The WESTON_BENCH_SURFACES environment variable overrides the number of
+ * ivi_surfaces.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared/helpers.h"
+#include "shared/xalloc.h"
+#include "weston-bench-helper.h"
+#include "weston-test-client-helper.h"
+#include "ivi-application-client-protocol.h"
+#include "ivi-test.h"
+#include "ivi-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+#define DEFAULT_SURFACES 300
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_IVI;
+	setup.extra_module = "test-ivi-layout.so";
+	setup.logging_scopes = "log";
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+TEST(ivi_layout_commit_benchmark)
+{
+	int n_surfaces = getenv_int("WESTON_BENCH_SURFACES", DEFAULT_SURFACES);
+	struct wl_surface **wl_surfaces;
+	struct ivi_surface **ivi_surfaces;
+	struct ivi_application *iviapp;
+	struct runner *runner;
+	struct client *client;
+	int i;
+
+	client = create_client();
+	runner = client_create_runner(client);
+	iviapp = get_ivi_application(client);
+
+	wl_surfaces = xzalloc(n_surfaces * sizeof *wl_surfaces);
+	ivi_surfaces = xzalloc(n_surfaces * sizeof *ivi_surfaces);
+	for (i = 0; i < n_surfaces; i++) {
+		wl_surfaces[i] =
+			wl_compositor_create_surface(client->wl_compositor);
+		ivi_surfaces[i] =
+			ivi_application_surface_create(iviapp,
+						       IVI_TEST_SURFACE_ID(i),
+						       wl_surfaces[i]);
+	}
+	client_roundtrip(client);
+
+	runner_run(runner, "commit_benchmark");
+
+	for (i = 0; i < n_surfaces; i++) {
+		ivi_surface_destroy(ivi_surfaces[i]);
+		wl_surface_destroy(wl_surfaces[i]);
+	}
+	free(ivi_surfaces);
+	free(wl_surfaces);
+
+	runner_destroy(runner);
+	ivi_application_destroy(iviapp);
+	client_destroy(client);
+}
@@ -34,6 +34,7 @@
 #include "weston-test-client-helper.h"
 #include "ivi-application-client-protocol.h"
 #include "ivi-test.h"
+#include "ivi-test-client-helper.h"
 #include "weston-test-fixture-compositor.h"
 
 static enum test_result_code
@@ -49,109 +50,6 @@ fixture_setup(struct weston_test_harness *harness)
 }
 DECLARE_FIXTURE_SETUP(fixture_setup);
 
-struct runner {
-	struct client *client;
-	struct weston_test_runner *test_runner;
-	int done;
-};
-
-static void
-runner_finished_handler(void *data, struct weston_test_runner *test_runner)
-{
-	struct runner *runner = data;
-
-	runner->done = 1;
-}
-
-static const struct weston_test_runner_listener test_runner_listener = {
-	runner_finished_handler
-};
-
-static struct runner *
-client_create_runner(struct client *client)
-{
-	struct runner *runner;
-	struct global *g;
-	struct global *global_runner = NULL;
-
-	runner = xzalloc(sizeof(*runner));
-	runner->client = client;
-
-	wl_list_for_each(g, &client->global_list, link) {
-		if (strcmp(g->interface, "weston_test_runner"))
-			continue;
-
-		if (global_runner)
-			assert(0 && "multiple weston_test_runner objects");
-
-		global_runner = g;
-	}
-
-	assert(global_runner && "no weston_test_runner found");
-	assert(global_runner->version == 1);
-
-	runner->test_runner = wl_registry_bind(client->wl_registry,
-					       global_runner->name,
-					       &weston_test_runner_interface,
-					       1);
-	assert(runner->test_runner);
-
-	weston_test_runner_add_listener(runner->test_runner,
-					&test_runner_listener, runner);
-
-	return runner;
-}
-
-static void
-runner_destroy(struct runner *runner)
-{
-	weston_test_runner_destroy(runner->test_runner);
-	client_roundtrip(runner->client);
-	free(runner);
-}
-
-static void
-runner_run(struct runner *runner, const char *test_name)
-{
-	testlog("weston_test_runner.run(\"%s\")\n", test_name);
-
-	runner->done = 0;
-	weston_test_runner_run(runner->test_runner, test_name);
-
-	while (!runner->done) {
-		if (wl_display_dispatch(runner->client->wl_display) < 0)
-			assert(0 && "runner wait");
-	}
-}
-
-static struct ivi_application *
-get_ivi_application(struct client *client)
-{
-	struct global *g;
-	struct global *global_iviapp = NULL;
-	struct ivi_application *iviapp;
-
-	wl_list_for_each(g, &client->global_list, link) {
-		if (strcmp(g->interface, "ivi_application"))
-			continue;
-
-		if (global_iviapp)
-			assert(0 && "multiple ivi_application objects");
-
-		global_iviapp = g;
-	}
-
-	assert(global_iviapp && "no ivi_application found");
-
-	assert(global_iviapp->version == 1);
-
-	iviapp = wl_registry_bind(client->wl_registry, global_iviapp->name,
-				  &ivi_application_interface, 1);
-	assert(iviapp);
-
-	return iviapp;
-}
-
 struct ivi_window {
 	struct wl_surface *wl_surface;
 	struct ivi_surface *ivi_surface;
@@ -220,6 +118,8 @@ const char * const render_order_test_names[] = {
 	"layer_render_order",
 	"layer_bad_render_order",
 	"layer_add_surfaces",
+	"commit_one_property",
+	"commit_notification_order",
 };
 
 TEST_P(ivi_layout_runner, basic_test_names)
@@ -529,3 +429,41 @@ TEST(ivi_layout_surface_remove_notification)
 	ivi_application_destroy(iviapp);
 	client_destroy(client);
 }
+
+TEST(ivi_layout_transition_frame_sync)
+{
+	struct client *client;
+	struct runner *runner;
+	struct ivi_application *iviapp;
+	struct ivi_window *wind;
+	struct buffer *buffer;
+	int frame;
+	int done;
+
+	client = create_client();
+	runner = client_create_runner(client);
+	iviapp = get_ivi_application(client);
+
+	wind = client_create_ivi_window(client, iviapp, IVI_TEST_SURFACE_ID(0));
+	buffer = create_shm_buffer_a8r8g8b8(client, 20, 20);
+	wl_surface_attach(wind->wl_surface, buffer->proxy, 0, 0);
+	wl_surface_damage(wind->wl_surface, 0, 0, 20, 20);
+	wl_surface_commit(wind->wl_surface);
+
+	runner_run(runner, "transition_frame_sync_p1");
+
+	/* let the 200 ms transition run through its frames, and then some */
+	for (frame = 0; frame < 30; frame++) {
+		frame_callback_set(wind->wl_surface, &done);
+		wl_surface_commit(wind->wl_surface);
+		frame_callback_wait(client, &done);
+	}
+
+	runner_run(runner, "transition_frame_sync_p2");
+
+	buffer_destroy(buffer);
+	ivi_window_destroy(wind);
+	runner_destroy(runner);
+	ivi_application_destroy(iviapp);
+	client_destroy(client);
+}
@@ -28,12 +28,15 @@
 #include "config.h"
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
 #include <errno.h>
+#include <time.h>
 
 #include <libweston/libweston.h>
 #include "compositor/weston.h"
@@ -41,6 +44,7 @@
 #include "ivi-test.h"
 #include "ivi-shell/ivi-layout-export.h"
 #include "shared/helpers.h"
+#include "shared/timespec-util.h"
 
 struct test_context;
 
@@ -86,6 +90,10 @@ struct test_context {
 	struct wl_listener surface_created;
 	struct wl_listener surface_removed;
 	struct wl_listener surface_configured;
+
+	/* transition_frame_sync */
+	uint64_t step_msc;
+	uint32_t step_count;
 };
 
 struct test_launcher {
@@ -1037,3 +1045,492 @@ RUNNER_TEST(surface_bad_properties_changed_notification)
 	runner_assert(lyt->surface_add_listener(
 		      ivisurf, NULL) == IVI_FAILED);
 }
+
+/*
+ * Property change listeners recording what was notified, and in which order
+ * across all of them.
+ */
+struct prop_recorder {
+	struct wl_listener listener;
+	const struct ivi_layout_interface *lyt;
+	int *seq;
+	int count;
+	int order;
+	uint32_t mask;
+};
+
+static void
+surface_prop_recorder_notify(struct wl_listener *listener, void *data)
+{
+	struct prop_recorder *rec =
+		container_of(listener, struct prop_recorder, listener);
+	struct ivi_layout_surface *ivisurf = data;
+
+	rec->count++;
+	rec->order = ++*rec->seq;
+	rec->mask = rec->lyt->get_properties_of_surface(ivisurf)->event_mask;
+}
+
+static void
+layer_prop_recorder_notify(struct wl_listener *listener, void *data)
+{
+	struct prop_recorder *rec =
+		container_of(listener, struct prop_recorder, listener);
+	struct ivi_layout_layer *ivilayer = data;
+
+	rec->count++;
+	rec->order = ++*rec->seq;
+	rec->mask = rec->lyt->get_properties_of_layer(ivilayer)->event_mask;
+}
+
+static void
+prop_recorders_reset(struct prop_recorder *recs, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		recs[i].count = 0;
+		recs[i].order = 0;
+		recs[i].mask = 0;
+	}
+}
+
+/*
+ * Puts the test surfaces on a new layer, commits until no notification is
+ * left, and starts recording the property changes of the surfaces in
+ * surf_recs and of the layer in layer_rec.
+ */
+static struct ivi_layout_layer *
+setup_recorded_layer(struct test_context *ctx,
+		     struct ivi_layout_surface **ivisurfs,
+		     struct prop_recorder *surf_recs,
+		     struct prop_recorder *layer_rec, int *seq)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_layer *ivilayer;
+	uint32_t i;
+
+	ivilayer = lyt->layer_create_with_dimension(IVI_TEST_LAYER_ID(0),
+						    200, 300);
+	if (!runner_assert(ivilayer != NULL))
+		return NULL;
+
+	for (i = 0; i < IVI_TEST_SURFACE_COUNT; i++) {
+		ivisurfs[i] = lyt->get_surface_from_id(IVI_TEST_SURFACE_ID(i));
+		if (!runner_assert(ivisurfs[i] != NULL))
+			return NULL;
+	}
+
+	lyt->layer_set_render_order(ivilayer, ivisurfs,
+				    IVI_TEST_SURFACE_COUNT);
+	lyt->commit_changes();
+	lyt->commit_changes();
+
+	*seq = 0;
+	for (i = 0; i < IVI_TEST_SURFACE_COUNT; i++) {
+		surf_recs[i].lyt = lyt;
+		surf_recs[i].seq = seq;
+		surf_recs[i].listener.notify = surface_prop_recorder_notify;
+		lyt->surface_add_listener(ivisurfs[i], &surf_recs[i].listener);
+	}
+	layer_rec->lyt = lyt;
+	layer_rec->seq = seq;
+	layer_rec->listener.notify = layer_prop_recorder_notify;
+	lyt->layer_add_listener(ivilayer, &layer_rec->listener);
+
+	prop_recorders_reset(surf_recs, IVI_TEST_SURFACE_COUNT);
+	prop_recorders_reset(layer_rec, 1);
+
+	return ivilayer;
+}
+
+static void
+teardown_recorded_layer(struct test_context *ctx,
+			struct ivi_layout_layer *ivilayer,
+			struct prop_recorder *surf_recs,
+			struct prop_recorder *layer_rec)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	uint32_t i;
+
+	for (i = 0; i < IVI_TEST_SURFACE_COUNT; i++)
+		wl_list_remove(&surf_recs[i].listener.link);
+	wl_list_remove(&layer_rec->listener.link);
+
+	lyt->layer_destroy(ivilayer);
+	lyt->commit_changes();
+}
+
+RUNNER_TEST(commit_one_property)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurfs[IVI_TEST_SURFACE_COUNT] = {};
+	struct prop_recorder surf_recs[IVI_TEST_SURFACE_COUNT] = {};
+	struct prop_recorder layer_rec = {};
+	const struct ivi_layout_surface_properties *prop;
+	struct ivi_layout_layer *ivilayer;
+	int seq;
+
+	ivilayer = setup_recorded_layer(ctx, ivisurfs, surf_recs, &layer_rec,
+					&seq);
+	runner_assert_or_return(ivilayer);
+
+	/* The opacity of one surface is applied and notified on commit. */
+	prop = lyt->get_properties_of_surface(ivisurfs[1]);
+	runner_assert(lyt->surface_set_opacity(ivisurfs[1],
+		      wl_fixed_from_double(0.5)) == IVI_SUCCEEDED);
+	runner_assert(prop->opacity == wl_fixed_from_double(1.0));
+	runner_assert(surf_recs[1].count == 0);
+
+	lyt->commit_changes();
+
+	runner_assert(prop->opacity == wl_fixed_from_double(0.5));
+	runner_assert(surf_recs[1].count == 1);
+	runner_assert(surf_recs[1].mask == IVI_NOTIFICATION_OPACITY);
+	runner_assert(surf_recs[0].count == 0);
+	runner_assert(surf_recs[2].count == 0);
+	runner_assert(layer_rec.count == 0);
+
+	/* Nothing is notified again by a commit without changes. */
+	prop_recorders_reset(surf_recs, IVI_TEST_SURFACE_COUNT);
+	lyt->commit_changes();
+	lyt->commit_changes();
+
+	runner_assert(prop->opacity == wl_fixed_from_double(0.5));
+	runner_assert(surf_recs[1].count == 0);
+	runner_assert(lyt->get_properties_of_surface(ivisurfs[1])->event_mask
+		      == 0);
+
+	/* The destination rectangle of another surface. */
+	prop = lyt->get_properties_of_surface(ivisurfs[2]);
+	runner_assert(lyt->surface_set_destination_rectangle(ivisurfs[2],
+		      20, 30, 200, 300) == IVI_SUCCEEDED);
+	lyt->commit_changes();
+
+	runner_assert(prop->dest_x == 20 && prop->dest_y == 30 &&
+		      prop->dest_width == 200 && prop->dest_height == 300);
+	runner_assert(surf_recs[2].count == 1);
+	runner_assert(surf_recs[2].mask & IVI_NOTIFICATION_DEST_RECT);
+	runner_assert(surf_recs[0].count == 0);
+	runner_assert(surf_recs[1].count == 0);
+	runner_assert(layer_rec.count == 0);
+
+	/* The opacity of the layer notifies the layer only. */
+	prop_recorders_reset(surf_recs, IVI_TEST_SURFACE_COUNT);
+	runner_assert(lyt->layer_set_opacity(ivilayer,
+		      wl_fixed_from_double(0.25)) == IVI_SUCCEEDED);
+	lyt->commit_changes();
+
+	runner_assert(lyt->get_properties_of_layer(ivilayer)->opacity ==
+		      wl_fixed_from_double(0.25));
+	runner_assert(layer_rec.count == 1);
+	runner_assert(layer_rec.mask == IVI_NOTIFICATION_OPACITY);
+	runner_assert(surf_recs[0].count == 0);
+	runner_assert(surf_recs[1].count == 0);
+	runner_assert(surf_recs[2].count == 0);
+
+	/* Setting the current value again notifies nothing. */
+	prop_recorders_reset(&layer_rec, 1);
+	lyt->commit_changes();
+	runner_assert(lyt->surface_set_opacity(ivisurfs[1],
+		      wl_fixed_from_double(0.5)) == IVI_SUCCEEDED);
+	lyt->commit_changes();
+
+	runner_assert(surf_recs[1].count == 0);
+	runner_assert(layer_rec.count == 0);
+
+	teardown_recorded_layer(ctx, ivilayer, surf_recs, &layer_rec);
+}
+
+RUNNER_TEST(commit_notification_order)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurfs[IVI_TEST_SURFACE_COUNT] = {};
+	struct prop_recorder surf_recs[IVI_TEST_SURFACE_COUNT] = {};
+	struct prop_recorder layer_rec = {};
+	struct ivi_layout_layer *ivilayer;
+	int seq;
+
+	ivilayer = setup_recorded_layer(ctx, ivisurfs, surf_recs, &layer_rec,
+					&seq);
+	runner_assert_or_return(ivilayer);
+
+	/*
+	 * Whatever order the properties were set in, layers are notified
+	 * before surfaces, and surfaces in the order they were created.
+	 */
+	lyt->surface_set_opacity(ivisurfs[2], wl_fixed_from_double(0.5));
+	lyt->surface_set_opacity(ivisurfs[0], wl_fixed_from_double(0.5));
+	lyt->layer_set_opacity(ivilayer, wl_fixed_from_double(0.5));
+	lyt->surface_set_opacity(ivisurfs[1], wl_fixed_from_double(0.5));
+	lyt->commit_changes();
+
+	runner_assert(layer_rec.order == 1);
+	runner_assert(surf_recs[0].order == 2);
+	runner_assert(surf_recs[1].order == 3);
+	runner_assert(surf_recs[2].order == 4);
+
+	teardown_recorded_layer(ctx, ivilayer, surf_recs, &layer_rec);
+}
+
+static struct weston_output *
+get_first_output(const struct ivi_layout_interface *lyt,
+		 struct ivi_layout_surface *ivisurf)
+{
+	struct weston_compositor *compositor =
+		lyt->surface_get_weston_surface(ivisurf)->compositor;
+
+	return container_of(compositor->output_list.next,
+			    struct weston_output, link);
+}
+
+static void
+transition_step_notification(struct wl_listener *listener, void *data)
+{
+	struct test_context *ctx =
+		container_of(listener, struct test_context,
+			     surface_property_changed);
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurf = data;
+	const struct ivi_layout_surface_properties *prop;
+	struct weston_output *output = get_first_output(lyt, ivisurf);
+
+	prop = lyt->get_properties_of_surface(ivisurf);
+	if (!(prop->event_mask & IVI_NOTIFICATION_DEST_RECT))
+		return;
+
+	/* a second step within the same output frame */
+	if (ctx->step_count > 0 && output->msc == ctx->step_msc)
+		ctx->user_flags++;
+
+	ctx->step_msc = output->msc;
+	ctx->step_count++;
+}
+
+RUNNER_TEST(transition_frame_sync_p1)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurf;
+	struct ivi_layout_layer *ivilayer;
+	struct weston_output *output;
+
+	ivisurf = lyt->get_surface_from_id(IVI_TEST_SURFACE_ID(0));
+	runner_assert_or_return(ivisurf);
+	output = get_first_output(lyt, ivisurf);
+
+	ivilayer = lyt->layer_create_with_dimension(IVI_TEST_LAYER_ID(0),
+						    200, 300);
+	runner_assert_or_return(ivilayer);
+
+	runner_assert(lyt->screen_add_layer(output, ivilayer) ==
+		      IVI_SUCCEEDED);
+	runner_assert(lyt->layer_add_surface(ivilayer, ivisurf) ==
+		      IVI_SUCCEEDED);
+	runner_assert(lyt->layer_set_visibility(ivilayer, true) ==
+		      IVI_SUCCEEDED);
+	runner_assert(lyt->surface_set_visibility(ivisurf, true) ==
+		      IVI_SUCCEEDED);
+	runner_assert(lyt->surface_set_source_rectangle(ivisurf, 0, 0,
+							 20, 20) ==
+		      IVI_SUCCEEDED);
+	runner_assert(lyt->surface_set_destination_rectangle(ivisurf, 0, 0,
+							      20, 20) ==
+		      IVI_SUCCEEDED);
+	lyt->commit_changes();
+
+	/* 200 ms make about 12 frames at the 60 Hz of the headless output */
+	runner_assert(lyt->surface_set_transition(ivisurf,
+			IVI_LAYOUT_TRANSITION_VIEW_DEST_RECT_ONLY, 200) == 0);
+	runner_assert(lyt->surface_set_destination_rectangle(ivisurf,
+							      150, 250,
+							      20, 20) ==
+		      IVI_SUCCEEDED);
+	lyt->commit_changes();
+
+	/* count the steps of the transition from now on */
+	ctx->user_flags = 0;
+	ctx->step_count = 0;
+	ctx->surface_property_changed.notify = transition_step_notification;
+	runner_assert(lyt->surface_add_listener(ivisurf,
+			&ctx->surface_property_changed) == IVI_SUCCEEDED);
+}
+
+RUNNER_TEST(transition_frame_sync_p2)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct ivi_layout_surface *ivisurf;
+	struct ivi_layout_layer *ivilayer;
+	const struct ivi_layout_surface_properties *prop;
+	struct weston_output *output;
+
+	ivisurf = lyt->get_surface_from_id(IVI_TEST_SURFACE_ID(0));
+	runner_assert_or_return(ivisurf);
+	output = get_first_output(lyt, ivisurf);
+
+	wl_list_remove(&ctx->surface_property_changed.link);
+
+	/* the transition has run to its end... */
+	prop = lyt->get_properties_of_surface(ivisurf);
+	runner_assert(prop->dest_x == 150);
+	runner_assert(prop->dest_y == 250);
+
+	/* ...in several steps, never more than one per output frame... */
+	runner_assert(ctx->step_count > 1);
+	runner_assert(ctx->user_flags == 0);
+
+	/* ...and no longer runs on the output frames. */
+	runner_assert(wl_list_empty(&output->animation_list));
+
+	ivilayer = lyt->get_layer_from_id(IVI_TEST_LAYER_ID(0));
+	runner_assert_or_return(ivilayer);
+	lyt->layer_destroy(ivilayer);
+	lyt->commit_changes();
+}
+
+/*
+ * Commit cost benchmark, run by test-benchmark-ivi-layout
+ * (ivi-layout-benchmark.c) with a number of ivi_surfaces already created.
+ *
+ * The ivi_surfaces are spread over IVI_BENCH_LAYER_COUNT ivi_layers on the
+ * first output, and each case measures ivi_layout_commit_changes() after
+ * changing a single property, which is what an HMI does most of the time.
+ * The results are printed as TAP diagnostic lines "# bench {json}".
+ */
+#define IVI_BENCH_LAYER_COUNT 4
+#define IVI_BENCH_COMMITS 1000
+
+enum bench_change {
+	BENCH_CHANGE_NONE,
+	BENCH_CHANGE_SURFACE_OPACITY,
+	BENCH_CHANGE_LAYER_OPACITY,
+	BENCH_CHANGE_RENDER_ORDER,
+};
+
+static const struct {
+	const char *name;
+	enum bench_change change;
+} bench_cases[] = {
+	{ "no_change", BENCH_CHANGE_NONE },
+	{ "surface_opacity", BENCH_CHANGE_SURFACE_OPACITY },
+	{ "layer_opacity", BENCH_CHANGE_LAYER_OPACITY },
+	{ "render_order", BENCH_CHANGE_RENDER_ORDER },
+};
+
+struct bench_layer {
+	struct ivi_layout_layer *ivilayer;
+	struct ivi_layout_surface **surfaces;
+	int32_t count;
+};
+
+static void
+bench_change(const struct ivi_layout_interface *lyt,
+	     struct bench_layer *layers, enum bench_change change, int i)
+{
+	struct bench_layer *layer = &layers[i % IVI_BENCH_LAYER_COUNT];
+	struct ivi_layout_surface *first;
+	wl_fixed_t opacity = wl_fixed_from_double(i % 2 ? 0.5 : 1.0);
+
+	switch (change) {
+	case BENCH_CHANGE_NONE:
+		break;
+	case BENCH_CHANGE_SURFACE_OPACITY:
+		lyt->surface_set_opacity(layer->surfaces[i % layer->count],
+					 opacity);
+		break;
+	case BENCH_CHANGE_LAYER_OPACITY:
+		lyt->layer_set_opacity(layer->ivilayer, opacity);
+		break;
+	case BENCH_CHANGE_RENDER_ORDER:
+		/* raise the bottom-most ivi_surface to the top */
+		first = layer->surfaces[0];
+		memmove(&layer->surfaces[0], &layer->surfaces[1],
+			(layer->count - 1) * sizeof layer->surfaces[0]);
+		layer->surfaces[layer->count - 1] = first;
+		lyt->layer_set_render_order(layer->ivilayer, layer->surfaces,
+					    layer->count);
+		break;
+	}
+}
+
+RUNNER_TEST(commit_benchmark)
+{
+	const struct ivi_layout_interface *lyt = ctx->layout_interface;
+	struct bench_layer layers[IVI_BENCH_LAYER_COUNT] = {};
+	struct ivi_layout_surface **surfaces = NULL;
+	struct weston_compositor *compositor;
+	struct weston_output *output;
+	struct timespec begin, end;
+	int32_t length = 0;
+	int32_t i, j;
+	unsigned c;
+
+	runner_assert_or_return(lyt->get_surfaces(&length, &surfaces) ==
+				IVI_SUCCEEDED);
+	runner_assert_or_return(length >= IVI_BENCH_LAYER_COUNT);
+
+	compositor = lyt->surface_get_weston_surface(surfaces[0])->compositor;
+	output = wl_container_of(compositor->output_list.next, output, link);
+
+	for (i = 0; i < IVI_BENCH_LAYER_COUNT; i++) {
+		layers[i].ivilayer = lyt->layer_create_with_dimension(
+			IVI_TEST_LAYER_ID(i), output->width, output->height);
+		layers[i].surfaces = zalloc(length * sizeof surfaces[0]);
+		runner_assert_or_return(layers[i].ivilayer &&
+					layers[i].surfaces);
+		lyt->layer_set_visibility(layers[i].ivilayer, true);
+		lyt->layer_set_destination_rectangle(layers[i].ivilayer, 0, 0,
+						     output->width,
+						     output->height);
+		lyt->screen_add_layer(output, layers[i].ivilayer);
+	}
+
+	for (j = 0; j < length; j++) {
+		struct bench_layer *layer = &layers[j % IVI_BENCH_LAYER_COUNT];
+
+		lyt->surface_set_visibility(surfaces[j], true);
+		lyt->surface_set_source_rectangle(surfaces[j], 0, 0, 64, 64);
+		lyt->surface_set_destination_rectangle(surfaces[j],
+						       (j * 16) % output->width,
+						       (j * 9) % output->height,
+						       64, 64);
+		layer->surfaces[layer->count++] = surfaces[j];
+	}
+
+	for (i = 0; i < IVI_BENCH_LAYER_COUNT; i++)
+		lyt->layer_set_render_order(layers[i].ivilayer,
+					    layers[i].surfaces,
+					    layers[i].count);
+	lyt->commit_changes();
+
+	for (c = 0; c < ARRAY_LENGTH(bench_cases); c++) {
+		/* warm up and settle the notifications of the last case */
+		for (i = 0; i < 10; i++) {
+			bench_change(lyt, layers, bench_cases[c].change, i);
+			lyt->commit_changes();
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (i = 0; i < IVI_BENCH_COMMITS; i++) {
+			bench_change(lyt, layers, bench_cases[c].change, i);
+			lyt->commit_changes();
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		printf("# bench {\"case\":\"%s\",\"surfaces\":%d,"
+		       "\"layers\":%d,\"commits\":%d,"
+		       "\"commit_us_mean\":%.2f}\n",
+		       bench_cases[c].name, length, IVI_BENCH_LAYER_COUNT,
+		       IVI_BENCH_COMMITS,
+		       timespec_sub_to_nsec(&end, &begin) / 1000.0 /
+		       IVI_BENCH_COMMITS);
+		fflush(stdout);
+	}
+
+	for (i = 0; i < IVI_BENCH_LAYER_COUNT; i++) {
+		lyt->layer_destroy(layers[i].ivilayer);
+		free(layers[i].surfaces);
+	}
+	lyt->commit_changes();
+
+	free(surfaces);
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2015 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared/xalloc.h"
+#include "weston-test-client-helper.h"
+#include "ivi-application-client-protocol.h"
+#include "ivi-test-client-helper.h"
+
+static void
+runner_finished_handler(void *data, struct weston_test_runner *test_runner)
+{
+	struct runner *runner = data;
+
+	runner->done = 1;
+}
+
+static const struct weston_test_runner_listener test_runner_listener = {
+	runner_finished_handler
+};
+
+struct runner *
+client_create_runner(struct client *client)
+{
+	struct runner *runner;
+	struct global *g;
+	struct global *global_runner = NULL;
+
+	runner = xzalloc(sizeof(*runner));
+	runner->client = client;
+
+	wl_list_for_each(g, &client->global_list, link) {
+		if (strcmp(g->interface, "weston_test_runner"))
+			continue;
+
+		if (global_runner)
+			assert(0 && "multiple weston_test_runner objects");
+
+		global_runner = g;
+	}
+
+	assert(global_runner && "no weston_test_runner found");
+	assert(global_runner->version == 1);
+
+	runner->test_runner = wl_registry_bind(client->wl_registry,
+					       global_runner->name,
+					       &weston_test_runner_interface,
+					       1);
+	assert(runner->test_runner);
+
+	weston_test_runner_add_listener(runner->test_runner,
+					&test_runner_listener, runner);
+
+	return runner;
+}
+
+void
+runner_destroy(struct runner *runner)
+{
+	weston_test_runner_destroy(runner->test_runner);
+	client_roundtrip(runner->client);
+	free(runner);
+}
+
+void
+runner_run(struct runner *runner, const char *test_name)
+{
+	testlog("weston_test_runner.run(\"%s\")\n", test_name);
+
+	runner->done = 0;
+	weston_test_runner_run(runner->test_runner, test_name);
+
+	while (!runner->done) {
+		if (wl_display_dispatch(runner->client->wl_display) < 0)
+			assert(0 && "runner wait");
+	}
+}
+
+struct ivi_application *
+get_ivi_application(struct client *client)
+{
+	struct global *g;
+	struct global *global_iviapp = NULL;
+	struct ivi_application *iviapp;
+
+	wl_list_for_each(g, &client->global_list, link) {
+		if (strcmp(g->interface, "ivi_application"))
+			continue;
+
+		if (global_iviapp)
+			assert(0 && "multiple ivi_application objects");
+
+		global_iviapp = g;
+	}
+
+	assert(global_iviapp && "no ivi_application found");
+
+	assert(global_iviapp->version == 1);
+
+	iviapp = wl_registry_bind(client->wl_registry, global_iviapp->name,
+				  &ivi_application_interface, 1);
+	assert(iviapp);
+
+	return iviapp;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2015 Collabora, Ltd.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef IVI_TEST_CLIENT_HELPER_H
+#define IVI_TEST_CLIENT_HELPER_H
+
+#include "config.h"
+
+struct client;
+struct ivi_application;
+
+/* Runs the RUNNER_TEST()s of test-ivi-layout.so, see
+ * ivi-layout-test-plugin.c. */
+struct runner {
+	struct client *client;
+	struct weston_test_runner *test_runner;
+	int done;
+};
+
+struct runner *
+client_create_runner(struct client *client);
+
+void
+runner_destroy(struct runner *runner);
+
+void
+runner_run(struct runner *runner, const char *test_name);
+
+struct ivi_application *
+get_ivi_application(struct client *client);
+
+#endif /* IVI_TEST_CLIENT_HELPER_H */
@@ -0,0 +1,386 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <libweston/libweston.h>
+#include <libweston/weston-log.h>
+#include "weston-test-runner.h"
+
+#include "shared/helpers.h"
+
+#define N_WRITERS 4
+
+/* An asynchronous file subscriber on one scope, logged to from several
+ * threads at once. */
+struct async_log {
+	struct weston_log_context *log_ctx;
+	struct weston_log_scope *scope;
+	struct weston_log_subscriber *sub;
+};
+
+struct writer {
+	pthread_t thread;
+	struct async_log *log;
+	int id;
+	int count;
+	int payload_max;
+};
+
+static char *
+output_path(const char *suffix)
+{
+	const char *dir = getenv("WESTON_TEST_OUTPUT_PATH");
+	char *path;
+
+	if (!dir)
+		dir = ".";
+	assert(asprintf(&path, "%s/%s%s", dir, get_test_name(), suffix) > 0);
+
+	return path;
+}
+
+static void
+async_log_start(struct async_log *log, const char *path, size_t ring_size,
+		size_t rotate_size)
+{
+	log->log_ctx = weston_log_ctx_create();
+	assert(log->log_ctx);
+	log->scope = weston_log_ctx_add_log_scope(log->log_ctx, "test",
+						  "async log test",
+						  NULL, NULL, NULL);
+	assert(log->scope);
+	log->sub = weston_log_subscriber_create_log_async(path, ring_size,
+							  rotate_size);
+	assert(log->sub);
+	weston_log_subscribe(log->log_ctx, log->sub, "test");
+}
+
+static void
+async_log_stop(struct async_log *log)
+{
+	weston_log_scope_destroy(log->scope);
+	weston_log_subscriber_destroy(log->sub);
+	weston_log_ctx_destroy(log->log_ctx);
+}
+
+/* Waits until the writer thread has dealt with all n messages, one way or
+ * the other. */
+static void
+async_log_wait(struct async_log *log, uint64_t n,
+	       struct weston_log_async_stats *stats)
+{
+	struct timespec delay = { 0, 1000000 };
+	int i;
+
+	for (i = 0; i < 10000; i++) {
+		assert(weston_log_subscriber_get_async_stats(log->sub, stats));
+		if (stats->messages + stats->dropped == n)
+			return;
+		nanosleep(&delay, NULL);
+	}
+
+	assert(!"the writer thread did not catch up");
+}
+
+/* Every message is one line: the writer, its sequence number, and a
+ * payload whose length and contents follow from those two. */
+static int
+format_message(char *buf, size_t size, int id, int seq, int payload_max)
+{
+	int len, plen, i;
+
+	plen = (id * 31 + seq * 17) % (payload_max + 1);
+	len = snprintf(buf, size, "w%d %d %d ", id, seq, plen);
+	assert(len > 0 && (size_t)(len + plen + 1) < size);
+	for (i = 0; i < plen; i++)
+		buf[len + i] = 'a' + (id + seq + i) % 26;
+	buf[len + plen] = '\n';
+
+	return len + plen + 1;
+}
+
+static void *
+writer_thread(void *data)
+{
+	struct writer *w = data;
+	char buf[2048];
+	int seq, len;
+
+	for (seq = 0; seq < w->count; seq++) {
+		len = format_message(buf, sizeof buf, w->id, seq,
+				     w->payload_max);
+		weston_log_scope_write(w->log->scope, buf, len);
+	}
+
+	return NULL;
+}
+
+static void
+run_writers(struct async_log *log, int count, int payload_max)
+{
+	struct writer writers[N_WRITERS];
+	int i;
+
+	for (i = 0; i < N_WRITERS; i++) {
+		writers[i].log = log;
+		writers[i].id = i;
+		writers[i].count = count;
+		writers[i].payload_max = payload_max;
+		assert(pthread_create(&writers[i].thread, NULL,
+				      writer_thread, &writers[i]) == 0);
+	}
+
+	for (i = 0; i < N_WRITERS; i++)
+		pthread_join(writers[i].thread, NULL);
+}
+
+/* Checks every message in data is intact, and that each writer's
+ * messages come in the order it logged them. Returns how many there
+ * were. With gaps allowed, messages may be missing, as dropped ones are.
+ * The line the subscriber writes about itself when destroyed, and
+ * anything else not from a writer, is skipped. */
+static int
+check_messages(const char *data, size_t size, int payload_max, bool gaps,
+	       int *next_seq)
+{
+	char expected[2048];
+	const char *line = data, *end;
+	int n = 0, id, seq, plen, len;
+
+	while (line < data + size) {
+		end = memchr(line, '\n', data + size - line);
+		assert(end);
+
+		if (sscanf(line, "w%d %d %d ", &id, &seq, &plen) == 3) {
+			assert(id >= 0 && id < N_WRITERS);
+			if (gaps)
+				assert(seq >= next_seq[id]);
+			else
+				assert(seq == next_seq[id]);
+			next_seq[id] = seq + 1;
+
+			len = format_message(expected, sizeof expected,
+					     id, seq, payload_max);
+			assert(end + 1 - line == len);
+			assert(memcmp(line, expected, len) == 0);
+			n++;
+		}
+
+		line = end + 1;
+	}
+
+	return n;
+}
+
+static char *
+read_file(const char *path, size_t *size)
+{
+	struct stat st;
+	char *data;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	assert(fd >= 0);
+	assert(fstat(fd, &st) == 0);
+	data = malloc(st.st_size + 1);
+	assert(data);
+	assert(read(fd, data, st.st_size) == st.st_size);
+	close(fd);
+
+	*size = st.st_size;
+	return data;
+}
+
+TEST(log_async_concurrent_writers)
+{
+	const int count = 2000, payload_max = 200;
+	struct weston_log_async_stats stats;
+	struct async_log log;
+	int next_seq[N_WRITERS] = { 0 };
+	char *path, *data;
+	size_t size;
+	int i;
+
+	path = output_path(".log");
+	unlink(path);
+
+	/* The ring holds everything, so nothing may be dropped even if the
+	 * writer thread never gets to run. */
+	async_log_start(&log, path, 4 * 1024 * 1024, 0);
+
+	run_writers(&log, count, payload_max);
+	async_log_wait(&log, N_WRITERS * count, &stats);
+	assert(stats.messages == (uint64_t)N_WRITERS * count);
+	assert(stats.dropped == 0);
+	assert(stats.rotations == 0);
+
+	data = read_file(path, &size);
+	assert(check_messages(data, size, payload_max, false, next_seq) ==
+	       N_WRITERS * count);
+	for (i = 0; i < N_WRITERS; i++)
+		assert(next_seq[i] == count);
+	free(data);
+
+	async_log_stop(&log);
+	unlink(path);
+	free(path);
+}
+
+struct fifo_reader {
+	pthread_t thread;
+	int fd;
+	char *data;
+	size_t size;
+};
+
+static void *
+fifo_reader_thread(void *data)
+{
+	struct fifo_reader *r = data;
+	size_t alloc = 0;
+	ssize_t ret;
+
+	for (;;) {
+		if (r->size == alloc) {
+			alloc = alloc ? alloc * 2 : 64 * 1024;
+			r->data = realloc(r->data, alloc);
+			assert(r->data);
+		}
+
+		ret = read(r->fd, r->data + r->size, alloc - r->size);
+		assert(ret >= 0);
+		if (ret == 0)
+			break;
+		r->size += ret;
+	}
+
+	return NULL;
+}
+
+TEST(log_async_drops_are_counted)
+{
+	const int count = 500, payload_max = 1000;
+	struct weston_log_async_stats stats;
+	struct fifo_reader reader = { 0 };
+	struct async_log log;
+	int next_seq[N_WRITERS] = { 0 };
+	char *path;
+	int flags;
+
+	/* The log goes to a FIFO nobody reads yet, so the writer thread
+	 * blocks as soon as the pipe is full, and then the smallest ring
+	 * fills up too. The writers log far more than both can hold. */
+	path = output_path(".fifo");
+	unlink(path);
+	assert(mkfifo(path, 0600) == 0);
+	reader.fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	assert(reader.fd >= 0);
+
+	async_log_start(&log, path, 0, 0);
+	run_writers(&log, count, payload_max);
+
+	flags = fcntl(reader.fd, F_GETFL);
+	assert(fcntl(reader.fd, F_SETFL, flags & ~O_NONBLOCK) == 0);
+	assert(pthread_create(&reader.thread, NULL, fifo_reader_thread,
+			      &reader) == 0);
+
+	async_log_wait(&log, N_WRITERS * count, &stats);
+	assert(stats.dropped > 0);
+	assert(stats.messages > 0);
+
+	/* Closes the FIFO, which ends the reader. */
+	async_log_stop(&log);
+	pthread_join(reader.thread, NULL);
+	close(reader.fd);
+
+	/* What got through is intact and in order, and is exactly what the
+	 * counters say was written. */
+	assert(check_messages(reader.data, reader.size, payload_max, true,
+			      next_seq) == (int)stats.messages);
+
+	unlink(path);
+	free(path);
+	free(reader.data);
+}
+
+TEST(log_async_rotation)
+{
+	const int count = 400, payload_max = 100;
+	const size_t rotate_size = 4096;
+	struct weston_log_async_stats stats;
+	struct async_log log;
+	struct writer w = { .log = &log, .id = 0, .count = count,
+			    .payload_max = payload_max };
+	int next_seq[N_WRITERS] = { 0 };
+	char *path, *old, *data;
+	size_t size, old_size;
+	int n_old;
+
+	path = output_path(".log");
+	assert(asprintf(&old, "%s.1", path) > 0);
+	unlink(path);
+	unlink(old);
+
+	async_log_start(&log, path, 0, rotate_size);
+	writer_thread(&w);
+	async_log_wait(&log, count, &stats);
+	assert(stats.messages == (uint64_t)count);
+	assert(stats.dropped == 0);
+	assert(stats.rotations > 0);
+
+	/* Lets the writer thread finish rotating. */
+	async_log_stop(&log);
+
+	/* Only the last rotated file is kept. It was rotated once it
+	 * reached the limit, so it is at least that big. Together with the
+	 * current file, it holds the newest messages without a gap. */
+	data = read_file(old, &old_size);
+	assert(old_size >= rotate_size);
+	n_old = check_messages(data, old_size, payload_max, true, next_seq);
+	assert(n_old > 0);
+	free(data);
+
+	data = read_file(path, &size);
+	check_messages(data, size, payload_max, false, next_seq);
+	free(data);
+	assert(next_seq[0] == count);
+
+	unlink(path);
+	unlink(old);
+	free(path);
+	free(old);
+}
@@ -25,6 +25,7 @@
 
 #include "config.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -33,6 +34,7 @@
 #include <time.h>
 
 #include <libweston/matrix.h>
+#include "shared/helpers.h"
 
 struct inverse_matrix {
 	double LU[16];		/* column-major */
@@ -243,6 +245,133 @@ test(void)
 	return TEST_FAIL;
 }
 
+#define POINTS_MAX 67
+
+/* Transform n points with weston_matrix_transform_points() and compare
+ * each with weston_matrix_transform() of (x, y, 0, 1). The x coordinates
+ * listed in special are put first, at the end of the SSE2 part and in the
+ * scalar tail. Returns the number of mismatches.
+ */
+static int
+check_transform_points(const char *name, struct weston_matrix *m, int n,
+		       const float *special, int n_special)
+{
+	float x[POINTS_MAX], y[POINTS_MAX];
+	float out_x[POINTS_MAX], out_y[POINTS_MAX];
+	int unstable = 0;
+	int fails = 0;
+	int ret, i;
+
+	assert(n <= POINTS_MAX);
+
+	for (i = 0; i < POINTS_MAX; ++i) {
+		x[i] = 100.0 * frand();
+		y[i] = 100.0 * frand();
+	}
+	for (i = 0; i < n_special && i < n; ++i) {
+		x[i] = special[i];
+		x[n - 1 - i] = special[i];
+		if (n > 4)
+			x[n / 4 * 4 - 1 - i % 4] = special[i];
+	}
+
+	ret = weston_matrix_transform_points(m, x, y, out_x, out_y, n);
+
+	for (i = 0; i < n; ++i) {
+		struct weston_vector v = { { x[i], y[i], 0.0f, 1.0f } };
+		float ex, ey;
+
+		weston_matrix_transform(m, &v);
+		if (fabsf(v.f[3]) < 1e-6) {
+			unstable++;
+			ex = 0.0f;
+			ey = 0.0f;
+		} else {
+			ex = v.f[0] / v.f[3];
+			ey = v.f[1] / v.f[3];
+		}
+
+		if (fabsf(out_x[i] - ex) > 1e-5 * fmaxf(1.0f, fabsf(ex)) ||
+		    fabsf(out_y[i] - ey) > 1e-5 * fmaxf(1.0f, fabsf(ey))) {
+			printf("%s, %d points: point %d (%g, %g) -> (%g, %g), "
+			       "expected (%g, %g)\n", name, n, i, x[i], y[i],
+			       out_x[i], out_y[i], ex, ey);
+			fails++;
+		}
+	}
+
+	if (ret != unstable) {
+		printf("%s, %d points: %d unstable points, expected %d\n",
+		       name, n, ret, unstable);
+		fails++;
+	}
+
+	return fails;
+}
+
+static int
+test_transform_points(void)
+{
+	static const int counts[] = { 1, 3, 4, 7, 16, POINTS_MAX };
+	/* Divisors around the 1e-6 cutoff, for the projective case. */
+	static const float near_zero_w[] = { 0.0f, 1e-7f, -5e-7f, 2e-6f };
+	struct weston_matrix m[4];
+	const char *names[4] = { "translate", "scale", "affine", "projective" };
+	int fails = 0;
+	unsigned i, j;
+
+	weston_matrix_init(&m[0]);
+	weston_matrix_translate(&m[0], 12.5f, -7.25f, 0.0f);
+
+	weston_matrix_init(&m[1]);
+	weston_matrix_scale(&m[1], 2.5f, -0.5f, 1.0f);
+	weston_matrix_translate(&m[1], 12.5f, -7.25f, 0.0f);
+
+	weston_matrix_init(&m[2]);
+	weston_matrix_scale(&m[2], 2.5f, 0.5f, 1.0f);
+	weston_matrix_rotate_xy(&m[2], cosf(0.5f), sinf(0.5f));
+	weston_matrix_translate(&m[2], 12.5f, -7.25f, 0.0f);
+
+	assert(m[0].type == WESTON_MATRIX_TRANSFORM_TRANSLATE);
+	assert(m[1].type == (WESTON_MATRIX_TRANSFORM_SCALE |
+			     WESTON_MATRIX_TRANSFORM_TRANSLATE));
+	assert(m[2].type & WESTON_MATRIX_TRANSFORM_ROTATE);
+
+	printf("\nComparing weston_matrix_transform_points() with "
+	       "weston_matrix_transform()...\n");
+
+	for (i = 0; i < 3; ++i)
+		for (j = 0; j < ARRAY_LENGTH(counts); ++j)
+			fails += check_transform_points(names[i], &m[i],
+							counts[j], NULL, 0);
+
+	/* A random projective matrix whose w stays around 1. */
+	for (j = 0; j < ARRAY_LENGTH(counts); ++j) {
+		for (i = 0; i < 16; ++i)
+			m[3].d[i] = frand();
+		m[3].d[3] *= 1e-3;
+		m[3].d[7] *= 1e-3;
+		m[3].d[15] = 1.0f;
+		m[3].type = WESTON_MATRIX_TRANSFORM_OTHER;
+		fails += check_transform_points(names[3], &m[3], counts[j],
+						NULL, 0);
+	}
+
+	/* w = x, to cross the cutoff. */
+	weston_matrix_init(&m[3]);
+	m[3].d[3] = 1.0f;
+	m[3].d[15] = 0.0f;
+	m[3].type = WESTON_MATRIX_TRANSFORM_OTHER;
+	for (j = 0; j < ARRAY_LENGTH(counts); ++j)
+		fails += check_transform_points("w cutoff", &m[3], counts[j],
+						near_zero_w,
+						ARRAY_LENGTH(near_zero_w));
+
+	printf("%d mismatches.\n", fails);
+
+	return fails;
+}
+
 static int running;
 static void
 stopme(int n)
@@ -414,6 +543,9 @@ int main(void)
 	print_matrix(&M);
 	printf("max abs error: %g, original determinant %g\n", errsup, det);
 
+	if (test_transform_points() != 0)
+		return 1;
+
 	test_loop_precision();
 	test_loop_speed_matrixvector();
 	test_loop_speed_inversetransform();
@@ -0,0 +1,248 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <time.h>
+
+#include "relative-pointer-unstable-v1-client-protocol.h"
+#include "shared/timespec-util.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.shell = SHELL_TEST_DESKTOP;
+	weston_ini_setup(&setup,
+			 cfgln("[core]"),
+			 cfgln("coalesce-pointer-motion=true"));
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+/* Numbers the events on a wl_pointer and its relative pointer in the order
+ * they arrive, to check how the coalesced motion is framed. */
+struct motion_log {
+	int seq;
+	int x, y;
+
+	int n_motions;
+	int last_motion;
+
+	int n_relative;
+	int last_relative;
+	wl_fixed_t dx, dy;
+	wl_fixed_t dx_unaccel, dy_unaccel;
+
+	int last_frame;
+};
+
+static void
+log_handle_enter(void *data, struct wl_pointer *wl_pointer,
+		 uint32_t serial, struct wl_surface *wl_surface,
+		 wl_fixed_t x, wl_fixed_t y)
+{
+	struct motion_log *log = data;
+
+	log->x = wl_fixed_to_int(x);
+	log->y = wl_fixed_to_int(y);
+}
+
+static void
+log_handle_leave(void *data, struct wl_pointer *wl_pointer,
+		 uint32_t serial, struct wl_surface *wl_surface)
+{
+}
+
+static void
+log_handle_motion(void *data, struct wl_pointer *wl_pointer,
+		  uint32_t time, wl_fixed_t x, wl_fixed_t y)
+{
+	struct motion_log *log = data;
+
+	log->x = wl_fixed_to_int(x);
+	log->y = wl_fixed_to_int(y);
+	log->n_motions++;
+	log->last_motion = ++log->seq;
+}
+
+static void
+log_handle_button(void *data, struct wl_pointer *wl_pointer,
+		  uint32_t serial, uint32_t time, uint32_t button,
+		  uint32_t state)
+{
+}
+
+static void
+log_handle_axis(void *data, struct wl_pointer *wl_pointer,
+		uint32_t time, uint32_t axis, wl_fixed_t value)
+{
+}
+
+static void
+log_handle_frame(void *data, struct wl_pointer *wl_pointer)
+{
+	struct motion_log *log = data;
+
+	log->last_frame = ++log->seq;
+}
+
+static void
+log_handle_axis_source(void *data, struct wl_pointer *wl_pointer,
+		       uint32_t source)
+{
+}
+
+static void
+log_handle_axis_stop(void *data, struct wl_pointer *wl_pointer,
+		     uint32_t time, uint32_t axis)
+{
+}
+
+static void
+log_handle_axis_discrete(void *data, struct wl_pointer *wl_pointer,
+			 uint32_t axis, int32_t discrete)
+{
+}
+
+static const struct wl_pointer_listener log_pointer_listener = {
+	log_handle_enter,
+	log_handle_leave,
+	log_handle_motion,
+	log_handle_button,
+	log_handle_axis,
+	log_handle_frame,
+	log_handle_axis_source,
+	log_handle_axis_stop,
+	log_handle_axis_discrete,
+};
+
+static void
+log_handle_relative_motion(void *data,
+			   struct zwp_relative_pointer_v1 *relative_pointer,
+			   uint32_t utime_hi, uint32_t utime_lo,
+			   wl_fixed_t dx, wl_fixed_t dy,
+			   wl_fixed_t dx_unaccel, wl_fixed_t dy_unaccel)
+{
+	struct motion_log *log = data;
+
+	log->dx += dx;
+	log->dy += dy;
+	log->dx_unaccel += dx_unaccel;
+	log->dy_unaccel += dy_unaccel;
+	log->n_relative++;
+	log->last_relative = ++log->seq;
+}
+
+static const struct zwp_relative_pointer_v1_listener log_relative_listener = {
+	log_handle_relative_motion,
+};
+
+static void
+inject_motion(struct client *client, int x, int y)
+{
+	struct timespec time;
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	timespec_to_proto(&time, &tv_sec_hi, &tv_sec_lo, &tv_nsec);
+	weston_test_move_pointer(client->test->weston_test,
+				 tv_sec_hi, tv_sec_lo, tv_nsec, x, y);
+}
+
+TEST(coalesced_relative_motion_is_lossless)
+{
+	const int n_events = 16;
+	struct motion_log log = { 0 };
+	struct zwp_relative_pointer_manager_v1 *manager;
+	struct zwp_relative_pointer_v1 *relative;
+	struct wl_pointer *wl_pointer;
+	struct client *client;
+	int x0 = 40, y0 = 30;
+	int x = x0, y = y0;
+	int round, i;
+
+	client = create_client_and_test_surface(0, 0, 320, 240);
+	assert(client);
+
+	wl_pointer = wl_seat_get_pointer(client->input->wl_seat);
+	wl_pointer_add_listener(wl_pointer, &log_pointer_listener, &log);
+
+	manager = bind_to_singleton_global(client,
+					   &zwp_relative_pointer_manager_v1_interface,
+					   1);
+	relative = zwp_relative_pointer_manager_v1_get_relative_pointer(manager,
+									wl_pointer);
+	zwp_relative_pointer_v1_add_listener(relative, &log_relative_listener,
+					     &log);
+
+	/* Get the focus at the starting position. */
+	inject_motion(client, x0, y0);
+	while (log.x != x0 || log.y != y0)
+		assert(wl_display_dispatch(client->wl_display) >= 0);
+	client_roundtrip(client);
+	log = (struct motion_log) { .x = x0, .y = y0 };
+
+	for (round = 0; round < 3; round++) {
+		/* A burst of motions in a single dispatch of the compositor,
+		 * including steps back, which must not cancel out. */
+		for (i = 0; i < n_events; i++) {
+			x += (i % 4 == 3) ? -2 : 3;
+			y += (i % 2) ? 1 : 2;
+			inject_motion(client, x, y);
+		}
+
+		while (log.x != x || log.y != y)
+			assert(wl_display_dispatch(client->wl_display) >= 0);
+		client_roundtrip(client);
+
+		/* Nothing of the injected motion went missing ... */
+		assert(log.dx_unaccel == wl_fixed_from_int(x - x0));
+		assert(log.dy_unaccel == wl_fixed_from_int(y - y0));
+		assert(log.dx == wl_fixed_from_int(x - x0));
+		assert(log.dy == wl_fixed_from_int(y - y0));
+		assert(log.n_relative == log.n_motions);
+		assert(log.n_motions > 0);
+
+		/* ... and the flushed motion was terminated by a frame. */
+		assert(log.last_frame > log.last_motion);
+		assert(log.last_frame > log.last_relative);
+		assert(log.last_frame == log.seq);
+	}
+
+	testlog("%d injected motions delivered as %d\n",
+		3 * n_events, log.n_motions);
+
+	zwp_relative_pointer_v1_destroy(relative);
+	zwp_relative_pointer_manager_v1_destroy(manager);
+	wl_pointer_release(wl_pointer);
+	client_destroy(client);
+}
@@ -0,0 +1,300 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Pointer motion benchmark, with and without coalesce-pointer-motion.
+ *
+ * A high rate mouse is simulated by injecting bursts of one pixel
+ * weston_test.move_pointer requests, one burst per frame, over a surface
+ * covering the output. After each burst the client waits for the
+ * wl_pointer.motion reaching the final position. Per burst, it measures:
+ *
+ * - the CPU time spent by the compositor, i.e. the process CPU time minus
+ *   the CPU time of this client thread,
+ * - the number of wl_pointer.motion events received,
+ * - the latency from the last injected motion to its delivery.
+ *
+ * The results are printed as TAP diagnostic lines of the form
+ * "# bench {json}", one per case.
+ *
+ * WESTON_BENCH_FRAMES and WESTON_BENCH_EVENTS environment variables
+ * override the number of bursts and the number of motions per burst.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+#include "weston-bench-helper.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+#define WARMUP_FRAMES 10
+#define DEFAULT_FRAMES 120
+/* a 1000 Hz mouse on a 60 Hz output */
+#define DEFAULT_EVENTS 16
+
+#define OUTPUT_WIDTH 1024
+#define OUTPUT_HEIGHT 768
+
+struct setup_args {
+	struct fixture_metadata meta;
+	bool coalesce;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{
+		.meta.name = "immediate",
+		.coalesce = false,
+	},
+	{
+		.meta.name = "coalesced",
+		.coalesce = true,
+	},
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.width = OUTPUT_WIDTH;
+	setup.height = OUTPUT_HEIGHT;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log";
+
+	if (arg->coalesce) {
+		weston_ini_setup(&setup,
+				 cfgln("[core]"),
+				 cfgln("coalesce-pointer-motion=true"));
+	}
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
+
+struct motion_counter {
+	int x;
+	int n_motions;
+	struct timespec last_motion;
+};
+
+static void
+counter_handle_enter(void *data, struct wl_pointer *wl_pointer,
+		     uint32_t serial, struct wl_surface *wl_surface,
+		     wl_fixed_t x, wl_fixed_t y)
+{
+	struct motion_counter *counter = data;
+
+	counter->x = wl_fixed_to_int(x);
+	clock_gettime(CLOCK_MONOTONIC, &counter->last_motion);
+}
+
+static void
+counter_handle_leave(void *data, struct wl_pointer *wl_pointer,
+		     uint32_t serial, struct wl_surface *wl_surface)
+{
+}
+
+static void
+counter_handle_motion(void *data, struct wl_pointer *wl_pointer,
+		      uint32_t time, wl_fixed_t x, wl_fixed_t y)
+{
+	struct motion_counter *counter = data;
+
+	counter->x = wl_fixed_to_int(x);
+	counter->n_motions++;
+	clock_gettime(CLOCK_MONOTONIC, &counter->last_motion);
+}
+
+static void
+counter_handle_button(void *data, struct wl_pointer *wl_pointer,
+		      uint32_t serial, uint32_t time, uint32_t button,
+		      uint32_t state)
+{
+}
+
+static void
+counter_handle_axis(void *data, struct wl_pointer *wl_pointer,
+		    uint32_t time, uint32_t axis, wl_fixed_t value)
+{
+}
+
+static void
+counter_handle_frame(void *data, struct wl_pointer *wl_pointer)
+{
+}
+
+static void
+counter_handle_axis_source(void *data, struct wl_pointer *wl_pointer,
+			   uint32_t source)
+{
+}
+
+static void
+counter_handle_axis_stop(void *data, struct wl_pointer *wl_pointer,
+			 uint32_t time, uint32_t axis)
+{
+}
+
+static void
+counter_handle_axis_discrete(void *data, struct wl_pointer *wl_pointer,
+			     uint32_t axis, int32_t discrete)
+{
+}
+
+static const struct wl_pointer_listener counter_listener = {
+	counter_handle_enter,
+	counter_handle_leave,
+	counter_handle_motion,
+	counter_handle_button,
+	counter_handle_axis,
+	counter_handle_frame,
+	counter_handle_axis_source,
+	counter_handle_axis_stop,
+	counter_handle_axis_discrete,
+};
+
+struct burst_stats {
+	int64_t compositor_cpu_nsec;
+	int64_t latency_nsec;
+	int n_motions;
+};
+
+static void
+run_burst(struct client *client, struct motion_counter *counter,
+	  int first, int n_events, struct burst_stats *stats)
+{
+	struct timespec proc_begin, proc_end, thread_begin, thread_end;
+	struct timespec inject_time;
+	uint32_t tv_sec_hi, tv_sec_lo, tv_nsec;
+	int motions_begin = counter->n_motions;
+	int x = 0;
+	int i;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &proc_begin);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_begin);
+
+	for (i = 0; i < n_events; i++) {
+		/* Stay clear of the output edges, and never end a burst
+		 * where the previous one ended. */
+		x = 100 + (first + i) % (OUTPUT_WIDTH - 200);
+
+		clock_gettime(CLOCK_MONOTONIC, &inject_time);
+		timespec_to_proto(&inject_time, &tv_sec_hi, &tv_sec_lo,
+				  &tv_nsec);
+		weston_test_move_pointer(client->test->weston_test,
+					 tv_sec_hi, tv_sec_lo, tv_nsec,
+					 x, OUTPUT_HEIGHT / 2);
+	}
+
+	while (counter->x != x)
+		assert(wl_display_dispatch(client->wl_display) >= 0);
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &proc_end);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_end);
+
+	stats->compositor_cpu_nsec =
+		timespec_sub_to_nsec(&proc_end, &proc_begin) -
+		timespec_sub_to_nsec(&thread_end, &thread_begin);
+	stats->latency_nsec =
+		timespec_sub_to_nsec(&counter->last_motion, &inject_time);
+	stats->n_motions = counter->n_motions - motions_begin;
+}
+
+static void
+report(const struct burst_stats *stats, int count, int n_events)
+{
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	int64_t *latency = xzalloc(count * sizeof *latency);
+	int64_t cpu_total = 0, motions_total = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		cpu_total += stats[i].compositor_cpu_nsec;
+		motions_total += stats[i].n_motions;
+		latency[i] = stats[i].latency_nsec;
+	}
+	qsort(latency, count, sizeof *latency, compare_int64);
+
+	printf("# bench {\"case\":\"%s\",\"frames\":%d,"
+	       "\"events_per_frame\":%d,\"motions_per_frame\":%.2f,"
+	       "\"cpu_us_per_event\":%.2f,\"cpu_us_per_frame\":%.1f,"
+	       "\"latency_us_p50\":%.1f,\"latency_us_p95\":%.1f}\n",
+	       args->meta.name, count, n_events,
+	       (double) motions_total / count,
+	       cpu_total / 1000.0 / ((int64_t) count * n_events),
+	       cpu_total / 1000.0 / count,
+	       latency[count / 2] / 1000.0,
+	       latency[(count * 95) / 100] / 1000.0);
+	fflush(stdout);
+
+	free(latency);
+}
+
+TEST(pointer_motion_benchmark)
+{
+	int n_frames = getenv_int("WESTON_BENCH_FRAMES", DEFAULT_FRAMES);
+	int n_events = getenv_int("WESTON_BENCH_EVENTS", DEFAULT_EVENTS);
+	struct motion_counter counter = { .x = -1 };
+	struct burst_stats *stats;
+	struct wl_pointer *wl_pointer;
+	struct client *client;
+	int i;
+
+	/* A burst must move the pointer, see run_burst(). */
+	assert(n_events % (OUTPUT_WIDTH - 200) != 0);
+
+	client = create_client_and_test_surface(0, 0,
+						OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	assert(client);
+
+	wl_pointer = wl_seat_get_pointer(client->input->wl_seat);
+	wl_pointer_add_listener(wl_pointer, &counter_listener, &counter);
+	client_roundtrip(client);
+
+	stats = xzalloc(n_frames * sizeof *stats);
+
+	for (i = 0; i < WARMUP_FRAMES; i++)
+		run_burst(client, &counter, i * n_events, n_events, &stats[0]);
+
+	for (i = 0; i < n_frames; i++)
+		run_burst(client, &counter, (WARMUP_FRAMES + i) * n_events,
+			  n_events, &stats[i]);
+
+	report(stats, n_frames, n_events);
+
+	free(stats);
+	wl_pointer_release(wl_pointer);
+	client_destroy(client);
+}
@@ -495,3 +495,45 @@ TEST(pointer_timestamps_stop_after_client_releases_wl_pointer)
 	client->input->pointer = NULL;
 	client_destroy(client);
 }
+
+TEST(pointer_focus_follows_scene_under_stationary_pointer)
+{
+	struct client *client;
+	struct client *other;
+	struct surface *surface;
+
+	client = create_client_with_pointer_focus(100, 100, 100, 100);
+	surface = client->surface;
+	check_pointer_move(client, 150, 150);
+
+	/* A second client repaints the output after the first one unmapped,
+	 * since an unmapped surface gets no frame callbacks. */
+	other = create_client_and_test_surface(300, 300, 50, 50);
+	assert(other);
+
+	/* the surface moves away from the pointer */
+	move_client(client, 200, 200);
+	client_roundtrip(client);
+	assert(client->input->pointer->focus == NULL);
+
+	/* and back under it */
+	move_client(client, 100, 100);
+	client_roundtrip(client);
+	check_pointer(client, 150, 150);
+
+	/* the surface is unmapped */
+	wl_surface_attach(surface->wl_surface, NULL, 0, 0);
+	wl_surface_commit(surface->wl_surface);
+	client_roundtrip(client);
+	move_client(other, 310, 310);
+	client_roundtrip(client);
+	assert(client->input->pointer->focus == NULL);
+
+	/* and mapped again */
+	move_client(client, 100, 100);
+	client_roundtrip(client);
+	check_pointer(client, 150, 150);
+
+	client_destroy(other);
+	client_destroy(client);
+}
@@ -39,16 +39,35 @@
 #include "presentation-time-client-protocol.h"
 #include "weston-test-fixture-compositor.h"
 
+struct setup_args {
+	struct fixture_metadata meta;
+	const char *refresh_rate;
+	uint32_t refresh_mhz;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{ .meta.name = "default", .refresh_rate = NULL, .refresh_mhz = 60000 },
+	{ .meta.name = "30 Hz", .refresh_rate = "30", .refresh_mhz = 30000 },
+	{ .meta.name = "free-running", .refresh_rate = "0", .refresh_mhz = 0 },
+};
+
 static enum test_result_code
-fixture_setup(struct weston_test_harness *harness)
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
 {
 	struct compositor_setup setup;
 
 	compositor_setup_defaults(&setup);
 
+	if (arg->refresh_rate) {
+		weston_ini_setup(&setup,
+				 cfgln("[output]"),
+				 cfgln("name=headless"),
+				 cfgln("refresh-rate=%s", arg->refresh_rate));
+	}
+
 	return weston_test_harness_execute_as_client(harness, &setup);
 }
-DECLARE_FIXTURE_SETUP(fixture_setup);
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
 
 static struct wp_presentation *
 get_presentation(struct client *client)
@@ -250,3 +269,58 @@ TEST(test_presentation_feedback_simple)
 	wp_presentation_destroy(pres);
 	client_destroy(client);
 }
+
+TEST(test_presentation_feedback_refresh_rate)
+{
+	const struct setup_args *arg = &my_setup_args[get_test_fixture_index()];
+	struct client *client;
+	struct feedback *fb[5];
+	struct wp_presentation *pres;
+	int64_t period;
+	unsigned i;
+
+	client = create_client_and_test_surface(100, 50, 123, 77);
+	assert(client);
+	pres = get_presentation(client);
+
+	for (i = 0; i < ARRAY_LENGTH(fb); i++) {
+		wl_surface_attach(client->surface->wl_surface,
+				  client->surface->buffer->proxy, 0, 0);
+		fb[i] = feedback_create(client, client->surface->wl_surface,
+					pres);
+		wl_surface_damage(client->surface->wl_surface, 0, 0, 100, 100);
+		wl_surface_commit(client->surface->wl_surface);
+		feedback_wait(fb[i]);
+
+		testlog("%s feedback %u:", __func__, i);
+		feedback_print(fb[i]);
+		testlog("\n");
+
+		assert(fb[i]->result == FB_PRESENTED);
+	}
+
+	for (i = 1; i < ARRAY_LENGTH(fb); i++) {
+		assert(fb[i]->seq > fb[i - 1]->seq);
+		assert(timespec_sub_to_nsec(&fb[i]->time, &fb[i - 1]->time) > 0);
+	}
+
+	if (arg->refresh_mhz == 0) {
+		/* Free-running: frames are not tied to any vblank. */
+		for (i = 0; i < ARRAY_LENGTH(fb); i++)
+			assert(!(fb[i]->flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC));
+	} else {
+		/* Clocked: every frame lands exactly on a virtual vblank. */
+		period = millihz_to_nsec(arg->refresh_mhz);
+		for (i = 0; i < ARRAY_LENGTH(fb); i++) {
+			assert(fb[i]->refresh_nsec == period);
+			assert(fb[i]->flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC);
+			assert(timespec_sub_to_nsec(&fb[i]->time, &fb[0]->time) ==
+			       (int64_t)(fb[i]->seq - fb[0]->seq) * period);
+		}
+	}
+
+	for (i = 0; i < ARRAY_LENGTH(fb); i++)
+		feedback_destroy(fb[i]);
+	wp_presentation_destroy(pres);
+	client_destroy(client);
+}
@@ -0,0 +1,671 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Synthetic load benchmarks for the repaint path.
+ *
+ * Each case maps a number of wl_shm (or udmabuf-backed dmabuf) surfaces,
+ * then commits new content with a given damage pattern for a number of
+ * frames. Per frame, it measures:
+ *
+ * - the CPU time spent by the compositor, i.e. the process CPU time minus
+ *   the CPU time of this client thread,
+ * - the latency from wl_surface.commit to the presentation timestamp
+ *   reported by wp_presentation_feedback,
+ * - the number of heap allocations made outside of the client thread.
+ *
+ * The results are printed as TAP diagnostic lines of the form
+ * "# bench {json}", one per case, so they can be collected from the
+ * meson benchmark log.
+ *
+ * WESTON_BENCH_FRAMES and WESTON_BENCH_SURFACES environment variables
+ * override the number of measured frames and surfaces for every case.
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#ifdef HAVE_LINUX_UDMABUF_H
+#include <linux/udmabuf.h>
+#endif
+
+#include "shared/helpers.h"
+#include "shared/os-compatibility.h"
+#include "shared/timespec-util.h"
+#include "shared/weston-drm-fourcc.h"
+#include "shared/xalloc.h"
+#include "weston-bench-helper.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+#include "presentation-time-client-protocol.h"
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+
+#define WARMUP_FRAMES 10
+#define DEFAULT_FRAMES 120
+
+struct setup_args {
+	struct fixture_metadata meta;
+	enum renderer_type renderer;
+	const char *renderer_name;
+};
+
+static const struct setup_args my_setup_args[] = {
+	{
+		.meta.name = "pixman",
+		.renderer = RENDERER_PIXMAN,
+		.renderer_name = "pixman",
+	},
+	{
+		.meta.name = "GL",
+		.renderer = RENDERER_GL,
+		.renderer_name = "gl",
+	},
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness, const struct setup_args *arg)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.renderer = arg->renderer;
+	setup.width = 1280;
+	setup.height = 720;
+	setup.shell = SHELL_TEST_DESKTOP;
+	setup.logging_scopes = "log";
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP_WITH_ARG(fixture_setup, my_setup_args, meta);
+
+/*
+ * Heap allocation counting
+ *
+ * The compositor runs in this same process, so interposing malloc and
+ * friends lets us count its allocations. Allocations made by the client
+ * thread are not counted.
+ */
+#ifdef HAVE___LIBC_MALLOC
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static __thread bool in_client_thread;
+static uint64_t alloc_count;
+
+static inline void
+count_alloc(void)
+{
+	if (!in_client_thread)
+		__atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+}
+
+WL_EXPORT void *
+malloc(size_t size)
+{
+	count_alloc();
+	return __libc_malloc(size);
+}
+
+WL_EXPORT void *
+calloc(size_t nmemb, size_t size)
+{
+	count_alloc();
+	return __libc_calloc(nmemb, size);
+}
+
+WL_EXPORT void *
+realloc(void *ptr, size_t size)
+{
+	count_alloc();
+	return __libc_realloc(ptr, size);
+}
+
+static void
+mark_client_thread(void)
+{
+	in_client_thread = true;
+}
+
+static int64_t
+read_alloc_count(void)
+{
+	return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+}
+#else
+static void
+mark_client_thread(void)
+{
+}
+
+static int64_t
+read_alloc_count(void)
+{
+	return -1;
+}
+#endif
+
+enum damage_pattern {
+	/* the whole surface */
+	DAMAGE_FULL,
+	/* one small rectangle moving across the surface */
+	DAMAGE_SMALL,
+	/* a grid of many tiny rectangles, like text glyphs */
+	DAMAGE_SCATTERED,
+};
+
+struct bench_case {
+	const char *name;
+	int n_surfaces;
+	int width;
+	int height;
+	enum damage_pattern damage;
+	/* depth of the synchronized sub-surface chain on each surface */
+	int subsurface_depth;
+	/* wp_viewport destination in percent of buffer size, 0 for none */
+	int viewport_percent;
+	enum wl_output_transform buffer_transform;
+	bool dmabuf;
+};
+
+static const struct bench_case bench_cases[] = {
+	{ "shm-full", 1, 1280, 720, DAMAGE_FULL },
+	{ "shm-small", 1, 1280, 720, DAMAGE_SMALL },
+	{ "shm-scattered", 1, 1280, 720, DAMAGE_SCATTERED },
+	{ "shm-many", 32, 160, 120, DAMAGE_SMALL },
+	{ "subsurface-tree", 4, 320, 240, DAMAGE_SMALL, .subsurface_depth = 4 },
+	{ "viewport-scaled", 8, 160, 120, DAMAGE_FULL, .viewport_percent = 150 },
+	{ "rotated", 8, 160, 120, DAMAGE_FULL,
+	  .buffer_transform = WL_OUTPUT_TRANSFORM_90 },
+	{ "dmabuf-full", 1, 1280, 720, DAMAGE_FULL, .dmabuf = true },
+};
+
+struct bench_surface {
+	struct wl_surface *wl_surface;
+	struct wl_subsurface *subsurface;
+	struct wp_viewport *viewport;
+	struct buffer *buffer;
+};
+
+struct bench {
+	struct client *client;
+	const struct bench_case *bcase;
+	struct wp_presentation *presentation;
+	clockid_t clk_id;
+	struct wl_subcompositor *subcompositor;
+	struct wp_viewporter *viewporter;
+	struct zwp_linux_dmabuf_v1 *dmabuf;
+	int udmabuf_fd;
+
+	int n_surfaces;
+	struct bench_surface *surfaces;
+};
+
+struct frame_stats {
+	int64_t compositor_cpu_nsec;
+	int64_t latency_nsec;
+	int64_t allocs;
+};
+
+struct feedback {
+	bool done;
+	bool presented;
+	struct timespec time;
+};
+
+static void
+presentation_clock_id(void *data, struct wp_presentation *presentation,
+		      uint32_t clk_id)
+{
+	struct bench *bench = data;
+
+	bench->clk_id = clk_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	presentation_clock_id
+};
+
+static void
+feedback_sync_output(void *data,
+		     struct wp_presentation_feedback *presentation_feedback,
+		     struct wl_output *output)
+{
+}
+
+static void
+feedback_presented(void *data,
+		   struct wp_presentation_feedback *presentation_feedback,
+		   uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+		   uint32_t refresh_nsec, uint32_t seq_hi, uint32_t seq_lo,
+		   uint32_t flags)
+{
+	struct feedback *fb = data;
+
+	timespec_from_proto(&fb->time, tv_sec_hi, tv_sec_lo, tv_nsec);
+	fb->presented = true;
+	fb->done = true;
+	wp_presentation_feedback_destroy(presentation_feedback);
+}
+
+static void
+feedback_discarded(void *data,
+		   struct wp_presentation_feedback *presentation_feedback)
+{
+	struct feedback *fb = data;
+
+	fb->done = true;
+	wp_presentation_feedback_destroy(presentation_feedback);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	feedback_sync_output,
+	feedback_presented,
+	feedback_discarded
+};
+
+static struct buffer *
+create_udmabuf_buffer(struct bench *bench, int width, int height)
+{
+#ifdef HAVE_LINUX_UDMABUF_H
+	struct udmabuf_create create = { 0 };
+	struct zwp_linux_buffer_params_v1 *params;
+	struct buffer *buf;
+	size_t stride = width * 4;
+	size_t size;
+	void *data;
+	int memfd, dmabuf_fd;
+
+	size = stride * height;
+	size = (size + getpagesize() - 1) & ~(size_t)(getpagesize() - 1);
+
+	memfd = memfd_create("weston-bench-udmabuf", MFD_ALLOW_SEALING);
+	assert(memfd >= 0);
+	assert(ftruncate(memfd, size) == 0);
+	assert(fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) == 0);
+
+	create.memfd = memfd;
+	create.offset = 0;
+	create.size = size;
+	dmabuf_fd = ioctl(bench->udmabuf_fd, UDMABUF_CREATE, &create);
+	assert(dmabuf_fd >= 0);
+
+	data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	assert(data != MAP_FAILED);
+	close(memfd);
+
+	buf = xzalloc(sizeof *buf);
+	buf->len = size;
+	buf->image = pixman_image_create_bits(PIXMAN_x8r8g8b8, width, height,
+					      data, stride);
+	assert(buf->image);
+
+	params = zwp_linux_dmabuf_v1_create_params(bench->dmabuf);
+	zwp_linux_buffer_params_v1_add(params, dmabuf_fd, 0, 0, stride, 0, 0);
+	buf->proxy = zwp_linux_buffer_params_v1_create_immed(params, width,
+							     height,
+							     DRM_FORMAT_XRGB8888,
+							     0);
+	zwp_linux_buffer_params_v1_destroy(params);
+	close(dmabuf_fd);
+	assert(buf->proxy);
+
+	return buf;
+#else
+	return NULL;
+#endif
+}
+
+static void
+bench_surface_init(struct bench *bench, struct bench_surface *bsurf,
+		   struct wl_surface *parent, int x, int y)
+{
+	const struct bench_case *bcase = bench->bcase;
+	struct client *client = bench->client;
+	pixman_color_t color;
+
+	bsurf->wl_surface = wl_compositor_create_surface(client->wl_compositor);
+	assert(bsurf->wl_surface);
+
+	if (bcase->dmabuf)
+		bsurf->buffer = create_udmabuf_buffer(bench, bcase->width,
+						      bcase->height);
+	else
+		bsurf->buffer = create_shm_buffer_a8r8g8b8(client, bcase->width,
+							   bcase->height);
+
+	color_rgb888(&color, 64, 64, 64);
+	fill_image_with_color(bsurf->buffer->image, &color);
+
+	if (bcase->buffer_transform != WL_OUTPUT_TRANSFORM_NORMAL)
+		wl_surface_set_buffer_transform(bsurf->wl_surface,
+						bcase->buffer_transform);
+
+	if (bcase->viewport_percent > 0) {
+		bsurf->viewport = wp_viewporter_get_viewport(bench->viewporter,
+							     bsurf->wl_surface);
+		wp_viewport_set_destination(bsurf->viewport,
+					    bcase->width * bcase->viewport_percent / 100,
+					    bcase->height * bcase->viewport_percent / 100);
+	}
+
+	wl_surface_attach(bsurf->wl_surface, bsurf->buffer->proxy, 0, 0);
+	wl_surface_damage_buffer(bsurf->wl_surface, 0, 0,
+				 bcase->width, bcase->height);
+
+	if (parent) {
+		bsurf->subsurface =
+			wl_subcompositor_get_subsurface(bench->subcompositor,
+							bsurf->wl_surface,
+							parent);
+		wl_subsurface_set_position(bsurf->subsurface, x, y);
+	} else {
+		weston_test_move_surface(client->test->weston_test,
+					 bsurf->wl_surface, x, y);
+	}
+}
+
+static void
+bench_surface_fini(struct bench_surface *bsurf)
+{
+	if (bsurf->viewport)
+		wp_viewport_destroy(bsurf->viewport);
+	if (bsurf->subsurface)
+		wl_subsurface_destroy(bsurf->subsurface);
+	wl_surface_destroy(bsurf->wl_surface);
+	buffer_destroy(bsurf->buffer);
+}
+
+static void
+bench_surface_damage(struct bench *bench, struct bench_surface *bsurf,
+		     int frame)
+{
+	const struct bench_case *bcase = bench->bcase;
+	pixman_color_t color;
+	pixman_image_t *solid;
+	struct rectangle rects[64];
+	int n_rects = 0;
+	int x, y, i;
+
+	switch (bcase->damage) {
+	case DAMAGE_FULL:
+		rects[n_rects++] = (struct rectangle)
+			{ 0, 0, bcase->width, bcase->height };
+		break;
+	case DAMAGE_SMALL:
+		rects[n_rects++] = (struct rectangle)
+			{ (frame * 7) % (bcase->width - 16),
+			  (frame * 3) % (bcase->height - 16), 16, 16 };
+		break;
+	case DAMAGE_SCATTERED:
+		for (y = 0; y < 8; y++) {
+			for (x = 0; x < 8; x++) {
+				rects[n_rects++] = (struct rectangle)
+					{ (x * bcase->width / 8 + frame) %
+						(bcase->width - 8),
+					  y * bcase->height / 8, 8, 14 };
+			}
+		}
+		break;
+	}
+
+	color_rgb888(&color, frame * 37, frame * 11, frame * 5);
+	solid = pixman_image_create_solid_fill(&color);
+	for (i = 0; i < n_rects; i++) {
+		pixman_image_composite32(PIXMAN_OP_SRC, solid, NULL,
+					 bsurf->buffer->image,
+					 0, 0, 0, 0, rects[i].x, rects[i].y,
+					 rects[i].width, rects[i].height);
+		wl_surface_damage_buffer(bsurf->wl_surface,
+					 rects[i].x, rects[i].y,
+					 rects[i].width, rects[i].height);
+	}
+	pixman_image_unref(solid);
+
+	wl_surface_attach(bsurf->wl_surface, bsurf->buffer->proxy, 0, 0);
+}
+
+static bool
+bench_init_dmabuf(struct bench *bench)
+{
+#ifndef HAVE_LINUX_UDMABUF_H
+	return false;
+#else
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	struct global *g;
+
+	if (args->renderer != RENDERER_GL)
+		return false;
+
+	bench->udmabuf_fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+	if (bench->udmabuf_fd < 0)
+		return false;
+
+	wl_list_for_each(g, &bench->client->global_list, link) {
+		if (strcmp(g->interface, zwp_linux_dmabuf_v1_interface.name) == 0) {
+			bench->dmabuf = wl_registry_bind(bench->client->wl_registry,
+							 g->name,
+							 &zwp_linux_dmabuf_v1_interface,
+							 2);
+			return true;
+		}
+	}
+
+	return false;
+#endif
+}
+
+static bool
+bench_setup(struct bench *bench, const struct bench_case *bcase)
+{
+	int n_toplevels;
+	int depth = bcase->subsurface_depth;
+	int i, j, done;
+
+	memset(bench, 0, sizeof *bench);
+	bench->bcase = bcase;
+	bench->clk_id = CLOCK_MONOTONIC;
+	bench->udmabuf_fd = -1;
+
+	bench->client = create_client();
+	bench->presentation = bind_to_singleton_global(bench->client,
+						       &wp_presentation_interface,
+						       1);
+	wp_presentation_add_listener(bench->presentation,
+				     &presentation_listener, bench);
+	bench->subcompositor = bind_to_singleton_global(bench->client,
+							&wl_subcompositor_interface,
+							1);
+	bench->viewporter = bind_to_singleton_global(bench->client,
+						     &wp_viewporter_interface,
+						     1);
+	client_roundtrip(bench->client);
+
+	/* skip() would end the whole program, not just this case */
+	if (bcase->dmabuf && !bench_init_dmabuf(bench)) {
+		testlog("%s: udmabuf or linux-dmabuf with GL-renderer not "
+			"available, not running\n", bcase->name);
+		return false;
+	}
+
+	n_toplevels = getenv_int("WESTON_BENCH_SURFACES", bcase->n_surfaces);
+	bench->n_surfaces = n_toplevels * (1 + depth);
+	bench->surfaces = xzalloc(bench->n_surfaces * sizeof *bench->surfaces);
+
+	/* Surfaces are laid out in a grid, sub-surfaces cascade from their
+	 * parent. Each top-level is followed by its sub-surfaces, so that
+	 * committing in reverse order applies the whole tree at once. */
+	for (i = 0; i < n_toplevels; i++) {
+		struct bench_surface *top = &bench->surfaces[i * (1 + depth)];
+
+		bench_surface_init(bench, top, NULL,
+				   (i % 8) * 150, (i / 8) * 110);
+		for (j = 1; j <= depth; j++)
+			bench_surface_init(bench, &top[j], top[j - 1].wl_surface,
+					   10, 10);
+	}
+
+	for (i = bench->n_surfaces - 1; i >= 0; i--)
+		wl_surface_commit(bench->surfaces[i].wl_surface);
+
+	frame_callback_set(bench->surfaces[0].wl_surface, &done);
+	wl_surface_commit(bench->surfaces[0].wl_surface);
+	frame_callback_wait(bench->client, &done);
+
+	return true;
+}
+
+static void
+bench_teardown(struct bench *bench)
+{
+	int i;
+
+	for (i = bench->n_surfaces - 1; i >= 0; i--)
+		bench_surface_fini(&bench->surfaces[i]);
+	free(bench->surfaces);
+
+	if (bench->dmabuf)
+		zwp_linux_dmabuf_v1_destroy(bench->dmabuf);
+	if (bench->udmabuf_fd >= 0)
+		close(bench->udmabuf_fd);
+	wp_viewporter_destroy(bench->viewporter);
+	wl_subcompositor_destroy(bench->subcompositor);
+	wp_presentation_destroy(bench->presentation);
+	client_destroy(bench->client);
+}
+
+static void
+bench_frame(struct bench *bench, int frame, struct frame_stats *stats)
+{
+	struct wp_presentation_feedback *fb_obj;
+	struct feedback fb = { 0 };
+	struct timespec commit_time;
+	struct timespec proc_begin, proc_end, thread_begin, thread_end;
+	int64_t allocs_begin;
+	int i, done;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &proc_begin);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_begin);
+	allocs_begin = read_alloc_count();
+
+	for (i = 0; i < bench->n_surfaces; i++)
+		bench_surface_damage(bench, &bench->surfaces[i], frame);
+
+	fb_obj = wp_presentation_feedback(bench->presentation,
+					  bench->surfaces[0].wl_surface);
+	wp_presentation_feedback_add_listener(fb_obj, &feedback_listener, &fb);
+	frame_callback_set(bench->surfaces[0].wl_surface, &done);
+
+	clock_gettime(bench->clk_id, &commit_time);
+	for (i = bench->n_surfaces - 1; i >= 0; i--)
+		wl_surface_commit(bench->surfaces[i].wl_surface);
+
+	frame_callback_wait(bench->client, &done);
+	while (!fb.done)
+		assert(wl_display_dispatch(bench->client->wl_display) >= 0);
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &proc_end);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_end);
+
+	stats->compositor_cpu_nsec =
+		timespec_sub_to_nsec(&proc_end, &proc_begin) -
+		timespec_sub_to_nsec(&thread_end, &thread_begin);
+	stats->latency_nsec = fb.presented ?
+		timespec_sub_to_nsec(&fb.time, &commit_time) : -1;
+	stats->allocs = allocs_begin >= 0 ?
+		read_alloc_count() - allocs_begin : -1;
+}
+
+static void
+report(const struct bench *bench, const struct frame_stats *stats, int count)
+{
+	const struct setup_args *args = &my_setup_args[get_test_fixture_index()];
+	int64_t *latency = xzalloc(count * sizeof *latency);
+	int64_t cpu_total = 0, allocs_total = 0;
+	int n_latency = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		cpu_total += stats[i].compositor_cpu_nsec;
+		allocs_total += stats[i].allocs;
+		if (stats[i].latency_nsec >= 0)
+			latency[n_latency++] = stats[i].latency_nsec;
+	}
+	qsort(latency, n_latency, sizeof *latency, compare_int64);
+
+	printf("# bench {\"renderer\":\"%s\",\"case\":\"%s\","
+	       "\"surfaces\":%d,\"frames\":%d,"
+	       "\"repaint_cpu_us_mean\":%.1f,"
+	       "\"latency_us_median\":%.1f,\"latency_us_p95\":%.1f,"
+	       "\"allocs_per_frame\":%.1f}\n",
+	       args->renderer_name, bench->bcase->name,
+	       bench->n_surfaces, count,
+	       cpu_total / 1000.0 / count,
+	       n_latency ? latency[n_latency / 2] / 1000.0 : -1.0,
+	       n_latency ? latency[n_latency * 95 / 100] / 1000.0 : -1.0,
+	       stats[0].allocs >= 0 ? (double)allocs_total / count : -1.0);
+	fflush(stdout);
+
+	free(latency);
+}
+
+TEST_P(repaint_benchmark, bench_cases)
+{
+	const struct bench_case *bcase = data;
+	struct bench bench;
+	struct frame_stats *stats;
+	int n_frames = getenv_int("WESTON_BENCH_FRAMES", DEFAULT_FRAMES);
+	int frame;
+
+	mark_client_thread();
+
+	if (!bench_setup(&bench, bcase)) {
+		bench_teardown(&bench);
+		return;
+	}
+
+	stats = xzalloc(n_frames * sizeof *stats);
+	for (frame = 0; frame < WARMUP_FRAMES + n_frames; frame++) {
+		struct frame_stats tmp;
+
+		bench_frame(&bench, frame, &tmp);
+		if (frame >= WARMUP_FRAMES)
+			stats[frame - WARMUP_FRAMES] = tmp;
+	}
+
+	report(&bench, stats, n_frames);
+
+	free(stats);
+	bench_teardown(&bench);
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Output throughput benchmark of weston-terminal.
+ *
+ * Each case writes a file made of one repeated line, then runs
+ * weston-terminal in the test compositor with a "shell" that only cats
+ * that file. The terminal exits once the pty is drained and the shell is
+ * gone, which is detected through a pipe inherited by both. A run with
+ * an empty file measures the startup and teardown time, which is
+ * subtracted from every case.
+ *
+ * The results are printed as TAP diagnostic lines of the form
+ * "# bench {json}", one per case, with the throughput in MB/s.
+ *
+ * The WESTON_BENCH_MBYTES environment variable overrides the size of the
+ * output of every case, in MiB.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <libweston/libweston.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "weston-bench-helper.h"
+#include "weston-test-client-helper.h"
+#include "weston-test-fixture-compositor.h"
+
+#define DEFAULT_MBYTES 32
+
+struct bench_case {
+	const char *name;
+	const char *line;
+};
+
+static const struct bench_case bench_cases[] = {
+	{
+		"ascii",
+		"Oct 18 12:00:00 host kernel: [ 1234.567890] usb 1-1: "
+		"new high-speed USB device number 2 using xhci_hcd\n",
+	},
+	{
+		"sgr",
+		"\033[1;32mPASS\033[0m tests/\033[34mmodule\033[0m.c:42: "
+		"\033[33mwarning:\033[0m unused variable [-Wunused]\n",
+	},
+	{
+		"utf8",
+		"Grüße, café, naïve: ½ µs → ≤ 3 × ∑ "
+		"日本語のテキスト ελληνικά\n",
+	},
+};
+
+static enum test_result_code
+fixture_setup(struct weston_test_harness *harness)
+{
+	struct compositor_setup setup;
+
+	compositor_setup_defaults(&setup);
+	setup.width = 1024;
+	setup.height = 768;
+	setup.logging_scopes = "log";
+
+	return weston_test_harness_execute_as_client(harness, &setup);
+}
+DECLARE_FIXTURE_SETUP(fixture_setup);
+
+static size_t
+write_payload(const char *path, const char *line, size_t size)
+{
+	size_t line_len = strlen(line);
+	size_t written = 0;
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	assert(fp);
+
+	while (written < size) {
+		assert(fwrite(line, 1, line_len, fp) == line_len);
+		written += line_len;
+	}
+
+	assert(fclose(fp) == 0);
+
+	return written;
+}
+
+static void
+write_shell(const char *path, const char *payload_path)
+{
+	FILE *fp;
+
+	fp = fopen(path, "w");
+	assert(fp);
+	fprintf(fp, "#!/bin/sh\nexec cat '%s'\n", payload_path);
+	assert(fclose(fp) == 0);
+	assert(chmod(path, 0700) == 0);
+}
+
+/* Returns the time in nanoseconds from launching weston-terminal to the
+ * exit of both the terminal and its shell. */
+static int64_t
+run_terminal(const char *terminal_path, const char *shell_path)
+{
+	struct timespec begin, end;
+	char *shell_arg;
+	char buf[16];
+	int fds[2];
+	ssize_t len;
+	pid_t pid;
+
+	str_printf(&shell_arg, "--shell=%s", shell_path);
+	assert(shell_arg);
+	assert(pipe2(fds, O_CLOEXEC) == 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		/* Keep the write end open in the terminal and its shell. */
+		if (fcntl(fds[1], F_SETFD, 0) < 0)
+			_exit(EXIT_FAILURE);
+		execl(terminal_path, terminal_path, shell_arg, NULL);
+		_exit(EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	do {
+		len = read(fds[0], buf, sizeof buf);
+	} while (len > 0 || (len < 0 && errno == EINTR));
+	assert(len == 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	close(fds[0]);
+	free(shell_arg);
+
+	/* The compositor reaps the terminal, it is our child too. */
+	return timespec_sub_to_nsec(&end, &begin);
+}
+
+TEST(terminal_output_benchmark)
+{
+	size_t size = (size_t)getenv_int("WESTON_BENCH_MBYTES",
+					  DEFAULT_MBYTES) << 20;
+	char terminal_path[PATH_MAX];
+	char dir[] = "/tmp/weston-terminal-bench-XXXXXX";
+	char *payload_path, *shell_path;
+	int64_t startup_ns, ns;
+	size_t bytes;
+	unsigned i;
+
+	assert(weston_module_path_from_env("weston-terminal", terminal_path,
+					   sizeof terminal_path) > 0);
+	assert(mkdtemp(dir));
+	str_printf(&payload_path, "%s/payload", dir);
+	str_printf(&shell_path, "%s/shell", dir);
+	assert(payload_path && shell_path);
+
+	write_shell(shell_path, payload_path);
+
+	write_payload(payload_path, "", 0);
+	startup_ns = run_terminal(terminal_path, shell_path);
+
+	for (i = 0; i < ARRAY_LENGTH(bench_cases); i++) {
+		bytes = write_payload(payload_path, bench_cases[i].line, size);
+		ns = run_terminal(terminal_path, shell_path) - startup_ns;
+		if (ns <= 0)
+			ns = 1;
+
+		printf("# bench {\"case\":\"%s\",\"bytes\":%zu,"
+		       "\"startup_ms\":%.3f,\"ms\":%.3f,\"mb_per_s\":%.2f}\n",
+		       bench_cases[i].name, bytes, startup_ns / 1e6, ns / 1e6,
+		       (bytes / 1048576.0) / (ns / 1e9));
+		fflush(stdout);
+	}
+
+	unlink(payload_path);
+	unlink(shell_path);
+	rmdir(dir);
+	free(payload_path);
+	free(shell_path);
+}
@@ -0,0 +1,367 @@
+/*
+ * Copyright © 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Benchmark of the batched point transformation and quad clipping used by
+ * the GL renderer to build its vertices, against the one point and one
+ * polygon at a time functions they replace.
+ *
+ * The transformation cases cover every kind of weston_matrix.type, with
+ * the random matrices of matrix-test for the projective one. The clipping
+ * cases use the bounding box of vertex-clip-test, and quads around it with
+ * or without rotation. Both sides must agree, which is checked as well.
+ *
+ * The results are printed as TAP diagnostic lines of the form
+ * "# bench {json}", one per case.
+ *
+ * The WESTON_BENCH_POINTS environment variable overrides the number of
+ * points transformed or quad corners clipped per round, and
+ * WESTON_BENCH_ROUNDS the number of rounds.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libweston/matrix.h>
+
+#include "shared/helpers.h"
+#include "shared/timespec-util.h"
+#include "shared/xalloc.h"
+#include "vertex-clipping.h"
+#include "weston-bench-helper.h"
+#include "weston-test-runner.h"
+
+#define DEFAULT_POINTS 4096
+#define DEFAULT_ROUNDS 2000
+
+/* see vertex-clip-test.c */
+#define BOUNDING_BOX_TOP_Y 100.0f
+#define BOUNDING_BOX_LEFT_X 50.0f
+#define BOUNDING_BOX_RIGHT_X 100.0f
+#define BOUNDING_BOX_BOTTOM_Y 50.0f
+
+/* see matrix-test.c */
+static double
+frand(void)
+{
+	double r = random();
+	return r / (double)(RAND_MAX / 2) - 1.0f;
+}
+
+static void
+print_result(const char *name, const char *kind, int n_items, int rounds,
+	     int64_t single_ns, int64_t batch_ns)
+{
+	double items = (double) n_items * rounds;
+
+	if (single_ns <= 0)
+		single_ns = 1;
+	if (batch_ns <= 0)
+		batch_ns = 1;
+
+	printf("# bench {\"case\":\"%s\",\"%s\":%d,\"rounds\":%d,"
+	       "\"single_ns_per_item\":%.2f,\"batch_ns_per_item\":%.2f,"
+	       "\"speedup\":%.2f}\n",
+	       name, kind, n_items, rounds,
+	       single_ns / items, batch_ns / items,
+	       (double) single_ns / batch_ns);
+	fflush(stdout);
+}
+
+struct matrix_case {
+	const char *name;
+	void (*build)(struct weston_matrix *m);
+};
+
+static void
+build_translate(struct weston_matrix *m)
+{
+	weston_matrix_translate(m, 123.0f, -45.5f, 0.0f);
+}
+
+static void
+build_scale(struct weston_matrix *m)
+{
+	weston_matrix_scale(m, 1.5f, 0.75f, 1.0f);
+	weston_matrix_translate(m, 123.0f, -45.5f, 0.0f);
+}
+
+static void
+build_rotate(struct weston_matrix *m)
+{
+	weston_matrix_translate(m, -320.0f, -240.0f, 0.0f);
+	weston_matrix_rotate_xy(m, cosf(0.3f), sinf(0.3f));
+	weston_matrix_scale(m, 1.5f, 1.5f, 1.0f);
+	weston_matrix_translate(m, 640.0f, 480.0f, 0.0f);
+}
+
+static void
+build_other(struct weston_matrix *m)
+{
+	unsigned i;
+
+	for (i = 0; i < 16; ++i)
+		m->d[i] = frand() * exp(10.0 * frand());
+	m->type = WESTON_MATRIX_TRANSFORM_OTHER;
+}
+
+static const struct matrix_case matrix_cases[] = {
+	{ "translate", build_translate },
+	{ "scale", build_scale },
+	{ "rotate", build_rotate },
+	{ "other", build_other },
+};
+
+static void
+check_points(struct weston_matrix *m, const float *x, const float *y,
+	     const float *out_x, const float *out_y, int n)
+{
+	struct weston_vector v;
+	float ex, ey;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		v.f[0] = x[i];
+		v.f[1] = y[i];
+		v.f[2] = 0.0f;
+		v.f[3] = 1.0f;
+		weston_matrix_transform(m, &v);
+		if (fabsf(v.f[3]) < 1e-6f)
+			continue;
+
+		ex = v.f[0] / v.f[3];
+		ey = v.f[1] / v.f[3];
+		assert(fabsf(ex - out_x[i]) <= 1e-4f * fmaxf(1.0f, fabsf(ex)));
+		assert(fabsf(ey - out_y[i]) <= 1e-4f * fmaxf(1.0f, fabsf(ey)));
+	}
+}
+
+TEST(matrix_transform_points_benchmark)
+{
+	int n_points = getenv_int("WESTON_BENCH_POINTS", DEFAULT_POINTS);
+	int rounds = getenv_int("WESTON_BENCH_ROUNDS", DEFAULT_ROUNDS);
+	float *x, *y, *out_x, *out_y;
+	struct weston_matrix m;
+	struct weston_vector v;
+	struct timespec begin, end;
+	int64_t single_ns, batch_ns;
+	unsigned c;
+	int i, r;
+
+	x = xzalloc(n_points * sizeof *x);
+	y = xzalloc(n_points * sizeof *y);
+	out_x = xzalloc(n_points * sizeof *out_x);
+	out_y = xzalloc(n_points * sizeof *out_y);
+
+	srandom(4321);
+	for (i = 0; i < n_points; i++) {
+		x[i] = 1000.0 * frand();
+		y[i] = 1000.0 * frand();
+	}
+
+	for (c = 0; c < ARRAY_LENGTH(matrix_cases); c++) {
+		weston_matrix_init(&m);
+		matrix_cases[c].build(&m);
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (r = 0; r < rounds; r++) {
+			for (i = 0; i < n_points; i++) {
+				v.f[0] = x[i];
+				v.f[1] = y[i];
+				v.f[2] = 0.0f;
+				v.f[3] = 1.0f;
+				weston_matrix_transform(&m, &v);
+				if (fabsf(v.f[3]) < 1e-6f) {
+					out_x[i] = out_y[i] = 0.0f;
+					continue;
+				}
+				out_x[i] = v.f[0] / v.f[3];
+				out_y[i] = v.f[1] / v.f[3];
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		single_ns = timespec_sub_to_nsec(&end, &begin);
+
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (r = 0; r < rounds; r++)
+			weston_matrix_transform_points(&m, x, y, out_x, out_y,
+						       n_points);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		batch_ns = timespec_sub_to_nsec(&end, &begin);
+
+		check_points(&m, x, y, out_x, out_y, n_points);
+		print_result(matrix_cases[c].name, "points", n_points, rounds,
+			     single_ns, batch_ns);
+	}
+
+	free(x);
+	free(y);
+	free(out_x);
+	free(out_y);
+}
+
+static void
+make_quads(float *x, float *y, int n_quads, bool rotated)
+{
+	float cx, cy, angle, c, s;
+	int i, k;
+
+	for (i = 0; i < n_quads; i++) {
+		/* Centered anywhere from fully outside to fully inside. */
+		cx = 75.0f + 50.0f * frand();
+		cy = 75.0f + 50.0f * frand();
+		angle = rotated ? M_PI * frand() : 0.0f;
+		c = 20.0f * cosf(angle);
+		s = 20.0f * sinf(angle);
+
+		for (k = 0; k < 4; k++) {
+			/* clockwise corners of a square */
+			float ux = (k == 0 || k == 3) ? -1.0f : 1.0f;
+			float uy = (k < 2) ? -1.0f : 1.0f;
+
+			x[4 * i + k] = cx + ux * c - uy * s;
+			y[4 * i + k] = cy + ux * s + uy * c;
+		}
+	}
+}
+
+/* The per polygon path of the GL renderer before clip_quads(). */
+static int
+clip_one(struct clip_context *ctx, const float *x, const float *y,
+	 bool transformed, float *ex, float *ey)
+{
+	struct polygon8 surf = {
+		{ x[0], x[1], x[2], x[3] },
+		{ y[0], y[1], y[2], y[3] },
+		4
+	};
+	float min_x, max_x, min_y, max_y;
+	int i, n;
+
+	min_x = max_x = surf.x[0];
+	min_y = max_y = surf.y[0];
+	for (i = 1; i < 4; i++) {
+		min_x = MIN(min_x, surf.x[i]);
+		max_x = MAX(max_x, surf.x[i]);
+		min_y = MIN(min_y, surf.y[i]);
+		max_y = MAX(max_y, surf.y[i]);
+	}
+
+	if ((min_x >= ctx->clip.x2) || (max_x <= ctx->clip.x1) ||
+	    (min_y >= ctx->clip.y2) || (max_y <= ctx->clip.y1))
+		return 0;
+
+	if (!transformed)
+		return clip_simple(ctx, &surf, ex, ey);
+
+	n = clip_transformed(ctx, &surf, ex, ey);
+
+	return n < 3 ? 0 : n;
+}
+
+TEST(clip_quads_benchmark)
+{
+	int n_quads = getenv_int("WESTON_BENCH_POINTS", DEFAULT_POINTS) / 4;
+	int rounds = getenv_int("WESTON_BENCH_ROUNDS", DEFAULT_ROUNDS);
+	struct polygon8 clipped[CLIP_QUADS_MAX];
+	struct clip_context ctx;
+	struct timespec begin, end;
+	int64_t single_ns, batch_ns;
+	int single_count, batch_count;
+	float ex[8], ey[8];
+	float *x, *y;
+	int rotated, i, j, r, n;
+
+	if (n_quads < 1)
+		n_quads = 1;
+
+	x = xzalloc(n_quads * 4 * sizeof *x);
+	y = xzalloc(n_quads * 4 * sizeof *y);
+
+	ctx.clip.x1 = BOUNDING_BOX_LEFT_X;
+	ctx.clip.y1 = BOUNDING_BOX_BOTTOM_Y;
+	ctx.clip.x2 = BOUNDING_BOX_RIGHT_X;
+	ctx.clip.y2 = BOUNDING_BOX_TOP_Y;
+
+	srandom(1234);
+	for (rotated = 0; rotated < 2; rotated++) {
+		make_quads(x, y, n_quads, rotated);
+
+		single_count = 0;
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (r = 0; r < rounds; r++) {
+			for (i = 0; i < n_quads; i++)
+				single_count += clip_one(&ctx, &x[4 * i],
+							 &y[4 * i], rotated,
+							 ex, ey) > 0;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		single_ns = timespec_sub_to_nsec(&end, &begin);
+
+		batch_count = 0;
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		for (r = 0; r < rounds; r++) {
+			for (i = 0; i < n_quads; i += n) {
+				n = MIN(n_quads - i, CLIP_QUADS_MAX);
+				batch_count += clip_quads(&ctx, &x[4 * i],
+							  &y[4 * i], n,
+							  rotated, clipped);
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		batch_ns = timespec_sub_to_nsec(&end, &begin);
+
+		assert(single_count == batch_count);
+
+		/* Same polygons, vertex for vertex. */
+		for (i = 0; i < n_quads; i += n) {
+			n = MIN(n_quads - i, CLIP_QUADS_MAX);
+			clip_quads(&ctx, &x[4 * i], &y[4 * i], n, rotated,
+				   clipped);
+			for (j = 0; j < n; j++) {
+				int k, m;
+
+				m = clip_one(&ctx, &x[4 * (i + j)],
+					     &y[4 * (i + j)], rotated, ex, ey);
+				assert(m == clipped[j].n);
+				for (k = 0; k < m; k++) {
+					assert(ex[k] == clipped[j].x[k]);
+					assert(ey[k] == clipped[j].y[k]);
+				}
+			}
+		}
+
+		print_result(rotated ? "clip-rotated" : "clip-aligned",
+			     "quads", n_quads, rounds, single_ns, batch_ns);
+	}
+
+	free(x);
+	free(y);
+}
@@ -221,3 +221,69 @@ TEST(float_difference_same)
 	assert(float_difference(1.0f, 1.0f) == 0.0f);
 }
 
+TEST(clip_quads_expected_vertices)
+{
+	struct clip_context ctx;
+	struct polygon8 clipped[CLIP_QUADS_MAX];
+	const struct vertex_clip_test_data *quads[CLIP_QUADS_MAX];
+	float x[CLIP_QUADS_MAX * 4], y[CLIP_QUADS_MAX * 4];
+	int i, k, n = 0;
+
+	/* All the quads of test_data, clipped in one batch. */
+	for (i = 0; i < (int) ARRAY_LENGTH(test_data); i++) {
+		if (test_data[i].surface.n != 4)
+			continue;
+
+		assert(n < CLIP_QUADS_MAX);
+		for (k = 0; k < 4; k++) {
+			x[4 * n + k] = test_data[i].surface.x[k];
+			y[4 * n + k] = test_data[i].surface.y[k];
+		}
+		quads[n++] = &test_data[i];
+	}
+
+	populate_clip_context(&ctx);
+	assert(clip_quads(&ctx, x, y, n, true, clipped) == n);
+
+	for (i = 0; i < n; i++) {
+		assert(clipped[i].n == quads[i]->expected.n);
+		for (k = 0; k < clipped[i].n; k++) {
+			assert(clipped[i].x[k] == quads[i]->expected.x[k]);
+			assert(clipped[i].y[k] == quads[i]->expected.y[k]);
+		}
+	}
+}
+
+TEST(clip_quads_reject_outside)
+{
+	struct clip_context ctx;
+	struct polygon8 clipped[5];
+	/* Four quads around the bounding box, one inside. */
+	float x[] = {
+		OUTSIDE_X1 - 10, OUTSIDE_X1, OUTSIDE_X1, OUTSIDE_X1 - 10,
+		OUTSIDE_X2, OUTSIDE_X2 + 10, OUTSIDE_X2 + 10, OUTSIDE_X2,
+		INSIDE_X1, INSIDE_X2, INSIDE_X2, INSIDE_X1,
+		INSIDE_X1, INSIDE_X2, INSIDE_X2, INSIDE_X1,
+		OUTSIDE_X1, OUTSIDE_X2, OUTSIDE_X2, OUTSIDE_X1,
+	};
+	float y[] = {
+		INSIDE_Y1, INSIDE_Y1, INSIDE_Y2, INSIDE_Y2,
+		INSIDE_Y1, INSIDE_Y1, INSIDE_Y2, INSIDE_Y2,
+		OUTSIDE_Y1 - 10, OUTSIDE_Y1 - 10, OUTSIDE_Y1, OUTSIDE_Y1,
+		OUTSIDE_Y2, OUTSIDE_Y2, OUTSIDE_Y2 + 10, OUTSIDE_Y2 + 10,
+		OUTSIDE_Y1, OUTSIDE_Y1, OUTSIDE_Y2, OUTSIDE_Y2,
+	};
+	int i;
+
+	populate_clip_context(&ctx);
+	assert(clip_quads(&ctx, x, y, 5, false, clipped) == 1);
+
+	for (i = 0; i < 4; i++)
+		assert(clipped[i].n == 0);
+
+	assert(clipped[4].n == 4);
+	assert(clipped[4].x[0] == BOUNDING_BOX_LEFT_X);
+	assert(clipped[4].y[0] == BOUNDING_BOX_BOTTOM_Y);
+	assert(clipped[4].x[2] == BOUNDING_BOX_RIGHT_X);
+	assert(clipped[4].y[2] == BOUNDING_BOX_TOP_Y);
+}
@@ -182,6 +182,7 @@ wet_shell_init(struct weston_compositor *ec,
 	       int *argc, char *argv[])
 {
 	struct desktest_shell *dts;
+	pixman_region32_t input;
 
 	dts = zalloc(sizeof *dts);
 	if (!dts)
@@ -213,8 +214,9 @@ wet_shell_init(struct weston_compositor *ec,
 	weston_surface_set_color(dts->background_surface, 0.16, 0.32, 0.48, 1.);
 	pixman_region32_fini(&dts->background_surface->opaque);
 	pixman_region32_init_rect(&dts->background_surface->opaque, 0, 0, 2000, 2000);
-	pixman_region32_fini(&dts->background_surface->input);
-	pixman_region32_init_rect(&dts->background_surface->input, 0, 0, 2000, 2000);
+	pixman_region32_init_rect(&input, 0, 0, 2000, 2000);
+	weston_surface_set_input_region(dts->background_surface, &input);
+	pixman_region32_fini(&input);
 
 	weston_surface_set_size(dts->background_surface, 2000, 2000);
 	weston_view_set_position(dts->background_view, 0, 0);
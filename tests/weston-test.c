@@ -145,8 +145,10 @@ notify_pointer_position(struct weston_test *test, struct wl_resource *resource)
 {
 	struct weston_seat *seat = get_seat(test);
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
+	wl_fixed_t x, y;
 
-	weston_test_send_pointer_position(resource, pointer->x, pointer->y);
+	weston_pointer_get_pending_position(pointer, &x, &y);
+	weston_test_send_pointer_position(resource, x, y);
 }
 
 static void
@@ -286,16 +288,21 @@ move_pointer(struct wl_client *client, struct wl_resource *resource,
 	struct weston_pointer *pointer = weston_seat_get_pointer(seat);
 	struct weston_pointer_motion_event event = { 0 };
 	struct timespec time;
+	wl_fixed_t cur_x, cur_y;
+
+	/* Relative to where coalesced motion will take the pointer. */
+	weston_pointer_get_pending_position(pointer, &cur_x, &cur_y);
 
 	event = (struct weston_pointer_motion_event) {
 		.mask = WESTON_POINTER_MOTION_REL,
-		.dx = wl_fixed_to_double(wl_fixed_from_int(x) - pointer->x),
-		.dy = wl_fixed_to_double(wl_fixed_from_int(y) - pointer->y),
+		.dx = wl_fixed_to_double(wl_fixed_from_int(x) - cur_x),
+		.dy = wl_fixed_to_double(wl_fixed_from_int(y) - cur_y),
 	};
 
 	timespec_from_proto(&time, tv_sec_hi, tv_sec_lo, tv_nsec);
 
 	notify_motion(seat, &time, &event);
+	notify_pointer_frame(seat);
 
 	notify_pointer_position(test, resource);
 }
@@ -36,8 +36,6 @@
 #include <string.h>
 #include <fcntl.h>
 
-#include <cairo.h>
-
 #include "wcap-decode.h"
 
 static void
@@ -139,6 +139,10 @@ struct weston_wm_window {
 	xcb_window_t frame_id;
 	struct frame *frame;
 	cairo_surface_t *cairo_surface;
+	/* what the frame window shows, to skip redundant redraws */
+	bool decoration_valid;
+	const char *decoration_how;
+	int decoration_width, decoration_height;
 	uint32_t surface_id;
 	struct weston_surface *surface;
 	struct weston_desktop_xwayland_surface *shsurf;
@@ -1214,6 +1218,7 @@ weston_wm_handle_map_request(struct weston_wm *wm, xcb_generic_event_t *event)
 
 	xcb_map_window(wm->conn, map_request->window);
 	xcb_map_window(wm->conn, window->frame_id);
+	window->decoration_valid = false;
 
 	/* Mapped in the X server, we can draw immediately.
 	 * Cannot set pending state though, no weston_surface until
@@ -1278,6 +1283,7 @@ weston_wm_handle_unmap_notify(struct weston_wm *wm, xcb_generic_event_t *event)
 	weston_wm_window_set_virtual_desktop(window, -1);
 
 	xcb_unmap_window(wm->conn, window->frame_id);
+	window->decoration_valid = false;
 }
 
 static void
@@ -1289,18 +1295,36 @@ weston_wm_window_draw_decoration(struct weston_wm_window *window)
 
 	weston_wm_window_get_frame_size(window, &width, &height);
 
+	if (window->fullscreen) {
+		how = "fullscreen";
+	} else if (window->decorate) {
+		how = "decorate";
+		frame_set_title(window->frame, window->name);
+	} else {
+		how = "shadow";
+	}
+
+	/* The frame window keeps its content while it stays mapped, so
+	 * only draw when the size, the kind or the frame state changed. */
+	if (window->decoration_valid &&
+	    window->decoration_how == how &&
+	    window->decoration_width == width &&
+	    window->decoration_height == height &&
+	    !(window->decorate && !window->fullscreen &&
+	      (frame_status(window->frame) & FRAME_STATUS_REPAINT))) {
+		wm_printf(window->wm, "XWM: decoration unchanged, win %d\n",
+			  window->id);
+		return;
+	}
+
 	cairo_xcb_surface_set_size(window->cairo_surface, width, height);
 	cr = cairo_create(window->cairo_surface);
 
 	if (window->fullscreen) {
-		how = "fullscreen";
 		/* nothing */
 	} else if (window->decorate) {
-		how = "decorate";
-		frame_set_title(window->frame, window->name);
 		frame_repaint(window->frame, cr);
 	} else {
-		how = "shadow";
 		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
 		cairo_set_source_rgba(cr, 0, 0, 0, 0);
 		cairo_paint(cr);
@@ -1315,6 +1339,11 @@ weston_wm_window_draw_decoration(struct weston_wm_window *window)
 	cairo_destroy(cr);
 	cairo_surface_flush(window->cairo_surface);
 	xcb_flush(window->wm->conn);
+
+	window->decoration_valid = true;
+	window->decoration_how = how;
+	window->decoration_width = width;
+	window->decoration_height = height;
 }
 
 static void